@@ -285,8 +285,7 @@ void vvComponentArithmeticTemplate(vtkVVPluginInfo *info,
   int i, j, k, l;
   for ( k = 0; k < dim[2]; k++ )                                      
     {                                                                 
-    info->UpdateProgress(info,(float)1.0*k/dim[2],"Processing..."); 
-    abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
+    abort = info->ReportProgress(info,(float)1.0*k/dim[2],"Processing..."); 
     for ( j = 0; !abort && j < dim[1]; j++ )                          
       {          
       switch (oper)
@@ -11,83 +11,102 @@
 =========================================================================*/
 
 #include "vtkVVPluginAPI.h"
+#include "vvPluginExpression.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string>
 
+/* the expression to evaluate, from the operator or the expression entry */
+static std::string vvImageMathematicsExpression(vtkVVPluginInfo *info)
+{
+  const char *label = info->GetGUIProperty(info, 0, VVP_GUI_VALUE);
+  static const char *operators[][2] =
+    {
+      { "+", "A + B" },
+      { "-", "A - B" },
+      { "*", "A * B" },
+      { "/", "A / B" },
+      { "|-|", "abs(A - B)" }
+    };
+  int i;
+  for (i = 0; label && i < 5; ++i)
+    {
+    if (!strcmp(label, operators[i][0]))
+      {
+      return operators[i][1];
+      }
+    }
+  const char *text = info->GetGUIProperty(info, 1, VVP_GUI_VALUE);
+  return text ? text : "";
+}
 
-#define ApplyImageMathFilterMacro( COMPARISON )                         \
-    int i, j, k;                                                        \
-    for ( k = 0; k < dim[2]; k++ )                                      \
-      {                                                                 \
-      info->UpdateProgress(info,(float)1.0*k/dim[2],"ImageMathing..."); \
-      abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));       \
-      for ( j = 0; !abort && j < dim[1]; j++ )                          \
-        {                                                               \
-        for ( i = 0; i < nc*dim[0]; i++ )                               \
-          {                                                             \
-          *ptr = ( COMPARISON );                                        \
-          ++ptr;                                                        \
-          ++ptr2;                                                       \
-          }                                                             \
-        }                                                               \
-      }                                                                 \
-    info->UpdateProgress(info,(float)1.0,"ImageMathing Complete");
-
+/* values that float holds exactly are computed in float, on the vector
+ * registers, the others in double */
+template <class T>
+inline int vvImageMathematicsFitsFloat()
+{
+  return !std::numeric_limits<T>::is_integer ? sizeof(T) <= sizeof(float) :
+    sizeof(T) <= 2;
+}
 
 //-----------------------------------------------------------
-template <class IT, class I2T>
-void vvImageMathematicsTemplate2(vtkVVPluginInfo *info,
-                             vtkVVProcessDataStruct *pds, 
-                             IT *, I2T *)
+template <class R, class IT, class I2T>
+void vvImageMathematicsExecute(vtkVVPluginInfo *info,
+                               vtkVVProcessDataStruct *pds,
+                               const std::string &text, IT *, I2T *)
 {
-  IT *ptr = (IT *)pds->outData;
-  I2T *ptr2 = (I2T *)pds->inData2;
-
   int *dim = info->InputVolumeDimensions;
-
-  int abort = 0;
-  int inNumCom = info->InputVolumeNumberOfComponents;
-  int inNumCom2 = info->InputVolume2NumberOfComponents;
   int nc = info->InputVolumeNumberOfComponents;
-  const char *label = info->GetGUIProperty(info, 0, VVP_GUI_VALUE);
-  
-  if (!strcmp(label,"+"))
-    {
-    ApplyImageMathFilterMacro( (*ptr)+(*ptr2) );
-    }
-  if (!strcmp(label,"-"))
-    {
-    ApplyImageMathFilterMacro( (*ptr)-(*ptr2) );
-    }
-  if (!strcmp(label,"*"))
+  vvExpression<R> expression;
+  expression.Parse(text.c_str());
+
+  /* the slices of this piece, the whole volume when processing in place */
+  size_t sliceSize = (size_t)nc*dim[0]*dim[1];
+  IT *inPtr = (IT *)pds->inData + sliceSize*pds->StartSlice;
+  I2T *inPtr2 = (I2T *)pds->inData2 + sliceSize*pds->StartSlice;
+  IT *outPtr = (IT *)pds->outData;
+
+  vvExpressionKernel<R, IT, I2T> kernel(expression, inPtr, inPtr2);
+  if (vvPluginExecuteKernel(info, kernel, inPtr, outPtr,
+                            sliceSize*pds->NumberOfSlicesToProcess,
+                            "ImageMathing..."))
     {
-    ApplyImageMathFilterMacro( (*ptr)*(*ptr2) );
+    info->UpdateProgress(info,(float)1.0,"ImageMathing Complete");
     }
-  if (!strcmp(label,"/"))
+}
+
+//-----------------------------------------------------------
+template <class IT, class I2T>
+void vvImageMathematicsTemplate2(vtkVVPluginInfo *info,
+                                 vtkVVProcessDataStruct *pds,
+                                 const std::string &text,
+                                 IT *, I2T *)
+{
+  if (vvImageMathematicsFitsFloat<IT>() && vvImageMathematicsFitsFloat<I2T>())
     {
-    ApplyImageMathFilterMacro( (*ptr)/(*ptr2) );
+    vvImageMathematicsExecute<float>(info, pds, text, static_cast<IT *>(0),
+                                     static_cast<I2T *>(0));
     }
-  if (!strcmp(label,"|-|"))
+  else
     {
-    ApplyImageMathFilterMacro( fabs((double)((*ptr)-(*ptr2))) );
+    vvImageMathematicsExecute<double>(info, pds, text, static_cast<IT *>(0),
+                                      static_cast<I2T *>(0));
     }
 }
 
 //-----------------------------------------------------------
 template <class IT>
 void vvImageMathematicsTemplate(vtkVVPluginInfo *info,
-                            vtkVVProcessDataStruct *pds, 
-                            IT *)
+                                vtkVVProcessDataStruct *pds,
+                                const std::string &text,
+                                IT *)
 {
-  const int rescaleDynamicRangeForMerging = atoi( info->GetGUIProperty( 
-    info, 0, VVP_GUI_VALUE));
-  
   switch (info->InputVolume2ScalarType)
     {
     // invoke the appropriate templated function
-    vtkTemplateMacro4(vvImageMathematicsTemplate2, info, pds, 
+    vtkTemplateMacro5(vvImageMathematicsTemplate2, info, pds, text,
                       static_cast<IT *>(0), static_cast<VTK_TT *>(0));
     }
 
@@ -120,11 +139,22 @@ static int ProcessData(void *inf, vtkVVProcessDataStruct *pds)
     info->SetProperty(info, VVP_REPORT_TEXT, buffer);
     return 1;
     }
+
+  /* compile the expression once here to report errors */
+  std::string text = vvImageMathematicsExpression(info);
+  vvExpression<double> expression;
+  if (!expression.Parse(text.c_str()))
+    {
+    std::string message = "Invalid expression \"" + text + "\": " +
+      expression.GetError();
+    info->SetProperty(info, VVP_REPORT_TEXT, message.c_str());
+    return 1;
+    }
   
   switch (info->InputVolumeScalarType)
     {
     // invoke the appropriate templated function
-    vtkTemplateMacro3(vvImageMathematicsTemplate, info, pds, 
+    vtkTemplateMacro4(vvImageMathematicsTemplate, info, pds, text,
                       static_cast<VTK_TT *>(0));
     }
   return 0;
@@ -141,7 +171,14 @@ static int UpdateGUI(void *inf)
   info->SetGUIProperty(info, 0, VVP_GUI_DEFAULT , "-");
   info->SetGUIProperty(info, 0, VVP_GUI_HELP,
                        "The operator for a pixel");
-  info->SetGUIProperty(info, 0, VVP_GUI_HINTS, "5\n+\n-\n*\n|-|\n/");
+  info->SetGUIProperty(info, 0, VVP_GUI_HINTS,
+                       "6\n+\n-\n*\n|-|\n/\nexpression");
+
+  info->SetGUIProperty(info, 1, VVP_GUI_LABEL, "Expression");
+  info->SetGUIProperty(info, 1, VVP_GUI_TYPE, VVP_GUI_ENTRY);
+  info->SetGUIProperty(info, 1, VVP_GUI_DEFAULT, "clamp(A - B, 0, 1000)");
+  info->SetGUIProperty(info, 1, VVP_GUI_HELP,
+                       "The expression computed for each pixel when the operator is \"expression\". A and B are the pixels of the two inputs. It may use numbers, + - * /, the comparisons < <= == != >= > (giving 0 or 1), && ||, c ? x : y, abs(x), sqrt(x), min(x, y), max(x, y) and clamp(x, lo, hi). For example: clamp((A - B)*0.5, 0, 1000) < 100 ? 0 : A");
   
   info->OutputVolumeScalarType = info->InputVolumeScalarType;
   int i;
@@ -175,11 +212,11 @@ extern "C"
   info->SetProperty(info, VVP_TERSE_DOCUMENTATION,
                     "Pixel wise Mathematics on two inputs");
   info->SetProperty(info, VVP_FULL_DOCUMENTATION,
-                    "This filter performs a pixel wise operations based on two images. The images need to have the same dimensions, scalar type and metadata.");
+                    "This filter performs a pixel wise operations based on two images. The images need to have the same dimensions, scalar type and metadata. Besides the fixed operators an expression over the two pixels A and B can be entered, which is evaluated in a single pass over the data. Results are clamped to the range of the data type.");
 
   info->SetProperty(info, VVP_SUPPORTS_IN_PLACE_PROCESSING, "1");
   info->SetProperty(info, VVP_SUPPORTS_PROCESSING_PIECES,   "1");
-  info->SetProperty(info, VVP_NUMBER_OF_GUI_ITEMS,          "1");
+  info->SetProperty(info, VVP_NUMBER_OF_GUI_ITEMS,          "2");
   info->SetProperty(info, VVP_REQUIRES_SECOND_INPUT,        "1");
   info->SetProperty(info, VVP_REQUIRES_SERIES_INPUT,        "0");
   info->SetProperty(info, VVP_SUPPORTS_PROCESSING_SERIES_BY_VOLUMES, "0");
@@ -1,4 +1,3 @@
-<<<<<<< HEAD
 /*=========================================================================
 
   Copyright (c) Kitware, Inc.
@@ -12,6 +11,9 @@
 =========================================================================*/
 
 #include "vtkVVPluginAPI.h"
+#include "vvPluginVolume.h"
+#include "vvPluginBuffers.h"
+#include "vvPluginPointWriter.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -33,715 +35,29 @@ struct Coordinate{
 
 template <class IT>
 void generateStatisticsOrPly(vtkVVPluginInfo *info,  IT* ptr, int filetype){
-	FILE *out;
-	int abort;
-	int* dim = info->InputVolumeDimensions;
-	int nonzero = 0;
-	int Xd = (int)dim[0];
-	int Yd = (int)dim[1]; 
-	int Zd = (int)dim[2];
-	switch(filetype){
-		case 0:
-			if(out = fopen("coronary_skeleton.txt", "w")){
-				fprintf(out, "%d x %d x %d voxels, InputVolumeNumberOfComponents = %d\n", Xd, Yd, Zd, info->InputVolumeNumberOfComponents);
-			}
-			for (int i = 0; i < Zd; i++){
-				info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-				abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-				for (int j = 0;  !abort && j < Yd; j++){
-					for (int k = 0; k < Xd; k++) {
-						//grayScalar[i][j][k] = *readVol;
-						if(*ptr){
-							fprintf(out, "%d %d %d\n", i, j, k);
-						}
-						ptr++;
-					}
-				}
-			}
-
-			break;
-		case 1:
-			if(out = fopen("coronary_data.ply", "w")){
-				fprintf(out, "ply\nformat ascii 1.0\ncomment VCGLIB generated\nelement vertex          \nproperty float x\nproperty float y\nproperty float z\nelement face 0\nproperty list uchar int vertex_indices\nend_header\n");
-			}
-			for (int i = 0; i < Zd; i++){
-				info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-				abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-				for (int j = 0;  !abort && j < Yd; j++){
-					for (int k = 0; k < Xd; k++) {
-						//grayScalar[i][j][k] = *readVol;
-						if(*ptr){
-							//fprintf(out, "%f %f %f\n", 100.0*k/Xd, 100.0*j/Yd, 100.0*i/Zd);
-							fprintf(out, "%d %d %d\n", i, j, k);
-							nonzero++;
-						}
-						ptr++;
-					}
-				}
-			}
-			fseek(out, 64, SEEK_SET); //ļָָļͷ
-			fprintf(out, "%d", nonzero); //дvertex
-			break;
-			
-		default:break;
-	}
-
-	/*
-	short *** grayScalar = new short**[Zd];  //Never write "new (double**)[n]"
-	for(int i = 0; i < Zd; i++){
-		grayScalar[i] = new short*[Yd];
-		for(int j = 0; j < Yd; j++){
-			grayScalar[i][j] =  new short[Xd];
-		}
-	}*/
-  
-	//output the statistics of HU
-	/*
-	std::map<int, int> stat;
-	fprintf(out, "-------statistics-------\n");
-	fprintf(out, "Non-zero pixel:%d\n", nonzpix);
-	for(std::map<int, int>::const_iterator it = stat.begin(); it != stat.end(); it++){
-	  fprintf(out, "HU[%d]=%d\n", it->first, it->second);
-	}*/
-  
-
-	/*
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] grayScalar[i][j];
-		}
-		delete[] grayScalar[i];
-	}
-	delete[] grayScalar;*/
-  
-	fclose(out);
-}
-
-//2016125աΪáͳÿһƬЧظ
-//޸128աslicePoints->volumePointsȥͼ2ground truthͼ1ԡ
-template <class IT, class I2T>
-void volumePoints(vtkVVPluginInfo *info, vtkVVProcessDataStruct *pds, IT *, I2T *){
-	
-	IT *ptr1 = (IT *)pds->outData;
-	I2T *ptr2 = (I2T *)pds->inData2;
-	int *dim = info->InputVolumeDimensions;
-	FILE *out;
-	int abort;
-	
-	int Xd = (int)dim[0];
-	int Yd = (int)dim[1]; 
-	int Zd = (int)dim[2];
-	
-	int*** V1 = new int**[Zd];  
-
-	int nonzero1 = 0, nonzero2 = 0, intersection = 0;
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Reading ground truth..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		V1[i] = new int*[Yd];
-		for (int j = 0;  !abort && j < Yd; j++){
-			V1[i][j] =  new int[Xd]();
-			for (int k = 0; k < Xd; k++) {
-				if(*ptr1>0){
-					nonzero1++;
-					V1[i][j][k] = *ptr1;
-				}
-				ptr1++;
-			}
-		}
-	}
-
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Reading this volume..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0;  !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				if(*ptr2>0){
-					nonzero2++;
-					if(V1[i][j][k] > 0) intersection++;
-				}
-				ptr2++;
-			}
-		}
-	}
-  
-	out = fopen("volume_points.txt", "w");
-	fprintf(out, "ground truth:%d, volume points:%d, similarity:%lf\n", nonzero1, nonzero2, 2.0 * intersection/(nonzero1 + nonzero2));
-	fclose(out);
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] V1[i][j];
-		}
-		delete[] V1[i];
-	}
-	delete[] V1;
-}
-
-template <class IT>
-void reserveSurfacePoints(vtkVVPluginInfo *info,  IT* ptr){
-	//ֵʵġͼı
-	int* dim = info->InputVolumeDimensions;
-	int Xd = (int)dim[0];
-	int Yd = (int)dim[1]; 
-	int Zd = (int)dim[2];
-	int abort;
-	IT* readVol = ptr;
-
-	/*FILE* out;
-	if(out = fopen("coronary_surface.txt", "w")){
-		fprintf(out, "%d x %d x %d voxels, InputVolumeNumberOfComponents = %d\n", Xd, Yd, Zd, inc);
-	}*/
-
-	short *** grayScalar = new short**[Zd];  //Never write "new (double**)[n]"
-	for(int i = 0; i < Zd; i++){
-		grayScalar[i] = new short*[Yd];
-		for(int j = 0; j < Yd; j++){
-			grayScalar[i][j] =  new short[Xd];
-		}
-	}
-
-	bool*** border = new bool**[Zd];   //ǷΪ߽
-	for(int i = 0; i < Zd; i++){
-		border[i] = new bool*[Yd];
-		for(int j = 0; j < Yd; j++){
-			border[i][j] =  new bool[Xd];
-			for(int k = 0; k < Xd; k++)
-				border[i][j][k] = false;
-		}
-	}
-	
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0;  !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				grayScalar[i][j][k] = (short)*readVol;
-				readVol++;
-			}
-		}
-	}
-
-	const int neighborDirection[26][3] = {
-		{1, 0, 0},{0, 1, 0},{0, 0, 1},{-1, 0, 0},{0, -1, 0},{0, 0, -1},
-		{1, 1, 0},{1, -1, 0},{-1, 1, 0},{-1, -1, 0},
-		{0, 1, 1},{0, 1, -1},{0, -1, 1},{0, -1, -1},
-		{1, 0, 1},{1, 0, -1},{-1, 0, 1},{-1, 0, -1},
-		{1, 1, 1},{1, 1, -1},{1, -1, 1},{1, -1, -1},{-1, 1, 1},{-1, 1, -1},{-1, -1, 1},{-1,-1,-1}
-	};
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0; !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				if(grayScalar[i][j][k]){
-				  int countBackground = 0;
-				  for(int h = 0; h < 26; h++){
-					  if(!grayScalar[i + neighborDirection[h][0]][j + neighborDirection[h][1]][k + neighborDirection[h][2]])
-						  countBackground++;
-				  }
-				  if(countBackground >= 9)  //26жǱ߽磬ɵ
-					  border[i][j][k] = true;
-				}
-			}
-		}
-	}
-  
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0; !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				if(!border[i][j][k]){ 
-					*ptr = 0;   //Min of gray scalarɵ
-				}
-				//ܷŵgenerateStatisticsOrPlyȥʵ
-				/*else{
-					fprintf(out, "%.3f %.3f %.3f\n", 10.0 * i / Xd, 10.0 * j / Yd, 10.0 * k / Zd);
-				}*/
-				ptr++;
-			}
-		}
-	}
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] grayScalar[i][j];
-		}
-		delete[] grayScalar[i];
-	}
-	delete[] grayScalar;
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] border[i][j];
-		}
-		delete[] border[i];
-	}
-	delete[] border;
-	
-	//fclose(out);
-}
-
-template <class IT>
-void stenosisVisualization(vtkVVPluginInfo *info,  IT* ptr){
-	//ӻխ
-	int* dim = info->InputVolumeDimensions;
-	int Xd = (int)dim[0];
-	int Yd = (int)dim[1]; 
-	int Zd = (int)dim[2];
-	int abort;
-	IT* readVol = ptr;
-
-
-	short *** grayScalar = new short**[Zd];  //Never write "new (double**)[n]"
-	for(int i = 0; i < Zd; i++){
-		grayScalar[i] = new short*[Yd];
-		for(int j = 0; j < Yd; j++){
-			grayScalar[i][j] =  new short[Xd];
-		}
-	}
-	
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Reading into memory..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0; !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				grayScalar[i][j][k] = (short)*readVol;
-				readVol++;
-			}
-		}
-	}
-
-	FILE *in;
-	int x, y, z;
-	double stenosisPercent;  //stenosisPercent
-	map<Coordinate, double> pointMap;
-	char volInfo[102];
-	if((in = fopen("stenosis_persent.txt","r")) == NULL) {  //жļǷڼɶ		
-			printf("error!"); 
-			return; 
-	} 
-	while (!feof(in)) { 
-			fgets(volInfo,100,in);  //ȡһ
-			if(4 == fscanf(in, "%d %d %d %lf", &z, &y, &x, &stenosisPercent)){
-				Coordinate co(z, y, x);
-				pointMap[co] = stenosisPercent;
-			}
-	} 
-	fclose(in);                     //رļ*/
-
-	FILE *console;
-	console = fopen("console.log", "w");
-	fprintf(console, "size of map: %d\n", (int)pointMap.size());
-	
-
-	for (map<Coordinate, double>::iterator it = pointMap.begin(); it != pointMap.end(); it++){
-		Coordinate pco = it->first;
-		int z = pco.z, y = pco.y, x = pco.x;
-		double pct = it->second;
-		int r = 1 + (int)(6.0 * (1.0 - pct));
-		fprintf(console, "r = %d, gray = %d\n", r, 25 + (int)(230.0 * pct));
-		for(int k = -r; k <= r; k++){
-			for(int j = -r; j <= r; j++){
-				for(int i = -r; i <= r; i++){
-					if (grayScalar[z+k][y+i][x+j])
-						grayScalar[z+k][y+i][x+j] = 25 + (int)(230.0 * pct);
-					}
-				}
-			}
-		}
-	fclose(console);
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Writing volume..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0; !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				*ptr = grayScalar[i][j][k];   
-				ptr++;
-			}
-		}
-	}
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] grayScalar[i][j];
-		}
-		delete[] grayScalar[i];
-	}
-	delete[] grayScalar;
-
-}
-
-
-template <class IT>
-void connectedComponentStatistics(vtkVVPluginInfo *info,  IT* ptr){
-	//Ѫܵͨԭʼͼϵͳ
-	int* dim = info->InputVolumeDimensions;
-	int Xd = (int)dim[0];
-	int Yd = (int)dim[1]; 
-	int Zd = (int)dim[2];
-	int abort;
-	IT* readVol = ptr;
-
-
-	short *** grayScalar = new short**[Zd];  //Never write "new (double**)[n]"
-	for(int i = 0; i < Zd; i++){
-		grayScalar[i] = new short*[Yd];
-		for(int j = 0; j < Yd; j++){
-			grayScalar[i][j] =  new short[Xd];
-		}
-	}
-
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Reading into memory..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0; !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				grayScalar[i][j][k] = (short)*readVol;
-				readVol++;
-			}
-		}
-	}
-
-	FILE *in;
-	int x, y, z;
-	char volInfo[102];
-	if((in = fopen("log_connectivity.txt","r")) == NULL) {  //жļǷڼɶ		
-		printf("error!"); 
-		return; 
-	} 
-
-	map<int, double> averageGray;
-	double graySum = 0.0;
-	int vNum = 0, ccNO = 0;  //ͨͨ
-	bool start = false, firstcc = true;
-	while (!feof(in)) { 
-		fgets(volInfo,100,in);  //ȡһ
-		
-		if(!start) {
-			if(volInfo[0] == '*') {
-				start = true;
-			}
-			continue;
-		}
-
-		if(volInfo[0] == '#') {
-			if(firstcc) {
-				firstcc = false;
-			}
-			else{
-				averageGray[ccNO] = graySum / vNum;
-			}
-
-			graySum = 0.0;
-			vNum = 0;
-			ccNO = 0;
-			fscanf(in, "#%d $%d", &ccNO, &vNum);
-
-			continue;
-		}
-		if(3 == fscanf(in, "%d %d %d", &z, &y, &x)){
-			graySum += grayScalar[z][y][x];
-			vNum++;
-		}
-	} 
-	averageGray[ccNO] = graySum / vNum;
-	fclose(in);                     //رļ*/
-
-
-	FILE *console;
-	console = fopen("log_original_gray", "w");
-	fprintf(console, "size of components: %d\n", (int)averageGray.size());
-	for(map<int, double>::iterator it = averageGray.begin(); it != averageGray.end(); it++) {
-		fprintf(console, "#%d  %.4f\n", it->first, it->second);
-	}
-	
-	fclose(console);
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] grayScalar[i][j];
-		}
-		delete[] grayScalar[i];
-	}
-	delete[] grayScalar;
-
-}
-
-template <class IT, class I2T>
-void coronaryBw2Gray(vtkVVPluginInfo *info,
-								 vtkVVProcessDataStruct *pds, 
-								 IT *, I2T *)
-{
-	//2015-11-27עӦò˰ɡVolViewԴUtility->Masking(ITK)Ϳʵͬܡ
-	IT *ptr = (IT *)pds->outData;
-	I2T *ptr2 = (I2T *)pds->inData2;
-
-	int *dim = info->InputVolumeDimensions;
-
-	int abort = 0;
-	int inNumCom = info->InputVolumeNumberOfComponents;
-	int inNumCom2 = info->InputVolume2NumberOfComponents;
-	
-	//ָõĶֵͼƥ䵽ԭҶͼ
-
-	int Xd = (int)dim[0];
-	int Yd = (int)dim[1]; 
-	int Zd = (int)dim[2];
-
-	/*
-	FILE *in;
-	int x, y, z;
-	set<Coordinate> pointSet;
-	char volInfo[102];
-	if(in = fopen("coronary_data.txt", "r")){
-		//fscanf(in, "%s", volInfo); // һһпո񣬾ͶոΪֹ
-		fgets(volInfo, 100, in);  //or scanf("%[^\n]", str);
-		while(3 == fscanf(in, "%d %d %d", &z, &y, &x)){
-			Coordinate co(z, y, x);
-			pointSet.insert(co);
-		}
-		fclose(in);
-	}
-	else{
-		perror("coronary_data.txt");  //print "coronary_data.txt: No such file or directory"
-	}
-	*/
-	
-	/*FILE *console;
-	console = fopen("console.log", "w");
-	fprintf(console, "%s", volInfo);
-	if(!pointSet.empty())
-		fprintf(console, "size of set: %d\n", (int)pointSet.size());
-	fclose(console);*/
-	
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0; !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				if(!*ptr2) 
-					*ptr = -1024;
-				ptr++;
-				ptr2++;
-			}
-		}
-	}
-}
-
-
-template <class IT>
-/* TODO 1: Rename vvSampleTemplate to vv<your_plugin>Template */
-void vvLzfStatisticsTemplate(vtkVVPluginInfo *info,
-                      vtkVVProcessDataStruct *pds, 
-                      IT *)
-{
-	IT *inPtr1 = (IT *)pds->inData;
-	IT *outPtr1 = (IT *)pds->outData;
-	int *dim1 = info->InputVolumeDimensions;
-	int inNumComp1 = info->InputVolumeNumberOfComponents;
-
-	//ֱ϶ڶͼĳ͵д̫ãλͳһ׳ΪIT*һͼָͣʱλ̵ͼǰʵβɡ
-	unsigned char *inPtr2 = (unsigned char*)pds->inData2;  
-	//coronaryBw2Gray򿪵ԭʼĻҶͼ2ֽڣͼ2ǷָõѪֵܶͼȡҲԣ1ֽڣ
-
-	//coronaryStenosis򿪵fdtͼ2ֽڣͼ2ѪܹǼ߶ֵͼ1ֽڣ
-	int *dim2 = info->InputVolume2Dimensions;
-	int inNumComp2 = info->InputVolume2NumberOfComponents;
-
-	int Xd = (int)dim1[0];
-	int Yd = (int)dim1[1]; 
-	int Zd = (int)dim1[2];
-  /*
-  *The following code is writen by lzf on May 22, 2015
-  *for save as a .ply file
-  */
-	
-	//reserveSurfacePoints(info, outPtr1);
-	
-	//generateStatisticsOrPly(info, outPtr1, 1); //0:txt 1:ply
-
-	//stenosisVisualization(info, outPtr1);
-
-	connectedComponentStatistics(info, outPtr1);
-
-	//·ͼλͬ⡾ܣ
-	/*switch (info->InputVolume2ScalarType)
-	{
-		//invoke the appropriate templated function
-		vtkTemplateMacro4(volumePoints, info, pds, 
-			static_cast<IT *>(0), static_cast<VTK_TT *>(0));
-	}*/
-                                                    
-	info->UpdateProgress(info,(float)1.0,"Processing Complete");
-}
-
-static int ProcessData(void *inf, vtkVVProcessDataStruct *pds)
-{
-  vtkVVPluginInfo *info = (vtkVVPluginInfo *)inf;
-
-  switch (info->InputVolumeScalarType)
-    {
-    /* TODO 2: Rename vvSampleTemplate to vv<your_plugin>Template */
-    vtkTemplateMacro3(vvLzfStatisticsTemplate, info, pds, 
-                      static_cast<VTK_TT *>(0));
-    }
-  return 0;
-}
-
-/* this function updates the GUI elements to accomidate new data */
-/* it will always get called prior to the plugin executing. */
-static int UpdateGUI(void *inf)
-{
-  vtkVVPluginInfo *info = (vtkVVPluginInfo *)inf;
-
-  /* TODO 8: create your required GUI elements here */
-
-
-  /* TODO 6: modify the following code as required. By default the output
-  *  image's properties match those of the input depending on what your
-  *  filter does it may need to change some of these values
-  */
-  info->OutputVolumeScalarType = info->InputVolumeScalarType;
-  info->OutputVolumeNumberOfComponents = 
-    info->InputVolumeNumberOfComponents;
-  int i;
-  for (i = 0; i < 3; i++)
-    {
-    info->OutputVolumeDimensions[i] = info->InputVolumeDimensions[i];
-    info->OutputVolumeSpacing[i] = info->InputVolumeSpacing[i];
-    info->OutputVolumeOrigin[i] = info->InputVolumeOrigin[i];
-    }
-
-  return 1;
-}
-
-extern "C" 
-{
-  /* TODO 3: Rename vvSampleInit to vv<your_plugin>Init */
-  void VV_PLUGIN_EXPORT vvLzfStatisticsInit(vtkVVPluginInfo *info)
-  {
-    /* always check the version */
-    vvPluginVersionCheck();
-    
-    /* setup information that never changes */
-    info->ProcessData = ProcessData;
-    info->UpdateGUI = UpdateGUI;
-    
-    /* set the properties this plugin uses */
-    /* TODO 4: Rename "Sample" to "<your_plugin>" */
-    info->SetProperty(info, VVP_NAME, "LzfStatistics");
-    info->SetProperty(info, VVP_GROUP, "Utility");
-
-    /* TODO 5: update the terse and full documentation for your filter */
-    info->SetProperty(info, VVP_TERSE_DOCUMENTATION,
-                      "This plugin includes several functions...");
-    info->SetProperty(info, VVP_FULL_DOCUMENTATION,
-                      "This plugin is created on May 22nd, 2015, and being expanded. You only need to import the second image when 'coronaryBw2Gray'.");
-
-    
-    /* TODO 9: set these two values to "0" or "1" based on how your plugin
-     * handles data all possible combinations of 0 and 1 are valid. */
-    info->SetProperty(info, VVP_SUPPORTS_IN_PLACE_PROCESSING, "1");
-    info->SetProperty(info, VVP_SUPPORTS_PROCESSING_PIECES,   "1");
-
-    /* TODO 7: set the number of GUI items used by this plugin */
-    info->SetProperty(info, VVP_NUMBER_OF_GUI_ITEMS,          "0");
-		info->SetProperty(info, VVP_REQUIRES_SECOND_INPUT,        "1");
-  info->SetProperty(info, VVP_REQUIRES_SERIES_INPUT,        "0");
-  info->SetProperty(info, VVP_SUPPORTS_PROCESSING_SERIES_BY_VOLUMES, "0");
-  info->SetProperty(info, VVP_PRODUCES_OUTPUT_SERIES, "0");
-  info->SetProperty(info, VVP_PRODUCES_PLOTTING_OUTPUT, "0");
-  }
-}
-=======
-/*=========================================================================
-
-  Copyright (c) Kitware, Inc.
-  All rights reserved.
-  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
-
-     This software is distributed WITHOUT ANY WARRANTY; without even
-     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
-     PURPOSE.  See the above copyright notice for more information.
-
-=========================================================================*/
-
-#include "vtkVVPluginAPI.h"
-#include <string.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include <map>
-#include <set>
-using namespace std;
-struct Coordinate{
-	int x, y, z;
-	Coordinate(int zz, int yy, int xx){
-		x = xx;
-		y = yy;
-		z = zz;
-	}
-	bool operator < (const Coordinate &co) const{
-		return ((z < co.z) || (z == co.z && y < co.y) || (z == co.z && y == co.y && x <co.x));
-	}
-};
-
-template <class IT>
-void generateStatisticsOrPly(vtkVVPluginInfo *info,  IT* ptr, int filetype){
-	FILE *out;
-	int abort;
-	int* dim = info->InputVolumeDimensions;
-	int nonzero = 0;
-	int Xd = (int)dim[0];
-	int Yd = (int)dim[1]; 
-	int Zd = (int)dim[2];
+	//صΪ㼯, ʽvvPluginPointWriter.h
+	vvVolumeView<IT> vol(ptr, info->InputVolumeDimensions, info->InputVolumeNumberOfComponents);
+	vvSparsePointWriter<IT> writer;
+	writer.SetPluginInfo(info);
+	const char *filename = 0;
+	int ok = 1;
 	switch(filetype){
 		case 0:
-			if(out = fopen("coronary_skeleton.txt", "w")){
-				fprintf(out, "%d x %d x %d voxels, InputVolumeNumberOfComponents = %d\n", Xd, Yd, Zd, info->InputVolumeNumberOfComponents);
-			}
-			for (int i = 0; i < Zd; i++){
-				info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-				abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-				for (int j = 0;  !abort && j < Yd; j++){
-					for (int k = 0; k < Xd; k++) {
-						//grayScalar[i][j][k] = *readVol;
-						if(*ptr){
-							fprintf(out, "%d %d %d\n", i, j, k);
-						}
-						ptr++;
-					}
-				}
-			}
-
+			filename = "coronary_skeleton.raw";
+			ok = writer.Write(filename, vol, vvSparsePointWriter<IT>::Packed);
 			break;
 		case 1:
-			if(out = fopen("coronary_data.ply", "w")){
-				fprintf(out, "ply\nformat ascii 1.0\ncomment VCGLIB generated\nelement vertex          \nproperty float x\nproperty float y\nproperty float z\nelement face 0\nproperty list uchar int vertex_indices\nend_header\n");
-			}
-			for (int i = 0; i < Zd; i++){
-				info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-				abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-				for (int j = 0;  !abort && j < Yd; j++){
-					for (int k = 0; k < Xd; k++) {
-						//grayScalar[i][j][k] = *readVol;
-						if(*ptr){
-							//fprintf(out, "%f %f %f\n", 100.0*k/Xd, 100.0*j/Yd, 100.0*i/Zd);
-							fprintf(out, "%d %d %d\n", i, j, k);
-							nonzero++;
-						}
-						ptr++;
-					}
-				}
-			}
-			fseek(out, 64, SEEK_SET); //ļָָļͷ
-			fprintf(out, "%d", nonzero); //дvertex
+			filename = "coronary_data.ply";
+			ok = writer.Write(filename, vol, vvSparsePointWriter<IT>::PLY);
 			break;
 			
 		default:break;
 	}
+	if(!ok && !vvPluginAbortRequested(info)){
+		char msg[256];
+		sprintf(msg, "Unable to write %s.", filename);
+		info->SetProperty(info, VVP_ERROR, msg);
+	}
 
 	/*
 	short *** grayScalar = new short**[Zd];  //Never write "new (double**)[n]"
@@ -770,8 +86,6 @@ void generateStatisticsOrPly(vtkVVPluginInfo *info,  IT* ptr, int filetype){
 		delete[] grayScalar[i];
 	}
 	delete[] grayScalar;*/
-  
-	fclose(out);
 }
 
 //2016125աΪáͳÿһƬЧظ
@@ -779,45 +93,28 @@ void generateStatisticsOrPly(vtkVVPluginInfo *info,  IT* ptr, int filetype){
 template <class IT, class I2T>
 void volumePoints(vtkVVPluginInfo *info, vtkVVProcessDataStruct *pds, IT *, I2T *){
 	
-	IT *ptr1 = (IT *)pds->outData;
-	I2T *ptr2 = (I2T *)pds->inData2;
 	int *dim = info->InputVolumeDimensions;
+	vvVolumeView<IT> V1((IT *)pds->outData, dim);
+	vvVolumeView<I2T> V2((I2T *)pds->inData2, dim);
 	FILE *out;
 	int abort;
 	
 	int Xd = (int)dim[0];
 	int Yd = (int)dim[1]; 
 	int Zd = (int)dim[2];
-	
-	int*** V1 = new int**[Zd];  
 
 	int nonzero1 = 0, nonzero2 = 0, intersection = 0;
 	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Reading ground truth..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		V1[i] = new int*[Yd];
+		abort = info->ReportProgress(info,(float)1.0*i/Zd,"Comparing volumes..."); 
 		for (int j = 0;  !abort && j < Yd; j++){
-			V1[i][j] =  new int[Xd]();
 			for (int k = 0; k < Xd; k++) {
-				if(*ptr1>0){
+				if(V1(k, j, i) > 0){
 					nonzero1++;
-					V1[i][j][k] = *ptr1;
 				}
-				ptr1++;
-			}
-		}
-	}
-
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Reading this volume..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0;  !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				if(*ptr2>0){
+				if(V2(k, j, i) > 0){
 					nonzero2++;
-					if(V1[i][j][k] > 0) intersection++;
+					if(V1(k, j, i) > 0) intersection++;
 				}
-				ptr2++;
 			}
 		}
 	}
@@ -825,14 +122,6 @@ void volumePoints(vtkVVPluginInfo *info, vtkVVProcessDataStruct *pds, IT *, I2T
 	out = fopen("volume_points.txt", "w");
 	fprintf(out, "ground truth:%d, volume points:%d, similarity:%lf\n", nonzero1, nonzero2, 2.0 * intersection/(nonzero1 + nonzero2));
 	fclose(out);
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] V1[i][j];
-		}
-		delete[] V1[i];
-	}
-	delete[] V1;
 }
 
 template <class IT>
@@ -843,40 +132,18 @@ void reserveSurfacePoints(vtkVVPluginInfo *info,  IT* ptr){
 	int Yd = (int)dim[1]; 
 	int Zd = (int)dim[2];
 	int abort;
-	IT* readVol = ptr;
 
 	/*FILE* out;
 	if(out = fopen("coronary_surface.txt", "w")){
 		fprintf(out, "%d x %d x %d voxels, InputVolumeNumberOfComponents = %d\n", Xd, Yd, Zd, inc);
 	}*/
 
-	short *** grayScalar = new short**[Zd];  //Never write "new (double**)[n]"
-	for(int i = 0; i < Zd; i++){
-		grayScalar[i] = new short*[Yd];
-		for(int j = 0; j < Yd; j++){
-			grayScalar[i][j] =  new short[Xd];
-		}
-	}
+	vvVolumeView<IT> grayScalar(ptr, dim);
 
-	bool*** border = new bool**[Zd];   //ǷΪ߽
-	for(int i = 0; i < Zd; i++){
-		border[i] = new bool*[Yd];
-		for(int j = 0; j < Yd; j++){
-			border[i][j] =  new bool[Xd];
-			for(int k = 0; k < Xd; k++)
-				border[i][j][k] = false;
-		}
-	}
-	
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0;  !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				grayScalar[i][j][k] = (short)*readVol;
-				readVol++;
-			}
-		}
+	vvVolumeBuffer<bool> border;   //ǷΪ߽
+	if(!border.Allocate(dim)){
+		info->SetProperty(info, VVP_ERROR, "Unable to allocate the border flags.");
+		return;
 	}
 
 	const int neighborDirection[26][3] = {
@@ -887,55 +154,40 @@ void reserveSurfacePoints(vtkVVPluginInfo *info,  IT* ptr){
 		{1, 1, 1},{1, 1, -1},{1, -1, 1},{1, -1, -1},{-1, 1, 1},{-1, 1, -1},{-1, -1, 1},{-1,-1,-1}
 	};
 	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
+		abort = info->ReportProgress(info,(float)1.0*i/Zd,"Processing..."); 
 		for (int j = 0; !abort && j < Yd; j++){
 			for (int k = 0; k < Xd; k++) {
-				if(grayScalar[i][j][k]){
+				if(grayScalar(k, j, i)){
 				  int countBackground = 0;
 				  for(int h = 0; h < 26; h++){
-					  if(!grayScalar[i + neighborDirection[h][0]][j + neighborDirection[h][1]][k + neighborDirection[h][2]])
+					  int qi = i + neighborDirection[h][0];
+					  int qj = j + neighborDirection[h][1];
+					  int qk = k + neighborDirection[h][2];
+					  //֮ĵ
+					  if(!grayScalar.IsInside(qk, qj, qi) || !grayScalar(qk, qj, qi))
 						  countBackground++;
 				  }
 				  if(countBackground >= 9)  //26жǱ߽磬ɵ
-					  border[i][j][k] = true;
+					  border(k, j, i) = true;
 				}
 			}
 		}
 	}
   
 	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
+		abort = info->ReportProgress(info,(float)1.0*i/Zd,"Processing..."); 
 		for (int j = 0; !abort && j < Yd; j++){
 			for (int k = 0; k < Xd; k++) {
-				if(!border[i][j][k]){ 
-					*ptr = 0;   //Min of gray scalarɵ
+				if(!border(k, j, i)){ 
+					grayScalar(k, j, i) = 0;   //Min of gray scalarɵ
 				}
 				//ܷŵgenerateStatisticsOrPlyȥʵ
 				/*else{
 					fprintf(out, "%.3f %.3f %.3f\n", 10.0 * i / Xd, 10.0 * j / Yd, 10.0 * k / Zd);
 				}*/
-				ptr++;
 			}
 		}
 	}
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] grayScalar[i][j];
-		}
-		delete[] grayScalar[i];
-	}
-	delete[] grayScalar;
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] border[i][j];
-		}
-		delete[] border[i];
-	}
-	delete[] border;
 	
 	//fclose(out);
 }
@@ -944,49 +196,38 @@ template <class IT>
 void stenosisVisualization(vtkVVPluginInfo *info,  IT* ptr){
 	//ӻխ
 	int* dim = info->InputVolumeDimensions;
-	int Xd = (int)dim[0];
-	int Yd = (int)dim[1]; 
-	int Zd = (int)dim[2];
-	int abort;
-	IT* readVol = ptr;
-
 
-	short *** grayScalar = new short**[Zd];  //Never write "new (double**)[n]"
-	for(int i = 0; i < Zd; i++){
-		grayScalar[i] = new short*[Yd];
-		for(int j = 0; j < Yd; j++){
-			grayScalar[i][j] =  new short[Xd];
-		}
-	}
-	
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Reading into memory..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0; !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				grayScalar[i][j][k] = (short)*readVol;
-				readVol++;
-			}
-		}
-	}
+	//ֱ޸
+	vvVolumeView<IT> grayScalar(ptr, dim);
 
-	FILE *in;
 	int x, y, z;
 	double stenosisPercent;  //stenosisPercent
 	map<Coordinate, double> pointMap;
-	char volInfo[102];
-	if((in = fopen("stenosis_persent.txt","r")) == NULL) {  //жļǷڼɶ		
-			printf("error!"); 
-			return; 
-	} 
-	while (!feof(in)) { 
-			fgets(volInfo,100,in);  //ȡһ
-			if(4 == fscanf(in, "%d %d %d %lf", &z, &y, &x, &stenosisPercent)){
-				Coordinate co(z, y, x);
-				pointMap[co] = stenosisPercent;
-			}
-	} 
-	fclose(in);                     //رļ*/
+	size_t numPoints;
+	const vvPluginPointValue *points = vvPluginGetArray<vvPluginPointValue>(info, VV_BUFFER_STENOSIS, &numPoints);
+	if(points){
+		for(size_t p = 0; p < numPoints; p++){
+			Coordinate co(points[p].z, points[p].y, points[p].x);
+			pointMap[co] = points[p].Value;
+		}
+	}
+	else{
+		//ûвխʱ, ⲿűɵļ
+		FILE *in;
+		char volInfo[102];
+		if((in = fopen("stenosis_persent.txt","r")) == NULL) {  //жļǷڼɶ		
+				info->SetProperty(info, VVP_ERROR, "No stenosis ratio available.");
+				return; 
+		} 
+		while (!feof(in)) { 
+				fgets(volInfo,100,in);  //ȡһ
+				if(4 == fscanf(in, "%d %d %d %lf", &z, &y, &x, &stenosisPercent)){
+					Coordinate co(z, y, x);
+					pointMap[co] = stenosisPercent;
+				}
+		} 
+		fclose(in);                     //رļ*/
+	}
 
 	FILE *console;
 	console = fopen("console.log", "w");
@@ -1002,32 +243,13 @@ void stenosisVisualization(vtkVVPluginInfo *info,  IT* ptr){
 		for(int k = -r; k <= r; k++){
 			for(int j = -r; j <= r; j++){
 				for(int i = -r; i <= r; i++){
-					if (grayScalar[z+k][y+i][x+j])
-						grayScalar[z+k][y+i][x+j] = 25 + (int)(230.0 * pct);
+					if (grayScalar.IsInside(x+j, y+i, z+k) && grayScalar(x+j, y+i, z+k))
+						grayScalar(x+j, y+i, z+k) = (IT)(25 + (int)(230.0 * pct));
 					}
 				}
 			}
 		}
 	fclose(console);
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Writing volume..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0; !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				*ptr = grayScalar[i][j][k];   
-				ptr++;
-			}
-		}
-	}
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] grayScalar[i][j];
-		}
-		delete[] grayScalar[i];
-	}
-	delete[] grayScalar;
-
 }
 
 
@@ -1035,77 +257,38 @@ template <class IT>
 void connectedComponentStatistics(vtkVVPluginInfo *info,  IT* ptr){
 	//Ѫܵͨԭʼͼϵͳ
 	int* dim = info->InputVolumeDimensions;
-	int Xd = (int)dim[0];
-	int Yd = (int)dim[1]; 
-	int Zd = (int)dim[2];
-	int abort;
-	IT* readVol = ptr;
 
+	vvVolumeView<IT> grayScalar(ptr, dim);
 
-	short *** grayScalar = new short**[Zd];  //Never write "new (double**)[n]"
-	for(int i = 0; i < Zd; i++){
-		grayScalar[i] = new short*[Yd];
-		for(int j = 0; j < Yd; j++){
-			grayScalar[i][j] =  new short[Xd];
-		}
+	//LzfConnectivityµĸͨ(vvPluginBuffers.h)
+	size_t size;
+	const int *buffer = vvPluginGetArray<int>(info, VV_BUFFER_COMPONENTS, &size);
+	if(!buffer || size < 4 || buffer[0] != dim[0] || buffer[1] != dim[1] || buffer[2] != dim[2]){
+		info->SetProperty(info, VVP_ERROR, "Run LzfConnectivity on a volume of the same size first.");
+		return;
 	}
-
-	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Reading into memory..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
-		for (int j = 0; !abort && j < Yd; j++){
-			for (int k = 0; k < Xd; k++) {
-				grayScalar[i][j][k] = (short)*readVol;
-				readVol++;
-			}
-		}
+	int cnt = buffer[3];
+	const int *voxelCount = buffer + 4;
+	const int *voxels = voxelCount + cnt;
+	size_t total = 4 + (size_t)cnt;
+	for(int c = 0; c < cnt && total <= size; c++){
+		total += voxelCount[c];
+	}
+	if(cnt < 0 || total > size){
+		info->SetProperty(info, VVP_ERROR, "The component list left by LzfConnectivity is damaged.");
+		return;
 	}
-
-	FILE *in;
-	int x, y, z;
-	char volInfo[102];
-	if((in = fopen("log_connectivity.txt","r")) == NULL) {  //жļǷڼɶ		
-		printf("error!"); 
-		return; 
-	} 
 
 	map<int, double> averageGray;
-	double graySum = 0.0;
-	int vNum = 0, ccNO = 0;  //ͨͨ
-	bool start = false, firstcc = true;
-	while (!feof(in)) { 
-		fgets(volInfo,100,in);  //ȡһ
-		
-		if(!start) {
-			if(volInfo[0] == '*') {
-				start = true;
-			}
-			continue;
-		}
-
-		if(volInfo[0] == '#') {
-			if(firstcc) {
-				firstcc = false;
-			}
-			else{
-				averageGray[ccNO] = graySum / vNum;
-			}
-
-			graySum = 0.0;
-			vNum = 0;
-			ccNO = 0;
-			fscanf(in, "#%d $%d", &ccNO, &vNum);
-
-			continue;
-		}
-		if(3 == fscanf(in, "%d %d %d", &z, &y, &x)){
-			graySum += grayScalar[z][y][x];
-			vNum++;
+	for(int c = 1; c <= cnt; c++){
+		int vNum = voxelCount[c - 1];  //ͨ
+		double graySum = 0.0;
+		for(int h = 0; h < vNum; h++){
+			graySum += grayScalar[voxels[h]];
 		}
-	} 
-	averageGray[ccNO] = graySum / vNum;
-	fclose(in);                     //رļ*/
-
+		averageGray[c] = vNum ? graySum / vNum : 0.0;
+		voxels += vNum;
+	}
 
 	FILE *console;
 	console = fopen("log_original_gray", "w");
@@ -1115,15 +298,6 @@ void connectedComponentStatistics(vtkVVPluginInfo *info,  IT* ptr){
 	}
 	
 	fclose(console);
-
-	for(int i = 0; i < Zd; i++){
-		for(int j = 0; j < Yd; j++){
-			delete[] grayScalar[i][j];
-		}
-		delete[] grayScalar[i];
-	}
-	delete[] grayScalar;
-
 }
 
 template <class IT, class I2T>
@@ -1174,8 +348,7 @@ void coronaryBw2Gray(vtkVVPluginInfo *info,
 	fclose(console);*/
 	
 	for (int i = 0; i < Zd; i++){
-		info->UpdateProgress(info,(float)1.0*i/Zd,"Processing..."); 
-		abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
+		abort = info->ReportProgress(info,(float)1.0*i/Zd,"Processing..."); 
 		for (int j = 0; !abort && j < Yd; j++){
 			for (int k = 0; k < Xd; k++) {
 				if(!*ptr2) 
@@ -1217,7 +390,7 @@ void vvLzfStatisticsTemplate(vtkVVPluginInfo *info,
 	
 	//reserveSurfacePoints(info, outPtr1);
 	
-	//generateStatisticsOrPly(info, outPtr1, 1); //0:txt 1:ply
+	//generateStatisticsOrPly(info, outPtr1, 1); //0:raw 1:ply
 
 	//stenosisVisualization(info, outPtr1);
 
@@ -1301,7 +474,8 @@ extern "C"
     /* TODO 9: set these two values to "0" or "1" based on how your plugin
      * handles data all possible combinations of 0 and 1 are valid. */
     info->SetProperty(info, VVP_SUPPORTS_IN_PLACE_PROCESSING, "1");
-    info->SetProperty(info, VVP_SUPPORTS_PROCESSING_PIECES,   "1");
+    /* the statistics are gathered over the whole volume, not a slab */
+    info->SetProperty(info, VVP_SUPPORTS_PROCESSING_PIECES,   "0");
 
     /* TODO 7: set the number of GUI items used by this plugin */
     info->SetProperty(info, VVP_NUMBER_OF_GUI_ITEMS,          "0");
@@ -1312,4 +486,3 @@ extern "C"
   info->SetProperty(info, VVP_PRODUCES_PLOTTING_OUTPUT, "0");
   }
 }
->>>>>>> 582480cd14e067db3b1fed95c429f1724f683c48
@@ -77,8 +77,7 @@ void vvMergeVolumesTemplate2(
   
   for ( k = 0; k < dim1[2]; k++ )                                      
     {                                                                 
-    info->UpdateProgress(info,(float)0.5*k/dim1[2],"Processing..."); 
-    abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
+    abort = info->ReportProgress(info,(float)0.5*k/dim1[2],"Processing..."); 
     for ( j = 0; !abort && j < dim1[1]; j++ )                          
       {          
       // copy the result into the output
@@ -129,8 +128,7 @@ void vvMergeVolumesTemplate2(
 
   for ( k = 0; k < dim1[2]; k++ )                                      
     {                                                                 
-    info->UpdateProgress(info,(float)(0.5 + 0.5*k/dim1[2]),"Processing..."); 
-    abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
+    abort = info->ReportProgress(info,(float)(0.5 + 0.5*k/dim1[2]),"Processing..."); 
     for ( j = 0; !abort && j < dim1[1]; j++ )                          
       {          
       // copy the result into the output
@@ -193,8 +191,7 @@ void vvMergeVolumesTemplate2(vtkVVPluginInfo *info,
   int i, j, k, l;
   for ( k = 0; k < dim1[2]; k++ )                                      
     {                                                                 
-    info->UpdateProgress(info,(float)1.0*k/dim1[2],"Processing..."); 
-    abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
+    abort = info->ReportProgress(info,(float)1.0*k/dim1[2],"Processing..."); 
     for ( j = 0; !abort && j < dim1[1]; j++ )                          
       {          
       // copy the result into the output
@@ -12,57 +12,38 @@
 
 
 #include "vtkVVPluginAPI.h"
+#include "vvPluginKernels.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-#define ApplyPixelMathFilterMacro( COMPARISON )                         \
-    int i, j, k;                                                        \
-    for ( k = 0; k < dim[2]; k++ )                                      \
-      {                                                                 \
-      info->UpdateProgress(info,(float)1.0*k/dim[2],"PixelMathing..."); \
-      abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));       \
-      for ( j = 0; !abort && j < dim[1]; j++ )                          \
-        {                                                               \
-        for ( i = 0; i < nc*dim[0]; i++ )                               \
-          {                                                             \
-          *ptr = ( *ptr COMPARISON compVal );                           \
-          ptr++;                                                        \
-          }                                                             \
-        }                                                               \
-      }                                                                 \
-    info->UpdateProgress(info,(float)1.0,"PixelMathing Complete");
-
-
 //-----------------------------------------------------------
 template <class IT>
 void vvPixelMathTemplate(vtkVVPluginInfo *info,
                          vtkVVProcessDataStruct *pds, 
                          IT *)
 {
-  IT *ptr = (IT *)pds->outData;
   int *dim = info->InputVolumeDimensions;
   double v1 = atof(info->GetGUIProperty(info, 1, VVP_GUI_VALUE));
   const char *label = info->GetGUIProperty(info, 0, VVP_GUI_VALUE);
-  int abort = 0;
-  IT compVal = (IT)v1;
   int nc = info->InputVolumeNumberOfComponents;
-  
-  if (!strcmp(label,"+"))
-    {
-    ApplyPixelMathFilterMacro( + );
-    }
-  if (!strcmp(label,"-"))
+  int op = vvPluginKernelOperation(label);
+  if (op < VV_KERNEL_ADD || op > VV_KERNEL_DIVIDE)
     {
-    ApplyPixelMathFilterMacro( - );
+    return;
     }
-  if (!strcmp(label,"*"))
-    {
-    ApplyPixelMathFilterMacro( * );
-    }
-  if (!strcmp(label,"/"))
+
+  /* the slices of this piece, the whole volume when processing in place */
+  size_t sliceSize = (size_t)nc*dim[0]*dim[1];
+  IT *inPtr = (IT *)pds->inData + sliceSize*pds->StartSlice;
+  IT *outPtr = (IT *)pds->outData;
+
+  vvPixelMathKernel<IT> kernel(op, v1);
+  if (vvPluginExecuteKernel(info, kernel, inPtr, outPtr,
+                            sliceSize*pds->NumberOfSlicesToProcess,
+                            "PixelMathing..."))
     {
-    ApplyPixelMathFilterMacro( / );
+    info->UpdateProgress(info,(float)1.0,"PixelMathing Complete");
     }
 }
 
@@ -146,7 +127,7 @@ extern "C"
   info->SetProperty(info, VVP_TERSE_DOCUMENTATION,
                     "Pixel wise operation on an image. This can be used to add/subtract or multiply/divide a constant value to all pixels in the image.");
   info->SetProperty(info, VVP_FULL_DOCUMENTATION,
-                    "This filter performs a pixel replacement, replacing pixel in the original data by the result of the specified operation. This filter operates in place, and does not change the dimensions, data type, or spacing of the volume.");
+                    "This filter performs a pixel replacement, replacing pixel in the original data by the result of the specified operation. Results are clamped to the range of the data type, and integer data divided by zero gives the largest (or smallest) value of the type. This filter operates in place, and does not change the dimensions, data type, or spacing of the volume.");
 
   info->SetProperty(info, VVP_SUPPORTS_IN_PLACE_PROCESSING, "1");
   info->SetProperty(info, VVP_SUPPORTS_PROCESSING_PIECES,   "1");
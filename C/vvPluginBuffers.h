@@ -0,0 +1,66 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Results handed from one C plugin to the next through the named buffers
+ * of vtkVVPluginInfo (SetBuffer/GetBuffer), and the layout of each one.
+ *
+ * VV_BUFFER_COMPONENTS, written by LzfConnectivity: an int array made of
+ * the volume dimensions (3 values), the number of components n, the voxel
+ * count of components 1 to n, then the raster indices (x + X*(y + Y*z))
+ * of the voxels of component 1, followed by those of component 2, etc.
+ *
+ * VV_BUFFER_SKELETON_DISTANCE, written by LzfFDT and LzfStenosisDetection:
+ * a vvPluginPointValue per skeleton voxel, the value being the fuzzy
+ * distance as found in the FDT output volume.
+ *
+ * VV_BUFFER_STENOSIS, read by LzfStatistics: a vvPluginPointValue per
+ * skeleton voxel, the value being the stenosis ratio in [0, 1]. */
+
+#ifndef vvPluginBuffers_h
+#define vvPluginBuffers_h
+
+#include "vtkVVPluginAPI.h"
+
+#define VV_BUFFER_COMPONENTS        "Lzf.Components"
+#define VV_BUFFER_SKELETON_DISTANCE "Lzf.SkeletonDistance"
+#define VV_BUFFER_STENOSIS          "Lzf.Stenosis"
+
+struct vvPluginPointValue
+{
+  int x, y, z;
+  float Value;
+};
+
+/* store 'n' elements under 'key', a NULL 'data' removes the key. Return 0
+ * on failure. */
+template <class T>
+int vvPluginSetArray(vtkVVPluginInfo *info, const char *key,
+                     const T *data, size_t n)
+{
+  if (!info->SetBuffer)
+    {
+    return 0;
+    }
+  return info->SetBuffer(info, key, data, n*sizeof(T));
+}
+
+/* return the elements stored under 'key' and their number in 'n', or NULL
+ * if no plugin stored anything under that key */
+template <class T>
+const T *vvPluginGetArray(vtkVVPluginInfo *info, const char *key, size_t *n)
+{
+  size_t size = 0;
+  const void *data = info->GetBuffer ? info->GetBuffer(info, key, &size) : 0;
+  *n = data ? size/sizeof(T) : 0;
+  return (const T *)data;
+}
+
+#endif
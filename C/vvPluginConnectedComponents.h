@@ -0,0 +1,424 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Connected component labelling for the C plugins.
+ *
+ * vvConnectedComponents labels the voxels of a single component volume
+ * whose value is above zero, with 6, 18 or 26 connectivity. The volume is
+ * cut into slabs along Z and each thread labels its slab with a union-find
+ * forest stored in the label buffer itself (one int per voxel, no other
+ * per voxel memory). The slab boundaries are then merged and the forest
+ * is flattened, again one slab per thread.
+ *
+ * Components are numbered from 1 in the raster order of their first voxel,
+ * which is the order a scan line flood fill would find them in, 0 is the
+ * background. The number of voxels and the mean intensity of each
+ * component are kept in flat arrays indexed by label. */
+
+#ifndef vvPluginConnectedComponents_h
+#define vvPluginConnectedComponents_h
+
+#include "vtkVVPluginAPI.h"
+#include "vvPluginVolume.h"
+#include "vvPluginThreads.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <vector>
+
+template <class T>
+class vvConnectedComponents
+{
+public:
+  vvConnectedComponents()
+    {
+    this->Connectivity = 26;
+    this->NumberOfThreads = vvPluginGetNumberOfProcessors();
+    this->Info = 0;
+    this->Volume = 0;
+    this->NumberOfComponents = 0;
+    this->Aborted = 0;
+    }
+
+  /* 6, 18 or 26 */
+  void SetConnectivity(int c)
+    {
+    this->Connectivity = (c == 6 || c == 18) ? c : 26;
+    }
+  int GetConnectivity() const { return this->Connectivity; }
+
+  void SetNumberOfThreads(int n)
+    {
+    this->NumberOfThreads = n < 1 ? 1 : n;
+    }
+
+  /* when set, progress is reported and aborts are honored through it */
+  void SetPluginInfo(vtkVVPluginInfo *info) { this->Info = info; }
+
+  /* label 'vol'. Return the number of components or -1 if the labels
+   * could not be allocated or the processing was aborted. */
+  int Execute(const vvVolumeView<T> &vol)
+    {
+    this->Volume = &vol;
+    this->NumberOfComponents = 0;
+    this->Aborted = 0;
+    this->Counts.clear();
+    this->Sums.clear();
+
+    const int *dim = vol.GetDimensions();
+    if (vol.GetNumberOfVoxels() >= (size_t)INT_MAX ||
+        !this->Labels.Allocate(dim))
+      {
+      return -1;
+      }
+    this->BuildNeighbors();
+
+    int numThreads = this->NumberOfThreads;
+    if (numThreads > dim[2])
+      {
+      numThreads = dim[2] > 0 ? dim[2] : 1;
+      }
+    if (numThreads > VV_PLUGIN_MAX_THREADS)
+      {
+      numThreads = VV_PLUGIN_MAX_THREADS;
+      }
+    this->SlabRoots.assign(numThreads + 1, 0);
+    this->ThreadCounts.resize(numThreads);
+    this->ThreadSums.resize(numThreads);
+
+    /* provisional labels, slab by slab */
+    this->Run(LabelSlabs, numThreads);
+    if (this->Aborted)
+      {
+      return -1;
+      }
+
+    /* join the trees across slab boundaries */
+    int t;
+    for (t = 1; t < numThreads; ++t)
+      {
+      this->MergePlane(this->SlabStart(t, numThreads, dim[2]));
+      }
+
+    /* number the roots in raster order */
+    this->Run(CountRoots, numThreads);
+    int total = 0;
+    for (t = 0; t < numThreads; ++t)
+      {
+      int n = this->SlabRoots[t];
+      this->SlabRoots[t] = total;
+      total += n;
+      }
+    this->NumberOfComponents = total;
+    this->Run(NumberRoots, numThreads);
+
+    /* flatten the forest and gather the statistics */
+    this->Run(ResolveLabels, numThreads);
+    this->Run(Accumulate, numThreads);
+
+    this->Counts.assign(total + 1, 0);
+    this->Sums.assign(total + 1, 0.0);
+    for (t = 0; t < numThreads; ++t)
+      {
+      int l;
+      for (l = 1; l <= total; ++l)
+        {
+        this->Counts[l] += this->ThreadCounts[t][l];
+        this->Sums[l] += this->ThreadSums[t][l];
+        }
+      this->ThreadCounts[t].clear();
+      this->ThreadSums[t].clear();
+      }
+    return total;
+    }
+
+  int GetNumberOfComponents() const { return this->NumberOfComponents; }
+
+  /* labels of the last execution, 0 for the background */
+  vvVolumeBuffer<int> &GetLabels() { return this->Labels; }
+
+  int GetVoxelCount(int label) const { return this->Counts[label]; }
+  double GetMeanIntensity(int label) const
+    {
+    return this->Counts[label] ? this->Sums[label] / this->Counts[label] : 0;
+    }
+
+protected:
+  enum Stage
+  {
+    LabelSlabs,
+    CountRoots,
+    NumberRoots,
+    ResolveLabels,
+    Accumulate
+  };
+
+  struct Neighbor
+  {
+    int dx, dy, dz;
+    int Offset;
+  };
+
+  /* the neighbors already visited in raster order */
+  void BuildNeighbors()
+    {
+    this->Neighbors.clear();
+    int dx, dy, dz;
+    for (dz = -1; dz <= 0; ++dz)
+      {
+      for (dy = -1; dy <= 1; ++dy)
+        {
+        for (dx = -1; dx <= 1; ++dx)
+          {
+          int d = abs(dx) + abs(dy) + abs(dz);
+          int before = dz < 0 || dy < 0 || (dy == 0 && dx < 0);
+          if (!before || (this->Connectivity == 6 && d > 1) ||
+              (this->Connectivity == 18 && d > 2))
+            {
+            continue;
+            }
+          Neighbor n;
+          n.dx = dx;
+          n.dy = dy;
+          n.dz = dz;
+          n.Offset = (int)(dz*(int)this->Volume->GetSliceStride() +
+                           dy*(int)this->Volume->GetRowStride() + dx);
+          this->Neighbors.push_back(n);
+          }
+        }
+      }
+    }
+
+  static int SlabStart(int t, int numThreads, int zd)
+    {
+    return (int)((double)zd*t/numThreads);
+    }
+
+  static void ThreadExecute(void *arg, int threadId, int numThreads)
+    {
+    vvConnectedComponents<T> *self = (vvConnectedComponents<T> *)arg;
+    const int *dim = self->Volume->GetDimensions();
+    int z0 = SlabStart(threadId, numThreads, dim[2]);
+    int z1 = SlabStart(threadId + 1, numThreads, dim[2]);
+    switch (self->CurrentStage)
+      {
+      case LabelSlabs:
+        self->LabelSlab(threadId, z0, z1);
+        break;
+      case CountRoots:
+        self->SlabRoots[threadId] = self->CountSlabRoots(z0, z1);
+        break;
+      case NumberRoots:
+        self->NumberSlabRoots(self->SlabRoots[threadId], z0, z1);
+        break;
+      case ResolveLabels:
+        self->ResolveSlab(z0, z1);
+        break;
+      case Accumulate:
+        self->AccumulateSlab(threadId, z0, z1);
+        break;
+      }
+    }
+
+  void Run(Stage stage, int numThreads)
+    {
+    this->CurrentStage = stage;
+    vvPluginParallelExecute(numThreads,
+                            &vvConnectedComponents<T>::ThreadExecute, this);
+    }
+
+  /* While labelling, a foreground voxel holds the index of its parent plus
+   * one and a root points to itself, 0 is the background. Once numbered,
+   * a voxel holds the opposite of its label. */
+  int FindRoot(int v)
+    {
+    int *p = this->Labels.GetData();
+    while (p[v] - 1 != v)
+      {
+      int parent = p[v] - 1;
+      p[v] = p[parent];
+      v = parent;
+      }
+    return v;
+    }
+
+  void Union(int a, int b)
+    {
+    int *p = this->Labels.GetData();
+    a = this->FindRoot(a);
+    b = this->FindRoot(b);
+    if (a < b)
+      {
+      p[b] = a + 1;
+      }
+    else if (b < a)
+      {
+      p[a] = b + 1;
+      }
+    }
+
+  void LinkVoxel(int x, int y, int z, int zmin)
+    {
+    int v = (int)this->Volume->Index(x, y, z);
+    size_t n;
+    for (n = 0; n < this->Neighbors.size(); ++n)
+      {
+      const Neighbor &nb = this->Neighbors[n];
+      if (z + nb.dz < zmin || !this->Volume->IsInside(x + nb.dx, y + nb.dy,
+                                                      z + nb.dz))
+        {
+        continue;
+        }
+      int w = v + nb.Offset;
+      if (this->Labels[w])
+        {
+        this->Union(v, w);
+        }
+      }
+    }
+
+  void LabelSlab(int threadId, int z0, int z1)
+    {
+    const vvVolumeView<T> &vol = *this->Volume;
+    const int *dim = vol.GetDimensions();
+    int *p = this->Labels.GetData();
+    int x, y, z;
+    for (z = z0; z < z1 && !this->Aborted; ++z)
+      {
+      if (!threadId && this->Info)
+        {
+        if (this->Info->ReportProgress(this->Info,
+                                       (float)0.8*(z - z0)/(z1 - z0),
+                                       "Labelling connected components..."))
+          {
+          this->Aborted = 1;
+          }
+        }
+      for (y = 0; y < dim[1]; ++y)
+        {
+        int v = (int)vol.Index(0, y, z);
+        for (x = 0; x < dim[0]; ++x, ++v)
+          {
+          if (vol[v] > 0)
+            {
+            p[v] = v + 1;
+            this->LinkVoxel(x, y, z, z0);
+            }
+          else
+            {
+            p[v] = 0;
+            }
+          }
+        }
+      }
+    }
+
+  /* union the first plane of a slab with the last plane of the previous */
+  void MergePlane(int z)
+    {
+    const int *dim = this->Volume->GetDimensions();
+    int x, y;
+    for (y = 0; y < dim[1]; ++y)
+      {
+      int v = (int)this->Volume->Index(0, y, z);
+      for (x = 0; x < dim[0]; ++x, ++v)
+        {
+        if (this->Labels[v])
+          {
+          this->LinkVoxel(x, y, z, z - 1);
+          }
+        }
+      }
+    }
+
+  int CountSlabRoots(int z0, int z1)
+    {
+    const int *p = this->Labels.GetData();
+    int v = (int)this->Volume->Index(0, 0, z0);
+    int end = (int)this->Volume->Index(0, 0, z1);
+    int n = 0;
+    for (; v < end; ++v)
+      {
+      n += (p[v] - 1 == v);
+      }
+    return n;
+    }
+
+  void NumberSlabRoots(int first, int z0, int z1)
+    {
+    int *p = this->Labels.GetData();
+    int v = (int)this->Volume->Index(0, 0, z0);
+    int end = (int)this->Volume->Index(0, 0, z1);
+    for (; v < end; ++v)
+      {
+      if (p[v] - 1 == v)
+        {
+        p[v] = -(++first);
+        }
+      }
+    }
+
+  /* Other threads may replace a parent link by the final label while this
+   * one walks through it, both lead to the same label. */
+  void ResolveSlab(int z0, int z1)
+    {
+    volatile int *p = this->Labels.GetData();
+    int v = (int)this->Volume->Index(0, 0, z0);
+    int end = (int)this->Volume->Index(0, 0, z1);
+    for (; v < end; ++v)
+      {
+      int w = p[v];
+      while (w > 0)
+        {
+        w = p[w - 1];
+        }
+      p[v] = w;
+      }
+    }
+
+  void AccumulateSlab(int threadId, int z0, int z1)
+    {
+    std::vector<int> &counts = this->ThreadCounts[threadId];
+    std::vector<double> &sums = this->ThreadSums[threadId];
+    counts.assign(this->NumberOfComponents + 1, 0);
+    sums.assign(this->NumberOfComponents + 1, 0.0);
+    const vvVolumeView<T> &vol = *this->Volume;
+    int *p = this->Labels.GetData();
+    int v = (int)vol.Index(0, 0, z0);
+    int end = (int)vol.Index(0, 0, z1);
+    for (; v < end; ++v)
+      {
+      int l = -p[v];
+      p[v] = l;
+      counts[l]++;
+      sums[l] += vol[v];
+      }
+    counts[0] = 0;
+    sums[0] = 0;
+    }
+
+  int Connectivity;
+  int NumberOfThreads;
+  vtkVVPluginInfo *Info;
+  const vvVolumeView<T> *Volume;
+  vvVolumeBuffer<int> Labels;
+  int NumberOfComponents;
+  volatile int Aborted;
+  Stage CurrentStage;
+  std::vector<Neighbor> Neighbors;
+  std::vector<int> SlabRoots;
+  std::vector<int> Counts;
+  std::vector<double> Sums;
+  std::vector<std::vector<int> > ThreadCounts;
+  std::vector<std::vector<double> > ThreadSums;
+};
+
+#endif
@@ -0,0 +1,709 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Voxel-wise expressions over two volumes A and B, for the
+ * ImageMathematics plugin.
+ *
+ * From the lowest precedence to the highest the grammar is
+ *
+ *   c ? x : y                      select, c is true when not 0
+ *   x || y
+ *   x && y
+ *   x < y, <=, ==, !=, >=, >       comparisons, giving 0 or 1
+ *   x + y, x - y
+ *   x * y, x / y
+ *   -x
+ *   A, B, numbers, (x), abs(x), sqrt(x), min(x, y), max(x, y),
+ *   clamp(x, lo, hi)
+ *
+ * so that "(A - B) * 0.5, clamped to 0..1000, then thresholded at 100" is
+ *
+ *   clamp((A - B)*0.5, 0, 1000) < 100 ? 0 : clamp((A - B)*0.5, 0, 1000)
+ *
+ * vvExpression<R>::Parse compiles the text once into a short program for a
+ * stack of registers, each register holding a block of values, and folds
+ * the constant sub-expressions. Execute runs the program block by block, so
+ * the whole expression is a single pass over the data. The values are
+ * computed in R; for float the instructions run on the vector registers of
+ * vvPluginKernels.h. Results are saturated to the output type as
+ * vvKernelSaturate does. Both sides of a select are computed. */
+
+#ifndef vvPluginExpression_h
+#define vvPluginExpression_h
+
+#include "vvPluginKernels.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/* the instructions */
+enum
+{
+  /* push a value */
+  VV_EXPR_A = 0,
+  VV_EXPR_B,
+  VV_EXPR_CONSTANT,
+  /* replace the top of the stack */
+  VV_EXPR_NEGATE,
+  VV_EXPR_ABS,
+  VV_EXPR_SQRT,
+  /* replace the two values on top of the stack */
+  VV_EXPR_ADD,
+  VV_EXPR_SUBTRACT,
+  VV_EXPR_MULTIPLY,
+  VV_EXPR_DIVIDE,
+  VV_EXPR_MIN,
+  VV_EXPR_MAX,
+  VV_EXPR_LESS,
+  VV_EXPR_LESS_EQUAL,
+  VV_EXPR_EQUAL,
+  VV_EXPR_NOT_EQUAL,
+  VV_EXPR_GREATER_EQUAL,
+  VV_EXPR_GREATER,
+  VV_EXPR_AND,
+  VV_EXPR_OR,
+  /* replace the three values on top of the stack */
+  VV_EXPR_SELECT
+};
+
+/* number of values an instruction pops from the stack */
+inline int vvExpressionOperands(int op)
+{
+  return op <= VV_EXPR_CONSTANT ? 0 : op <= VV_EXPR_SQRT ? 1 :
+    op <= VV_EXPR_OR ? 2 : 3;
+}
+
+/* the result of an instruction for one set of operands */
+template <int Op, class R>
+inline R vvExpressionApply(R x, R y, R z)
+{
+  switch (Op)
+    {
+    case VV_EXPR_NEGATE: return -x;
+    case VV_EXPR_ABS: return (R)fabs(x);
+    case VV_EXPR_SQRT: return (R)sqrt(x);
+    case VV_EXPR_ADD: return x + y;
+    case VV_EXPR_SUBTRACT: return x - y;
+    case VV_EXPR_MULTIPLY: return x * y;
+    case VV_EXPR_DIVIDE: return x / y;
+    case VV_EXPR_MIN: return x < y ? x : y;
+    case VV_EXPR_MAX: return x > y ? x : y;
+    case VV_EXPR_LESS: return (R)(x < y);
+    case VV_EXPR_LESS_EQUAL: return (R)(x <= y);
+    case VV_EXPR_EQUAL: return (R)(x == y);
+    case VV_EXPR_NOT_EQUAL: return (R)(x != y);
+    case VV_EXPR_GREATER_EQUAL: return (R)(x >= y);
+    case VV_EXPR_GREATER: return (R)(x > y);
+    case VV_EXPR_AND: return (R)(x != 0 && y != 0);
+    case VV_EXPR_OR: return (R)(x != 0 || y != 0);
+    default: return x != 0 ? y : z;
+    }
+}
+
+/* return call(OP) for the instruction 'op', OP being a constant */
+#define vvExpressionDispatchMacro(op, call)                             \
+  switch (op)                                                           \
+    {                                                                   \
+    case VV_EXPR_NEGATE: return call(VV_EXPR_NEGATE);                   \
+    case VV_EXPR_ABS: return call(VV_EXPR_ABS);                         \
+    case VV_EXPR_SQRT: return call(VV_EXPR_SQRT);                       \
+    case VV_EXPR_ADD: return call(VV_EXPR_ADD);                         \
+    case VV_EXPR_SUBTRACT: return call(VV_EXPR_SUBTRACT);               \
+    case VV_EXPR_MULTIPLY: return call(VV_EXPR_MULTIPLY);               \
+    case VV_EXPR_DIVIDE: return call(VV_EXPR_DIVIDE);                   \
+    case VV_EXPR_MIN: return call(VV_EXPR_MIN);                         \
+    case VV_EXPR_MAX: return call(VV_EXPR_MAX);                         \
+    case VV_EXPR_LESS: return call(VV_EXPR_LESS);                       \
+    case VV_EXPR_LESS_EQUAL: return call(VV_EXPR_LESS_EQUAL);           \
+    case VV_EXPR_EQUAL: return call(VV_EXPR_EQUAL);                     \
+    case VV_EXPR_NOT_EQUAL: return call(VV_EXPR_NOT_EQUAL);             \
+    case VV_EXPR_GREATER_EQUAL: return call(VV_EXPR_GREATER_EQUAL);     \
+    case VV_EXPR_GREATER: return call(VV_EXPR_GREATER);                 \
+    case VV_EXPR_AND: return call(VV_EXPR_AND);                         \
+    case VV_EXPR_OR: return call(VV_EXPR_OR);                           \
+    case VV_EXPR_SELECT: return call(VV_EXPR_SELECT);                   \
+    }
+
+/* the result of an instruction for one set of operands, 'op' being
+ * decided at run time (used to fold constants) */
+template <class R>
+inline R vvExpressionCompute(int op, R x, R y, R z)
+{
+#define vvExpressionComputeCall(OP) vvExpressionApply<OP, R>(x, y, z)
+  vvExpressionDispatchMacro(op, vvExpressionComputeCall);
+#undef vvExpressionComputeCall
+  return x;
+}
+
+/* Vector loop of an instruction, return the number of values processed
+ * (a multiple of the register width, 0 when R has no vector code). */
+template <class V, class R>
+struct vvExpressionVector
+{
+  static size_t Execute(int, R *, const R *, const R *, const R *, size_t)
+    {
+    return 0;
+    }
+};
+
+#ifdef VV_PLUGIN_SIMD
+template <class V>
+struct vvExpressionVector<V, float>
+{
+  static size_t Execute(int op, float *d, const float *x, const float *y,
+                        const float *z, size_t n)
+    {
+#define vvExpressionVectorCall(OP) Run<OP>(d, x, y, z, n)
+    vvExpressionDispatchMacro(op, vvExpressionVectorCall);
+#undef vvExpressionVectorCall
+    return 0;
+    }
+
+  template <int Op>
+  static size_t Run(float *d, const float *x, const float *y,
+                    const float *z, size_t n)
+    {
+    typedef typename V::Float Float;
+    const size_t width = V::Bytes / sizeof(float);
+    const Float zero = V::SetF(0.0f);
+    const Float one = V::SetF(1.0f);
+    const Float sign = V::SetF(-0.0f);
+    size_t i;
+    for (i = 0; i + width <= n; i += width)
+      {
+      Float a = V::LoadF(x + i);
+      Float b = V::LoadF(y + i);
+      Float r;
+      switch (Op)
+        {
+        case VV_EXPR_NEGATE: r = V::XorF(a, sign); break;
+        case VV_EXPR_ABS: r = V::AndNotF(sign, a); break;
+        case VV_EXPR_SQRT: r = V::SqrtF(a); break;
+        case VV_EXPR_ADD: r = V::AddF(a, b); break;
+        case VV_EXPR_SUBTRACT: r = V::SubF(a, b); break;
+        case VV_EXPR_MULTIPLY: r = V::MulF(a, b); break;
+        case VV_EXPR_DIVIDE: r = V::DivF(a, b); break;
+        case VV_EXPR_MIN: r = V::MinF(a, b); break;
+        case VV_EXPR_MAX: r = V::MaxF(a, b); break;
+        case VV_EXPR_LESS: r = V::AndF(V::CmpLtF(a, b), one); break;
+        case VV_EXPR_LESS_EQUAL: r = V::AndF(V::CmpLeF(a, b), one); break;
+        case VV_EXPR_EQUAL: r = V::AndF(V::CmpEqF(a, b), one); break;
+        case VV_EXPR_NOT_EQUAL: r = V::AndF(V::CmpNeF(a, b), one); break;
+        case VV_EXPR_GREATER_EQUAL:
+          r = V::AndF(V::CmpGeF(a, b), one);
+          break;
+        case VV_EXPR_GREATER: r = V::AndF(V::CmpGtF(a, b), one); break;
+        case VV_EXPR_AND:
+          r = V::AndF(V::AndF(V::CmpNeF(a, zero), V::CmpNeF(b, zero)), one);
+          break;
+        case VV_EXPR_OR:
+          r = V::AndF(V::OrF(V::CmpNeF(a, zero), V::CmpNeF(b, zero)), one);
+          break;
+        default:
+          {
+          Float mask = V::CmpNeF(a, zero);
+          r = V::OrF(V::AndF(mask, b), V::AndNotF(mask, V::LoadF(z + i)));
+          }
+        }
+      V::StoreF(d + i, r);
+      }
+    return i;
+    }
+};
+#endif
+
+/* d[i] = op(x[i], y[i], z[i]) for 'n' values, unused operands may be any
+ * valid array */
+template <class R>
+struct vvExpressionBlock
+{
+  static void Execute(int op, R *d, const R *x, const R *y, const R *z,
+                      size_t n)
+    {
+    size_t i = 0;
+#ifdef VV_PLUGIN_SIMD
+    i = vvExpressionVector<vvSimd, R>::Execute(op, d, x, y, z, n);
+#endif
+#define vvExpressionBlockCall(OP) Run<OP>(d, x, y, z, i, n)
+    vvExpressionDispatchMacro(op, vvExpressionBlockCall);
+#undef vvExpressionBlockCall
+    }
+
+  template <int Op>
+  static void Run(R *d, const R *x, const R *y, const R *z, size_t i,
+                  size_t n)
+    {
+    for (; i < n; ++i)
+      {
+      d[i] = vvExpressionApply<Op, R>(x[i], y[i], z[i]);
+      }
+    }
+};
+
+/* number of values per register */
+#define VV_EXPRESSION_BLOCK_SIZE 512
+
+/* deepest stack an expression may use */
+#define VV_EXPRESSION_MAX_REGISTERS 32
+
+template <class R>
+class vvExpression
+{
+public:
+  vvExpression()
+    {
+    this->NumberOfRegisters = 0;
+    this->UsesB = 0;
+    }
+
+  /* compile 'text', return 0 and set the error message if it is not a
+   * valid expression */
+  int Parse(const char *text)
+    {
+    this->Program.clear();
+    this->Error = "";
+    this->NumberOfRegisters = 0;
+    this->UsesB = 0;
+    this->Depth = 0;
+    this->Text = text ? text : "";
+    this->Position = this->Text;
+    if (!this->ParseSelect())
+      {
+      return 0;
+      }
+    this->SkipSpaces();
+    if (*this->Position)
+      {
+      return this->Fail("unexpected character");
+      }
+    return 1;
+    }
+
+  /* why Parse failed */
+  const char *GetError() const { return this->Error.c_str(); }
+
+  /* whether the expression reads B */
+  int GetUsesB() const { return this->UsesB; }
+
+  /* length of the compiled program */
+  size_t GetNumberOfInstructions() const { return this->Program.size(); }
+
+  /* evaluate the expression for 'n' voxels of 'a' and 'b' into 'out',
+   * which may be 'a' */
+  template <class TA, class TB, class TO>
+  void Execute(const TA *a, const TB *b, TO *out, size_t n) const
+    {
+    const size_t block = VV_EXPRESSION_BLOCK_SIZE;
+    /* two more registers so that unused operands are always valid */
+    std::vector<R> registers((this->NumberOfRegisters + 2)*block);
+    R *r = &registers[0];
+    size_t begin, i;
+    for (begin = 0; begin < n; begin += block)
+      {
+      size_t count = n - begin < block ? n - begin : block;
+      size_t j;
+      for (j = 0; j < this->Program.size(); ++j)
+        {
+        const Instruction &inst = this->Program[j];
+        R *d = r + inst.Register*block;
+        switch (inst.Operation)
+          {
+          case VV_EXPR_A:
+            for (i = 0; i < count; ++i)
+              {
+              d[i] = (R)a[begin + i];
+              }
+            break;
+          case VV_EXPR_B:
+            for (i = 0; i < count; ++i)
+              {
+              d[i] = (R)b[begin + i];
+              }
+            break;
+          case VV_EXPR_CONSTANT:
+            for (i = 0; i < count; ++i)
+              {
+              d[i] = inst.Value;
+              }
+            break;
+          default:
+            {
+            int operands = vvExpressionOperands(inst.Operation);
+            vvExpressionBlock<R>::Execute(inst.Operation, d, d,
+                                          operands > 1 ? d + block : d,
+                                          operands > 2 ? d + 2*block : d,
+                                          count);
+            }
+          }
+        }
+      for (i = 0; i < count; ++i)
+        {
+        out[begin + i] = vvKernelSaturate<TO>((double)r[i]);
+        }
+      }
+    }
+
+protected:
+  struct Instruction
+  {
+    int Operation;
+    /* the register of the first operand, which receives the result */
+    int Register;
+    R Value;
+  };
+
+  /* append an instruction, computing it right away when its operands are
+   * all constants */
+  void Emit(int op, R value = 0)
+    {
+    int operands = vvExpressionOperands(op);
+    size_t size = this->Program.size();
+    int constant = operands > 0 && size >= (size_t)operands;
+    int i;
+    for (i = 0; constant && i < operands; ++i)
+      {
+      constant =
+        this->Program[size - 1 - i].Operation == VV_EXPR_CONSTANT;
+      }
+    if (constant)
+      {
+      R x[3];
+      for (i = 0; i < operands; ++i)
+        {
+        x[i] = this->Program[size - operands + i].Value;
+        }
+      for (; i < 3; ++i)
+        {
+        x[i] = x[0];
+        }
+      value = vvExpressionCompute<R>(op, x[0], x[1], x[2]);
+      this->Program.resize(size - operands);
+      this->Depth -= operands;
+      op = VV_EXPR_CONSTANT;
+      operands = 0;
+      }
+
+    Instruction inst;
+    inst.Operation = op;
+    inst.Register = this->Depth - operands;
+    inst.Value = value;
+    this->Program.push_back(inst);
+    this->Depth += 1 - operands;
+    if (this->Depth > this->NumberOfRegisters)
+      {
+      this->NumberOfRegisters = this->Depth;
+      }
+    }
+
+  int Fail(const char *message)
+    {
+    char position[64];
+    sprintf(position, " at character %d",
+            (int)(this->Position - this->Text) + 1);
+    this->Error = message;
+    this->Error += position;
+    return 0;
+    }
+
+  void SkipSpaces()
+    {
+    while (isspace((unsigned char)*this->Position))
+      {
+      ++this->Position;
+      }
+    }
+
+  /* skip 'token' if it comes next */
+  int Accept(const char *token)
+    {
+    this->SkipSpaces();
+    size_t length = strlen(token);
+    if (strncmp(this->Position, token, length))
+      {
+      return 0;
+      }
+    this->Position += length;
+    return 1;
+    }
+
+  int Expect(const char *token)
+    {
+    if (this->Accept(token))
+      {
+      return 1;
+      }
+    std::string message = "expected '";
+    message += token;
+    message += "'";
+    return this->Fail(message.c_str());
+    }
+
+  int ParseSelect()
+    {
+    if (!this->ParseOr())
+      {
+      return 0;
+      }
+    if (!this->Accept("?"))
+      {
+      return 1;
+      }
+    if (!this->ParseSelect() || !this->Expect(":") || !this->ParseSelect())
+      {
+      return 0;
+      }
+    return this->Push(VV_EXPR_SELECT);
+    }
+
+  int ParseOr()
+    {
+    if (!this->ParseAnd())
+      {
+      return 0;
+      }
+    while (this->Accept("||"))
+      {
+      if (!this->ParseAnd() || !this->Push(VV_EXPR_OR))
+        {
+        return 0;
+        }
+      }
+    return 1;
+    }
+
+  int ParseAnd()
+    {
+    if (!this->ParseCompare())
+      {
+      return 0;
+      }
+    while (this->Accept("&&"))
+      {
+      if (!this->ParseCompare() || !this->Push(VV_EXPR_AND))
+        {
+        return 0;
+        }
+      }
+    return 1;
+    }
+
+  int ParseCompare()
+    {
+    if (!this->ParseSum())
+      {
+      return 0;
+      }
+    /* the longer tokens first */
+    static const char *tokens[] = { "<=", ">=", "==", "!=", "<", ">" };
+    static const int ops[] =
+      {
+      VV_EXPR_LESS_EQUAL, VV_EXPR_GREATER_EQUAL, VV_EXPR_EQUAL,
+      VV_EXPR_NOT_EQUAL, VV_EXPR_LESS, VV_EXPR_GREATER
+      };
+    int i;
+    for (i = 0; i < 6; ++i)
+      {
+      if (this->Accept(tokens[i]))
+        {
+        return this->ParseSum() && this->Push(ops[i]);
+        }
+      }
+    return 1;
+    }
+
+  int ParseSum()
+    {
+    if (!this->ParseProduct())
+      {
+      return 0;
+      }
+    while (1)
+      {
+      int op;
+      if (this->Accept("+"))
+        {
+        op = VV_EXPR_ADD;
+        }
+      else if (this->Accept("-"))
+        {
+        op = VV_EXPR_SUBTRACT;
+        }
+      else
+        {
+        return 1;
+        }
+      if (!this->ParseProduct() || !this->Push(op))
+        {
+        return 0;
+        }
+      }
+    }
+
+  int ParseProduct()
+    {
+    if (!this->ParseUnary())
+      {
+      return 0;
+      }
+    while (1)
+      {
+      int op;
+      if (this->Accept("*"))
+        {
+        op = VV_EXPR_MULTIPLY;
+        }
+      else if (this->Accept("/"))
+        {
+        op = VV_EXPR_DIVIDE;
+        }
+      else
+        {
+        return 1;
+        }
+      if (!this->ParseUnary() || !this->Push(op))
+        {
+        return 0;
+        }
+      }
+    }
+
+  int ParseUnary()
+    {
+    if (this->Accept("-"))
+      {
+      return this->ParseUnary() && this->Push(VV_EXPR_NEGATE);
+      }
+    if (this->Accept("+"))
+      {
+      return this->ParseUnary();
+      }
+    return this->ParsePrimary();
+    }
+
+  int ParsePrimary()
+    {
+    this->SkipSpaces();
+    const char *p = this->Position;
+    if (isdigit((unsigned char)*p) || *p == '.')
+      {
+      char *end;
+      double value = strtod(p, &end);
+      if (end == p)
+        {
+        return this->Fail("invalid number");
+        }
+      this->Position = end;
+      return this->Push(VV_EXPR_CONSTANT, (R)value);
+      }
+    if (this->Accept("("))
+      {
+      return this->ParseSelect() && this->Expect(")");
+      }
+    if (!isalpha((unsigned char)*p))
+      {
+      return this->Fail(*p ? "unexpected character" :
+                        "unexpected end of the expression");
+      }
+
+    std::string name;
+    while (isalnum((unsigned char)*this->Position))
+      {
+      name += (char)tolower((unsigned char)*this->Position++);
+      }
+    if (name == "a")
+      {
+      return this->Push(VV_EXPR_A);
+      }
+    if (name == "b")
+      {
+      this->UsesB = 1;
+      return this->Push(VV_EXPR_B);
+      }
+    if (name == "abs" || name == "sqrt")
+      {
+      return this->Expect("(") && this->ParseSelect() &&
+        this->Expect(")") &&
+        this->Push(name == "abs" ? VV_EXPR_ABS : VV_EXPR_SQRT);
+      }
+    if (name == "min" || name == "max")
+      {
+      return this->Expect("(") && this->ParseSelect() &&
+        this->Expect(",") && this->ParseSelect() && this->Expect(")") &&
+        this->Push(name == "min" ? VV_EXPR_MIN : VV_EXPR_MAX);
+      }
+    if (name == "clamp")
+      {
+      /* min(max(x, lo), hi) */
+      if (!this->Expect("(") || !this->ParseSelect() ||
+          !this->Expect(",") || !this->ParseSelect() ||
+          !this->Push(VV_EXPR_MAX) || !this->Expect(",") ||
+          !this->ParseSelect() || !this->Expect(")"))
+        {
+        return 0;
+        }
+      return this->Push(VV_EXPR_MIN);
+      }
+    this->Position = p;
+    return this->Fail(("unknown name '" + name + "'").c_str());
+    }
+
+  /* Emit, failing when the stack gets too deep */
+  int Push(int op, R value = 0)
+    {
+    this->Emit(op, value);
+    if (this->NumberOfRegisters > VV_EXPRESSION_MAX_REGISTERS)
+      {
+      return this->Fail("expression too deeply nested");
+      }
+    return 1;
+    }
+
+  std::vector<Instruction> Program;
+  int NumberOfRegisters;
+  int UsesB;
+
+  /* parser state */
+  const char *Text;
+  const char *Position;
+  int Depth;
+  std::string Error;
+};
+
+/* Adapts an expression to vvPluginExecuteKernel, which hands out ranges
+ * of the first input; the matching range of B is found from the offset
+ * into A. */
+template <class R, class TA, class TB>
+class vvExpressionKernel
+{
+public:
+  vvExpressionKernel(const vvExpression<R> &expression, const TA *a,
+                     const TB *b)
+    : Expression(expression), A(a), B(b)
+    {
+    }
+
+  void Execute(const TA *in, TA *out, size_t n) const
+    {
+    this->Expression.Execute(in, this->B + (in - this->A), out, n);
+    }
+
+protected:
+  const vvExpression<R> &Expression;
+  const TA *A;
+  const TB *B;
+};
+
+#endif
@@ -0,0 +1,354 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Fuzzy distance transform for the C plugins.
+ *
+ * The fuzzy distance of a voxel is the length of the shortest 26-connected
+ * path to a background voxel, the step between two neighbors p and q
+ * costing 0.5*(mu(p) + mu(q))*|p - q| where mu is the fuzzy membership of
+ * the voxels.
+ *
+ * The caller fills 'omega' with 0 on the background and a value larger
+ * than any distance (FLT_MAX for instance) on the object, then Execute()
+ * replaces the object values by their distance.
+ *
+ * In Exact mode the distances are settled in increasing order with a
+ * binary heap (Dijkstra), every voxel is finalized once. In Approximate
+ * mode each iteration sweeps the volume plane by plane along +X, -X, +Y,
+ * -Y, +Z and -Z, each voxel being relaxed from the 9 neighbors of the
+ * previous plane; the voxels of a plane are shared among threads. The
+ * result is never below the exact distance and is equal to it for paths
+ * that change direction less often than the number of iterations, which
+ * is good enough for interactive previews. */
+
+#ifndef vvPluginFuzzyDistance_h
+#define vvPluginFuzzyDistance_h
+
+#include "vtkVVPluginAPI.h"
+#include "vvPluginVolume.h"
+#include "vvPluginThreads.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+class vvFuzzyDistanceTransform
+{
+public:
+  enum
+  {
+    Exact = 0,
+    Approximate = 1
+  };
+
+  vvFuzzyDistanceTransform()
+    {
+    this->Mode = Exact;
+    this->NumberOfIterations = 2;
+    this->NumberOfThreads = vvPluginGetNumberOfProcessors();
+    this->Info = 0;
+    this->Mu = 0;
+    this->Omega = 0;
+    this->Aborted = 0;
+    }
+
+  void SetMode(int mode) { this->Mode = mode; }
+  int GetMode() const { return this->Mode; }
+
+  /* number of sweep iterations in Approximate mode */
+  void SetNumberOfIterations(int n)
+    {
+    this->NumberOfIterations = n < 1 ? 1 : n;
+    }
+
+  void SetNumberOfThreads(int n)
+    {
+    this->NumberOfThreads = n < 1 ? 1 : n;
+    }
+
+  /* when set, progress is reported and aborts are honored through it */
+  void SetPluginInfo(vtkVVPluginInfo *info) { this->Info = info; }
+
+  /* compute the distances in place in 'omega'. Return 0 if aborted. */
+  int Execute(const vvVolumeView<float> &mu, vvVolumeView<float> &omega)
+    {
+    this->Mu = &mu;
+    this->Omega = &omega;
+    this->Aborted = 0;
+    this->BuildNeighbors();
+    if (this->Mode == Approximate)
+      {
+      this->ExecuteSweeps();
+      }
+    else
+      {
+      this->ExecuteDijkstra();
+      }
+    return !this->Aborted;
+    }
+
+protected:
+  struct Neighbor
+  {
+    int d[3];
+    float Distance;
+    ptrdiff_t Offset;
+  };
+
+  struct HeapEntry
+  {
+    float Distance;
+    size_t Index;
+    bool operator>(const HeapEntry &e) const
+      {
+      return this->Distance > e.Distance;
+      }
+  };
+
+  void BuildNeighbors()
+    {
+    this->Neighbors.clear();
+    int dx, dy, dz;
+    for (dz = -1; dz <= 1; ++dz)
+      {
+      for (dy = -1; dy <= 1; ++dy)
+        {
+        for (dx = -1; dx <= 1; ++dx)
+          {
+          if (!dx && !dy && !dz)
+            {
+            continue;
+            }
+          Neighbor n;
+          n.d[0] = dx;
+          n.d[1] = dy;
+          n.d[2] = dz;
+          n.Distance = (float)sqrt((double)(dx*dx + dy*dy + dz*dz));
+          n.Offset = (ptrdiff_t)dz*(ptrdiff_t)this->Omega->GetSliceStride() +
+            (ptrdiff_t)dy*(ptrdiff_t)this->Omega->GetRowStride() + dx;
+          this->Neighbors.push_back(n);
+          }
+        }
+      }
+    }
+
+  int CheckAbort(float progress, const char *msg)
+    {
+    if (this->Info)
+      {
+      if (this->Info->ReportProgress(this->Info, progress, msg))
+        {
+        this->Aborted = 1;
+        }
+      }
+    return this->Aborted;
+    }
+
+  /* label setting: each voxel leaves the heap once with its final value */
+  void ExecuteDijkstra()
+    {
+    const vvVolumeView<float> &mu = *this->Mu;
+    vvVolumeView<float> &omega = *this->Omega;
+    const int *dim = omega.GetDimensions();
+    std::vector<HeapEntry> heap;
+    size_t numObject = 0;
+    int x, y, z;
+    size_t n;
+
+    /* the background voxels touching the object start the propagation */
+    for (z = 0; z < dim[2]; ++z)
+      {
+      for (y = 0; y < dim[1]; ++y)
+        {
+        for (x = 0; x < dim[0]; ++x)
+          {
+          size_t i = omega.Index(x, y, z);
+          if (omega[i] > 0)
+            {
+            ++numObject;
+            continue;
+            }
+          for (n = 0; n < this->Neighbors.size(); ++n)
+            {
+            const Neighbor &nb = this->Neighbors[n];
+            if (omega.IsInside(x + nb.d[0], y + nb.d[1], z + nb.d[2]) &&
+                omega[i + nb.Offset] > 0)
+              {
+              HeapEntry e;
+              e.Distance = 0;
+              e.Index = i;
+              heap.push_back(e);
+              break;
+              }
+            }
+          }
+        }
+      }
+
+    std::greater<HeapEntry> order;
+    size_t settled = 0;
+    size_t sliceSize = omega.GetSliceStride();
+    while (!heap.empty())
+      {
+      std::pop_heap(heap.begin(), heap.end(), order);
+      HeapEntry e = heap.back();
+      heap.pop_back();
+      if (e.Distance > omega[e.Index])
+        {
+        continue; /* stale entry, the voxel was settled with less */
+        }
+      if (!(++settled & 0xffff) &&
+          this->CheckAbort((float)settled/(numObject + 1),
+                           "Computing fuzzy distance..."))
+        {
+        return;
+        }
+      z = (int)(e.Index / sliceSize);
+      y = (int)((e.Index % sliceSize) / dim[0]);
+      x = (int)(e.Index % dim[0]);
+      float mup = mu[e.Index];
+      for (n = 0; n < this->Neighbors.size(); ++n)
+        {
+        const Neighbor &nb = this->Neighbors[n];
+        if (!omega.IsInside(x + nb.d[0], y + nb.d[1], z + nb.d[2]))
+          {
+          continue;
+          }
+        size_t q = e.Index + nb.Offset;
+        float d = e.Distance + 0.5f*(mup + mu[q])*nb.Distance;
+        if (d < omega[q])
+          {
+          omega[q] = d;
+          HeapEntry f;
+          f.Distance = d;
+          f.Index = q;
+          heap.push_back(f);
+          std::push_heap(heap.begin(), heap.end(), order);
+          }
+        }
+      }
+    }
+
+  /* Approximate mode. For a sweep along 'Axis' the threads share the
+   * planes: along Z each one takes a band of rows, along X and Y a band
+   * of slices. A voxel on the edge of a band may read a neighbor another
+   * thread is updating, either value is the length of an existing path so
+   * the result stays an upper bound of the exact distance. */
+  void ExecuteSweeps()
+    {
+    int it, axis, dir;
+    int numSweeps = 6*this->NumberOfIterations;
+    int sweep = 0;
+    for (it = 0; it < this->NumberOfIterations; ++it)
+      {
+      for (axis = 0; axis < 3; ++axis)
+        {
+        for (dir = 1; dir >= -1; dir -= 2, ++sweep)
+          {
+          if (this->CheckAbort((float)sweep/numSweeps,
+                               "Computing fuzzy distance (preview)..."))
+            {
+            return;
+            }
+          this->SweepAxis = axis;
+          this->SweepDirection = dir;
+          int bandAxis = axis == 2 ? 1 : 2;
+          int numThreads = this->NumberOfThreads;
+          if (numThreads > this->Omega->GetDimensions()[bandAxis])
+            {
+            numThreads = this->Omega->GetDimensions()[bandAxis];
+            }
+          vvPluginParallelExecute(numThreads,
+                                  &vvFuzzyDistanceTransform::SweepThread,
+                                  this);
+          }
+        }
+      }
+    }
+
+  static void SweepThread(void *arg, int threadId, int numThreads)
+    {
+    vvFuzzyDistanceTransform *self = (vvFuzzyDistanceTransform *)arg;
+    const int *dim = self->Omega->GetDimensions();
+    int axis = self->SweepAxis;
+    int bandAxis = axis == 2 ? 1 : 2;
+    int otherAxis = 3 - axis - bandAxis;
+    int b0 = (int)((double)dim[bandAxis]*threadId/numThreads);
+    int b1 = (int)((double)dim[bandAxis]*(threadId + 1)/numThreads);
+    int dir = self->SweepDirection;
+    int first = dir > 0 ? 1 : dim[axis] - 2;
+    int last = dir > 0 ? dim[axis] : -1;
+
+    /* the 9 neighbors in the previous plane */
+    std::vector<const Neighbor *> previous;
+    size_t n;
+    for (n = 0; n < self->Neighbors.size(); ++n)
+      {
+      if (self->Neighbors[n].d[axis] == -dir)
+        {
+        previous.push_back(&self->Neighbors[n]);
+        }
+      }
+
+    const vvVolumeView<float> &mu = *self->Mu;
+    vvVolumeView<float> &omega = *self->Omega;
+    int p[3];
+    for (p[axis] = first; p[axis] != last; p[axis] += dir)
+      {
+      for (p[bandAxis] = b0; p[bandAxis] < b1; ++p[bandAxis])
+        {
+        for (p[otherAxis] = 0; p[otherAxis] < dim[otherAxis];
+             ++p[otherAxis])
+          {
+          size_t i = omega.Index(p[0], p[1], p[2]);
+          float best = omega[i];
+          if (best <= 0)
+            {
+            continue;
+            }
+          float mup = mu[i];
+          for (n = 0; n < previous.size(); ++n)
+            {
+            const Neighbor &nb = *previous[n];
+            if (!omega.IsInside(p[0] + nb.d[0], p[1] + nb.d[1],
+                                p[2] + nb.d[2]))
+              {
+              continue;
+              }
+            size_t q = i + nb.Offset;
+            float d = omega[q] + 0.5f*(mup + mu[q])*nb.Distance;
+            if (d < best)
+              {
+              best = d;
+              }
+            }
+          omega[i] = best;
+          }
+        }
+      }
+    }
+
+  int Mode;
+  int NumberOfIterations;
+  int NumberOfThreads;
+  vtkVVPluginInfo *Info;
+  const vvVolumeView<float> *Mu;
+  vvVolumeView<float> *Omega;
+  volatile int Aborted;
+  int SweepAxis;
+  int SweepDirection;
+  std::vector<Neighbor> Neighbors;
+};
+
+#endif
@@ -0,0 +1,971 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Voxel-wise kernels of the Threshold and PixelMath plugins.
+ *
+ * vvThresholdKernel replaces the values that compare to a threshold with a
+ * replacement value, vvPixelMathKernel adds, subtracts, multiplies or
+ * divides by a constant. Both are templated on the scalar type and pick
+ * the operator once per call, the inner loops being instantiated for each
+ * operator. Results saturate to the range of the scalar type instead of
+ * wrapping around: 30000 + 5000 gives 32767 for short data, x / 0 gives the
+ * largest (or smallest) value of the type and 0 / 0 gives 0.
+ *
+ * For integer types the threshold is applied exactly, as if the voxel
+ * values were compared to the real value typed by the user (x < 2.5 is
+ * x <= 2 and x == 2.5 never holds), while the PixelMath operand is
+ * truncated to an integer as before.
+ *
+ * The loops run on SSE2 registers, or AVX2 ones when the plugin is built
+ * with AVX2 enabled (-mavx2, /arch:AVX2), for the 8, 16 and 32 bits
+ * integers and for float, the remaining voxels and types going through the
+ * scalar code. PixelMath is vectorized for addition and subtraction on 8
+ * and 16 bits integers (with the saturating instructions) and for all the
+ * operators on float; the other operators on 8 and 16 bits integers read a
+ * table of the results computed once for every possible value.
+ *
+ * vvPluginExecuteKernel splits the volume in one contiguous range of
+ * voxels per thread. */
+
+#ifndef vvPluginKernels_h
+#define vvPluginKernels_h
+
+#include "vtkVVPluginAPI.h"
+#include "vvPluginThreads.h"
+
+#include <limits>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VV_PLUGIN_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(VV_PLUGIN_SSE2) && defined(__AVX2__)
+#define VV_PLUGIN_AVX2
+#include <immintrin.h>
+#endif
+
+/* the operators, as returned by vvPluginKernelOperation */
+enum
+{
+  VV_KERNEL_LESS = 0,
+  VV_KERNEL_LESS_EQUAL,
+  VV_KERNEL_EQUAL,
+  VV_KERNEL_GREATER_EQUAL,
+  VV_KERNEL_GREATER,
+  VV_KERNEL_ADD,
+  VV_KERNEL_SUBTRACT,
+  VV_KERNEL_MULTIPLY,
+  VV_KERNEL_DIVIDE
+};
+
+/* the operator matching a GUI label ("<", "<=", "==", ">=", ">", "+", "-",
+ * "*" or "/"), -1 if there is none */
+inline int vvPluginKernelOperation(const char *label)
+{
+  static const char *labels[] =
+    { "<", "<=", "==", ">=", ">", "+", "-", "*", "/" };
+  int i;
+  for (i = 0; label && i < (int)(sizeof(labels)/sizeof(labels[0])); ++i)
+    {
+    if (!strcmp(label, labels[i]))
+      {
+      return i;
+      }
+    }
+  return -1;
+}
+
+/* smallest and largest values of T as doubles */
+template <class T>
+inline double vvKernelMinimum()
+{
+  return std::numeric_limits<T>::is_integer ?
+    (double)std::numeric_limits<T>::min() :
+    -(double)std::numeric_limits<T>::max();
+}
+
+template <class T>
+inline double vvKernelMaximum()
+{
+  return (double)std::numeric_limits<T>::max();
+}
+
+/* convert 'v' to T, clamping it to the range of T. Integer types truncate
+ * toward zero and turn NaN into 0, floating point types keep infinities
+ * and NaN. */
+template <class T>
+inline T vvKernelSaturate(double v)
+{
+  if (!std::numeric_limits<T>::is_integer)
+    {
+    if (v > vvKernelMaximum<T>() && v != HUGE_VAL)
+      {
+      return std::numeric_limits<T>::max();
+      }
+    if (v < vvKernelMinimum<T>() && v != -HUGE_VAL)
+      {
+      return -std::numeric_limits<T>::max();
+      }
+    return (T)v;
+    }
+  if (v != v)
+    {
+    return 0;
+    }
+  if (v <= vvKernelMinimum<T>())
+    {
+    return std::numeric_limits<T>::min();
+    }
+  if (v >= vvKernelMaximum<T>())
+    {
+    return std::numeric_limits<T>::max();
+    }
+  return (T)v;
+}
+
+//-----------------------------------------------------------
+// Vector registers
+
+#ifdef VV_PLUGIN_SSE2
+#define VV_PLUGIN_SIMD
+
+struct vvSimdSSE2
+{
+  typedef __m128i Int;
+  typedef __m128 Float;
+  enum { Bytes = 16 };
+
+  static Int Load(const void *p) { return _mm_loadu_si128((const Int *)p); }
+  static void Store(void *p, Int a) { _mm_storeu_si128((Int *)p, a); }
+  static Int And(Int a, Int b) { return _mm_and_si128(a, b); }
+  /* ~a & b */
+  static Int AndNot(Int a, Int b) { return _mm_andnot_si128(a, b); }
+  static Int Or(Int a, Int b) { return _mm_or_si128(a, b); }
+  static Int Xor(Int a, Int b) { return _mm_xor_si128(a, b); }
+
+  static Int Set8(char v) { return _mm_set1_epi8(v); }
+  static Int CmpGt8(Int a, Int b) { return _mm_cmpgt_epi8(a, b); }
+  static Int CmpEq8(Int a, Int b) { return _mm_cmpeq_epi8(a, b); }
+  static Int AddS8(Int a, Int b) { return _mm_adds_epi8(a, b); }
+  static Int SubS8(Int a, Int b) { return _mm_subs_epi8(a, b); }
+  static Int AddU8(Int a, Int b) { return _mm_adds_epu8(a, b); }
+  static Int SubU8(Int a, Int b) { return _mm_subs_epu8(a, b); }
+
+  static Int Set16(short v) { return _mm_set1_epi16(v); }
+  static Int CmpGt16(Int a, Int b) { return _mm_cmpgt_epi16(a, b); }
+  static Int CmpEq16(Int a, Int b) { return _mm_cmpeq_epi16(a, b); }
+  static Int AddS16(Int a, Int b) { return _mm_adds_epi16(a, b); }
+  static Int SubS16(Int a, Int b) { return _mm_subs_epi16(a, b); }
+  static Int AddU16(Int a, Int b) { return _mm_adds_epu16(a, b); }
+  static Int SubU16(Int a, Int b) { return _mm_subs_epu16(a, b); }
+
+  static Int Set32(int v) { return _mm_set1_epi32(v); }
+  static Int CmpGt32(Int a, Int b) { return _mm_cmpgt_epi32(a, b); }
+  static Int CmpEq32(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+
+  static Float LoadF(const float *p) { return _mm_loadu_ps(p); }
+  static void StoreF(float *p, Float a) { _mm_storeu_ps(p, a); }
+  static Float SetF(float v) { return _mm_set1_ps(v); }
+  static Float AndF(Float a, Float b) { return _mm_and_ps(a, b); }
+  static Float AndNotF(Float a, Float b) { return _mm_andnot_ps(a, b); }
+  static Float OrF(Float a, Float b) { return _mm_or_ps(a, b); }
+  static Float XorF(Float a, Float b) { return _mm_xor_ps(a, b); }
+  static Float AddF(Float a, Float b) { return _mm_add_ps(a, b); }
+  static Float SubF(Float a, Float b) { return _mm_sub_ps(a, b); }
+  static Float MulF(Float a, Float b) { return _mm_mul_ps(a, b); }
+  static Float DivF(Float a, Float b) { return _mm_div_ps(a, b); }
+  /* a < b ? a : b and a > b ? a : b */
+  static Float MinF(Float a, Float b) { return _mm_min_ps(a, b); }
+  static Float MaxF(Float a, Float b) { return _mm_max_ps(a, b); }
+  static Float SqrtF(Float a) { return _mm_sqrt_ps(a); }
+  static Float CmpLtF(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+  static Float CmpLeF(Float a, Float b) { return _mm_cmple_ps(a, b); }
+  static Float CmpEqF(Float a, Float b) { return _mm_cmpeq_ps(a, b); }
+  /* true when a or b is NaN, as a != b */
+  static Float CmpNeF(Float a, Float b) { return _mm_cmpneq_ps(a, b); }
+  static Float CmpGeF(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+  static Float CmpGtF(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+};
+#endif
+
+#ifdef VV_PLUGIN_AVX2
+struct vvSimdAVX2
+{
+  typedef __m256i Int;
+  typedef __m256 Float;
+  enum { Bytes = 32 };
+
+  static Int Load(const void *p)
+    {
+    return _mm256_loadu_si256((const Int *)p);
+    }
+  static void Store(void *p, Int a) { _mm256_storeu_si256((Int *)p, a); }
+  static Int And(Int a, Int b) { return _mm256_and_si256(a, b); }
+  /* ~a & b */
+  static Int AndNot(Int a, Int b) { return _mm256_andnot_si256(a, b); }
+  static Int Or(Int a, Int b) { return _mm256_or_si256(a, b); }
+  static Int Xor(Int a, Int b) { return _mm256_xor_si256(a, b); }
+
+  static Int Set8(char v) { return _mm256_set1_epi8(v); }
+  static Int CmpGt8(Int a, Int b) { return _mm256_cmpgt_epi8(a, b); }
+  static Int CmpEq8(Int a, Int b) { return _mm256_cmpeq_epi8(a, b); }
+  static Int AddS8(Int a, Int b) { return _mm256_adds_epi8(a, b); }
+  static Int SubS8(Int a, Int b) { return _mm256_subs_epi8(a, b); }
+  static Int AddU8(Int a, Int b) { return _mm256_adds_epu8(a, b); }
+  static Int SubU8(Int a, Int b) { return _mm256_subs_epu8(a, b); }
+
+  static Int Set16(short v) { return _mm256_set1_epi16(v); }
+  static Int CmpGt16(Int a, Int b) { return _mm256_cmpgt_epi16(a, b); }
+  static Int CmpEq16(Int a, Int b) { return _mm256_cmpeq_epi16(a, b); }
+  static Int AddS16(Int a, Int b) { return _mm256_adds_epi16(a, b); }
+  static Int SubS16(Int a, Int b) { return _mm256_subs_epi16(a, b); }
+  static Int AddU16(Int a, Int b) { return _mm256_adds_epu16(a, b); }
+  static Int SubU16(Int a, Int b) { return _mm256_subs_epu16(a, b); }
+
+  static Int Set32(int v) { return _mm256_set1_epi32(v); }
+  static Int CmpGt32(Int a, Int b) { return _mm256_cmpgt_epi32(a, b); }
+  static Int CmpEq32(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+
+  static Float LoadF(const float *p) { return _mm256_loadu_ps(p); }
+  static void StoreF(float *p, Float a) { _mm256_storeu_ps(p, a); }
+  static Float SetF(float v) { return _mm256_set1_ps(v); }
+  static Float AndF(Float a, Float b) { return _mm256_and_ps(a, b); }
+  static Float AndNotF(Float a, Float b) { return _mm256_andnot_ps(a, b); }
+  static Float OrF(Float a, Float b) { return _mm256_or_ps(a, b); }
+  static Float XorF(Float a, Float b) { return _mm256_xor_ps(a, b); }
+  static Float AddF(Float a, Float b) { return _mm256_add_ps(a, b); }
+  static Float SubF(Float a, Float b) { return _mm256_sub_ps(a, b); }
+  static Float MulF(Float a, Float b) { return _mm256_mul_ps(a, b); }
+  static Float DivF(Float a, Float b) { return _mm256_div_ps(a, b); }
+  static Float MinF(Float a, Float b) { return _mm256_min_ps(a, b); }
+  static Float MaxF(Float a, Float b) { return _mm256_max_ps(a, b); }
+  static Float SqrtF(Float a) { return _mm256_sqrt_ps(a); }
+  static Float CmpLtF(Float a, Float b)
+    {
+    return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+    }
+  static Float CmpLeF(Float a, Float b)
+    {
+    return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+    }
+  static Float CmpEqF(Float a, Float b)
+    {
+    return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+    }
+  static Float CmpNeF(Float a, Float b)
+    {
+    return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ);
+    }
+  static Float CmpGeF(Float a, Float b)
+    {
+    return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+    }
+  static Float CmpGtF(Float a, Float b)
+    {
+    return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+    }
+};
+#endif
+
+/* the widest registers available */
+#if defined(VV_PLUGIN_AVX2)
+typedef vvSimdAVX2 vvSimd;
+#elif defined(VV_PLUGIN_SSE2)
+typedef vvSimdSSE2 vvSimd;
+#endif
+
+/* which vector code handles T */
+enum
+{
+  VV_SIMD_NONE = 0,
+  VV_SIMD_SMALL_INTEGER,  /* 8 and 16 bits, with saturating arithmetic */
+  VV_SIMD_INTEGER,        /* 32 bits, comparisons only */
+  VV_SIMD_FLOAT
+};
+
+template <class T>
+struct vvSimdKind
+{
+  enum
+  {
+    Value = !std::numeric_limits<T>::is_integer ? VV_SIMD_NONE :
+      sizeof(T) <= 2 ? VV_SIMD_SMALL_INTEGER :
+      sizeof(T) == 4 ? VV_SIMD_INTEGER : VV_SIMD_NONE
+  };
+};
+
+template <>
+struct vvSimdKind<float>
+{
+  enum { Value = VV_SIMD_FLOAT };
+};
+
+#ifdef VV_PLUGIN_SIMD
+/* the integer operations of V on lanes of 'Size' bytes */
+template <class V, int Size>
+struct vvSimdLanes;
+
+template <class V>
+struct vvSimdLanes<V, 1>
+{
+  typedef typename V::Int Int;
+  static Int Set(int v) { return V::Set8((char)v); }
+  static Int CmpGt(Int a, Int b) { return V::CmpGt8(a, b); }
+  static Int CmpEq(Int a, Int b) { return V::CmpEq8(a, b); }
+  static Int AddS(Int a, Int b) { return V::AddS8(a, b); }
+  static Int SubS(Int a, Int b) { return V::SubS8(a, b); }
+  static Int AddU(Int a, Int b) { return V::AddU8(a, b); }
+  static Int SubU(Int a, Int b) { return V::SubU8(a, b); }
+  /* the sign bit of every lane */
+  static Int SignBit() { return V::Set8((char)0x80); }
+};
+
+template <class V>
+struct vvSimdLanes<V, 2>
+{
+  typedef typename V::Int Int;
+  static Int Set(int v) { return V::Set16((short)v); }
+  static Int CmpGt(Int a, Int b) { return V::CmpGt16(a, b); }
+  static Int CmpEq(Int a, Int b) { return V::CmpEq16(a, b); }
+  static Int AddS(Int a, Int b) { return V::AddS16(a, b); }
+  static Int SubS(Int a, Int b) { return V::SubS16(a, b); }
+  static Int AddU(Int a, Int b) { return V::AddU16(a, b); }
+  static Int SubU(Int a, Int b) { return V::SubU16(a, b); }
+  static Int SignBit() { return V::Set16((short)0x8000); }
+};
+
+template <class V>
+struct vvSimdLanes<V, 4>
+{
+  typedef typename V::Int Int;
+  static Int Set(int v) { return V::Set32(v); }
+  static Int CmpGt(Int a, Int b) { return V::CmpGt32(a, b); }
+  static Int CmpEq(Int a, Int b) { return V::CmpEq32(a, b); }
+  static Int SignBit() { return V::Set32((int)0x80000000u); }
+};
+#endif
+
+//-----------------------------------------------------------
+// Threshold
+
+/* x <op> c, op being one of VV_KERNEL_LESS to VV_KERNEL_GREATER */
+template <int Op, class T>
+inline bool vvThresholdTest(T x, T c)
+{
+  switch (Op)
+    {
+    case VV_KERNEL_LESS: return x < c;
+    case VV_KERNEL_LESS_EQUAL: return x <= c;
+    case VV_KERNEL_EQUAL: return x == c;
+    case VV_KERNEL_GREATER_EQUAL: return x >= c;
+    default: return x > c;
+    }
+}
+
+/* Vector loop of the threshold, return the number of values processed
+ * (a multiple of the register width, 0 when T has no vector code). The
+ * integer types only come with LESS, EQUAL and GREATER_EQUAL, see
+ * vvThresholdKernel. */
+template <class V, class T, int Op, int Kind = vvSimdKind<T>::Value>
+struct vvThresholdVector
+{
+  static size_t Execute(const T *, T *, size_t, T, T) { return 0; }
+};
+
+#ifdef VV_PLUGIN_SIMD
+template <class V, class T, int Op>
+struct vvThresholdVector<V, T, Op, VV_SIMD_INTEGER>
+{
+  static size_t Execute(const T *in, T *out, size_t n, T value,
+                        T replacement)
+    {
+    typedef vvSimdLanes<V, sizeof(T)> L;
+    typedef typename V::Int Int;
+    const size_t width = V::Bytes / sizeof(T);
+    /* unsigned values are compared as signed ones once their sign bit is
+     * flipped */
+    const Int bias =
+      std::numeric_limits<T>::is_signed ? L::Set(0) : L::SignBit();
+    const Int c = V::Xor(L::Set((int)value), bias);
+    const Int r = L::Set((int)replacement);
+    size_t i;
+    for (i = 0; i + width <= n; i += width)
+      {
+      Int x = V::Load(in + i);
+      Int mask = Op == VV_KERNEL_EQUAL ?
+        L::CmpEq(V::Xor(x, bias), c) : L::CmpGt(c, V::Xor(x, bias));
+      if (Op == VV_KERNEL_GREATER_EQUAL)
+        {
+        x = V::Or(V::And(mask, x), V::AndNot(mask, r));
+        }
+      else
+        {
+        x = V::Or(V::And(mask, r), V::AndNot(mask, x));
+        }
+      V::Store(out + i, x);
+      }
+    return i;
+    }
+};
+
+template <class V, class T, int Op>
+struct vvThresholdVector<V, T, Op, VV_SIMD_SMALL_INTEGER>
+  : public vvThresholdVector<V, T, Op, VV_SIMD_INTEGER>
+{
+};
+
+template <class V, class T, int Op>
+struct vvThresholdVector<V, T, Op, VV_SIMD_FLOAT>
+{
+  static size_t Execute(const float *in, float *out, size_t n, float value,
+                        float replacement)
+    {
+    typedef typename V::Float Float;
+    const size_t width = V::Bytes / sizeof(float);
+    const Float c = V::SetF(value);
+    const Float r = V::SetF(replacement);
+    size_t i;
+    for (i = 0; i + width <= n; i += width)
+      {
+      Float x = V::LoadF(in + i);
+      Float mask;
+      switch (Op)
+        {
+        case VV_KERNEL_LESS: mask = V::CmpLtF(x, c); break;
+        case VV_KERNEL_LESS_EQUAL: mask = V::CmpLeF(x, c); break;
+        case VV_KERNEL_EQUAL: mask = V::CmpEqF(x, c); break;
+        case VV_KERNEL_GREATER_EQUAL: mask = V::CmpGeF(x, c); break;
+        default: mask = V::CmpGtF(x, c); break;
+        }
+      V::StoreF(out + i, V::OrF(V::AndF(mask, r), V::AndNotF(mask, x)));
+      }
+    return i;
+    }
+};
+#endif
+
+template <class T>
+class vvThresholdKernel
+{
+public:
+  /* replace the values v such that v <op> value holds by 'replacement',
+   * op being one of VV_KERNEL_LESS to VV_KERNEL_GREATER */
+  vvThresholdKernel(int op, double value, double replacement)
+    {
+    this->UseVector = 1;
+    this->Replacement = vvKernelSaturate<T>(replacement);
+    this->Operation = op;
+    this->Value = vvKernelSaturate<T>(value);
+    if (!std::numeric_limits<T>::is_integer)
+      {
+      return;
+      }
+
+    /* For integers turn the comparison into x < t, x == t or x >= t with
+     * t in the range of T, or into one that always (or never) holds. 'top'
+     * is the largest value plus one, which doubles hold exactly even for
+     * 64 bits types. Those cannot hold t + 1 either, they keep <= and >
+     * (they have no vector code anyway). */
+    double lo = vvKernelMinimum<T>();
+    double top = vvKernelMaximum<T>() + 1;
+    int exact = sizeof(T) <= 4;
+    double t;
+    if (value != value)
+      {
+      this->Operation = None;
+      return;
+      }
+    switch (op)
+      {
+      case VV_KERNEL_LESS:
+        t = ceil(value);
+        this->Set(t >= top, t <= lo, VV_KERNEL_LESS, t);
+        break;
+      case VV_KERNEL_LESS_EQUAL:
+        t = floor(value);
+        if (exact)
+          {
+          this->Set(t + 1 >= top, t < lo, VV_KERNEL_LESS, t + 1);
+          }
+        else
+          {
+          this->Set(t >= top, t < lo, VV_KERNEL_LESS_EQUAL, t);
+          }
+        break;
+      case VV_KERNEL_EQUAL:
+        this->Set(0, value != floor(value) || value < lo || value >= top,
+                  VV_KERNEL_EQUAL, value);
+        break;
+      case VV_KERNEL_GREATER_EQUAL:
+        t = ceil(value);
+        this->Set(t <= lo, t >= top, VV_KERNEL_GREATER_EQUAL, t);
+        break;
+      case VV_KERNEL_GREATER:
+        t = floor(value);
+        if (exact)
+          {
+          this->Set(t < lo, t + 1 >= top, VV_KERNEL_GREATER_EQUAL, t + 1);
+          }
+        else
+          {
+          this->Set(t < lo, t >= top, VV_KERNEL_GREATER, t);
+          }
+        break;
+      default:
+        this->Operation = None;
+      }
+    }
+
+  /* disable the vector code, to compare it with the scalar one */
+  void SetUseVector(int use) { this->UseVector = use; }
+
+  /* threshold 'n' values from 'in' to 'out', which may be the same */
+  void Execute(const T *in, T *out, size_t n) const
+    {
+    switch (this->Operation)
+      {
+      case VV_KERNEL_LESS:
+        this->Run<VV_KERNEL_LESS>(in, out, n);
+        break;
+      case VV_KERNEL_LESS_EQUAL:
+        this->Run<VV_KERNEL_LESS_EQUAL>(in, out, n);
+        break;
+      case VV_KERNEL_EQUAL:
+        this->Run<VV_KERNEL_EQUAL>(in, out, n);
+        break;
+      case VV_KERNEL_GREATER_EQUAL:
+        this->Run<VV_KERNEL_GREATER_EQUAL>(in, out, n);
+        break;
+      case VV_KERNEL_GREATER:
+        this->Run<VV_KERNEL_GREATER>(in, out, n);
+        break;
+      case All:
+        {
+        size_t i;
+        for (i = 0; i < n; ++i)
+          {
+          out[i] = this->Replacement;
+          }
+        }
+        break;
+      default:
+        if (in != out)
+          {
+          memmove(out, in, n*sizeof(T));
+          }
+      }
+    }
+
+protected:
+  /* comparisons that always or never hold */
+  enum { All = 100, None };
+
+  void Set(int all, int none, int op, double t)
+    {
+    this->Operation = all ? All : none ? None : op;
+    if (!all && !none)
+      {
+      this->Value = (T)t;
+      }
+    }
+
+  template <int Op>
+  void Run(const T *in, T *out, size_t n) const
+    {
+    size_t i = 0;
+#ifdef VV_PLUGIN_SIMD
+    if (this->UseVector)
+      {
+      i = vvThresholdVector<vvSimd, T, Op>::Execute(in, out, n, this->Value,
+                                                    this->Replacement);
+      }
+#endif
+    const T value = this->Value;
+    const T replacement = this->Replacement;
+    for (; i < n; ++i)
+      {
+      out[i] = vvThresholdTest<Op>(in[i], value) ? replacement : in[i];
+      }
+    }
+
+  int Operation;
+  int UseVector;
+  T Value;
+  T Replacement;
+};
+
+//-----------------------------------------------------------
+// PixelMath
+
+/* x <op> c saturated to the range of T, op being one of VV_KERNEL_ADD to
+ * VV_KERNEL_DIVIDE. Integers are computed in double, which is exact for
+ * up to 32 bits (the quotient is correctly rounded, so truncating it gives
+ * the integer division). Floating point types use their own arithmetic. */
+template <int Op, class T>
+inline T vvPixelMathScalar(T x, double c)
+{
+  if (std::numeric_limits<T>::is_integer)
+    {
+    double v = (double)x;
+    switch (Op)
+      {
+      case VV_KERNEL_ADD: v += c; break;
+      case VV_KERNEL_SUBTRACT: v -= c; break;
+      case VV_KERNEL_MULTIPLY: v *= c; break;
+      default: v /= c; break;
+      }
+    return vvKernelSaturate<T>(v);
+    }
+  const T t = (T)c;
+  switch (Op)
+    {
+    case VV_KERNEL_ADD: return x + t;
+    case VV_KERNEL_SUBTRACT: return x - t;
+    case VV_KERNEL_MULTIPLY: return x * t;
+    default: return x / t;
+    }
+}
+
+/* Vector loop of PixelMath, return the number of values processed. For
+ * small integers 'op' is one of the saturating operations below and 'c'
+ * fits in T. */
+enum
+{
+  VV_KERNEL_ADD_SIGNED = 200,
+  VV_KERNEL_SUBTRACT_SIGNED,
+  VV_KERNEL_ADD_UNSIGNED,
+  VV_KERNEL_SUBTRACT_UNSIGNED
+};
+
+template <class V, class T, int Kind = vvSimdKind<T>::Value>
+struct vvPixelMathVector
+{
+  static size_t Execute(int, const T *, T *, size_t, T) { return 0; }
+};
+
+#ifdef VV_PLUGIN_SIMD
+template <class V, class T>
+struct vvPixelMathVector<V, T, VV_SIMD_SMALL_INTEGER>
+{
+  static size_t Execute(int op, const T *in, T *out, size_t n, T c)
+    {
+    switch (op)
+      {
+      case VV_KERNEL_ADD_SIGNED:
+        return Run<VV_KERNEL_ADD_SIGNED>(in, out, n, c);
+      case VV_KERNEL_SUBTRACT_SIGNED:
+        return Run<VV_KERNEL_SUBTRACT_SIGNED>(in, out, n, c);
+      case VV_KERNEL_ADD_UNSIGNED:
+        return Run<VV_KERNEL_ADD_UNSIGNED>(in, out, n, c);
+      case VV_KERNEL_SUBTRACT_UNSIGNED:
+        return Run<VV_KERNEL_SUBTRACT_UNSIGNED>(in, out, n, c);
+      }
+    return 0;
+    }
+
+  template <int Op>
+  static size_t Run(const T *in, T *out, size_t n, T value)
+    {
+    typedef vvSimdLanes<V, sizeof(T)> L;
+    typedef typename V::Int Int;
+    const size_t width = V::Bytes / sizeof(T);
+    const Int c = L::Set((int)value);
+    size_t i;
+    for (i = 0; i + width <= n; i += width)
+      {
+      Int x = V::Load(in + i);
+      switch (Op)
+        {
+        case VV_KERNEL_ADD_SIGNED: x = L::AddS(x, c); break;
+        case VV_KERNEL_SUBTRACT_SIGNED: x = L::SubS(x, c); break;
+        case VV_KERNEL_ADD_UNSIGNED: x = L::AddU(x, c); break;
+        default: x = L::SubU(x, c); break;
+        }
+      V::Store(out + i, x);
+      }
+    return i;
+    }
+};
+
+template <class V, class T>
+struct vvPixelMathVector<V, T, VV_SIMD_FLOAT>
+{
+  static size_t Execute(int op, const float *in, float *out, size_t n,
+                        float c)
+    {
+    switch (op)
+      {
+      case VV_KERNEL_ADD: return Run<VV_KERNEL_ADD>(in, out, n, c);
+      case VV_KERNEL_SUBTRACT: return Run<VV_KERNEL_SUBTRACT>(in, out, n, c);
+      case VV_KERNEL_MULTIPLY: return Run<VV_KERNEL_MULTIPLY>(in, out, n, c);
+      case VV_KERNEL_DIVIDE: return Run<VV_KERNEL_DIVIDE>(in, out, n, c);
+      }
+    return 0;
+    }
+
+  template <int Op>
+  static size_t Run(const float *in, float *out, size_t n, float value)
+    {
+    typedef typename V::Float Float;
+    const size_t width = V::Bytes / sizeof(float);
+    const Float c = V::SetF(value);
+    size_t i;
+    for (i = 0; i + width <= n; i += width)
+      {
+      Float x = V::LoadF(in + i);
+      switch (Op)
+        {
+        case VV_KERNEL_ADD: x = V::AddF(x, c); break;
+        case VV_KERNEL_SUBTRACT: x = V::SubF(x, c); break;
+        case VV_KERNEL_MULTIPLY: x = V::MulF(x, c); break;
+        default: x = V::DivF(x, c); break;
+        }
+      V::StoreF(out + i, x);
+      }
+    return i;
+    }
+};
+#endif
+
+template <class T>
+class vvPixelMathKernel
+{
+public:
+  /* compute v <op> value for every value v, op being one of VV_KERNEL_ADD
+   * to VV_KERNEL_DIVIDE */
+  vvPixelMathKernel(int op, double value)
+    {
+    this->UseVector = 1;
+    this->Operation = op;
+    this->Value = value;
+    this->VectorOperation = op;
+    this->VectorValue = vvKernelSaturate<T>(value);
+    if (!std::numeric_limits<T>::is_integer)
+      {
+      this->Value = (double)this->VectorValue;
+      return;
+      }
+
+    /* the operand is truncated as it always was, but not wrapped */
+    this->Value = value != value ? 0 : value < 0 ? ceil(value) : floor(value);
+    if (sizeof(T) > 2)
+      {
+      return;
+      }
+
+    /* the saturating instructions need an operand that fits in T, the
+     * negative ones being turned around for unsigned types */
+    double c = this->Value;
+    double lo = vvKernelMinimum<T>();
+    double hi = vvKernelMaximum<T>();
+    this->VectorOperation = -1;
+    if (op == VV_KERNEL_ADD || op == VV_KERNEL_SUBTRACT)
+      {
+      int add = op == VV_KERNEL_ADD;
+      if (std::numeric_limits<T>::is_signed)
+        {
+        if (c >= lo && c <= hi)
+          {
+          this->VectorOperation =
+            add ? VV_KERNEL_ADD_SIGNED : VV_KERNEL_SUBTRACT_SIGNED;
+          this->VectorValue = (T)c;
+          }
+        }
+      else if (c >= -hi && c <= hi)
+        {
+        add = c < 0 ? !add : add;
+        this->VectorOperation =
+          add ? VV_KERNEL_ADD_UNSIGNED : VV_KERNEL_SUBTRACT_UNSIGNED;
+        this->VectorValue = (T)(c < 0 ? -c : c);
+        }
+      }
+
+    /* every other case reads a table of the 256 or 65536 results */
+    size_t size = (size_t)1 << (sizeof(T) == 1 ? 8 : 16);
+    this->Table.resize(size);
+    size_t i;
+    for (i = 0; i < size; ++i)
+      {
+      T x = sizeof(T) == 1 ? (T)(unsigned char)i : (T)(unsigned short)i;
+      this->Table[i] = this->Compute(x);
+      }
+    }
+
+  /* disable the vector code, to compare it with the scalar one */
+  void SetUseVector(int use) { this->UseVector = use; }
+
+  /* compute 'n' values from 'in' to 'out', which may be the same */
+  void Execute(const T *in, T *out, size_t n) const
+    {
+    size_t i = 0;
+#ifdef VV_PLUGIN_SIMD
+    if (this->UseVector)
+      {
+      i = vvPixelMathVector<vvSimd, T>::Execute(this->VectorOperation,
+                                                in, out, n,
+                                                this->VectorValue);
+      }
+#endif
+    if (!this->Table.empty())
+      {
+      const T *table = &this->Table[0];
+      for (; i < n; ++i)
+        {
+        out[i] = table[sizeof(T) == 1 ? (size_t)(unsigned char)in[i] :
+                       (size_t)(unsigned short)in[i]];
+        }
+      return;
+      }
+    switch (this->Operation)
+      {
+      case VV_KERNEL_ADD:
+        this->Run<VV_KERNEL_ADD>(in + i, out + i, n - i);
+        break;
+      case VV_KERNEL_SUBTRACT:
+        this->Run<VV_KERNEL_SUBTRACT>(in + i, out + i, n - i);
+        break;
+      case VV_KERNEL_MULTIPLY:
+        this->Run<VV_KERNEL_MULTIPLY>(in + i, out + i, n - i);
+        break;
+      case VV_KERNEL_DIVIDE:
+        this->Run<VV_KERNEL_DIVIDE>(in + i, out + i, n - i);
+        break;
+      default:
+        if (in != out)
+          {
+          memmove(out + i, in + i, (n - i)*sizeof(T));
+          }
+      }
+    }
+
+  /* the result for a single value */
+  T Compute(T x) const
+    {
+    switch (this->Operation)
+      {
+      case VV_KERNEL_ADD:
+        return vvPixelMathScalar<VV_KERNEL_ADD>(x, this->Value);
+      case VV_KERNEL_SUBTRACT:
+        return vvPixelMathScalar<VV_KERNEL_SUBTRACT>(x, this->Value);
+      case VV_KERNEL_MULTIPLY:
+        return vvPixelMathScalar<VV_KERNEL_MULTIPLY>(x, this->Value);
+      case VV_KERNEL_DIVIDE:
+        return vvPixelMathScalar<VV_KERNEL_DIVIDE>(x, this->Value);
+      }
+    return x;
+    }
+
+protected:
+  template <int Op>
+  void Run(const T *in, T *out, size_t n) const
+    {
+    const double c = this->Value;
+    size_t i;
+    for (i = 0; i < n; ++i)
+      {
+      out[i] = vvPixelMathScalar<Op>(in[i], c);
+      }
+    }
+
+  int Operation;
+  int UseVector;
+  double Value;
+  int VectorOperation;
+  T VectorValue;
+  std::vector<T> Table;
+};
+
+//-----------------------------------------------------------
+// Threaded execution
+
+/* number of values processed between two progress reports */
+#define VV_KERNEL_BLOCK_SIZE 65536
+
+template <class K, class T>
+struct vvPluginKernelJob
+{
+  const K *Kernel;
+  const T *Input;
+  T *Output;
+  size_t Size;
+  vtkVVPluginInfo *Info;
+  const char *Message;
+  volatile int Aborted;
+
+  static void ThreadExecute(void *arg, int threadId, int numThreads)
+    {
+    vvPluginKernelJob<K, T> *self = (vvPluginKernelJob<K, T> *)arg;
+    /* ranges start on a cache line so threads never share one */
+    size_t align = 64 / sizeof(T) ? 64 / sizeof(T) : 1;
+    size_t lines = (self->Size + align - 1) / align;
+    size_t begin = (size_t)((double)lines*threadId/numThreads)*align;
+    size_t end = (size_t)((double)lines*(threadId + 1)/numThreads)*align;
+    if (end > self->Size)
+      {
+      end = self->Size;
+      }
+    size_t i;
+    for (i = begin; i < end && !self->Aborted; i += VV_KERNEL_BLOCK_SIZE)
+      {
+      if (!threadId && self->Info)
+        {
+        if (self->Info->ReportProgress(self->Info,
+                                       (float)(i - begin)/(end - begin),
+                                       self->Message))
+          {
+          self->Aborted = 1;
+          break;
+          }
+        }
+      size_t n = end - i < VV_KERNEL_BLOCK_SIZE ?
+        end - i : VV_KERNEL_BLOCK_SIZE;
+      self->Kernel->Execute(self->Input + i, self->Output + i, n);
+      }
+    }
+};
+
+/* Run 'kernel' over 'n' values from 'in' to 'out' (which may be the same)
+ * on 'numThreads' threads, or one per processor if 0. When 'info' is set
+ * progress is reported and aborts honored through it. Return 0 if the
+ * processing was aborted. */
+template <class K, class T>
+int vvPluginExecuteKernel(vtkVVPluginInfo *info, const K &kernel,
+                          const T *in, T *out, size_t n,
+                          const char *message, int numThreads = 0)
+{
+  vvPluginKernelJob<K, T> job;
+  job.Kernel = &kernel;
+  job.Input = in;
+  job.Output = out;
+  job.Size = n;
+  job.Info = info;
+  job.Message = message;
+  job.Aborted = 0;
+  if (numThreads < 1)
+    {
+    numThreads = vvPluginGetNumberOfProcessors();
+    }
+  /* not worth a thread for less than a few blocks each */
+  if ((size_t)numThreads > n / (4*VV_KERNEL_BLOCK_SIZE))
+    {
+    numThreads = (int)(n / (4*VV_KERNEL_BLOCK_SIZE));
+    }
+  vvPluginParallelExecute(numThreads, &vvPluginKernelJob<K, T>::ThreadExecute,
+                          &job);
+  return !job.Aborted;
+}
+
+#endif
@@ -0,0 +1,320 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Export of the non-zero voxels of a volume as a point set.
+ *
+ * vvSparsePointWriter counts the points of every slice first (one slab of
+ * slices per thread), so the number of points is known before anything is
+ * written, then writes them in raster order through vvBufferedWriter. Two
+ * formats are supported, both little-endian whatever the host:
+ *
+ * - PLY: "binary_little_endian 1.0" with one vertex element made of the
+ *   float properties x, y and z (voxel indices) and an empty face element.
+ *
+ * - Packed: a 28 bytes header, the characters "VVPT", the dimensions as
+ *   three uint32, the size of a coordinate in bytes as a uint32 (2 if all
+ *   the dimensions fit in 16 bits, 4 otherwise) and the number of points as
+ *   a uint64, followed by x, y and z of every point. */
+
+#ifndef vvPluginPointWriter_h
+#define vvPluginPointWriter_h
+
+#include "vtkVVPluginAPI.h"
+#include "vvPluginVolume.h"
+#include "vvPluginThreads.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/* fwrite through a large buffer, with little-endian helpers */
+class vvBufferedWriter
+{
+public:
+  vvBufferedWriter()
+    {
+    this->File = 0;
+    this->Used = 0;
+    this->Error = 0;
+    unsigned int one = 1;
+    this->SwapBytes = *(unsigned char *)&one != 1;
+    }
+  ~vvBufferedWriter() { this->Close(); }
+
+  /* return 0 if the file cannot be created */
+  int Open(const char *filename)
+    {
+    this->Close();
+    this->Error = 0;
+    this->Used = 0;
+    this->File = fopen(filename, "wb");
+    if (this->File)
+      {
+      this->Buffer.resize(1 << 20);
+      }
+    return this->File != 0;
+    }
+
+  /* flush and close, return 0 if anything could not be written */
+  int Close()
+    {
+    if (!this->File)
+      {
+      return !this->Error;
+      }
+    this->Flush();
+    if (fclose(this->File))
+      {
+      this->Error = 1;
+      }
+    this->File = 0;
+    return !this->Error;
+    }
+
+  void Write(const void *data, size_t size)
+    {
+    const char *p = (const char *)data;
+    while (size)
+      {
+      if (this->Used == this->Buffer.size())
+        {
+        this->Flush();
+        }
+      size_t n = this->Buffer.size() - this->Used;
+      if (n > size)
+        {
+        n = size;
+        }
+      memcpy(&this->Buffer[this->Used], p, n);
+      this->Used += n;
+      p += n;
+      size -= n;
+      }
+    }
+
+  void WriteString(const char *s) { this->Write(s, strlen(s)); }
+
+  void WriteUInt16(unsigned short v) { this->WriteLittleEndian(&v, 2); }
+  void WriteUInt32(unsigned int v) { this->WriteLittleEndian(&v, 4); }
+  void WriteFloat32(float v) { this->WriteLittleEndian(&v, 4); }
+  void WriteUInt64(unsigned long long v) { this->WriteLittleEndian(&v, 8); }
+
+  int GetError() const { return this->Error; }
+
+protected:
+  void WriteLittleEndian(const void *v, int size)
+    {
+    if (!this->SwapBytes)
+      {
+      this->Write(v, size);
+      return;
+      }
+    unsigned char b[8];
+    int i;
+    for (i = 0; i < size; ++i)
+      {
+      b[i] = ((const unsigned char *)v)[size - 1 - i];
+      }
+    this->Write(b, size);
+    }
+
+  void Flush()
+    {
+    if (this->Used && !this->Error &&
+        fwrite(&this->Buffer[0], 1, this->Used, this->File) != this->Used)
+      {
+      this->Error = 1;
+      }
+    this->Used = 0;
+    }
+
+  FILE *File;
+  std::vector<char> Buffer;
+  size_t Used;
+  int Error;
+  int SwapBytes;
+
+private:
+  vvBufferedWriter(const vvBufferedWriter &);
+  void operator=(const vvBufferedWriter &);
+};
+
+template <class T>
+class vvSparsePointWriter
+{
+public:
+  enum
+  {
+    PLY = 0,
+    Packed = 1
+  };
+
+  vvSparsePointWriter()
+    {
+    this->NumberOfThreads = vvPluginGetNumberOfProcessors();
+    this->Info = 0;
+    this->Volume = 0;
+    this->NumberOfPoints = 0;
+    }
+
+  void SetNumberOfThreads(int n)
+    {
+    this->NumberOfThreads = n < 1 ? 1 : n;
+    }
+
+  /* when set, progress is reported and aborts are honored through it */
+  void SetPluginInfo(vtkVVPluginInfo *info) { this->Info = info; }
+
+  /* count the non-zero voxels of the first component of 'vol' */
+  size_t Count(const vvVolumeView<T> &vol)
+    {
+    this->Volume = &vol;
+    int zd = vol.GetDimensions()[2];
+    this->SliceCounts.assign(zd > 0 ? zd : 0, 0);
+    int numThreads = this->NumberOfThreads;
+    if (numThreads > zd)
+      {
+      numThreads = zd > 0 ? zd : 1;
+      }
+    vvPluginParallelExecute(numThreads,
+                            &vvSparsePointWriter<T>::CountThread, this);
+    this->NumberOfPoints = 0;
+    int z;
+    for (z = 0; z < zd; ++z)
+      {
+      this->NumberOfPoints += this->SliceCounts[z];
+      }
+    return this->NumberOfPoints;
+    }
+
+  size_t GetNumberOfPoints() const { return this->NumberOfPoints; }
+
+  /* write the non-zero voxels of 'vol' to 'filename'. Return 0 if the
+   * file could not be written or the processing was aborted. */
+  int Write(const char *filename, const vvVolumeView<T> &vol, int format)
+    {
+    this->Count(vol);
+    vvBufferedWriter out;
+    if (!out.Open(filename))
+      {
+      return 0;
+      }
+    const int *dim = vol.GetDimensions();
+    int shortCoordinates =
+      dim[0] <= 65536 && dim[1] <= 65536 && dim[2] <= 65536;
+    if (format == PLY)
+      {
+      char header[512];
+      sprintf(header,
+              "ply\nformat binary_little_endian 1.0\n"
+              "comment VolView plugin generated\n"
+              "element vertex %lu\nproperty float x\nproperty float y\n"
+              "property float z\nelement face 0\n"
+              "property list uchar int vertex_indices\nend_header\n",
+              (unsigned long)this->NumberOfPoints);
+      out.WriteString(header);
+      }
+    else
+      {
+      out.Write("VVPT", 4);
+      int i;
+      for (i = 0; i < 3; ++i)
+        {
+        out.WriteUInt32((unsigned int)dim[i]);
+        }
+      out.WriteUInt32(shortCoordinates ? 2 : 4);
+      out.WriteUInt64((unsigned long long)this->NumberOfPoints);
+      }
+
+    int nc = vol.GetNumberOfComponents();
+    int x, y, z;
+    for (z = 0; z < dim[2]; ++z)
+      {
+      if (this->Info)
+        {
+        if (this->Info->ReportProgress(this->Info, (float)z/dim[2],
+                                       "Writing points..."))
+          {
+          out.Close();
+          return 0;
+          }
+        }
+      if (!this->SliceCounts[z])
+        {
+        continue;
+        }
+      for (y = 0; y < dim[1]; ++y)
+        {
+        const T *p = &vol(0, y, z);
+        for (x = 0; x < dim[0]; ++x, p += nc)
+          {
+          if (!*p)
+            {
+            continue;
+            }
+          if (format == PLY)
+            {
+            out.WriteFloat32((float)x);
+            out.WriteFloat32((float)y);
+            out.WriteFloat32((float)z);
+            }
+          else if (shortCoordinates)
+            {
+            out.WriteUInt16((unsigned short)x);
+            out.WriteUInt16((unsigned short)y);
+            out.WriteUInt16((unsigned short)z);
+            }
+          else
+            {
+            out.WriteUInt32((unsigned int)x);
+            out.WriteUInt32((unsigned int)y);
+            out.WriteUInt32((unsigned int)z);
+            }
+          }
+        }
+      }
+    return out.Close();
+    }
+
+protected:
+  static void CountThread(void *arg, int threadId, int numThreads)
+    {
+    vvSparsePointWriter<T> *self = (vvSparsePointWriter<T> *)arg;
+    const vvVolumeView<T> &vol = *self->Volume;
+    const int *dim = vol.GetDimensions();
+    int z0 = (int)((double)dim[2]*threadId/numThreads);
+    int z1 = (int)((double)dim[2]*(threadId + 1)/numThreads);
+    int nc = vol.GetNumberOfComponents();
+    int x, y, z;
+    for (z = z0; z < z1; ++z)
+      {
+      size_t n = 0;
+      for (y = 0; y < dim[1]; ++y)
+        {
+        const T *p = &vol(0, y, z);
+        for (x = 0; x < dim[0]; ++x, p += nc)
+          {
+          n += *p ? 1 : 0;
+          }
+        }
+      self->SliceCounts[z] = n;
+      }
+    }
+
+  int NumberOfThreads;
+  vtkVVPluginInfo *Info;
+  const vvVolumeView<T> *Volume;
+  size_t NumberOfPoints;
+  std::vector<size_t> SliceCounts;
+};
+
+#endif
@@ -0,0 +1,256 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Scan line seed fill for the C plugins.
+ *
+ * vvSeedFill marks every voxel 26-connected to one of its seeds through
+ * voxels accepted by an 'Inside' functor (bool operator()(size_t index)
+ * const, index as given by vvVolumeView::Index). Rows are filled a span
+ * at a time and only the start of each span found in the 8 neighboring
+ * rows is pushed on an explicit stack, so the memory used does not depend
+ * on the shape of the region and deep vessel trees cannot overflow the
+ * call stack.
+ *
+ * The result is a bit mask, one bit per voxel. Seeds are shared among
+ * threads; voxels are claimed with an atomic OR on the mask so the fills
+ * of different seeds can meet without visiting a voxel twice. */
+
+#ifndef vvPluginSeedFill_h
+#define vvPluginSeedFill_h
+
+#include "vtkVVPluginAPI.h"
+#include "vvPluginThreads.h"
+
+#include <stdlib.h>
+#include <vector>
+
+class vvVolumeBitMask
+{
+public:
+  /* allocate a cleared mask, return 0 if the memory is not available */
+  int Allocate(size_t numberOfVoxels)
+    {
+    this->Words.clear();
+    try
+      {
+      this->Words.resize((numberOfVoxels + 31)/32, 0);
+      }
+    catch (...)
+      {
+      return 0;
+      }
+    return 1;
+    }
+
+  int Test(size_t i) const
+    {
+    return (this->Words[i >> 5] >> (i & 31)) & 1;
+    }
+
+  void Set(size_t i)
+    {
+    this->Words[i >> 5] |= 1u << (i & 31);
+    }
+
+  /* set the bit, return its previous value. Safe to call from several
+   * threads at once. */
+  int TestAndSet(size_t i)
+    {
+    unsigned int bit = 1u << (i & 31);
+    volatile unsigned int *word = &this->Words[i >> 5];
+    if (*word & bit)
+      {
+      return 1;
+      }
+    return (vvPluginAtomicFetchOr(word, bit) & bit) ? 1 : 0;
+    }
+
+protected:
+  std::vector<unsigned int> Words;
+};
+
+template <class Inside>
+class vvSeedFill
+{
+public:
+  vvSeedFill(const int dim[3], const Inside &inside)
+    : InsideFunctor(inside)
+    {
+    int i;
+    for (i = 0; i < 3; i++)
+      {
+      this->Dimensions[i] = dim[i];
+      }
+    this->NumberOfThreads = vvPluginGetNumberOfProcessors();
+    this->Info = 0;
+    this->Aborted = 0;
+    }
+
+  void SetNumberOfThreads(int n)
+    {
+    this->NumberOfThreads = n < 1 ? 1 : n;
+    }
+
+  /* when set, progress is reported and aborts are honored through it */
+  void SetPluginInfo(vtkVVPluginInfo *info) { this->Info = info; }
+
+  void AddSeed(int x, int y, int z)
+    {
+    this->Seeds.push_back(this->Index(x, y, z));
+    }
+  size_t GetNumberOfSeeds() const { return this->Seeds.size(); }
+
+  /* fill from all the seeds. Return 0 if the mask could not be allocated
+   * or the processing was aborted. */
+  int Execute()
+    {
+    this->Aborted = 0;
+    if (!this->Filled.Allocate((size_t)this->Dimensions[0]*
+                               this->Dimensions[1]*this->Dimensions[2]))
+      {
+      return 0;
+      }
+    int numThreads = this->NumberOfThreads;
+    if ((size_t)numThreads > this->Seeds.size())
+      {
+      numThreads = this->Seeds.size() ? (int)this->Seeds.size() : 1;
+      }
+    vvPluginParallelExecute(numThreads, &vvSeedFill<Inside>::ThreadExecute,
+                            this);
+    return !this->Aborted;
+    }
+
+  /* the voxels reached from the seeds */
+  const vvVolumeBitMask &GetFilled() const { return this->Filled; }
+  int IsFilled(int x, int y, int z) const
+    {
+    return this->Filled.Test(this->Index(x, y, z));
+    }
+
+protected:
+  struct Span
+  {
+    int x, y, z;
+  };
+
+  size_t Index(int x, int y, int z) const
+    {
+    return ((size_t)z*this->Dimensions[1] + y)*this->Dimensions[0] + x;
+    }
+
+  static void ThreadExecute(void *arg, int threadId, int numThreads)
+    {
+    vvSeedFill<Inside> *self = (vvSeedFill<Inside> *)arg;
+    std::vector<Span> stack;
+    size_t numSeeds = self->Seeds.size();
+    size_t s;
+    for (s = threadId; s < numSeeds && !self->Aborted; s += numThreads)
+      {
+      if (!threadId && self->Info && !(s % (64*numThreads)))
+        {
+        if (self->Info->ReportProgress(self->Info, (float)s/numSeeds,
+                                       "Filling from the seeds..."))
+          {
+          self->Aborted = 1;
+          }
+        }
+      size_t i = self->Seeds[s];
+      if (self->Filled.Test(i) || !self->InsideFunctor(i))
+        {
+        continue;
+        }
+      Span seed;
+      seed.x = (int)(i % self->Dimensions[0]);
+      seed.y = (int)((i / self->Dimensions[0]) % self->Dimensions[1]);
+      seed.z = (int)(i / ((size_t)self->Dimensions[0]*self->Dimensions[1]));
+      stack.push_back(seed);
+      self->Fill(stack);
+      }
+    }
+
+  void Fill(std::vector<Span> &stack)
+    {
+    const int *dim = this->Dimensions;
+    while (!stack.empty())
+      {
+      Span sp = stack.back();
+      stack.pop_back();
+
+      /* claim the span containing the seed, stop at voxels claimed by
+       * someone else: their owner looks after their neighbors */
+      size_t row = this->Index(0, sp.y, sp.z);
+      if (this->Filled.TestAndSet(row + sp.x))
+        {
+        continue;
+        }
+      int x0 = sp.x, x1 = sp.x;
+      while (x0 > 0 && this->InsideFunctor(row + x0 - 1) &&
+             !this->Filled.TestAndSet(row + x0 - 1))
+        {
+        --x0;
+        }
+      while (x1 < dim[0] - 1 && this->InsideFunctor(row + x1 + 1) &&
+             !this->Filled.TestAndSet(row + x1 + 1))
+        {
+        ++x1;
+        }
+
+      /* one new seed per run in the 8 neighboring rows, the runs touching
+       * [x0 - 1, x1 + 1] are 26-connected to the span */
+      int lo = x0 > 0 ? x0 - 1 : 0;
+      int hi = x1 < dim[0] - 1 ? x1 + 1 : dim[0] - 1;
+      int dy, dz;
+      for (dz = -1; dz <= 1; ++dz)
+        {
+        int z = sp.z + dz;
+        if (z < 0 || z >= dim[2])
+          {
+          continue;
+          }
+        for (dy = -1; dy <= 1; ++dy)
+          {
+          int y = sp.y + dy;
+          if ((!dy && !dz) || y < 0 || y >= dim[1])
+            {
+            continue;
+            }
+          size_t nrow = this->Index(0, y, z);
+          int inRun = 0;
+          int x;
+          for (x = lo; x <= hi; ++x)
+            {
+            int open = !this->Filled.Test(nrow + x) &&
+              this->InsideFunctor(nrow + x);
+            if (open && !inRun)
+              {
+              Span n;
+              n.x = x;
+              n.y = y;
+              n.z = z;
+              stack.push_back(n);
+              }
+            inRun = open;
+            }
+          }
+        }
+      }
+    }
+
+  int Dimensions[3];
+  Inside InsideFunctor;
+  int NumberOfThreads;
+  vtkVVPluginInfo *Info;
+  volatile int Aborted;
+  std::vector<size_t> Seeds;
+  vvVolumeBitMask Filled;
+};
+
+#endif
@@ -0,0 +1,245 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Intensity statistics for the C plugins.
+ *
+ * vvRunningStatistics accumulates count, mean, variance, minimum and
+ * maximum in one pass with Welford's update, and two accumulators can be
+ * merged (Chan et al.) so the work can be split among threads.
+ *
+ * vvVolumeStatistics runs it over the first component of a volume, one
+ * slab per thread, optionally skipping the voxels equal to a background
+ * value. The volume is read once: each row is summed and then its squared
+ * differences taken while it is still in cache, and the row is merged
+ * into the thread's accumulator. */
+
+#ifndef vvPluginStatistics_h
+#define vvPluginStatistics_h
+
+#include "vtkVVPluginAPI.h"
+#include "vvPluginVolume.h"
+#include "vvPluginThreads.h"
+
+#include <stdlib.h>
+#include <vector>
+
+class vvRunningStatistics
+{
+public:
+  vvRunningStatistics() { this->Reset(); }
+
+  void Reset()
+    {
+    this->Count = 0;
+    this->Mean = 0;
+    this->M2 = 0;
+    this->Minimum = 0;
+    this->Maximum = 0;
+    }
+
+  void Add(double x)
+    {
+    if (!this->Count || x < this->Minimum)
+      {
+      this->Minimum = x;
+      }
+    if (!this->Count || x > this->Maximum)
+      {
+      this->Maximum = x;
+      }
+    this->Count += 1;
+    double delta = x - this->Mean;
+    this->Mean += delta / this->Count;
+    this->M2 += delta * (x - this->Mean);
+    }
+
+  void Merge(const vvRunningStatistics &s)
+    {
+    this->Merge(s.Count, s.Mean, s.M2, s.Minimum, s.Maximum);
+    }
+
+  /* merge a block of 'count' values whose mean, sum of squared
+   * differences to the mean, minimum and maximum are known */
+  void Merge(double count, double mean, double m2, double minimum,
+             double maximum)
+    {
+    if (!count)
+      {
+      return;
+      }
+    if (!this->Count)
+      {
+      this->Count = count;
+      this->Mean = mean;
+      this->M2 = m2;
+      this->Minimum = minimum;
+      this->Maximum = maximum;
+      return;
+      }
+    double total = this->Count + count;
+    double delta = mean - this->Mean;
+    this->Mean += delta * count / total;
+    this->M2 += m2 + delta * delta * this->Count * count / total;
+    this->Count = total;
+    if (minimum < this->Minimum)
+      {
+      this->Minimum = minimum;
+      }
+    if (maximum > this->Maximum)
+      {
+      this->Maximum = maximum;
+      }
+    }
+
+  double GetCount() const { return this->Count; }
+  double GetMean() const { return this->Mean; }
+  double GetMinimum() const { return this->Minimum; }
+  double GetMaximum() const { return this->Maximum; }
+  /* population variance, sum((x - mean)^2) / count */
+  double GetVariance() const
+    {
+    return this->Count ? this->M2 / this->Count : 0;
+    }
+
+protected:
+  double Count;
+  double Mean;
+  double M2;
+  double Minimum;
+  double Maximum;
+};
+
+template <class T>
+class vvVolumeStatistics : public vvRunningStatistics
+{
+public:
+  vvVolumeStatistics()
+    {
+    this->UseBackground = 0;
+    this->BackgroundValue = 0;
+    this->NumberOfThreads = vvPluginGetNumberOfProcessors();
+    this->Info = 0;
+    this->Volume = 0;
+    this->Aborted = 0;
+    }
+
+  /* voxels equal to the background value are not accounted for */
+  void SetBackgroundValue(double value)
+    {
+    this->UseBackground = 1;
+    this->BackgroundValue = value;
+    }
+  void RemoveBackgroundValue() { this->UseBackground = 0; }
+
+  void SetNumberOfThreads(int n)
+    {
+    this->NumberOfThreads = n < 1 ? 1 : n;
+    }
+
+  /* when set, progress is reported and aborts are honored through it */
+  void SetPluginInfo(vtkVVPluginInfo *info) { this->Info = info; }
+
+  /* Return 0 if the processing was aborted. */
+  int Execute(const vvVolumeView<T> &vol)
+    {
+    this->Reset();
+    this->Volume = &vol;
+    this->Aborted = 0;
+    int zd = vol.GetDimensions()[2];
+    int numThreads = this->NumberOfThreads;
+    if (numThreads > zd)
+      {
+      numThreads = zd > 0 ? zd : 1;
+      }
+    this->Partial.assign(numThreads, vvRunningStatistics());
+    vvPluginParallelExecute(numThreads,
+                            &vvVolumeStatistics<T>::ThreadExecute, this);
+    int t;
+    for (t = 0; t < numThreads; ++t)
+      {
+      this->Merge(this->Partial[t]);
+      }
+    return !this->Aborted;
+    }
+
+protected:
+  static void ThreadExecute(void *arg, int threadId, int numThreads)
+    {
+    vvVolumeStatistics<T> *self = (vvVolumeStatistics<T> *)arg;
+    const vvVolumeView<T> &vol = *self->Volume;
+    const int *dim = vol.GetDimensions();
+    int z0 = (int)((double)dim[2]*threadId/numThreads);
+    int z1 = (int)((double)dim[2]*(threadId + 1)/numThreads);
+    int nc = vol.GetNumberOfComponents();
+    vvRunningStatistics &stats = self->Partial[threadId];
+    int x, y, z;
+    for (z = z0; z < z1 && !self->Aborted; ++z)
+      {
+      if (!threadId && self->Info)
+        {
+        if (self->Info->ReportProgress(self->Info, (float)(z - z0)/(z1 - z0),
+                                       "Computing statistics..."))
+          {
+          self->Aborted = 1;
+          }
+        }
+      for (y = 0; y < dim[1]; ++y)
+        {
+        const T *row = &vol(0, y, z);
+        const T *p = row;
+        double sum = 0, minimum = 0, maximum = 0;
+        int n = 0;
+        for (x = 0; x < dim[0]; ++x, p += nc)
+          {
+          double v = (double)*p;
+          if (self->UseBackground && v == self->BackgroundValue)
+            {
+            continue;
+            }
+          if (!n || v < minimum)
+            {
+            minimum = v;
+            }
+          if (!n || v > maximum)
+            {
+            maximum = v;
+            }
+          sum += v;
+          ++n;
+          }
+        if (!n)
+          {
+          continue;
+          }
+        double mean = sum / n, m2 = 0;
+        for (x = 0, p = row; x < dim[0]; ++x, p += nc)
+          {
+          double v = (double)*p;
+          if (!self->UseBackground || v != self->BackgroundValue)
+            {
+            m2 += (v - mean) * (v - mean);
+            }
+          }
+        stats.Merge(n, mean, m2, minimum, maximum);
+        }
+      }
+    }
+
+  int UseBackground;
+  double BackgroundValue;
+  int NumberOfThreads;
+  vtkVVPluginInfo *Info;
+  const vvVolumeView<T> *Volume;
+  volatile int Aborted;
+  std::vector<vvRunningStatistics> Partial;
+};
+
+#endif
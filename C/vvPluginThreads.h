@@ -0,0 +1,163 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Minimal threading support for the C plugins, which do not link against
+ * VTK. vvPluginParallelExecute runs the same function on a number of
+ * threads and returns once all of them are done. Thread 0 runs on the
+ * calling thread, so it is the one that should report progress and check
+ * for aborts (VolView callbacks are not meant to be called concurrently). */
+
+#ifndef vvPluginThreads_h
+#define vvPluginThreads_h
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#define VV_PLUGIN_MAX_THREADS 64
+
+typedef void (*vvPluginThreadFunction)(void *arg, int threadId,
+                                       int numThreads);
+
+struct vvPluginThreadInfo
+{
+  vvPluginThreadFunction Function;
+  void *Argument;
+  int ThreadId;
+  int NumberOfThreads;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI vvPluginThreadStart(LPVOID arg)
+#else
+static void *vvPluginThreadStart(void *arg)
+#endif
+{
+  vvPluginThreadInfo *ti = (vvPluginThreadInfo *)arg;
+  ti->Function(ti->Argument, ti->ThreadId, ti->NumberOfThreads);
+  return 0;
+}
+
+/* atomically OR 'bits' into '*word' and return the previous value */
+inline unsigned int vvPluginAtomicFetchOr(volatile unsigned int *word,
+                                          unsigned int bits)
+{
+#ifdef _WIN32
+  return (unsigned int)InterlockedOr((volatile LONG *)word, (LONG)bits);
+#else
+  return __sync_fetch_and_or(word, bits);
+#endif
+}
+
+/* number of processors available, at least 1 */
+inline int vvPluginGetNumberOfProcessors()
+{
+  int num = 1;
+#ifdef _WIN32
+  SYSTEM_INFO sysInfo;
+  GetSystemInfo(&sysInfo);
+  num = (int)sysInfo.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  num = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if (num < 1)
+    {
+    num = 1;
+    }
+  if (num > VV_PLUGIN_MAX_THREADS)
+    {
+    num = VV_PLUGIN_MAX_THREADS;
+    }
+  return num;
+}
+
+/* wall clock time in seconds, for timings */
+inline double vvPluginGetTime()
+{
+#ifdef _WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+#endif
+}
+
+/* run func(arg, i, numThreads) for i in [0, numThreads) and wait for all
+ * of them. If a thread cannot be created its share of the work is run on
+ * the calling thread after the others have been started. */
+inline void vvPluginParallelExecute(int numThreads,
+                                    vvPluginThreadFunction func, void *arg)
+{
+  if (numThreads < 1)
+    {
+    numThreads = 1;
+    }
+  if (numThreads > VV_PLUGIN_MAX_THREADS)
+    {
+    numThreads = VV_PLUGIN_MAX_THREADS;
+    }
+
+  vvPluginThreadInfo info[VV_PLUGIN_MAX_THREADS];
+  int started[VV_PLUGIN_MAX_THREADS];
+#ifdef _WIN32
+  HANDLE threads[VV_PLUGIN_MAX_THREADS];
+#else
+  pthread_t threads[VV_PLUGIN_MAX_THREADS];
+#endif
+
+  int i;
+  for (i = 0; i < numThreads; ++i)
+    {
+    info[i].Function = func;
+    info[i].Argument = arg;
+    info[i].ThreadId = i;
+    info[i].NumberOfThreads = numThreads;
+    started[i] = 0;
+    }
+
+  for (i = 1; i < numThreads; ++i)
+    {
+#ifdef _WIN32
+    threads[i] = CreateThread(0, 0, vvPluginThreadStart, &info[i], 0, 0);
+    started[i] = (threads[i] != 0);
+#else
+    started[i] =
+      !pthread_create(&threads[i], 0, vvPluginThreadStart, &info[i]);
+#endif
+    }
+
+  func(arg, 0, numThreads);
+
+  for (i = 1; i < numThreads; ++i)
+    {
+    if (!started[i])
+      {
+      func(arg, i, numThreads);
+      continue;
+      }
+#ifdef _WIN32
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+#else
+    pthread_join(threads[i], 0);
+#endif
+    }
+}
+
+#endif
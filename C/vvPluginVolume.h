@@ -0,0 +1,181 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* Flat voxel volumes for the C plugins.
+ *
+ * vvVolumeView wraps a buffer VolView already owns (pds->inData,
+ * pds->outData, pds->inData2) without copying it, and gives (x,y,z) access
+ * to it. vvVolumeBuffer is the owning variant for the scratch data of a
+ * plugin (labels, distances, flags...): a single aligned allocation for the
+ * whole volume instead of one allocation per row.
+ *
+ * Voxels are stored x fastest then y then z, the same layout VolView uses,
+ * so Index() can be used to walk a view and a buffer of the same dimensions
+ * in lock step. */
+
+#ifndef vvPluginVolume_h
+#define vvPluginVolume_h
+
+#include <stdlib.h>
+#include <string.h>
+
+template <class T>
+class vvVolumeView
+{
+public:
+  vvVolumeView()
+    {
+    this->SetData(0, 0, 1);
+    }
+  vvVolumeView(T *data, const int dim[3], int numComp = 1)
+    {
+    this->SetData(data, dim, numComp);
+    }
+
+  /* point the view at an existing buffer */
+  void SetData(T *data, const int dim[3], int numComp = 1)
+    {
+    this->Data = data;
+    this->NumberOfComponents = numComp;
+    int i;
+    for (i = 0; i < 3; i++)
+      {
+      this->Dimensions[i] = dim ? dim[i] : 0;
+      }
+    this->RowStride = (size_t)this->Dimensions[0]*numComp;
+    this->SliceStride = this->RowStride*this->Dimensions[1];
+    }
+
+  T *GetData() { return this->Data; }
+  const T *GetData() const { return this->Data; }
+  const int *GetDimensions() const { return this->Dimensions; }
+  int GetNumberOfComponents() const { return this->NumberOfComponents; }
+  size_t GetNumberOfVoxels() const
+    {
+    return (size_t)this->Dimensions[0]*this->Dimensions[1]*
+      this->Dimensions[2];
+    }
+  size_t GetRowStride() const { return this->RowStride; }
+  size_t GetSliceStride() const { return this->SliceStride; }
+
+  /* offset of the first component of voxel (x,y,z) */
+  size_t Index(int x, int y, int z) const
+    {
+    return (size_t)z*this->SliceStride + (size_t)y*this->RowStride +
+      (size_t)x*this->NumberOfComponents;
+    }
+
+  int IsInside(int x, int y, int z) const
+    {
+    return (x >= 0 && x < this->Dimensions[0] &&
+            y >= 0 && y < this->Dimensions[1] &&
+            z >= 0 && z < this->Dimensions[2]);
+    }
+
+  T &operator()(int x, int y, int z)
+    {
+    return this->Data[this->Index(x, y, z)];
+    }
+  const T &operator()(int x, int y, int z) const
+    {
+    return this->Data[this->Index(x, y, z)];
+    }
+  T &operator()(int x, int y, int z, int c)
+    {
+    return this->Data[this->Index(x, y, z) + c];
+    }
+  const T &operator()(int x, int y, int z, int c) const
+    {
+    return this->Data[this->Index(x, y, z) + c];
+    }
+  T &operator[](size_t idx) { return this->Data[idx]; }
+  const T &operator[](size_t idx) const { return this->Data[idx]; }
+
+  T *GetSlice(int z) { return this->Data + (size_t)z*this->SliceStride; }
+  T *GetRow(int y, int z)
+    {
+    return this->Data + (size_t)z*this->SliceStride +
+      (size_t)y*this->RowStride;
+    }
+
+protected:
+  T *Data;
+  int Dimensions[3];
+  int NumberOfComponents;
+  size_t RowStride;
+  size_t SliceStride;
+};
+
+template <class T>
+class vvVolumeBuffer : public vvVolumeView<T>
+{
+public:
+  /* alignment of the first voxel, enough for AVX loads */
+  enum { Alignment = 64 };
+
+  vvVolumeBuffer() : Block(0) {}
+  vvVolumeBuffer(const int dim[3], int numComp = 1) : Block(0)
+    {
+    this->Allocate(dim, numComp);
+    }
+  ~vvVolumeBuffer()
+    {
+    this->Release();
+    }
+
+  /* allocate the buffer, the voxels are set to zero. Return 0 if the
+   * memory could not be allocated. */
+  int Allocate(const int dim[3], int numComp = 1)
+    {
+    this->Release();
+    this->SetData(0, dim, numComp);
+    size_t size = this->GetNumberOfVoxels()*numComp*sizeof(T);
+    this->Block = calloc(size + Alignment, 1);
+    if (!this->Block)
+      {
+      this->SetData(0, 0, 1);
+      return 0;
+      }
+    size_t addr = (size_t)this->Block;
+    addr = (addr + Alignment - 1) & ~((size_t)Alignment - 1);
+    this->Data = (T *)addr;
+    return 1;
+    }
+
+  /* set every value of the buffer */
+  void Fill(const T &value)
+    {
+    size_t i, n = this->GetNumberOfVoxels()*this->NumberOfComponents;
+    for (i = 0; i < n; ++i)
+      {
+      this->Data[i] = value;
+      }
+    }
+
+  void Release()
+    {
+    if (this->Block)
+      {
+      free(this->Block);
+      }
+    this->Block = 0;
+    this->Data = 0;
+    }
+
+protected:
+  void *Block;
+
+private:
+  vvVolumeBuffer(const vvVolumeBuffer&); /* Not implemented */
+  void operator=(const vvVolumeBuffer&); /* Not implemented */
+};
+
+#endif
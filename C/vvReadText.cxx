@@ -1,4 +1,5 @@
 #include "vtkVVPluginAPI.h"
+#include "vvPluginVolume.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -21,19 +22,21 @@ void vvReadTextTemplate(vtkVVPluginInfo *info,
   /* TODO 10: Get your GUI values here */
   
   int x, y, z, scalar;
-  int *** vol = new int**[dim[2]];  
-  for(int i = 0; i < dim[2]; i++){
-    vol[i] = new int*[dim[1]];
-    for(int j = 0; j < dim[1]; j++){
-      vol[i][j] =  new int[dim[0]]();
+  vvVolumeBuffer<int> vol;
+  if (!vol.Allocate(dim))
+    {
+    info->SetProperty(info, VVP_ERROR, "Unable to allocate the text volume.");
+    return;
     }
-  }
   ifstream infile;
   infile.open("Z:\\papers\\FrangiVesslement\\total_delt=2-6(2).txt", ifstream::in);
   //ofstream outfile;
   //outfile.open(".\\REALLY.txt", ofstream::out);
   while (infile >> x >> y >> z >> scalar) {
-    vol[z-1][y-1][x-1] = scalar;
+    if (vol.IsInside(x-1, y-1, z-1))
+      {
+      vol(x-1, y-1, z-1) = scalar;
+      }
 	//outfile << x << " " << y << " " << z << " " << scalar << endl;
   }
   infile.close();
@@ -42,10 +45,8 @@ void vvReadTextTemplate(vtkVVPluginInfo *info,
   /* loop over the slices */
   for (int k = 0; k < dim[2]; k++ )                                      
     {                       
-    /* update the progress status */
-    info->UpdateProgress(info,(float)1.0*k/dim[2],"Processing..."); 
-    /* see if we should abort */
-    abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
+    /* update the progress status and see if we should abort */
+    abort = info->ReportProgress(info,(float)1.0*k/dim[2],"Processing..."); 
     /* loop over the rows and handle aborts */
     for (int j = 0; !abort && j < dim[1]; j++ )                          
       {          
@@ -53,8 +54,8 @@ void vvReadTextTemplate(vtkVVPluginInfo *info,
       for (int i = 0; i < dim[0]; i++ )
         {
         /* loop over the components */
-          if(vol[k][j][i])
-             *outPtr = vol[k][j][i];
+          if(vol(i, j, k))
+             *outPtr = vol(i, j, k);
           else
             *outPtr = -100;
 
@@ -132,7 +133,8 @@ extern "C"
     /* TODO 9: set these two values to "0" or "1" based on how your plugin
      * handles data all possible combinations of 0 and 1 are valid. */
     info->SetProperty(info, VVP_SUPPORTS_IN_PLACE_PROCESSING, "1");
-    info->SetProperty(info, VVP_SUPPORTS_PROCESSING_PIECES,   "1");
+    /* the points read are placed in the whole volume, not a slab */
+    info->SetProperty(info, VVP_SUPPORTS_PROCESSING_PIECES,   "0");
 
     /* TODO 7: set the number of GUI items used by this plugin */
     info->SetProperty(info, VVP_NUMBER_OF_GUI_ITEMS,          "0");
@@ -89,10 +89,81 @@ for what can be done.
 
 
 #include "vtkVVPluginAPI.h"
+#include "vvPluginKernels.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+/* Microbenchmark of the kernels of vvPluginKernels.h, this is not part of
+ * the skeleton. 'kernel' is run over 'n' values on the scalar code, the
+ * vector code and the vector code on every processor, and a line with the
+ * throughputs is appended to 'report'. */
+template <class K, class IT>
+void vvSampleTimeKernel(K &kernel, const IT *in, IT *ref, IT *out, size_t n,
+                        const char *name, char *report)
+{
+  double t[4];
+  t[0] = vvPluginGetTime();
+  kernel.SetUseVector(0);
+  kernel.Execute(in, ref, n);
+  t[1] = vvPluginGetTime();
+  kernel.SetUseVector(1);
+  kernel.Execute(in, out, n);
+  t[2] = vvPluginGetTime();
+  int same = !memcmp(ref, out, n*sizeof(IT));
+  vvPluginExecuteKernel((vtkVVPluginInfo *)0, kernel, in, out, n, 0);
+  t[3] = vvPluginGetTime();
+  same = same && !memcmp(ref, out, n*sizeof(IT));
+
+  double mvoxels[3];
+  int i;
+  for (i = 0; i < 3; ++i)
+    {
+    mvoxels[i] = n*1e-6/(t[i + 1] - t[i] > 1e-9 ? t[i + 1] - t[i] : 1e-9);
+    }
+  sprintf(report + strlen(report),
+          "%-12s scalar %8.1f  vector %8.1f  threads %8.1f Mvoxels/s%s\n",
+          name, mvoxels[0], mvoxels[1], mvoxels[2],
+          same ? "" : "  MISMATCH");
+}
+
+/* Times the Threshold and PixelMath kernels on a synthetic volume of 16M
+ * pseudo random values of type IT and reports the results. */
+template <class IT>
+void vvSampleBenchmark(vtkVVPluginInfo *info, IT *)
+{
+  const size_t n = (size_t)1 << 24;
+  std::vector<IT> input(n);
+  std::vector<IT> ref(n);
+  std::vector<IT> out(n);
+  double lo = vvKernelMinimum<IT>();
+  double hi = vvKernelMaximum<IT>();
+  lo = lo < -10000 ? -10000 : lo;
+  hi = hi > 10000 ? 10000 : hi;
+  size_t i;
+  for (i = 0; i < n; ++i)
+    {
+    input[i] = (IT)(lo + (hi - lo)*((i*2654435761u) % 65536)/65535.0);
+    }
+
+  char report[1024];
+  sprintf(report, "%lu values, %d threads\n", (unsigned long)n,
+          vvPluginGetNumberOfProcessors());
+  vvThresholdKernel<IT> threshold(VV_KERNEL_LESS, 0.5*(lo + hi), lo);
+  vvSampleTimeKernel(threshold, &input[0], &ref[0], &out[0], n,
+                     "Threshold <", report);
+  vvPixelMathKernel<IT> add(VV_KERNEL_ADD, 100);
+  vvSampleTimeKernel(add, &input[0], &ref[0], &out[0], n,
+                     "PixelMath +", report);
+  vvPixelMathKernel<IT> multiply(VV_KERNEL_MULTIPLY, 3);
+  vvSampleTimeKernel(multiply, &input[0], &ref[0], &out[0], n,
+                     "PixelMath *", report);
+  vvPixelMathKernel<IT> divide(VV_KERNEL_DIVIDE, 7);
+  vvSampleTimeKernel(divide, &input[0], &ref[0], &out[0], n,
+                     "PixelMath /", report);
+  info->SetProperty(info, VVP_REPORT_TEXT, report);
+}
+
 template <class IT>
 /* TODO 1: Rename vvSampleTemplate to vv<your_plugin>Template */
 void vvSampleTemplate(vtkVVPluginInfo *info,
@@ -107,14 +178,17 @@ void vvSampleTemplate(vtkVVPluginInfo *info,
   int abort;
 
   /* TODO 10: Get your GUI values here */
+  int benchmark = atoi(info->GetGUIProperty(info, 0, VVP_GUI_VALUE));
+  if (benchmark)
+    {
+    vvSampleBenchmark(info, static_cast<IT *>(0));
+    }
   
   /* loop over the slices */
   for ( k = 0; k < dim[2]; k++ )                                      
     {                       
-    /* update the progress status */
-    info->UpdateProgress(info,(float)1.0*k/dim[2],"Processing..."); 
-    /* see if we should abort */
-    abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));
+    /* update the progress status and see if we should abort */
+    abort = info->ReportProgress(info,(float)1.0*k/dim[2],"Processing..."); 
     /* loop over the rows and handle aborts */
     for ( j = 0; !abort && j < dim[1]; j++ )                          
       {          
@@ -155,7 +229,11 @@ static int UpdateGUI(void *inf)
   vtkVVPluginInfo *info = (vtkVVPluginInfo *)inf;
 
   /* TODO 8: create your required GUI elements here */
-
+  info->SetGUIProperty(info, 0, VVP_GUI_LABEL, "Benchmark kernels");
+  info->SetGUIProperty(info, 0, VVP_GUI_TYPE, VVP_GUI_CHECKBOX);
+  info->SetGUIProperty(info, 0, VVP_GUI_DEFAULT, "0");
+  info->SetGUIProperty(info, 0, VVP_GUI_HELP,
+                       "Time the Threshold and PixelMath kernels on synthetic data of the input's type before copying the input, the timings are shown in the report.");
 
   /* TODO 6: modify the following code as required. By default the output
   *  image's properties match those of the input depending on what your
@@ -205,7 +283,7 @@ extern "C"
     info->SetProperty(info, VVP_SUPPORTS_PROCESSING_PIECES,   "0");
 
     /* TODO 7: set the number of GUI items used by this plugin */
-    info->SetProperty(info, VVP_NUMBER_OF_GUI_ITEMS,          "0");
+    info->SetProperty(info, VVP_NUMBER_OF_GUI_ITEMS,          "1");
   info->SetProperty(info, VVP_REQUIRES_SERIES_INPUT,        "0");
   info->SetProperty(info, VVP_SUPPORTS_PROCESSING_SERIES_BY_VOLUMES, "0");
   info->SetProperty(info, VVP_PRODUCES_OUTPUT_SERIES, "0");
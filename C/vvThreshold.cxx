@@ -12,36 +12,10 @@
 
 
 #include "vtkVVPluginAPI.h"
+#include "vvPluginKernels.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-<<<<<<< HEAD
-=======
-#include <iostream>
-#include <fstream>
-#include <map>
->>>>>>> 582480cd14e067db3b1fed95c429f1724f683c48
-
-#define ApplyThresholdFilterMacro( COMPARISON )                         \
-    int i, j, k;                                                        \
-    for ( k = 0; k < dim[2]; k++ )                                      \
-      {                                                                 \
-      info->UpdateProgress(info,(float)1.0*k/dim[2],"Thresholding..."); \
-      abort = atoi(info->GetProperty(info,VVP_ABORT_PROCESSING));       \
-      for ( j = 0; !abort && j < dim[1]; j++ )                          \
-        {                                                               \
-        for ( i = 0; i < nc*dim[0]; i++ )                               \
-          {                                                             \
-          if ( *ptr COMPARISON compVal )                                \
-            {                                                           \
-            *ptr = assignVal;                                           \
-            }                                                           \
-          ptr++;                                                        \
-          }                                                             \
-        }                                                               \
-      }                                                                 \
-    info->UpdateProgress(info,(float)1.0,"Thresholding Complete");
-
 
 //-----------------------------------------------------------
 template <class IT>
@@ -49,46 +23,29 @@ void vvThresholdTemplate(vtkVVPluginInfo *info,
                          vtkVVProcessDataStruct *pds, 
                          IT *)
 {
-  IT *ptr = (IT *)pds->outData;
   int *dim = info->InputVolumeDimensions;
   double v1 = atof(info->GetGUIProperty(info, 1, VVP_GUI_VALUE));
   double v2 = atof(info->GetGUIProperty(info, 2, VVP_GUI_VALUE));
   const char *label = info->GetGUIProperty(info, 0, VVP_GUI_VALUE);
-  int abort = 0;
-  IT compVal = (IT)v1;
-  IT assignVal = (IT)v2;
   int nc = info->InputVolumeNumberOfComponents;
-<<<<<<< HEAD
-  
-=======
-
-
->>>>>>> 582480cd14e067db3b1fed95c429f1724f683c48
-  if (!strcmp(label,"<"))
-    {
-    ApplyThresholdFilterMacro( < );
-    }
-  if (!strcmp(label,"<="))
+  int op = vvPluginKernelOperation(label);
+  if (op < VV_KERNEL_LESS || op > VV_KERNEL_GREATER)
     {
-    ApplyThresholdFilterMacro( <= );
+    return;
     }
-  if (!strcmp(label,"=="))
-    {
-    ApplyThresholdFilterMacro( == );
-    }
-  if (!strcmp(label,">="))
+
+  /* the slices of this piece, the whole volume when processing in place */
+  size_t sliceSize = (size_t)nc*dim[0]*dim[1];
+  IT *inPtr = (IT *)pds->inData + sliceSize*pds->StartSlice;
+  IT *outPtr = (IT *)pds->outData;
+
+  vvThresholdKernel<IT> kernel(op, v1, v2);
+  if (vvPluginExecuteKernel(info, kernel, inPtr, outPtr,
+                            sliceSize*pds->NumberOfSlicesToProcess,
+                            "Thresholding..."))
     {
-    ApplyThresholdFilterMacro( >= );
+    info->UpdateProgress(info,(float)1.0,"Thresholding Complete");
     }
-  if (!strcmp(label,">"))
-    {
-    ApplyThresholdFilterMacro( > );
-<<<<<<< HEAD
-    }  
-=======
-    } 
-
->>>>>>> 582480cd14e067db3b1fed95c429f1724f683c48
 }
 
 static int ProcessData(void *inf, vtkVVProcessDataStruct *pds)
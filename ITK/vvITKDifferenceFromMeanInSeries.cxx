@@ -15,6 +15,8 @@
 
 #include "itkImageLinearConstIteratorWithIndex.h"
 
+#include <vector>
+
 
 
 template <class TInputPixelType>
@@ -46,6 +48,12 @@ class DifferenceFromMeanInSeriesRunner
     DifferenceFromMeanInSeriesRunner() {}
     void Execute( vtkVVPluginInfo *info, vtkVVProcessDataStruct *pds )
     {
+      if( !pds->inDataSeries && info->GetSeriesVolume )
+        {
+        this->ExecuteByVolumes( info, pds );
+        return;
+        }
+
       ModuleType  module;
       module.SetPluginInfo( info );
       module.SetUpdateMessage("Computing the Mean value of the Series...");
@@ -131,6 +139,83 @@ class DifferenceFromMeanInSeriesRunner
           }
         }
     }
+
+    // The series is not in pds->inDataSeries: walk it one volume at a time
+    // instead, twice, first to sum up then to compute the differences.
+    void ExecuteByVolumes( vtkVVPluginInfo *info, vtkVVProcessDataStruct *pds )
+    {
+      PixelType * outData = static_cast< PixelType * >( pds->outData );
+      PixelType * outDataSeries = static_cast< PixelType * >( pds->outDataSeries );
+      if( !outDataSeries )
+        {
+        info->SetProperty( info, VVP_ERROR, "This plugin produces a volume series as output but the current receiving pointer is NULL." ); 
+        return;
+        }
+
+      const int numberOfVolumesInSeries = info->InputVolumeSeriesNumberOfVolumes;
+      const unsigned long numberOfPixelInOneVolume = 
+        (unsigned long)info->InputVolumeSeriesDimensions[0] *
+                       info->InputVolumeSeriesDimensions[1] *
+                       info->InputVolumeSeriesDimensions[2] *
+                       info->InputVolumeSeriesNumberOfComponents;
+
+      std::vector< PixelAccumulateType > sum( numberOfPixelInOneVolume,
+                              itk::NumericTraits< PixelAccumulateType >::Zero );
+      int nv;
+      unsigned long np;
+      for( nv = 0; nv < numberOfVolumesInSeries; nv++ )
+        {
+        const PixelType * inData = 
+          static_cast< const PixelType * >( info->GetSeriesVolume( info, nv ) );
+        if( !inData )
+          {
+          info->SetProperty( info, VVP_ERROR, "A volume of the series could not be read." ); 
+          return;
+          }
+        for( np = 0; np < numberOfPixelInOneVolume; np++ )
+          {
+          sum[np] += inData[np];
+          }
+        info->ReleaseSeriesVolume( info, nv );
+        info->ReportProgress( info, 0.5 * (nv + 1) / numberOfVolumesInSeries,
+                              "Computing the Mean" );
+        if( vvPluginAbortRequested( info ) )
+          {
+          return;
+          }
+        }
+      for( np = 0; np < numberOfPixelInOneVolume; np++ )
+        {
+        outData[np] = static_cast< PixelType >( sum[np] / numberOfVolumesInSeries );
+        }
+
+      const PixelType middle = static_cast< PixelType >( (
+            itk::NumericTraits< PixelType >::max() 
+          + itk::NumericTraits< PixelType >::NonpositiveMin() ) / 2.0 );
+
+      for( nv = 0; nv < info->OutputVolumeSeriesNumberOfVolumes; nv++ )
+        {
+        const PixelType * inData = 
+          static_cast< const PixelType * >( info->GetSeriesVolume( info, nv ) );
+        if( !inData )
+          {
+          info->SetProperty( info, VVP_ERROR, "A volume of the series could not be read." ); 
+          return;
+          }
+        for( np = 0; np < numberOfPixelInOneVolume; np++ )
+          {
+          *outDataSeries = static_cast< PixelType >( inData[np] - outData[np] + middle );
+          ++outDataSeries;
+          }
+        info->ReleaseSeriesVolume( info, nv );
+        info->ReportProgress( info, 0.5 + 0.5 * (nv + 1) / numberOfVolumesInSeries,
+                              "Computing the Differences" );
+        if( vvPluginAbortRequested( info ) )
+          {
+          return;
+          }
+        }
+    }
   };
 
 
@@ -288,6 +373,7 @@ void VV_PLUGIN_EXPORT vvITKDifferenceFromMeanInSeriesInit(vtkVVPluginInfo *info)
   info->SetProperty(info, VVP_PER_VOXEL_MEMORY_REQUIRED,    "0"); 
   info->SetProperty(info, VVP_REQUIRES_SERIES_INPUT,        "1");
   info->SetProperty(info, VVP_SUPPORTS_PROCESSING_SERIES_BY_VOLUMES, "0");
+  info->SetProperty(info, VVP_SUPPORTS_PAGED_SERIES_INPUT, "1");
   info->SetProperty(info, VVP_PRODUCES_OUTPUT_SERIES, "1");
   info->SetProperty(info, VVP_PRODUCES_PLOTTING_OUTPUT, "0");
 }
@@ -312,6 +312,10 @@ FastMarchingModule<TInputPixelType>
   m_SigmoidFilter->AddObserver( itk::StartEvent(), this->GetCommandObserver() );
   m_SigmoidFilter->AddObserver( itk::EndEvent(), this->GetCommandObserver() );
 
+  // The post processing only shows in the execution trace
+  m_IntensityWindowingFilter->AddObserver( itk::StartEvent(), this->GetTraceObserver() );
+  m_IntensityWindowingFilter->AddObserver( itk::EndEvent(), this->GetTraceObserver() );
+
   // Execute the filters and progressively remove temporary memory
   this->SetUpdateMessage("Preprocessing with gradient magnitude...");
   this->SetCurrentFilterProgressWeight( 0.5 * m_ProgressWeighting );
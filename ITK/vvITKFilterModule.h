@@ -23,6 +23,9 @@
 #include "itkImage.h"
 #include "itkImportImageFilter.h"
 #include "itkImageRegionConstIterator.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
 
 
 namespace VolView
@@ -74,6 +77,7 @@ public:
     m_Filter->AddObserver( itk::StartEvent(), this->GetCommandObserver() );
     m_Filter->AddObserver( itk::EndEvent(), this->GetCommandObserver() );
     m_LetITKAllocateOutputMemory = false;
+    m_ComponentsSource = 0;
     }
 
 
@@ -111,6 +115,9 @@ public:
 
     const unsigned int numberOfComponents = this->GetPluginInfo()->InputVolumeNumberOfComponents;
 
+    // the components are extracted all at once by the first import
+    m_ComponentsSource = 0;
+
     for(unsigned int component=0; component < numberOfComponents; component++ )
       {
 
@@ -158,21 +165,18 @@ public:
       }
 
    
-    typedef itk::ImageRegionConstIterator< OutputImageType >  OutputIteratorType;
-
-    OutputIteratorType ot( outputImage, outputImage->GetBufferedRegion() );
-    
     OutputPixelType * outData = static_cast< OutputPixelType * >( pds->outData );
 
     outData += component;  // move to the start of the selected component;
 
-    ot.GoToBegin(); 
-    while( !ot.IsAtEnd() )
-      {
-      *outData = ot.Get();
-      ++ot;
-      outData += numberOfComponents;
-      }
+    ComponentCopyType copy;
+    copy.Source            = outputImage->GetBufferPointer();
+    copy.Destination       = outData;
+    copy.NumberOfPixels    = outputImage->GetBufferedRegion().GetNumberOfPixels();
+    copy.SourceStride      = 1;
+    copy.DestinationStride = numberOfComponents;
+    copy.NumberOfComponents = 1;
+    this->CopyComponents( copy, &FilterModule::InterleaveCallback );
 
   } // end of CopyOutputData
 
@@ -239,22 +243,34 @@ public:
       }
     else 
       {
-      const bool         importFilterWillDeleteTheInputBuffer = true;
+      const bool         importFilterWillDeleteTheInputBuffer = false;
       
-      InputPixelType *   extractedComponent = new InputPixelType[ totalNumberOfPixels ];
-
       InputPixelType *   dataBlockStart = 
                             static_cast< InputPixelType * >( pds->inData )  
                           + numberOfPixelsPerSlice * pds->StartSlice
-                          + component;
-
-      InputPixelType *   inputData = dataBlockStart;
+                          * numberOfComponents;
 
-      for(unsigned int i=0; i<totalNumberOfPixels; i++, inputData += numberOfComponents )
+      // Extract all the components in one pass, the next components are
+      // then imported from the same buffer
+      if( m_ComponentsSource != dataBlockStart )
         {
-        extractedComponent[i] =  *inputData;
+        m_Components.resize( totalNumberOfPixels * numberOfComponents );
+
+        ComponentCopyType copy;
+        copy.Source            = dataBlockStart;
+        copy.Destination       = &m_Components[0];
+        copy.NumberOfPixels    = totalNumberOfPixels;
+        copy.SourceStride      = numberOfComponents;
+        copy.DestinationStride = totalNumberOfPixels;
+        copy.NumberOfComponents = numberOfComponents;
+        this->CopyComponents( copy, &FilterModule::DeinterleaveCallback );
+
+        m_ComponentsSource = dataBlockStart;
         }
 
+      InputPixelType *   extractedComponent = 
+                            &m_Components[0] + component * totalNumberOfPixels;
+
       m_ImportFilter->SetImportPointer( extractedComponent, 
                                         totalNumberOfPixels,
                                         importFilterWillDeleteTheInputBuffer );
@@ -314,10 +330,123 @@ public:
   
   } // end of ExportPixelBuffer
 
+protected:
+
+  /** Description of a copy between interleaved and separate components,
+   *  split in ranges of pixels among the threads */
+  struct ComponentCopyType
+  {
+    const void *    Source;
+    void *          Destination;
+    unsigned long   NumberOfPixels;
+    unsigned long   SourceStride;
+    unsigned long   DestinationStride;
+    unsigned int    NumberOfComponents;
+  };
+
+  void CopyComponents( ComponentCopyType & copy, 
+                       ITK_THREAD_RETURN_TYPE (*callback)(void *) )
+  {
+    // small volumes are not worth starting threads for
+    const unsigned long pixelsPerThread = 65536;
+    int numberOfThreads = 
+      itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+    if( (unsigned long)numberOfThreads > copy.NumberOfPixels / pixelsPerThread )
+      {
+      numberOfThreads = static_cast< int >( copy.NumberOfPixels / pixelsPerThread );
+      }
+    if( numberOfThreads <= 1 )
+      {
+      itk::MultiThreader::ThreadInfoStruct threadInfo;
+      threadInfo.ThreadID = 0;
+      threadInfo.NumberOfThreads = 1;
+      threadInfo.UserData = &copy;
+      (*callback)( &threadInfo );
+      return;
+      }
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    threader->SetNumberOfThreads( numberOfThreads );
+    threader->SetSingleMethod( callback, &copy );
+    threader->SingleMethodExecute();
+  }
+
+  static void GetThreadRange( void * arg, ComponentCopyType * & copy,
+                              unsigned long & begin, unsigned long & end )
+  {
+    itk::MultiThreader::ThreadInfoStruct * threadInfo =
+      static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+    copy = static_cast< ComponentCopyType * >( threadInfo->UserData );
+    const unsigned long numberOfThreads = threadInfo->NumberOfThreads;
+    const unsigned long threadId        = threadInfo->ThreadID;
+    begin = copy->NumberOfPixels * threadId / numberOfThreads;
+    end   = copy->NumberOfPixels * ( threadId + 1 ) / numberOfThreads;
+  }
+
+  /** Gather the interleaved components of a range of pixels into one
+   *  buffer per component. The pixels go by blocks fitting in the cache so
+   *  that the input is read from memory once for all the components, while
+   *  the writes stay contiguous. */
+  static ITK_THREAD_RETURN_TYPE DeinterleaveCallback( void * arg )
+  {
+    ComponentCopyType * copy;
+    unsigned long begin;
+    unsigned long end;
+    GetThreadRange( arg, copy, begin, end );
+
+    const InputPixelType * source = 
+      static_cast< const InputPixelType * >( copy->Source );
+    InputPixelType * destination = 
+      static_cast< InputPixelType * >( copy->Destination );
+    const unsigned long stride = copy->SourceStride;
+
+    const unsigned long blockSize = 4096;
+    for( unsigned long block = begin; block < end; block += blockSize )
+      {
+      const unsigned long blockEnd = 
+        block + blockSize < end ? block + blockSize : end;
+      for( unsigned int c = 0; c < copy->NumberOfComponents; c++ )
+        {
+        const InputPixelType * in = source + block * stride + c;
+        InputPixelType * out = 
+          destination + c * copy->DestinationStride + block;
+        for( unsigned long i = block; i < blockEnd; i++, in += stride )
+          {
+          *out++ = *in;
+          }
+        }
+      }
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  /** Scatter the output of one component back among the others */
+  static ITK_THREAD_RETURN_TYPE InterleaveCallback( void * arg )
+  {
+    ComponentCopyType * copy;
+    unsigned long begin;
+    unsigned long end;
+    GetThreadRange( arg, copy, begin, end );
+
+    const OutputPixelType * in = 
+      static_cast< const OutputPixelType * >( copy->Source ) + begin;
+    const unsigned long stride = copy->DestinationStride;
+    OutputPixelType * out = 
+      static_cast< OutputPixelType * >( copy->Destination ) + begin * stride;
+    for( unsigned long i = begin; i < end; i++, out += stride )
+      {
+      *out = *in++;
+      }
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
 private:
     typename ImportFilterType::Pointer    m_ImportFilter;
     typename FilterType::Pointer          m_Filter;
     bool                                  m_LetITKAllocateOutputMemory;
+
+    // all the components of the input, one after the other, and where
+    // they were extracted from
+    std::vector< InputPixelType >         m_Components;
+    const InputPixelType *                m_ComponentsSource;
 };
 
 
@@ -20,7 +20,9 @@
 
 #include "itkCommand.h"
 #include "itkProcessObject.h"
+#include "itkImageBase.h"
 #include "itkImageRegion.h"
+#include "itkRealTimeClock.h"
 #include "itkSize.h"
 #include "itkIndex.h"
 
@@ -29,6 +31,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <fstream>   
+#include <string>
+#include <vector>
 
 namespace VolView
 {
@@ -59,6 +63,9 @@ public:
     m_Info               = 0;
     m_UpdateMessage      = "Processing the filter...";
     m_CommandObserver->SetCallbackFunction( this, &FilterModuleBase::ProgressUpdate );
+    m_TraceObserver      = CommandType::New();
+    m_TraceObserver->SetCallbackFunction( this, &FilterModuleBase::TraceUpdate );
+    m_Clock              = itk::RealTimeClock::New();
     m_CumulatedProgress = 0.0;
     m_CurrentFilterProgressWeight = 1.0;
     m_ProcessComponentsIndependetly = true;
@@ -534,6 +541,15 @@ const char * GetInputVolumeSeriesScalarTypeRangeFraction( const vtkVVPluginInfo
      return m_CommandObserver;
   }
 
+  /** Observer recording the Start/End events of a filter in the execution
+      trace, without reporting its progress. The filters observed by
+      GetCommandObserver() are traced already. */
+  CommandType *
+  GetTraceObserver()
+  {
+     return m_TraceObserver;
+  }
+
   virtual void CallbackForIterationEvent()
   {
     char tmp[1024];
@@ -552,6 +568,8 @@ const char * GetInputVolumeSeriesScalarTypeRangeFraction( const vtkVVPluginInfo
     itk::ProcessObject::Pointer process =
               dynamic_cast< itk::ProcessObject *>( caller );
 
+    this->TraceUpdate( caller, event );
+
     if( typeid( itk::EndEvent ) == typeid( event ) )
       {
       m_CumulatedProgress += m_CurrentFilterProgressWeight;
@@ -579,9 +597,10 @@ const char * GetInputVolumeSeriesScalarTypeRangeFraction( const vtkVVPluginInfo
         {
         progressForGUI /= m_Info->InputVolumeNumberOfComponents;
         }
-      m_Info->UpdateProgress(m_Info, progressForGUI, m_UpdateMessage.c_str()); 
-      // Test whether during the GUI update, the Abort button was pressed
-      int abort = atoi( m_Info->GetProperty( m_Info, VVP_ABORT_PROCESSING ) );
+      // Update the GUI (at most a few times per second) and test whether
+      // the Abort button was pressed
+      int abort = m_Info->ReportProgress( m_Info, progressForGUI,
+                                          m_UpdateMessage.c_str() );
       if( abort )
         {
         process->SetAbortGenerateData(true);
@@ -590,6 +609,91 @@ const char * GetInputVolumeSeriesScalarTypeRangeFraction( const vtkVVPluginInfo
   }
 
 
+  /** Record the filters execution in the VVP_TRACE_BUFFER, when VolView
+      traces the plugins: one event per filter run, with the number of
+      pixels produced, of threads and of iterations. */
+  void 
+  TraceUpdate( itk::Object * caller, const itk::EventObject & event )
+  {
+    if( !m_Info || !m_Info->GetBuffer || !m_Info->SetBuffer ||
+        !m_Info->GetBuffer( m_Info, VVP_TRACE_BUFFER, 0 ) )
+      {
+      return;
+      }
+
+    if( typeid( itk::StartEvent ) == typeid( event ) )
+      {
+      TraceEventType traceEvent;
+      traceEvent.Filter = caller;
+      traceEvent.Start = m_Clock->GetTimeStamp();
+      traceEvent.Iterations = 0;
+      m_TraceEvents.push_back( traceEvent );
+      return;
+      }
+
+    // the innermost filter running, the pipeline nests the executions
+    int current = static_cast<int>( m_TraceEvents.size() ) - 1;
+    while( current >= 0 && m_TraceEvents[current].Filter != caller )
+      {
+      current--;
+      }
+    if( current < 0 )
+      {
+      return;
+      }
+
+    if( typeid( itk::IterationEvent ) == typeid( event ) )
+      {
+      m_TraceEvents[current].Iterations++;
+      return;
+      }
+
+    if( typeid( itk::EndEvent ) != typeid( event ) )
+      {
+      return;
+      }
+
+    const double end = m_Clock->GetTimeStamp();
+    unsigned long pixels = 0;
+    int threads = 1;
+    itk::ProcessObject * process = dynamic_cast< itk::ProcessObject *>( caller );
+    if( process )
+      {
+      threads = process->GetNumberOfThreads();
+      if( process->GetNumberOfOutputs() > 0 )
+        {
+        const itk::ImageBase<3> * image = 
+          dynamic_cast< const itk::ImageBase<3> * >( process->GetOutputs()[0].GetPointer() );
+        if( image )
+          {
+          pixels = image->GetRequestedRegion().GetNumberOfPixels();
+          }
+        }
+      }
+
+    char json[1024];
+    sprintf( json,
+      "{\"name\":\"%s\",\"cat\":\"itk\",\"ph\":\"X\",\"ts\":%.0f,"
+      "\"dur\":%.0f,\"pid\":1,\"tid\":0,\"args\":{\"pixels\":%lu,"
+      "\"threads\":%d,\"iterations\":%u}}",
+      caller->GetNameOfClass(), m_TraceEvents[current].Start * 1e6,
+      ( end - m_TraceEvents[current].Start ) * 1e6, pixels, threads,
+      m_TraceEvents[current].Iterations );
+    m_TraceEvents.erase( m_TraceEvents.begin() + current );
+
+    size_t size = 0;
+    const char * trace = static_cast< const char * >(
+      m_Info->GetBuffer( m_Info, VVP_TRACE_BUFFER, &size ) );
+    std::string events( trace ? trace : "", trace ? size : 0 );
+    if( !events.empty() )
+      {
+      events += ",";
+      }
+    events += json;
+    m_Info->SetBuffer( m_Info, VVP_TRACE_BUFFER, events.data(), events.size() );
+  }
+
+
   /**  Set the Plugin Info structure */
   void
   SetPluginInfo( vtkVVPluginInfo * info )
@@ -607,7 +711,17 @@ const char * GetInputVolumeSeriesScalarTypeRangeFraction( const vtkVVPluginInfo
 
 
 private:
+    struct TraceEventType
+    {
+      const itk::Object * Filter;
+      double              Start;
+      unsigned int        Iterations;
+    };
+
     CommandType::Pointer         m_CommandObserver;
+    CommandType::Pointer         m_TraceObserver;
+    itk::RealTimeClock::Pointer  m_Clock;
+    std::vector< TraceEventType > m_TraceEvents;
     vtkVVPluginInfo            * m_Info;
     std::string                  m_UpdateMessage;
     float                        m_CumulatedProgress;
@@ -50,6 +50,10 @@ GeodesicActiveContourModule<TInputPixelType>
   m_GeodesicActiveContourFilter->AddObserver( itk::ProgressEvent(), this->GetCommandObserver() );
   m_GeodesicActiveContourFilter->AddObserver( itk::StartEvent(), this->GetCommandObserver() );
   m_GeodesicActiveContourFilter->AddObserver( itk::EndEvent(), this->GetCommandObserver() );
+
+  // The post processing only shows in the execution trace
+  m_IntensityWindowingFilter->AddObserver( itk::StartEvent(), this->GetTraceObserver() );
+  m_IntensityWindowingFilter->AddObserver( itk::EndEvent(), this->GetTraceObserver() );
 }
 
 
@@ -50,6 +50,10 @@ ShapeDetectionModule<TInputPixelType>
   m_ShapeDetectionFilter->AddObserver( itk::ProgressEvent(), this->GetCommandObserver() );
   m_ShapeDetectionFilter->AddObserver( itk::StartEvent(), this->GetCommandObserver() );
   m_ShapeDetectionFilter->AddObserver( itk::EndEvent(), this->GetCommandObserver() );
+
+  // The post processing only shows in the execution trace
+  m_IntensityWindowingFilter->AddObserver( itk::StartEvent(), this->GetTraceObserver() );
+  m_IntensityWindowingFilter->AddObserver( itk::EndEvent(), this->GetTraceObserver() );
 }
 
 
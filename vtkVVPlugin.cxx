@@ -21,9 +21,12 @@
 #include "vtkImageData.h"
 #include "vtkImageImport.h"
 #include "vtkMetaImageWriter.h"
+#include "vtkTimerLog.h"
 
 #include "vtkKWApplication.h"
 #include "vtkKWCheckButton.h"
+#include "vtkKWEntry.h"
+#include "vtkKWEntryWithLabel.h"
 #include "vtkKWFrameWithLabel.h"
 #include "vtkKWIcon.h"
 #include "vtkKWLabel.h"
@@ -39,7 +42,10 @@
 #include "vtkUnstructuredGrid.h"
 #include "vtkUnstructuredGridReader.h"
 
+#include "vtkConditionVariable.h"
 #include "vtkLargeInteger.h"
+#include "vtkMultiThreader.h"
+#include "vtkMutexLock.h"
 #include "vtkObjectFactory.h"
 #include "vtkPointData.h"
 #include "vtkPointSet.h"
@@ -82,12 +88,26 @@
 #include "vtkVolumeProperty.h"
 
 #include "vtkVVSelectionFrameLayoutManager.h"
+#include "vtkVVPluginBufferStore.h"
+#include "vtkVVPluginMemoryPlanner.h"
+#include "vtkVVPluginResultCache.h"
+#include "vtkVVPluginSeriesCache.h"
 
 #include <vtksys/SystemTools.hxx>
 
 #include <vtkstd/string>
+#include <vtkstd/vector>
+#include <math.h>
 #include <time.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#endif
+
 /* this is the data structure describing one GUI element. */
 class  vtkVVGUIItem 
 {
@@ -109,6 +129,140 @@ public:
   char *Value;
 };
 
+/* the progress and report text of a plugin running in the background,
+ * waiting for the GUI thread to show them. Only the last progress is
+ * worth showing, it replaces the one before it if not shown yet. */
+class vtkVVPluginMessageQueue
+{
+public:
+  enum { Progress, ReportText };
+  struct MessageType
+  {
+    int Type;
+    float Progress;
+    int HasText;
+    vtkstd::string Text;
+  };
+
+  vtkVVPluginMessageQueue() : Done(0) { this->Lock = vtkMutexLock::New(); }
+  ~vtkVVPluginMessageQueue() { this->Lock->Delete(); }
+
+  void Post(int type, float progress, const char *text)
+    {
+    MessageType message;
+    message.Type = type;
+    message.Progress = progress;
+    message.HasText = text ? 1 : 0;
+    message.Text = text ? text : "";
+    this->Lock->Lock();
+    if (type == Progress && !this->Messages.empty() && 
+        this->Messages.back().Type == Progress)
+      {
+      this->Messages.back() = message;
+      }
+    else
+      {
+      this->Messages.push_back(message);
+      }
+    this->Lock->Unlock();
+    }
+
+  /* called by the background thread once the plugin has returned */
+  void SetDone()
+    {
+    this->Lock->Lock();
+    this->Done = 1;
+    this->Lock->Unlock();
+    }
+
+  /* move the messages posted so far to 'messages', return 1 when nothing
+   * else will be posted */
+  int Take(vtkstd::vector<MessageType> &messages)
+    {
+    messages.clear();
+    this->Lock->Lock();
+    messages.swap(this->Messages);
+    int done = this->Done;
+    this->Lock->Unlock();
+    return done;
+    }
+
+protected:
+  vtkstd::vector<MessageType> Messages;
+  int Done;
+  vtkMutexLock *Lock;
+};
+
+//BTX
+#ifdef KWVolView_PLUGINS_USE_SERIES
+/* the state shared by the two sides of ProcessSeriesByVolumes(): the GUI
+ * thread, which owns the reader of the series, reads the volumes ahead
+ * into a ring of buffers (see ServeSeriesReads()) while the plugin thread
+ * runs the plugin on them. Volume v is in Buffers[v % NumberOfBuffers].
+ * Without a GUI thread to read (ReadInline), the plugin thread reads each
+ * volume before processing it. */
+class vtkVVPluginSeriesPrefetcher
+{
+public:
+  int (*Reader)(void *clientData, int volume, void *buffer, size_t size);
+  void *ReaderData;
+  int ReadInline;
+  vtkVVPluginInfo *Info;
+  vtkVVProcessDataStruct *ProcessDataStruct;
+  int NumberOfVolumes;
+  size_t VolumeSize;
+  unsigned char **Buffers;
+  int NumberOfBuffers;
+  /* the volumes read so far, and the volumes processed so far */
+  int ReadVolumes;
+  int ProcessedVolumes;
+  /* the volume that could not be read, -1 if none */
+  int MissingVolume;
+  int Failed;
+  vtkMutexLock *Lock;
+  /* signaled when a volume was read, or could not be */
+  vtkConditionVariable *Ready;
+};
+
+/* a volume of the series the plugin thread asks for through the
+ * SeriesCache, read by the GUI thread (see ServeSeriesReads()) */
+class vtkVVPluginSeriesRequest
+{
+public:
+  vtkVVPluginSeriesRequest() : Volume(0), Buffer(0), Size(0), Pending(0), 
+                               Result(0)
+    {
+    this->Lock = vtkMutexLock::New();
+    this->Done = vtkConditionVariable::New();
+    }
+  ~vtkVVPluginSeriesRequest()
+    {
+    this->Done->Delete();
+    this->Lock->Delete();
+    }
+  int Volume;
+  void *Buffer;
+  size_t Size;
+  int Pending;
+  int Result;
+  vtkMutexLock *Lock;
+  /* signaled when the volume was read, or could not be */
+  vtkConditionVariable *Done;
+};
+#endif
+//ETX
+
+/* the work RunInBackground() hands to the background thread */
+class vtkVVPluginBackgroundJob
+{
+public:
+  vtkVVPluginInfo *Info;
+  vtkVVProcessDataStruct *ProcessDataStruct;
+  vtkMultiThreader *Threader;
+  vtkVVPluginMessageQueue *Queue;
+  int Result;
+};
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro( vtkVVPlugin );
 vtkCxxRevisionMacro(vtkVVPlugin, "$Revision: 1.31 $");
@@ -120,11 +274,23 @@ vtkVVPlugin::vtkVVPlugin()
   this->DocText = vtkKWLabelWithLabel::New();
   this->ReportText = vtkKWLabelWithLabel::New();
   this->StopWatchText = vtkKWLabelWithLabel::New();
+  this->PreviewCroppedButton = 0;
 
   this->Widgets = 0;
   this->Window = 0;
   this->ProgressMinimum = 0;
   this->ProgressMaximum = 1;
+  this->LastProgressRefresh = 0;
+  this->MessageQueue = 0;
+  this->SeriesPrefetcher = 0;
+  this->SeriesCache = new vtkVVPluginSeriesCache;
+  this->SeriesRequest = 0;
+//BTX
+#ifdef KWVolView_PLUGINS_USE_SERIES
+  this->SeriesRequest = new vtkVVPluginSeriesRequest;
+#endif
+//ETX
+  this->ExecutingDataItem = 0;
   this->AbortProcessing = 0;
   
   this->Name = 0;
@@ -132,12 +298,16 @@ vtkVVPlugin::vtkVVPlugin()
   this->TerseDocumentation = 0;
   this->FullDocumentation = 0;
   this->GUIItems = 0;
+  this->FileName = 0;
+  this->Loaded = 0;
+  this->RecordingDescription = 0;
   this->SupportProcessingPieces = 0;
   this->SupportInPlaceProcessing = 0;
   this->SecondInputIsUnstructuredGrid = 0;
 //BTX
 #ifdef KWVolView_PLUGINS_USE_SERIES
   this->SupportProcessingSeriesByVolumes = 0;
+  this->SupportPagedSeriesInput = 0;
   this->SeriesInputButton = 0;
   this->SeriesInputOpenWizard = 0;
   this->ProducesSeriesOutput  = 0;
@@ -149,6 +319,11 @@ vtkVVPlugin::vtkVVPlugin()
 #endif
 //ETX
   this->PerVoxelMemoryRequired = 0;
+  this->PerVoxelStageMemory = 0;
+  this->PlannedPeakMemory = 0;
+  this->PlannedUndoMemory = 0;
+  this->PreviewMode = VTK_VV_PLUGIN_PREVIEW_DOWNSAMPLED;
+  this->PreviewSize = 128;
   this->RequiredZOverlap = 0;
   this->NumberOfGUIItems = 0;
   this->RequiresSecondInput = 0;
@@ -283,6 +458,12 @@ vtkVVPlugin::vtkVVPlugin()
   this->PluginInfo.GetGUIProperty = 0;
   this->PluginInfo.ProcessData = 0;
   this->PluginInfo.UpdateGUI = 0;
+  this->PluginInfo.SetBuffer = 0;
+  this->PluginInfo.GetBuffer = 0;
+  this->PluginInfo.AbortFlag = 0;
+  this->PluginInfo.ReportProgress = 0;
+  this->PluginInfo.GetSeriesVolume = 0;
+  this->PluginInfo.ReleaseSeriesVolume = 0;
 
 
   this->ResultingComponentsAreIndependent = -1;
@@ -298,12 +479,25 @@ vtkVVPlugin::~vtkVVPlugin()
 {
   int i;
 
+  delete this->SeriesCache;
+//BTX
+#ifdef KWVolView_PLUGINS_USE_SERIES
+  delete this->SeriesRequest;
+#endif
+//ETX
+
   // Free all of the widgets
   this->DocLabel->Delete();
   this->DocText->Delete();
   this->ReportText->Delete();
   this->StopWatchText->Delete();
 
+  if (this->PreviewCroppedButton)
+    {
+    this->PreviewCroppedButton->Delete();
+    this->PreviewCroppedButton = 0;
+    }
+
   if (this->SecondInputButton)
     {
     this->SecondInputButton->Delete();
@@ -349,7 +543,7 @@ vtkVVPlugin::~vtkVVPlugin()
     this->Widgets = 0;
     }
 
-  if (this->NumberOfGUIItems)
+  if (this->GUIItems)
     {
     for (i = 0; i < this->NumberOfGUIItems; ++i)
       {
@@ -379,6 +573,7 @@ vtkVVPlugin::~vtkVVPlugin()
 
   this->SetName(0);
   this->SetGroup(0);
+  this->SetFileName(0);
   this->SetTerseDocumentation(0);
   this->SetFullDocumentation(0);
   
@@ -449,6 +644,12 @@ vtkVVPlugin::~vtkVVPlugin()
   this->PluginInfo.GetGUIProperty = 0;
   this->PluginInfo.ProcessData = 0;
   this->PluginInfo.UpdateGUI = 0;
+  this->PluginInfo.SetBuffer = 0;
+  this->PluginInfo.GetBuffer = 0;
+  this->PluginInfo.AbortFlag = 0;
+  this->PluginInfo.ReportProgress = 0;
+  this->PluginInfo.GetSeriesVolume = 0;
+  this->PluginInfo.ReleaseSeriesVolume = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -460,6 +661,7 @@ void vtkVVPlugin::UpdateEnableState()
   this->PropagateEnableState(this->DocText);
   this->PropagateEnableState(this->ReportText);
   this->PropagateEnableState(this->StopWatchText);
+  this->PropagateEnableState(this->PreviewCroppedButton);
 
   if (this->Widgets)
     {
@@ -525,6 +727,159 @@ extern "C"
   }
 }
 
+//----------------------------------------------------------------------------
+// the buffers are shared by all the plugins and kept until the application
+// exits or ClearSharedBuffers() is called
+static vtkVVPluginBufferStore vtkVVPluginSharedBuffers;
+
+extern "C" 
+{
+  int vtkVVPluginSetBuffer(void *vtkNotUsed(inf), const char *key, 
+                           const void *data, size_t size)
+  {
+    return vtkVVPluginSharedBuffers.Set(key, data, size);
+  }
+
+  const void *vtkVVPluginGetBuffer(void *vtkNotUsed(inf), const char *key, 
+                                   size_t *size)
+  {
+    return vtkVVPluginSharedBuffers.Get(key, size);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPlugin::ClearSharedBuffers()
+{
+  vtkVVPluginSharedBuffers.Clear();
+}
+
+//----------------------------------------------------------------------------
+// the execution trace of the session (see VVP_TRACE_BUFFER), rewritten
+// after each execution to the file named by VV_PLUGIN_TRACE
+static vtkstd::string vtkVVPluginTraceEvents;
+
+static const char *vtkVVPluginGetTraceFileName()
+{
+  const char *fileName = getenv("VV_PLUGIN_TRACE");
+  return fileName && *fileName ? fileName : NULL;
+}
+
+static void vtkVVPluginWriteTrace(const char *fileName, const char *name,
+                                  vtkImageData *input, 
+                                  double start, double end, int aborted)
+{
+  // the event of the whole execution, the plugin ones nest inside
+  vtkstd::string event = "{\"name\":\"";
+  const char *c;
+  for (c = name ? name : ""; *c; ++c)
+    {
+    if (*c == '"' || *c == '\\')
+      {
+      event += '\\';
+      }
+    event += *c;
+    }
+  int *dim = input->GetDimensions();
+  char buf[512];
+  sprintf(buf, "\",\"cat\":\"plugin\",\"ph\":\"X\",\"ts\":%.0f,"
+          "\"dur\":%.0f,\"pid\":1,\"tid\":0,\"args\":{"
+          "\"dimensions\":\"%dx%dx%d\",\"type\":\"%s\","
+          "\"components\":%d,\"aborted\":%d}}",
+          start * 1e6, (end - start) * 1e6, dim[0], dim[1], dim[2],
+          input->GetScalarTypeAsString(), 
+          input->GetNumberOfScalarComponents(), aborted);
+  event += buf;
+
+  size_t size = 0;
+  const char *events = static_cast<const char *>(
+    vtkVVPluginSharedBuffers.Get(VVP_TRACE_BUFFER, &size));
+  if (size)
+    {
+    event += ",";
+    event.append(events, size);
+    }
+  vtkVVPluginSharedBuffers.Set(VVP_TRACE_BUFFER, NULL, 0);
+
+  if (!vtkVVPluginTraceEvents.empty())
+    {
+    vtkVVPluginTraceEvents += ",\n";
+    }
+  vtkVVPluginTraceEvents += event;
+
+  FILE *fp = fopen(fileName, "w");
+  if (fp)
+    {
+    fprintf(fp, "{\"traceEvents\":[\n%s\n],\"displayTimeUnit\":\"ms\"}\n", 
+            vtkVVPluginTraceEvents.c_str());
+    fclose(fp);
+    }
+}
+
+//----------------------------------------------------------------------------
+// the memory planner, it keeps what the previous runs of each plugin
+// really used, see vtkVVPlugin::PlanExecution()
+static vtkVVPluginMemoryPlanner vtkVVPluginMemoryPlans;
+
+// Get the resident memory of the process and its peak, in bytes. Return 0
+// if they are not known on this platform.
+static int vtkVVPluginGetProcessMemory(double *resident, double *peak)
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    {
+    return 0;
+    }
+  *resident = (double)pmc.WorkingSetSize;
+  *peak = (double)pmc.PeakWorkingSetSize;
+  return 1;
+#elif defined(__linux__)
+  FILE *fp = fopen("/proc/self/status", "r");
+  if (!fp)
+    {
+    return 0;
+    }
+  char line[256];
+  double kb;
+  int found = 0;
+  while (fgets(line, sizeof(line), fp))
+    {
+    if (sscanf(line, "VmRSS: %lf", &kb) == 1)
+      {
+      *resident = kb*1024;
+      found |= 1;
+      }
+    else if (sscanf(line, "VmHWM: %lf", &kb) == 1)
+      {
+      *peak = kb*1024;
+      found |= 2;
+      }
+    }
+  fclose(fp);
+  return found == 3;
+#else
+  (void)resident;
+  (void)peak;
+  return 0;
+#endif
+}
+
+// Bring the peak memory of the process down to its resident memory, so
+// that the next peak measures the next run only. Return 0 if it is not
+// supported, the peak then only tells about runs beyond the previous ones.
+static int vtkVVPluginResetPeakMemory()
+{
+#ifdef __linux__
+  FILE *fp = fopen("/proc/self/clear_refs", "w");
+  if (fp)
+    {
+    int ok = fputs("5", fp) >= 0;
+    ok = !fclose(fp) && ok;
+    return ok;
+    }
+#endif
+  return 0;
+}
 
 extern "C" 
 {
@@ -539,18 +894,121 @@ extern "C"
       {
       progress = self->ProgressMinimum + 
         (self->ProgressMaximum - self->ProgressMinimum)*progress;
-      self->GetWindow()->GetProgressGauge()->SetValue(
-        static_cast<int>(100.0*progress));
-      if (progress >= 1.0)
+      // refreshing the gauge and processing the Tk events is far more
+      // expensive than the work done between two calls by most plugins,
+      // do it at a fixed rate (the final call always goes through)
+      double now = vtkTimerLog::GetUniversalTime();
+      if (progress < 1.0 && 
+          now - self->LastProgressRefresh < 1.0/VTK_VV_PLUGIN_PROGRESS_RATE &&
+          now >= self->LastProgressRefresh)
+        {
+        return;
+        }
+      self->LastProgressRefresh = now;
+
+      // in the background, leave the GUI to its own thread
+      if (self->MessageQueue)
         {
-        self->GetWindow()->GetProgressGauge()->SetValue(static_cast<int>(0.0));
+        self->MessageQueue->Post(
+          vtkVVPluginMessageQueue::Progress, progress, msg);
+        return;
         }
-      self->GetWindow()->SetStatusText(msg);
+      self->ShowProgress(progress, msg);
       self->GetWindow()->GetApplication()->ProcessPendingEvents();
       }
   }
 }
 
+extern "C" 
+{
+  int vtkVVPluginReportProgress(void *inf, float progress, const char *msg)
+  {
+    // the rate is limited by vtkVVPluginUpdateProgress
+    vtkVVPluginInfo *info = (vtkVVPluginInfo *)inf;
+    info->UpdateProgress(inf, progress, msg);
+    return *info->AbortFlag;
+  }
+}
+
+extern "C" 
+{
+  const void *vtkVVPluginGetSeriesVolume(void *inf, int volume)
+  {
+    vtkVVPluginInfo *info = (vtkVVPluginInfo *)inf;
+    vtkVVPlugin *self = (vtkVVPlugin *)info->Self;
+    return self->SeriesCache->Acquire(volume);
+  }
+
+  void vtkVVPluginReleaseSeriesVolume(void *inf, int volume)
+  {
+    vtkVVPluginInfo *info = (vtkVVPluginInfo *)inf;
+    vtkVVPlugin *self = (vtkVVPlugin *)info->Self;
+    self->SeriesCache->Release(volume);
+  }
+}
+
+//BTX
+#ifdef KWVolView_PLUGINS_USE_SERIES
+//----------------------------------------------------------------------------
+// the file the volumes of a series handed out one at a time are paged to,
+// named by VV_PLUGIN_SERIES_SCRATCH (they are kept in memory otherwise)
+static const char *vtkVVPluginGetSeriesScratchFileName()
+{
+  const char *fileName = getenv("VV_PLUGIN_SERIES_SCRATCH");
+  return fileName && *fileName ? fileName : NULL;
+}
+
+//----------------------------------------------------------------------------
+int vtkVVPlugin::ReadSeriesVolume(void *self, int volume, 
+                                  void *buffer, size_t size)
+{
+  vtkVVPlugin *plugin = static_cast<vtkVVPlugin *>(self);
+  vtkImageData *image = 
+    plugin->SeriesInputOpenWizard->GetSeriesOutput(volume);
+  if (!image || !image->GetScalarPointer() ||
+      (size_t)image->GetNumberOfPoints()*image->GetScalarSize()*
+      image->GetNumberOfScalarComponents() != size)
+    {
+    return 0;
+    }
+  memcpy(buffer, image->GetScalarPointer(), size);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkVVPlugin::RequestSeriesVolume(void *self, int volume, 
+                                     void *buffer, size_t size)
+{
+  vtkVVPlugin *plugin = static_cast<vtkVVPlugin *>(self);
+
+  // not running in the background, this is the GUI thread
+  if (!plugin->MessageQueue)
+    {
+    return vtkVVPlugin::ReadSeriesVolume(self, volume, buffer, size);
+    }
+
+  // the SeriesCache asks with its own lock held, one volume at a time
+  vtkVVPluginSeriesRequest *request = plugin->SeriesRequest;
+  request->Lock->Lock();
+  while (request->Pending)
+    {
+    request->Done->Wait(request->Lock);
+    }
+  request->Volume = volume;
+  request->Buffer = buffer;
+  request->Size = size;
+  request->Pending = 1;
+  while (request->Pending)
+    {
+    request->Done->Wait(request->Lock);
+    }
+  int result = request->Result;
+  request->Lock->Unlock();
+  return result;
+}
+#endif
+//ETX
+
 extern "C" 
 {
   void  vtkVVPluginAssignPolygonalData(void *inf, vtkVVProcessDataStruct *pds)
@@ -627,6 +1085,11 @@ extern "C"
 //----------------------------------------------------------------------------
 void vtkVVPlugin::SetProperty(int param, const char *value)
 {
+  if (this->RecordingDescription && param != VVP_ERROR && value)
+    {
+    this->Description.push_back(vtkstd::make_pair(param, vtkstd::string(value)));
+    }
+
   switch (param)
     {
     case VVP_ERROR:
@@ -657,6 +1120,9 @@ void vtkVVPlugin::SetProperty(int param, const char *value)
     case VVP_SUPPORTS_PROCESSING_SERIES_BY_VOLUMES:
       this->SupportProcessingSeriesByVolumes = atoi(value);
       break;
+    case VVP_SUPPORTS_PAGED_SERIES_INPUT:
+      this->SupportPagedSeriesInput = atoi(value);
+      break;
 #endif
 //ETX
     case VVP_NUMBER_OF_GUI_ITEMS:
@@ -675,11 +1141,37 @@ void vtkVVPlugin::SetProperty(int param, const char *value)
     case VVP_PER_VOXEL_MEMORY_REQUIRED:
       this->PerVoxelMemoryRequired = atof(value);
       break;
+    case VVP_PER_VOXEL_STAGE_MEMORY:
+      {
+      // only the largest stage matters
+      this->PerVoxelStageMemory = 0;
+      const char *c = value;
+      char *end;
+      double stage = strtod(c, &end);
+      while (end != c)
+        {
+        if (stage > this->PerVoxelStageMemory)
+          {
+          this->PerVoxelStageMemory = (float)stage;
+          }
+        c = end;
+        stage = strtod(c, &end);
+        }
+      }
+      break;
     case VVP_ABORT_PROCESSING:
       this->AbortProcessing = atoi(value);
       break;
     case VVP_REPORT_TEXT:
-      this->SetReportText(value);
+      if (this->MessageQueue)
+        {
+        this->MessageQueue->Post(
+          vtkVVPluginMessageQueue::ReportText, 0, value);
+        }
+      else
+        {
+        this->SetReportText(value);
+        }
       break;
     case VVP_REQUIRES_SECOND_INPUT:
       this->RequiresSecondInput = atoi(value);
@@ -743,8 +1235,15 @@ void vtkVVPlugin::SetProperty(int param, const char *value)
 //----------------------------------------------------------------------------
 const char *vtkVVPlugin::GetProperty(int param)
 {
-  vtkVVDataItemVolume *volume_data = vtkVVDataItemVolume::SafeDownCast(
-                                  this->Window->GetSelectedDataItem());
+  // while executing, the plugin may run in its own thread and another item
+  // may be selected: answer for the item being processed, without going
+  // through the window
+  vtkVVDataItemVolume *volume_data = this->ExecutingDataItem;
+  if (!volume_data)
+    {
+    volume_data = vtkVVDataItemVolume::SafeDownCast(
+      this->Window->GetSelectedDataItem());
+    }
   switch (param)
     {
     case VVP_NAME:
@@ -786,7 +1285,8 @@ const char *vtkVVPlugin::GetProperty(int param)
       break;
       
     case VVP_INPUT_COMPONENTS_ARE_INDEPENDENT:
-      if (volume_data->GetVolumeProperty()->GetIndependentComponents())
+      if (!volume_data || 
+          volume_data->GetVolumeProperty()->GetIndependentComponents())
         {
         return "1";
         }
@@ -796,19 +1296,19 @@ const char *vtkVVPlugin::GetProperty(int param)
         }
       break;
     case VVP_INPUT_DISTANCE_UNITS:
-      return volume_data->GetDistanceUnits();
+      return volume_data ? volume_data->GetDistanceUnits() : NULL;
       break;
     case VVP_INPUT_COMPONENT_1_UNITS:
-      return volume_data->GetScalarUnits(0);
+      return volume_data ? volume_data->GetScalarUnits(0) : NULL;
       break;
     case VVP_INPUT_COMPONENT_2_UNITS:
-      return volume_data->GetScalarUnits(1);
+      return volume_data ? volume_data->GetScalarUnits(1) : NULL;
       break;
     case VVP_INPUT_COMPONENT_3_UNITS:
-      return volume_data->GetScalarUnits(2);
+      return volume_data ? volume_data->GetScalarUnits(2) : NULL;
       break;
     case VVP_INPUT_COMPONENT_4_UNITS:
-      return volume_data->GetScalarUnits(3);
+      return volume_data ? volume_data->GetScalarUnits(3) : NULL;
       break;
 
       // these values may change as the second input is changed
@@ -921,6 +1421,10 @@ void vtkVVPlugin::SetGUIProperty(int gui, int param, const char *value)
         {
         gi->GUIType = VV_GUI_CHECKBOX;
         }
+      if (!strcmp(value,VVP_GUI_ENTRY))
+        {
+        gi->GUIType = VV_GUI_ENTRY;
+        }
       break;
     }
 }
@@ -964,6 +1468,9 @@ const char *vtkVVPlugin::GetGUIProperty(int gui, int param)
         case VV_GUI_CHECKBOX:
           return VVP_GUI_CHECKBOX;
           break;
+        case VV_GUI_ENTRY:
+          return VVP_GUI_ENTRY;
+          break;
         }
       break;
     }
@@ -1068,13 +1575,23 @@ int vtkVVPlugin::Load(const char *path, vtkKWApplication *app)
     this->PluginInfo.GetProperty = vtkVVPluginGetProperty;
     this->PluginInfo.SetGUIProperty = vtkVVPluginSetGUIProperty;
     this->PluginInfo.GetGUIProperty = vtkVVPluginGetGUIProperty;
+    this->PluginInfo.SetBuffer = vtkVVPluginSetBuffer;
+    this->PluginInfo.GetBuffer = vtkVVPluginGetBuffer;
+    this->PluginInfo.AbortFlag = &this->AbortProcessing;
+    this->PluginInfo.ReportProgress = vtkVVPluginReportProgress;
+    this->PluginInfo.GetSeriesVolume = vtkVVPluginGetSeriesVolume;
+    this->PluginInfo.ReleaseSeriesVolume = vtkVVPluginReleaseSeriesVolume;
 //BTX
 #ifdef KWVolView_PLUGINS_USE_SPLINE
     this->PluginInfo.AssignPolygonalData = vtkVVPluginAssignPolygonalData;
 #endif
 //ETX
     this->PluginInfo.magic1 = VV_PLUGIN_API_VERSION;
+    this->SetFileName(path);
+    this->Description.clear();
+    this->RecordingDescription = 1;
     (*initFunction)(&this->PluginInfo);
+    this->RecordingDescription = 0;
     // a plugin will set magic1 to the plugin API it was compiled with
     // if it can work, otherwise zero. By default the rule is that a
     // plugin will assume that it will work with future API versions.
@@ -1103,11 +1620,52 @@ int vtkVVPlugin::Load(const char *path, vtkKWApplication *app)
         this->GUIItems[i].Value = 0;
         }
       }
+    this->Loaded = 1;
     return 0;
     }
   return 2;
 }
 
+//----------------------------------------------------------------------------
+void vtkVVPlugin::LoadDescription(
+  const char *path, const vtkVVPluginManifest::PropertiesType &properties)
+{
+  this->SetFileName(path);
+  this->SetGroup(VTK_VV_PLUGIN_DEFAULT_GROUP);
+  vtkVVPluginManifest::PropertiesType::const_iterator it;
+  for (it = properties.begin(); it != properties.end(); ++it)
+    {
+    this->SetProperty(it->first, it->second.c_str());
+    }
+  this->Description = properties;
+}
+
+//----------------------------------------------------------------------------
+int vtkVVPlugin::EnsureLoaded(vtkKWApplication *app)
+{
+  if (!this->Loaded)
+    {
+    if (!this->FileName)
+      {
+      return 1;
+      }
+    // Init sets the same properties again, the GUI items are allocated
+    vtkstd::string path = this->FileName;
+    int res = this->Load(path.c_str(), app);
+    if (res)
+      {
+      return res;
+      }
+    }
+
+  // the widget of a plugin is created the first time it is shown
+  if (!this->IsCreated() && this->GetParent())
+    {
+    this->Create();
+    }
+  return 0;
+}
+
 //----------------------------------------------------------------------------
 void vtkVVPlugin::CreateWidget()
 {
@@ -1188,6 +1746,17 @@ void vtkVVPlugin::CreateWidget()
                    this->Widgets[2*i+1]->GetWidgetName(), row++);
       }
       break;
+      case VV_GUI_ENTRY:
+      {
+      vtkKWEntryWithLabel *s = vtkKWEntryWithLabel::New();
+      s->SetParent(this);
+      s->Create();
+      s->SetLabelPositionToTop();
+      this->Widgets[2*i+1] = s;
+      this->Script("grid %s -sticky nsew -row %i -column 0 -columnspan 2",
+                   this->Widgets[2*i+1]->GetWidgetName(), row++);
+      }
+      break;
       }
     }
 
@@ -1269,6 +1838,23 @@ void vtkVVPlugin::CreateWidget()
 
   this->SetStopWatchText("");
 
+  if (this->CanBePreviewed())
+    {
+    this->PreviewCroppedButton = vtkKWCheckButton::New();
+    this->PreviewCroppedButton->SetParent(this);
+    this->PreviewCroppedButton->Create();
+    this->PreviewCroppedButton->SetText("Preview inside the cropping box");
+    this->PreviewCroppedButton->SetSelectedState(
+      this->PreviewMode == VTK_VV_PLUGIN_PREVIEW_CROPPED);
+    this->PreviewCroppedButton->SetCommand(this, "PreviewCroppedCallback");
+    this->PreviewCroppedButton->SetBalloonHelpString(
+      "Preview the plugin at full resolution inside the cropping box, "
+      "instead of on a downsampled copy of the whole data.");
+
+    this->Script("grid %s -sticky nsw -row %i -column 0 -columnspan 2 -pady 1",
+                 this->PreviewCroppedButton->GetWidgetName(), row++);
+    }
+
   // Update
   this->Update();
   // set the initial values for each GUI component ...
@@ -1301,6 +1887,13 @@ void vtkVVPlugin::CreateWidget()
       s->SetSelectedState(atoi(this->GUIItems[i].Default));
       }
       break;
+      case VV_GUI_ENTRY:
+      {
+      vtkKWEntryWithLabel *s = 
+        vtkKWEntryWithLabel::SafeDownCast(this->Widgets[2*i+1]);
+      s->GetWidget()->SetValue(this->GUIItems[i].Default);
+      }
+      break;
       }
     }
 }
@@ -1653,9 +2246,32 @@ char* vtkVVPlugin::GetStopWatchText()
   return this->StopWatchText->GetWidget()->GetText();
 }
 
+//----------------------------------------------------------------------------
+void vtkVVPlugin::ShowProgress(float progress, const char *msg)
+{
+  if (!this->Window || !this->Window->GetProgressGauge())
+    {
+    return;
+    }
+  this->Window->GetProgressGauge()->SetValue(static_cast<int>(100.0*progress));
+  if (progress >= 1.0)
+    {
+    this->Window->GetProgressGauge()->SetValue(0);
+    }
+  this->Window->SetStatusText(msg);
+}
+
 //----------------------------------------------------------------------------
 void vtkVVPlugin::Update()
 {
+  // The plugin running in the background uses the info of its data, it is
+  // updated once done
+
+  if (this->MessageQueue)
+    {
+    return;
+    }
+
   // Update enable state
 
   this->UpdateEnableState();
@@ -1678,6 +2294,12 @@ void vtkVVPlugin::Update()
 //----------------------------------------------------------------------------
 void vtkVVPlugin::UpdateData(vtkImageData *input)
 {
+  // nothing to update until the library is loaded, see EnsureLoaded()
+  if (!this->Loaded)
+    {
+    return;
+    }
+
   // update the markers if available
   if (this->Window)
     {
@@ -1939,6 +2561,17 @@ void vtkVVPlugin::UpdateGUI()
         }
       }
       break;
+      case VV_GUI_ENTRY:
+      {
+      vtkKWEntryWithLabel *s = 
+        vtkKWEntryWithLabel::SafeDownCast(this->Widgets[2*i+1]);
+      s->SetLabelText(this->GUIItems[i].Label);
+      if (this->GUIItems[i].Help)
+        {
+        s->SetBalloonHelpString(this->GUIItems[i].Help);
+        }
+      }
+      break;
       }
     }
 }
@@ -1980,6 +2613,13 @@ void vtkVVPlugin::GetGUIValues()
       this->SetGUIProperty(i, VVP_GUI_VALUE, tmp);
       }
       break;
+      case VV_GUI_ENTRY:
+      {
+      vtkKWEntryWithLabel *s = 
+        vtkKWEntryWithLabel::SafeDownCast(this->Widgets[2*i+1]);
+      this->SetGUIProperty(i, VVP_GUI_VALUE, s->GetWidget()->GetValue());
+      }
+      break;
       }
     }
 }
@@ -2021,6 +2661,13 @@ void vtkVVPlugin::SetGUIValues()
       s->SetSelectedState(atoi(this->GUIItems[i].Value));
       }
       break;
+      case VV_GUI_ENTRY:
+      {
+      vtkKWEntryWithLabel *s = 
+        vtkKWEntryWithLabel::SafeDownCast(this->Widgets[2*i+1]);
+      s->GetWidget()->SetValue(this->GUIItems[i].Value);
+      }
+      break;
       }
     }
 }
@@ -2029,18 +2676,12 @@ void vtkVVPlugin::SetGUIValues()
 // return 0 if there is not enough memory
 // return 1 if there is enough memory but do not keep the input
 // return 2 if there is enough memory and you can keep the input
-int vtkVVPlugin::CheckMemory(vtkImageData *input)
+int vtkVVPlugin::PlanExecution(vtkImageData *input,
+                               vtkVVPluginSelector *plugins)
 {
-  int *dim = input->GetDimensions();
+  this->PlannedPeakMemory = 0;
+  this->PlannedUndoMemory = 0;
 
-  // how much memory do we need
-  // compute in size as voxels for now 
-  vtkLargeInteger inSize;
-  int *ext = input->GetExtent();
-  inSize = (ext[1]-ext[0]);
-  inSize *= (ext[3]-ext[2]); 
-  inSize *= (ext[5]-ext[4]);
-  
   int outVolScalarSize = 1;
   switch (this->PluginInfo.OutputVolumeScalarType)
     {
@@ -2064,153 +2705,132 @@ int vtkVVPlugin::CheckMemory(vtkImageData *input)
       break;
     }
 
-  vtkLargeInteger outSize;
-  outSize = this->PluginInfo.OutputVolumeDimensions[0];
-  outSize *= this->PluginInfo.OutputVolumeDimensions[1]; 
-  outSize *= this->PluginInfo.OutputVolumeDimensions[2];
-  outSize *= this->PluginInfo.OutputVolumeNumberOfComponents;
-  outSize *= outVolScalarSize;
-
-  // how much intermediate space is required
-  vtkLargeInteger plugSize;
-  // special handling for float, we get one decimal of precision
-  // PerVoxelMemory Required is bytes per voxel
-  plugSize = inSize/ 10;
-  plugSize = plugSize * (int)(10*this->PerVoxelMemoryRequired);
-
-  // now make inSize in bytes not voxels
-  inSize *= input->GetNumberOfScalarComponents();
-  inSize *= input->GetScalarSize();
+  // what the run involves
+  int *dim = input->GetDimensions();
+  int *outDim = this->PluginInfo.OutputVolumeDimensions;
+  double voxels = (double)dim[0]*dim[1]*dim[2];
+  int sameLayout = 
+    outDim[0] == dim[0] && outDim[1] == dim[1] && outDim[2] == dim[2] &&
+    this->PluginInfo.OutputVolumeScalarType == input->GetScalarType() &&
+    this->PluginInfo.OutputVolumeNumberOfComponents == 
+    input->GetNumberOfScalarComponents();
 
-  vtkKWProcessStatistics *pr = vtkKWProcessStatistics::New();
-  long av = pr->GetAvailableVirtualMemory();
-  long ap = pr->GetAvailablePhysicalMemory();
-  long tv = pr->GetTotalVirtualMemory();
-  long tp = pr->GetTotalPhysicalMemory();
-  
-  pr->Delete();
-  // if we received bogus results from pr just return
-  if ( av < 0 || ap < 0 || tv < 0 || tp < 0 )
-    {
-    // assume everything is OK
-    return 2;
+  vtkVVPluginMemoryPlanner::RequestType req;
+  req.InputBytes = 
+    voxels*input->GetNumberOfScalarComponents()*input->GetScalarSize();
+  req.OutputBytes = (double)outDim[0]*outDim[1]*outDim[2]*
+    this->PluginInfo.OutputVolumeNumberOfComponents*outVolScalarSize;
+  req.IntermediateBytes = voxels*(this->PerVoxelStageMemory > 0 ? 
+    this->PerVoxelStageMemory : this->PerVoxelMemoryRequired);
+  req.Slices = dim[2];
+  req.RequiredZOverlap = this->RequiredZOverlap;
+  req.CanRunInPlace = this->SupportInPlaceProcessing && sameLayout;
+  req.CanRunInPieces = this->SupportProcessingPieces && sameLayout;
+  req.SeriesVolumeBytes = 0;
+  req.SeriesVolumes = 0;
+  req.CanRunSeriesByVolumes = 0;
+  // the compressed copy of the input SaveUndoData() keeps, which stops at
+  // the undo memory budget
+  req.UndoBytes = 0;
+  if (!this->RequiresLabelInput && plugins->GetUndoMemoryBudget() > 0)
+    {
+    double budget = 1024.0*1024.0*plugins->GetUndoMemoryBudget();
+    req.UndoBytes = (double)vtkVVPluginUndoStack::GetMaximumSnapshotSize(
+      dim, input->GetNumberOfScalarComponents()*input->GetScalarSize());
+    req.UndoBytes = req.UndoBytes > budget ? budget : req.UndoBytes;
     }
-  
 //BTX
 #ifdef KWVolView_PLUGINS_USE_SERIES
   if (this->RequiresSeriesInput)
     {
-    vtkLargeInteger seriesOneVolumeSize = this->PluginInfo.InputVolumeSeriesScalarSize;
-    seriesOneVolumeSize = 
-      seriesOneVolumeSize * this->PluginInfo.InputVolumeSeriesNumberOfComponents;
-    for(int k=0; k<3; k++)
-      {
-      seriesOneVolumeSize = 
-        seriesOneVolumeSize * this->PluginInfo.InputVolumeSeriesDimensions[k];
-      }
-    if(this->SupportProcessingSeriesByVolumes)
-      {
-      plugSize = inSize + seriesOneVolumeSize;
-      }
-    else
-      {
-      vtkLargeInteger seriesTotalSize = 
-        seriesOneVolumeSize * this->PluginInfo.InputVolumeSeriesNumberOfVolumes; 
-      plugSize = inSize + seriesTotalSize;
-      }
+    req.SeriesVolumeBytes = 
+      (double)this->PluginInfo.InputVolumeSeriesScalarSize *
+      this->PluginInfo.InputVolumeSeriesNumberOfComponents *
+      this->PluginInfo.InputVolumeSeriesDimensions[0] *
+      this->PluginInfo.InputVolumeSeriesDimensions[1] *
+      this->PluginInfo.InputVolumeSeriesDimensions[2];
+    req.SeriesVolumes = this->PluginInfo.InputVolumeSeriesNumberOfVolumes;
+    req.CanRunSeriesByVolumes = this->SupportProcessingSeriesByVolumes;
     }
 #endif
 //ETX
 
-  // how much memory do we need to run the plugin? There are a few different
-  // options on how the plugin can be run.
-  vtkLargeInteger runSize;
-  vtkLargeInteger runPiecesSize;
-  vtkLargeInteger runInPlaceSize;
-  
-  runSize = outSize + plugSize;
-  runPiecesSize = outSize + plugSize;
-  runPiecesSize *= 2;
-  runInPlaceSize = outSize + plugSize;
-  runInPlaceSize *= 2;
-  
-  // is the plugin is in place then we can ignore outSize
-  if (this->SupportInPlaceProcessing)
-    {
-    runInPlaceSize = plugSize;
-    }
-  
-  if (this->SupportProcessingPieces && 
-      this->PluginInfo.OutputVolumeDimensions[0] == dim[0] &&
-      this->PluginInfo.OutputVolumeDimensions[1] == dim[1] &&
-      this->PluginInfo.OutputVolumeDimensions[2] == dim[2] &&
-      this->PluginInfo.OutputVolumeScalarType == input->GetScalarType() &&
-      this->PluginInfo.OutputVolumeNumberOfComponents == 
-      input->GetNumberOfScalarComponents())
-    {
-    // ten pieces = 1/10 (then divide by 10 to handle floats)
-    runPiecesSize = inSize / 100;
-    runPiecesSize = runPiecesSize * (int)(10*this->PerVoxelMemoryRequired);
-    // two output buffers each at 1/10 = 1/5
-    runPiecesSize = outSize/5 + runPiecesSize;
-    }
+  vtkKWProcessStatistics *pr = vtkKWProcessStatistics::New();
+  long av = pr->GetAvailableVirtualMemory();
+  long ap = pr->GetAvailablePhysicalMemory();
+  long tv = pr->GetTotalVirtualMemory();
+  long tp = pr->GetTotalPhysicalMemory();
+  pr->Delete();
 
+  double calibration = vtkVVPluginMemoryPlans.GetCalibration(this->GetName());
 
-  // convert into K
-  runSize = runSize / 1000;
-  runInPlaceSize = runInPlaceSize / 1000;
-  runPiecesSize = runPiecesSize / 1000;
-  inSize = inSize / 1000;
-  outSize = outSize / 1000;
-  plugSize = plugSize / 1000;
+  // if we received bogus results from pr, assume everything is OK
+  if ( av < 0 || ap < 0 || tv < 0 || tp < 0 )
+    {
+    this->PlannedPeakMemory = vtkVVPluginMemoryPlanner::Estimate(
+      req, vtkVVPluginMemoryPlanner::OnePieceWithUndo, calibration).PeakBytes;
+    return vtkVVPluginMemoryPlanner::OnePieceWithUndo;
+    }
 
-  // now what is the deal, do we have enough memory?   
-  if ( runSize.CastToUnsignedLong() <= .5 * tp &&
-       runSize.CastToUnsignedLong() <= .8 * av)
+  // the statistics are in KB
+  vtkVVPluginMemoryPlanner::PlanType plan = vtkVVPluginMemoryPlanner::Plan(
+    req, 1024.0*av, 1024.0*tp, calibration);
+  this->PlannedPeakMemory = plan.PeakBytes;
+  if (plan.Strategy != vtkVVPluginMemoryPlanner::OnePieceWithUndo && 
+      plan.Undo)
     {
-    // everything is OK and we can keep the input
-    return 2;
+    this->PlannedUndoMemory = req.UndoBytes;
     }
-  
-  // we can't fit the input and the output easily Can we do it at all? This
-  // requires pieces or InPlace processing
-  if ( runPiecesSize.CastToUnsignedLong() < .9*av ||
-       runInPlaceSize.CastToUnsignedLong() < .9*av )
+  if (plan.Fits)
     {
+    if (plan.Strategy == vtkVVPluginMemoryPlanner::OnePieceWithUndo)
+      {
+      return plan.Strategy;
+      }
     if (vtkKWMessageDialog::PopupYesNo( 
           this->GetApplication(), this->Window, "Apply Plugin",
+          plan.Undo ?
+          "Applying this plugin to your data will require most of your "
+          "computer's memory. This could result in reduced performance "
+          "of VolView. Only a compressed copy of your data is kept to "
+          "Undo this operation, which is lost if it does not fit in the "
+          "memory set aside for Undo. Do you wish to continue?" :
           "Applying this plugin to your data will require most of your "
           "computer's memory. This could result in reduced performance "
           "of VolView. Due to the memory limits you will not be able to "
           "Undo this operation. Do you wish to continue?"
           , vtkKWMessageDialog::WarningIcon ) )
       {
-      return 1;
-      }
-    else
-      {
-      return 0;
+      return plan.Strategy;
       }
+    return vtkVVPluginMemoryPlanner::None;
     }
 
   // no way to load the data
+  double mb = 1024.0*1024.0;
+  vtkVVPluginMemoryPlanner::PlanType inPlace = vtkVVPluginMemoryPlanner::
+    Estimate(req, vtkVVPluginMemoryPlanner::InPlace, calibration);
+  vtkVVPluginMemoryPlanner::PlanType pieces = vtkVVPluginMemoryPlanner::
+    Estimate(req, vtkVVPluginMemoryPlanner::Pieces, calibration);
   char buffer[1024];
-  sprintf(buffer, "Applying this plugin to your data will NOT fit in your system memory. Please close some applications, increase the amount of swap space, or increase the amount of memory in the computer.\n\nNote: your available memory was estimated at %ld MB (physical or virtual), running this plugin will require %ld MB, in place %ld MB (%s supported), in pieces %ld MB (%s supported). Should this estimation be way off, you can attempt to ignore this message, but be aware that this application may crash.", 
+  sprintf(buffer, "Applying this plugin to your data will NOT fit in your system memory. Please close some applications, increase the amount of swap space, or increase the amount of memory in the computer.\n\nNote: your available memory was estimated at %ld MB (physical or virtual), running this plugin will require %.0f MB, in place %.0f MB (%s supported), in pieces %.0f MB (%s supported). Should this estimation be way off, you can attempt to ignore this message, but be aware that this application may crash.", 
           ((long)av / (long)1024), 
-          (long)(runSize.CastToLong() / 1024), 
-          (long)(runInPlaceSize.CastToLong() / 1024), 
-          (this->SupportInPlaceProcessing ? "is" : "not"),
-          (long)(runPiecesSize.CastToLong() / 1024),
-          (this->SupportProcessingPieces ? "is" : "not")
+          vtkVVPluginMemoryPlanner::Estimate(
+            req, vtkVVPluginMemoryPlanner::OnePiece, calibration).PeakBytes/mb,
+          inPlace.PeakBytes/mb, 
+          (inPlace.Strategy ? "is" : "not"),
+          pieces.PeakBytes/mb,
+          (pieces.Strategy ? "is" : "not")
     );
   if (vtkKWMessageDialog::PopupYesNo( 
         this->GetApplication(), this->Window, "Apply Plugin",
         buffer, vtkKWMessageDialog::WarningIcon))
     {
-    return 2;
+    // try the way needing the least memory
+    return plan.Strategy;
     }
 
-  return 0;
+  return vtkVVPluginMemoryPlanner::None;
 }
 
 //----------------------------------------------------------------------------
@@ -2529,16 +3149,84 @@ void vtkVVPlugin::Execute(vtkVVPluginSelector *plugins)
     return;
     }
 
-  clock_t start_clock = clock();
+  // Another data item may be selected while the plugin runs, the result
+  // still goes to this one
 
-  vtkVVDataItemVolume *volume_data = vtkVVDataItemVolume::SafeDownCast(
-                                  this->Window->GetSelectedDataItem());
+  vtkVVDataItemVolume *volume_data = plugins->GetActiveDataItem();
   if (!volume_data) return;
+  this->ExecutingDataItem = volume_data;
+
+  // The plugins append to the trace buffer only when it exists
+  const char *traceFileName = vtkVVPluginGetTraceFileName();
+  if (traceFileName)
+    {
+    vtkVVPluginSharedBuffers.Set(VVP_TRACE_BUFFER, "", 0);
+    }
+
+  // Measure the memory used by the run, to correct the next plans
+  this->PlannedPeakMemory = 0;
+  this->PlannedUndoMemory = 0;
+  double resident = 0, peak = 0, end_resident, end_peak;
+  int peak_reset = vtkVVPluginResetPeakMemory();
+  int measured = vtkVVPluginGetProcessMemory(&resident, &peak);
 
   // Execute the plugin
+  unsigned long input_time = volume_data->GetImageData()->GetMTime();
+  double start_time = vtkTimerLog::GetUniversalTime();
   this->ExecuteData(volume_data->GetImageData(), plugins);
+  double end_time = vtkTimerLog::GetUniversalTime();
+
+  // only the plugin is calibrated, not the copy kept for undo
+  if (measured && this->PlannedPeakMemory > 0 && !this->AbortProcessing &&
+      vtkVVPluginGetProcessMemory(&end_resident, &end_peak) &&
+      (peak_reset || end_peak > peak))
+    {
+    vtkVVPluginMemoryPlans.Calibrate(
+      this->GetName(), this->PlannedPeakMemory - this->PlannedUndoMemory, 
+      end_peak - resident - plugins->GetSavedUndoDataSize());
+    }
 
-  clock_t delta = clock() - start_clock;
+  // keep what the plugin changed for undo
+  plugins->CommitUndoData(volume_data->GetImageData());
+
+  // keep the result for the next run with the same settings on the same
+  // data, if it ran to completion
+  vtkVVPluginResultCache *cache = plugins->GetResultCache();
+  if (cache && !this->ResultCacheKey.empty() && !this->AbortProcessing &&
+      volume_data->GetImageData()->GetMTime() != input_time)
+    {
+    vtkVVPluginResultCache::ResultType *result = 
+      cache->NewResult(volume_data->GetImageData());
+    if (result)
+      {
+      const char *units[5] = 
+        {
+        this->ResultingDistanceUnits,
+        this->ResultingComponent1Units, this->ResultingComponent2Units, 
+        this->ResultingComponent3Units, this->ResultingComponent4Units
+        };
+      result->HasDistanceUnits = units[0] ? 1 : 0;
+      result->DistanceUnits = units[0] ? units[0] : "";
+      int i;
+      for (i = 0; i < 4; ++i)
+        {
+        result->HasScalarUnits[i] = units[i + 1] ? 1 : 0;
+        result->ScalarUnits[i] = units[i + 1] ? units[i + 1] : "";
+        }
+      result->IndependentComponents = this->ResultingComponentsAreIndependent;
+      const char *report = this->GetReportText();
+      result->ReportText = report ? report : "";
+      cache->Insert(this->ResultCacheKey, result);
+      }
+    }
+  this->ResultCacheKey = "";
+
+  if (traceFileName)
+    {
+    vtkVVPluginWriteTrace(traceFileName, this->GetName(), 
+                          volume_data->GetImageData(), start_time, end_time, 
+                          this->AbortProcessing);
+    }
 
   // Free the second input if it is required
 
@@ -2553,6 +3241,7 @@ void vtkVVPlugin::Execute(vtkVVPluginSelector *plugins)
 
   if (this->RequiresSeriesInput && this->SeriesInputOpenWizard)
     {
+    this->SeriesCache->Clear();
     this->SeriesInputOpenWizard->Release();
     }
 #endif
@@ -2570,7 +3259,7 @@ void vtkVVPlugin::Execute(vtkVVPluginSelector *plugins)
   // Display how long it took
 
   char buf[100];
-  sprintf(buf, "Done in %0.2f s.", (double)(delta) / (double)CLOCKS_PER_SEC);
+  sprintf(buf, "Done in %0.2f s.", end_time - start_time);
   this->SetStopWatchText(buf);
 
   vtkImageData *inLabelImage = this->GetInputLabelImage();
@@ -2586,6 +3275,7 @@ void vtkVVPlugin::Execute(vtkVVPluginSelector *plugins)
       }
     }
 
+  this->ExecutingDataItem = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -2594,6 +3284,347 @@ void vtkVVPlugin::Cancel(vtkVVPluginSelector *vtkNotUsed(plugins))
   this->SetProperty(VVP_ABORT_PROCESSING,"1");
 }
 
+//----------------------------------------------------------------------------
+int vtkVVPlugin::CanBePreviewed()
+{
+  // the preview only reduces the volume, and leaves the label map alone
+  if (this->RequiresLabelInput || this->RequiresSecondInput ||
+      this->ProducesPlottingOutput)
+    {
+    return 0;
+    }
+//BTX
+#ifdef KWVolView_PLUGINS_USE_SPLINE
+  if (this->ProducesMeshOnly || this->RequiresSplineSurfaces)
+    {
+    return 0;
+    }
+#endif
+#ifdef KWVolView_PLUGINS_USE_SERIES
+  if (this->RequiresSeriesInput || this->ProducesSeriesOutput)
+    {
+    return 0;
+    }
+#endif
+//ETX
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPlugin::PreviewCroppedCallback(int state)
+{
+  this->SetPreviewMode(state ? VTK_VV_PLUGIN_PREVIEW_CROPPED : 
+                       VTK_VV_PLUGIN_PREVIEW_DOWNSAMPLED);
+}
+
+//----------------------------------------------------------------------------
+// the image shown for a preview: 'result', the output of the plugin on
+// 'preview' (the voxels of 'extent' of 'input' every 'factor' voxels),
+// brought back to the resolution of 'input' by repeating its voxels, with
+// 'input' around 'extent' when they have the same scalars. A result of
+// other dimensions is shown as is.
+static vtkImageData *vtkVVPluginNewPreviewDisplay(vtkImageData *input, 
+                                                  vtkImageData *preview,
+                                                  vtkImageData *result,
+                                                  const int extent[6], 
+                                                  int factor)
+{
+  vtkImageData *display = vtkImageData::New();
+  int *rdim = result->GetDimensions();
+  int *pdim = preview->GetDimensions();
+  if (rdim[0] != pdim[0] || rdim[1] != pdim[1] || rdim[2] != pdim[2])
+    {
+    display->ShallowCopy(result);
+    return display;
+    }
+
+  int *dim = input->GetDimensions();
+  display->SetScalarType(result->GetScalarType());
+  display->SetNumberOfScalarComponents(result->GetNumberOfScalarComponents());
+  display->SetSpacing(input->GetSpacing());
+  display->SetOrigin(input->GetOrigin());
+  display->SetDimensions(dim);
+  display->AllocateScalars();
+
+  size_t elem = 
+    display->GetScalarSize()*display->GetNumberOfScalarComponents();
+  unsigned char *dst = static_cast<unsigned char *>(
+    display->GetScalarPointer());
+  if (extent[0] > 0 || extent[1] < dim[0] - 1 || 
+      extent[2] > 0 || extent[3] < dim[1] - 1 || 
+      extent[4] > 0 || extent[5] < dim[2] - 1)
+    {
+    size_t size = elem*dim[0]*dim[1]*dim[2];
+    if (result->GetScalarType() == input->GetScalarType() &&
+        result->GetNumberOfScalarComponents() == 
+        input->GetNumberOfScalarComponents())
+      {
+      memcpy(dst, input->GetScalarPointer(), size);
+      }
+    else
+      {
+      memset(dst, 0, size);
+      }
+    }
+
+  const unsigned char *src = static_cast<const unsigned char *>(
+    result->GetScalarPointer());
+  size_t slice = elem*dim[0]*dim[1];
+  size_t row = elem*(extent[1] - extent[0] + 1);
+  int x, y, z;
+  for (z = extent[4]; z <= extent[5]; z++)
+    {
+    for (y = extent[2]; y <= extent[3]; y++)
+      {
+      unsigned char *out = 
+        dst + elem*(((size_t)z*dim[1] + y)*dim[0] + extent[0]);
+      // the rows made of the same voxels are copies of the first one
+      if ((z - extent[4]) % factor)
+        {
+        memcpy(out, out - slice, row);
+        continue;
+        }
+      if ((y - extent[2]) % factor)
+        {
+        memcpy(out, out - elem*dim[0], row);
+        continue;
+        }
+      const unsigned char *in = src + elem*
+        (((size_t)(z - extent[4])/factor*pdim[1] + 
+          (y - extent[2])/factor)*pdim[0]);
+      for (x = 0; x <= extent[1] - extent[0]; x++)
+        {
+        memcpy(out + elem*x, in + elem*(x/factor), elem);
+        }
+      }
+    }
+  return display;
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPlugin::Preview(vtkVVPluginSelector *plugins)
+{
+  this->SetReportText(NULL);
+
+  if (!this->CanBePreviewed())
+    {
+    this->SetReportText(
+      "This plugin can not be previewed, it has to be applied.");
+    return;
+    }
+
+  if (this->PreparePlugin(plugins))
+    {
+    return;
+    }
+
+  // the preview runs on the data, not on the previous preview
+  plugins->ClearPreview();
+  vtkVVDataItemVolume *volume_data = vtkVVDataItemVolume::SafeDownCast(
+                                  this->Window->GetSelectedDataItem());
+  if (!volume_data || !volume_data->GetImageData())
+    {
+    return;
+    }
+  vtkImageData *input = volume_data->GetImageData();
+
+  // the region of the data to run on, and the subsampling along each axis
+  this->UpdateData(input);
+  int *dim = input->GetDimensions();
+  int extent[6] = { 0, dim[0] - 1, 0, dim[1] - 1, 0, dim[2] - 1 };
+  int factor = 1;
+  int i;
+  if (this->PreviewMode == VTK_VV_PLUGIN_PREVIEW_CROPPED)
+    {
+    // the cropping planes are in world coordinates
+    double *spacing = input->GetSpacing();
+    double *origin = input->GetOrigin();
+    float *planes = this->PluginInfo.CroppingPlanes;
+    for (i = 0; i < 3 && planes; i++)
+      {
+      double lo = (planes[2*i] - origin[i])/spacing[i];
+      double hi = (planes[2*i + 1] - origin[i])/spacing[i];
+      if (lo > hi)
+        {
+        double tmp = lo;
+        lo = hi;
+        hi = tmp;
+        }
+      extent[2*i] = lo <= 0 ? 0 : (lo >= dim[i] ? dim[i] : (int)ceil(lo));
+      extent[2*i + 1] = 
+        hi >= dim[i] - 1 ? dim[i] - 1 : (hi < 0 ? -1 : (int)floor(hi));
+      if (extent[2*i] > extent[2*i + 1])
+        {
+        this->SetReportText(
+          "The cropping box does not contain any voxel to preview.");
+        return;
+        }
+      }
+    }
+  else
+    {
+    int largest = dim[0] > dim[1] ? dim[0] : dim[1];
+    largest = largest > dim[2] ? largest : dim[2];
+    factor = (largest + this->PreviewSize - 1)/this->PreviewSize;
+    }
+  vtkImageData *preview = plugins->GetPreviewInput(volume_data, extent, factor);
+  if (!preview)
+    {
+    return;
+    }
+
+  // run the plugin on the copy in one piece, like on the data
+  vtkVVProcessDataStruct pds;
+  memset(&pds, 0, sizeof(pds));
+  this->AbortProcessing = 0;
+  this->ProgressMinimum = 0;
+  this->ProgressMaximum = 1;
+  this->LastProgressRefresh = 0;
+  this->GetGUIValues();
+  this->UpdateData(preview);
+
+  int *outDim = this->PluginInfo.OutputVolumeDimensions;
+  vtkImageData *result = vtkImageData::New();
+  result->SetScalarType(this->PluginInfo.OutputVolumeScalarType);
+  result->SetNumberOfScalarComponents(
+    this->PluginInfo.OutputVolumeNumberOfComponents);
+  result->SetSpacing(this->PluginInfo.OutputVolumeSpacing[0],
+                     this->PluginInfo.OutputVolumeSpacing[1],
+                     this->PluginInfo.OutputVolumeSpacing[2]);
+  result->SetOrigin(preview->GetOrigin());
+  result->SetDimensions(outDim);
+  result->AllocateScalars();
+
+  pds.inData = preview->GetScalarPointer();
+  pds.outData = result->GetScalarPointer();
+  // for in place plugins copy the input to the output
+  if (this->SupportInPlaceProcessing)
+    {
+    size_t inSize = (size_t)preview->GetScalarSize()*
+      preview->GetNumberOfScalarComponents()*preview->GetNumberOfPoints();
+    size_t outSize = (size_t)result->GetScalarSize()*
+      result->GetNumberOfScalarComponents()*result->GetNumberOfPoints();
+    memcpy(pds.outData, pds.inData, inSize < outSize ? inSize : outSize);
+    }
+  pds.StartSlice = 0;
+  pds.CurrentVolumeFromSeries = 0;
+  pds.NumberOfSlicesToProcess = outDim[2];
+
+  double start_time = vtkTimerLog::GetUniversalTime();
+  int failed = this->PluginInfo.ProcessData(&this->PluginInfo, &pds);
+  double end_time = vtkTimerLog::GetUniversalTime();
+
+  // back to the data, for the final apply
+  this->UpdateData(input);
+  this->GetWindow()->SetStatusText("");
+  this->GetWindow()->GetProgressGauge()->SetValue(0);
+
+  if (failed || this->AbortProcessing)
+    {
+    result->Delete();
+    if (this->AbortProcessing)
+      {
+      this->SetReportText("Plugin preview was canceled!");
+      }
+    return;
+    }
+
+  vtkImageData *display = 
+    vtkVVPluginNewPreviewDisplay(input, preview, result, extent, factor);
+  plugins->ShowPreview(display);
+  display->Delete();
+  result->Delete();
+
+  char buf[100];
+  sprintf(buf, "Preview done in %0.2f s.", end_time - start_time);
+  this->SetStopWatchText(buf);
+}
+
+//----------------------------------------------------------------------------
+// the layout and the fingerprint of a volume, for the result cache key
+static void vtkVVPluginAppendVolumeKey(vtkstd::string &key, 
+                                       vtkImageData *volume, 
+                                       vtkVVPluginResultCache *cache)
+{
+  int *dim = volume->GetDimensions();
+  double *spacing = volume->GetSpacing();
+  double *origin = volume->GetOrigin();
+  vtkTypeUInt64 fingerprint = cache->GetFingerprint(volume);
+  char buf[512];
+  sprintf(buf, "%d %d %d %d %d %.17g %.17g %.17g %.17g %.17g %.17g "
+          "%08lx%08lx\n", volume->GetScalarType(), 
+          volume->GetNumberOfScalarComponents(), dim[0], dim[1], dim[2],
+          spacing[0], spacing[1], spacing[2], origin[0], origin[1], origin[2],
+          (unsigned long)(fingerprint >> 32), 
+          (unsigned long)(fingerprint & 0xffffffffUL));
+  key += buf;
+}
+
+//----------------------------------------------------------------------------
+int vtkVVPlugin::GetResultCacheKey(vtkImageData *input, 
+                                   vtkVVPluginResultCache *cache,
+                                   vtkstd::string &key)
+{
+  // plugins changing the label map or producing more than the volume are
+  // run every time
+  if (this->RequiresLabelInput || this->ProducesPlottingOutput ||
+      (this->RequiresSecondInput && this->SecondInputIsUnstructuredGrid))
+    {
+    return 0;
+    }
+//BTX
+#ifdef KWVolView_PLUGINS_USE_SPLINE
+  if (this->ProducesMeshOnly || this->RequiresSplineSurfaces)
+    {
+    return 0;
+    }
+#endif
+#ifdef KWVolView_PLUGINS_USE_SERIES
+  if (this->RequiresSeriesInput || this->ProducesSeriesOutput)
+    {
+    return 0;
+    }
+#endif
+//ETX
+
+  key = this->GetName() ? this->GetName() : "";
+  key += '\n';
+  key += this->GetGroup() ? this->GetGroup() : "";
+  key += '\n';
+  int i;
+  for (i = 0; i < this->NumberOfGUIItems; ++i)
+    {
+    key += this->GUIItems[i].Value ? this->GUIItems[i].Value : "";
+    key += '\n';
+    }
+  // the seeds and the cropping box the plugin may read
+  char buf[512];
+  for (i = 0; i < this->PluginInfo.NumberOfMarkers; ++i)
+    {
+    float *marker = this->PluginInfo.Markers + 3*i;
+    sprintf(buf, "%.9g %.9g %.9g %u\n", marker[0], marker[1], marker[2],
+            this->PluginInfo.MarkersGroupId ? 
+            (unsigned int)this->PluginInfo.MarkersGroupId[i] : 0);
+    key += buf;
+    }
+  if (this->PluginInfo.CroppingPlanes)
+    {
+    float *planes = this->PluginInfo.CroppingPlanes;
+    sprintf(buf, "%.9g %.9g %.9g %.9g %.9g %.9g\n", planes[0], planes[1],
+            planes[2], planes[3], planes[4], planes[5]);
+    key += buf;
+    }
+  vtkVVPluginAppendVolumeKey(key, input, cache);
+  if (this->RequiresSecondInput && 
+      this->SecondInputOpenWizard && 
+      this->SecondInputOpenWizard->GetOutput(0))
+    {
+    vtkVVPluginAppendVolumeKey(
+      key, this->SecondInputOpenWizard->GetOutput(0), cache);
+    }
+  return 1;
+}
+
 //----------------------------------------------------------------------------
 void vtkVVPlugin::ExecuteData(vtkImageData *input, vtkVVPluginSelector *plugins)
 {
@@ -2614,6 +3645,7 @@ void vtkVVPlugin::ExecuteData(vtkImageData *input, vtkVVPluginSelector *plugins)
   this->AbortProcessing = 0;
   this->ProgressMinimum = 0;
   this->ProgressMaximum = 1;
+  this->LastProgressRefresh = 0;
 //BTX
 #ifdef KWVolView_PLUGINS_USE_SPLINE
   pds.NumberOfMeshPoints = 0;
@@ -2631,14 +3663,47 @@ void vtkVVPlugin::ExecuteData(vtkImageData *input, vtkVVPluginSelector *plugins)
   this->GetGUIValues();
   this->Update();
 
-  // clear any undo data
-  plugins->SetUndoData(0);
+  // plugins changing the label map under the hood cannot be undone
+  if (this->RequiresLabelInput)
+    {
+    plugins->ClearUndoHistory();
+    }
   this->SetResultingDistanceUnits(0);
   this->SetResultingComponent1Units(0);
   this->SetResultingComponent2Units(0);
   this->SetResultingComponent3Units(0);
   this->SetResultingComponent4Units(0);
   this->ResultingComponentsAreIndependent = -1;
+
+  // reuse the result of the same run on the same data, if it was cached
+  vtkVVPluginResultCache *cache = plugins->GetResultCache();
+  this->ResultCacheKey = "";
+  if (cache && this->GetResultCacheKey(input, cache, this->ResultCacheKey))
+    {
+    const vtkVVPluginResultCache::ResultType *result = 
+      cache->Find(this->ResultCacheKey);
+    if (result)
+      {
+      this->ResultCacheKey = "";
+      plugins->SaveUndoData(input);
+      vtkVVPluginResultCache::Restore(result, input);
+      this->SetResultingDistanceUnits(
+        result->HasDistanceUnits ? result->DistanceUnits.c_str() : 0);
+      this->SetResultingComponent1Units(
+        result->HasScalarUnits[0] ? result->ScalarUnits[0].c_str() : 0);
+      this->SetResultingComponent2Units(
+        result->HasScalarUnits[1] ? result->ScalarUnits[1].c_str() : 0);
+      this->SetResultingComponent3Units(
+        result->HasScalarUnits[2] ? result->ScalarUnits[2].c_str() : 0);
+      this->SetResultingComponent4Units(
+        result->HasScalarUnits[3] ? result->ScalarUnits[3].c_str() : 0);
+      this->ResultingComponentsAreIndependent = 
+        result->IndependentComponents;
+      this->PushNewProperties();
+      this->SetReportText(result->ReportText.c_str());
+      return;
+      }
+    }
    
   // Get the paintbrush label image.
   vtkImageData *inLabelImage = this->GetInputLabelImage();
@@ -2667,6 +3732,29 @@ void vtkVVPlugin::ExecuteData(vtkImageData *input, vtkVVPluginSelector *plugins)
   if (this->RequiresSeriesInput && 
       this->SeriesInputOpenWizard && 
       this->SeriesInputOpenWizard->GetLastReader() &&
+     !this->SupportProcessingSeriesByVolumes &&
+      this->SupportPagedSeriesInput)
+    {
+    // the plugin asks for the volumes it needs one at a time
+    size_t volumeSize = 
+      (size_t)this->PluginInfo.InputVolumeSeriesScalarSize*
+      this->PluginInfo.InputVolumeSeriesNumberOfComponents*
+      this->PluginInfo.InputVolumeSeriesDimensions[0]*
+      this->PluginInfo.InputVolumeSeriesDimensions[1]*
+      this->PluginInfo.InputVolumeSeriesDimensions[2];
+    const char *scratchFile = vtkVVPluginGetSeriesScratchFileName();
+    if (!this->SeriesCache->Initialize(
+          this->PluginInfo.InputVolumeSeriesNumberOfVolumes, volumeSize,
+          VTK_VV_PLUGIN_SERIES_CACHE, vtkVVPlugin::RequestSeriesVolume, this,
+          scratchFile))
+      {
+      vtkWarningMacro("Could not map " << scratchFile << ", the volumes of "
+                      "the series are kept in memory.");
+      }
+    }
+  else if (this->RequiresSeriesInput && 
+      this->SeriesInputOpenWizard && 
+      this->SeriesInputOpenWizard->GetLastReader() &&
      !this->SupportProcessingSeriesByVolumes )
     {
     // Replace this with an allocation for N x DataSet size buffer,
@@ -2712,7 +3800,7 @@ void vtkVVPlugin::ExecuteData(vtkImageData *input, vtkVVPluginSelector *plugins)
     pds.CurrentVolumeFromSeries = 0;
 #endif
     pds.NumberOfSlicesToProcess = input->GetDimensions()[2];
-    this->PluginInfo.ProcessData(&this->PluginInfo, &pds);
+    this->RunInBackground(&pds, 0);
     // update the GUI
     plugins->Update();
     return;
@@ -2770,18 +3858,36 @@ void vtkVVPlugin::ExecuteData(vtkImageData *input, vtkVVPluginSelector *plugins)
 #endif
 //ETX
 
-  // otherwise check first for memory issues
-  int memCheck = this->CheckMemory(input);
-  if (!memCheck)
+  // otherwise plan the run given the memory available. The process
+  // functions below keep the input for undo when memCheck is 2.
+  int strategy = this->PlanExecution(input, plugins);
+  if (strategy == vtkVVPluginMemoryPlanner::None)
     {
     return;
     }
+  int memCheck = 
+    strategy == vtkVVPluginMemoryPlanner::OnePieceWithUndo ? 2 : 1;
+
+  // when the input is not kept, keep a compressed copy of it for undo if
+  // the plan has room for it. Execute() turns it into an undo level once
+  // the plugin has run.
+  if (memCheck != 2 && !this->RequiresLabelInput)
+    {
+    if (this->PlannedUndoMemory > 0)
+      {
+      plugins->SaveUndoData(input);
+      }
+    else
+      {
+      plugins->ClearUndoHistory();
+      }
+    }
 
   // For plugins that produce as output array data to be plotted in 2D.
   // Here we allocate the memory needed for returning the data array.
   // We assume that the memory size of this array is negligeable compared
-  // to the volume data itself, therefore we don't count this array on the
-  // CheckMemory() function above.
+  // to the volume data itself, therefore we don't count this array in
+  // PlanExecution() above.
   if( this->ProducesPlottingOutput )
     {
     const int arraySize = 
@@ -2799,40 +3905,38 @@ void vtkVVPlugin::ExecuteData(vtkImageData *input, vtkVVPluginSelector *plugins)
 #endif
 //ETX
     {
-    // if we have the memory, and the plugin is not expecting a series
-    // on a volume-by-volume basis, then just pass it in in one piece
-    if (memCheck == 2)
+    // if we have the memory just pass it in in one piece, keeping the
+    // input if possible
+    if (strategy == vtkVVPluginMemoryPlanner::OnePieceWithUndo ||
+        strategy == vtkVVPluginMemoryPlanner::OnePiece)
       {
       this->ProcessInOnePiece(input, memCheck, &pds, plugins);
       this->DisplayPlot(&pds);
       return;
       }
     
-    // if it supports in place processing then that is the easiest
-    // but if we have the memory we might as well keep the input
-    // around 
-    if (this->SupportInPlaceProcessing)
-      {
-      // make sure the other values are consistent with in place 
-      // processing as well
-      if (this->PluginInfo.OutputVolumeDimensions[0] !=
-          input->GetDimensions()[0] ||
-          this->PluginInfo.OutputVolumeDimensions[1] !=
-          input->GetDimensions()[1] ||
-          this->PluginInfo.OutputVolumeDimensions[2] !=
-          input->GetDimensions()[2] ||
-          this->PluginInfo.OutputVolumeScalarType !=
-          input->GetScalarType())
-        {
-        vtkErrorMacro("A plugin specified incorrectly that it could perform in place processing!");
-        return;
-        }
+    // if it supports in place processing then that is the easiest, the
+    // planner only picks it when the output has the layout of the input
+    if (strategy == vtkVVPluginMemoryPlanner::InPlace)
+      {
       pds.inData = input->GetScalarPointer();
       pds.outData = input->GetScalarPointer();
       pds.StartSlice = 0;
       pds.CurrentVolumeFromSeries = 0;
       pds.NumberOfSlicesToProcess = input->GetDimensions()[2];
-      this->PluginInfo.ProcessData(&this->PluginInfo, &pds);
+      if (this->RunInBackground(&pds, 0) || this->AbortProcessing)
+        {
+        // the plugin stopped half way through the data, put it back from
+        // the copy kept for undo. Without one the partial result is shown,
+        // but not cached.
+        this->ResultCacheKey = "";
+        if (!plugins->RestoreSavedUndoData(input))
+          {
+          input->Modified();
+          }
+        this->DisplayPlot(&pds);
+        return;
+        }
       input->Modified();
       this->PushNewProperties();
       this->DisplayPlot(&pds);
@@ -2841,20 +3945,7 @@ void vtkVVPlugin::ExecuteData(vtkImageData *input, vtkVVPluginSelector *plugins)
 
     // handle the next case which is that the output type and extent are the
     // same as the input, but it cannot process in place
-    int *dim = input->GetDimensions();
-    if (this->SupportProcessingPieces && 
-        this->PluginInfo.OutputVolumeDimensions[0] == dim[0] &&
-        this->PluginInfo.OutputVolumeDimensions[1] == dim[1] &&
-        this->PluginInfo.OutputVolumeDimensions[2] == dim[2] &&
-        this->PluginInfo.OutputVolumeScalarType == input->GetScalarType() &&
-        this->PluginInfo.OutputVolumeNumberOfComponents == 
-        input->GetNumberOfScalarComponents() 
-//BTX
-#ifdef KWVolView_PLUGINS_USE_SERIES
-        && !this->RequiresSeriesInput 
-#endif
-//ETX
-      )
+    if (strategy == vtkVVPluginMemoryPlanner::Pieces)
       {
       this->ProcessInPieces(input,memCheck, &pds);
       }
@@ -2953,6 +4044,162 @@ vtkKWEPaintbrushDrawing * vtkVVPlugin::GetPaintbrushDrawing()
   return NULL;
 }
   
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE vtkVVPluginBackgroundWorker(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *ti = 
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkVVPluginBackgroundJob *job = 
+    static_cast<vtkVVPluginBackgroundJob *>(ti->UserData);
+  if (job->Threader)
+    {
+    job->Threader->SingleMethodExecute();
+    }
+  else
+    {
+    job->Result = job->Info->ProcessData(job->Info, job->ProcessDataStruct);
+    }
+  job->Queue->SetDone();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+int vtkVVPlugin::CanRunInBackground()
+{
+  return this->Window && this->Window->GetApplication() && 
+    !this->MessageQueue;
+}
+
+//----------------------------------------------------------------------------
+int vtkVVPlugin::ServeSeriesReads()
+{
+  int served = 0;
+//BTX
+#ifdef KWVolView_PLUGINS_USE_SERIES
+  // read the volume the SeriesCache waits for
+  vtkVVPluginSeriesRequest *request = this->SeriesRequest;
+  request->Lock->Lock();
+  if (request->Pending)
+    {
+    request->Result = vtkVVPlugin::ReadSeriesVolume(
+      this, request->Volume, request->Buffer, request->Size);
+    request->Pending = 0;
+    request->Done->Broadcast();
+    served = 1;
+    }
+  request->Lock->Unlock();
+
+  // read ahead the next volume of a series processed volume by volume, if
+  // a buffer is free for it; one at a time, the events are served between
+  vtkVVPluginSeriesPrefetcher *prefetch = this->SeriesPrefetcher;
+  if (prefetch)
+    {
+    prefetch->Lock->Lock();
+    int v = prefetch->ReadVolumes;
+    int read = v < prefetch->NumberOfVolumes && 
+      prefetch->MissingVolume < 0 && !prefetch->Failed &&
+      v - prefetch->ProcessedVolumes < prefetch->NumberOfBuffers;
+    prefetch->Lock->Unlock();
+    if (read)
+      {
+      int ok = prefetch->Reader(
+        prefetch->ReaderData, v, 
+        prefetch->Buffers[v % prefetch->NumberOfBuffers], 
+        prefetch->VolumeSize);
+      prefetch->Lock->Lock();
+      if (ok)
+        {
+        prefetch->ReadVolumes = v + 1;
+        }
+      else
+        {
+        prefetch->MissingVolume = v;
+        }
+      prefetch->Ready->Signal();
+      prefetch->Lock->Unlock();
+      served = 1;
+      }
+    }
+#endif
+//ETX
+  return served;
+}
+
+//----------------------------------------------------------------------------
+int vtkVVPlugin::RunInBackground(vtkVVProcessDataStruct *pds, 
+                                 vtkMultiThreader *threader)
+{
+  vtkVVPluginMessageQueue queue;
+  vtkVVPluginBackgroundJob job;
+  job.Info = &this->PluginInfo;
+  job.ProcessDataStruct = pds;
+  job.Threader = threader;
+  job.Queue = &queue;
+  job.Result = 0;
+
+  // without a GUI to keep alive, or already in the background, run it here
+  vtkKWApplication *app = this->Window ? this->Window->GetApplication() : 0;
+  vtkMultiThreader *background = 0;
+  int id = -1;
+  if (this->CanRunInBackground())
+    {
+    this->MessageQueue = &queue;
+    background = vtkMultiThreader::New();
+    id = background->SpawnThread(vtkVVPluginBackgroundWorker, &job);
+    }
+  if (id < 0)
+    {
+    this->MessageQueue = 0;
+    if (background)
+      {
+      background->Delete();
+      }
+    if (threader)
+      {
+      threader->SingleMethodExecute();
+      return 0;
+      }
+    return this->PluginInfo.ProcessData(&this->PluginInfo, pds);
+    }
+
+  // the events are processed as usual meanwhile (the Cancel button sets the
+  // abort flag the plugin polls), but the data is only touched here once
+  // the plugin is done with it
+  vtkstd::vector<vtkVVPluginMessageQueue::MessageType> messages;
+  int done = 0;
+  while (!done)
+    {
+    done = queue.Take(messages);
+    size_t i;
+    for (i = 0; i < messages.size(); ++i)
+      {
+      const char *text = 
+        messages[i].HasText ? messages[i].Text.c_str() : 0;
+      if (messages[i].Type == vtkVVPluginMessageQueue::Progress)
+        {
+        this->ShowProgress(messages[i].Progress, text);
+        }
+      else
+        {
+        this->SetReportText(text);
+        }
+      }
+    if (!done)
+      {
+      app->ProcessPendingEvents();
+      if (!this->ServeSeriesReads())
+        {
+        vtksys::SystemTools::Delay(VTK_VV_PLUGIN_BACKGROUND_POLL);
+        }
+      }
+    }
+
+  background->TerminateThread(id);
+  background->Delete();
+  this->MessageQueue = 0;
+  return job.Result;
+}
+
 //----------------------------------------------------------------------------
 void vtkVVPlugin::ProcessInPieces(vtkImageData *input, 
                                   int vtkNotUsed(memCheck),
@@ -2996,7 +4243,7 @@ void vtkVVPlugin::ProcessInPieces(vtkImageData *input,
     pds->outData = buffer1;
     pds->StartSlice = buffer1Slice;
     pds->NumberOfSlicesToProcess = numSlicesToProcess;
-    if (this->PluginInfo.ProcessData(&this->PluginInfo, pds))
+    if (this->RunInBackground(pds, 0))
       {
       abort = 1;
       }
@@ -3037,6 +4284,22 @@ void vtkVVPlugin::ProcessInOnePiece(vtkImageData *input, int memCheck,
                                     vtkVVProcessDataStruct *pds, 
                                     vtkVVPluginSelector *plugins)
 {
+  // in place plugins that do not change the layout of the data can write
+  // straight into the input, there is no need for a second full volume
+  int *inDim = input->GetDimensions();
+  if (memCheck == 2 && 
+      this->SupportInPlaceProcessing &&
+      this->PluginInfo.OutputVolumeDimensions[0] == inDim[0] &&
+      this->PluginInfo.OutputVolumeDimensions[1] == inDim[1] &&
+      this->PluginInfo.OutputVolumeDimensions[2] == inDim[2] &&
+      this->PluginInfo.OutputVolumeScalarType == input->GetScalarType() &&
+      this->PluginInfo.OutputVolumeNumberOfComponents == 
+      input->GetNumberOfScalarComponents())
+    {
+    this->ProcessInPlace(input, pds, plugins);
+    return;
+    }
+
   vtkImageData *output;
   // if we have the memory then keep the input and use a new output
   if (memCheck == 2)
@@ -3094,7 +4357,7 @@ void vtkVVPlugin::ProcessInOnePiece(vtkImageData *input, int memCheck,
   pds->CurrentVolumeFromSeries = 0;
   pds->NumberOfSlicesToProcess = outDim[2];
 
-  int failed = this->PluginInfo.ProcessData(&this->PluginInfo, pds);
+  int failed = this->RunInBackground(pds, 0);
   
   if (!failed && !this->AbortProcessing)
     {
@@ -3147,8 +4410,106 @@ void vtkVVPlugin::ProcessInOnePiece(vtkImageData *input, int memCheck,
     }
 }
  
+//----------------------------------------------------------------------------
+void vtkVVPlugin::ProcessInPlace(vtkImageData *input,
+                                 vtkVVProcessDataStruct *pds, 
+                                 vtkVVPluginSelector *plugins)
+{
+  // keep a compressed snapshot of the input to restore it on failure and
+  // to compute the undo difference, encoded in the background like the
+  // copies of the other strategies. Execute() turns it into the undo
+  // level. Label maps do not get undo (see ProcessInOnePiece), so there is
+  // nothing to keep for them.
+  int keepUndo = 
+    this->RequiresLabelInput == 0 && plugins->SaveUndoData(input, 0);
+
+  pds->inData = input->GetScalarPointer();
+  pds->outData = input->GetScalarPointer();
+  pds->StartSlice = 0;
+  pds->CurrentVolumeFromSeries = 0;
+  pds->NumberOfSlicesToProcess = input->GetDimensions()[2];
+
+  int failed = this->RunInBackground(pds, 0);
+
+  if (failed || this->AbortProcessing)
+    {
+    this->ResultCacheKey = "";
+    if (!keepUndo || !plugins->RestoreSavedUndoData(input))
+      {
+      input->Modified();
+      }
+    return;
+    }
+  input->Modified();
+  this->PushNewProperties();
+}
+
 //BTX
 #ifdef KWVolView_PLUGINS_USE_SERIES
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE vtkVVPluginSeriesWorker(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *ti = 
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkVVPluginSeriesPrefetcher *prefetch = 
+    static_cast<vtkVVPluginSeriesPrefetcher *>(ti->UserData);
+  int done;
+  int v;
+
+  // run the plugin on the volumes as they come in
+  vtkVVProcessDataStruct *pds = prefetch->ProcessDataStruct;
+  for (v = 0; v < prefetch->NumberOfVolumes; ++v)
+    {
+    if (prefetch->ReadInline)
+      {
+      if (prefetch->Reader(prefetch->ReaderData, v, 
+                           prefetch->Buffers[v % prefetch->NumberOfBuffers],
+                           prefetch->VolumeSize))
+        {
+        prefetch->ReadVolumes = v + 1;
+        }
+      else
+        {
+        prefetch->MissingVolume = v;
+        }
+      }
+    prefetch->Lock->Lock();
+    while (prefetch->ReadVolumes <= v && prefetch->MissingVolume < 0)
+      {
+      prefetch->Ready->Wait(prefetch->Lock);
+      }
+    done = (prefetch->ReadVolumes <= v);
+    prefetch->Lock->Unlock();
+    if (done || *prefetch->Info->AbortFlag)
+      {
+      break;
+      }
+
+    pds->inDataSeries = prefetch->Buffers[v % prefetch->NumberOfBuffers];
+    pds->CurrentVolumeFromSeries = v;
+    int failed = prefetch->Info->ProcessData(prefetch->Info, pds);
+
+    prefetch->Lock->Lock();
+    prefetch->ProcessedVolumes = v + 1;
+    if (failed)
+      {
+      prefetch->Failed = 1;
+      }
+    prefetch->Lock->Unlock();
+    if (failed)
+      {
+      break;
+      }
+    }
+
+  // stop the reads ahead
+  prefetch->Lock->Lock();
+  prefetch->ProcessedVolumes = prefetch->NumberOfVolumes;
+  prefetch->Failed = (prefetch->Failed || v < prefetch->NumberOfVolumes);
+  prefetch->Lock->Unlock();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
 //----------------------------------------------------------------------------
 void vtkVVPlugin::ProcessSeriesByVolumes(vtkImageData *input, 
                                           int memCheck,
@@ -3211,33 +4572,65 @@ void vtkVVPlugin::ProcessSeriesByVolumes(vtkImageData *input,
   pds->inData = input->GetScalarPointer();
   pds->outData = buffer1;
 
-  int abort = 0;
-  int volumeToProcess = 0;
+  // read the next volumes while the plugin processes the current one, in
+  // a bounded number of buffers of our own (the reader may reuse its
+  // output). The reader belongs to the GUI thread, it reads them while the
+  // plugin runs in the background.
+  vtkVVPluginSeriesPrefetcher prefetch;
+  prefetch.Reader = vtkVVPlugin::ReadSeriesVolume;
+  prefetch.ReaderData = this;
+  prefetch.ReadInline = !this->CanRunInBackground();
+  prefetch.Info = &this->PluginInfo;
+  prefetch.ProcessDataStruct = pds;
+  prefetch.NumberOfVolumes = this->PluginInfo.InputVolumeSeriesNumberOfVolumes;
+  prefetch.VolumeSize = 
+    (size_t)this->PluginInfo.InputVolumeSeriesScalarSize*
+    this->PluginInfo.InputVolumeSeriesNumberOfComponents*
+    this->PluginInfo.InputVolumeSeriesDimensions[0]*
+    this->PluginInfo.InputVolumeSeriesDimensions[1]*
+    this->PluginInfo.InputVolumeSeriesDimensions[2];
+  prefetch.NumberOfBuffers = VTK_VV_PLUGIN_SERIES_PREFETCH;
+  if (prefetch.NumberOfBuffers > prefetch.NumberOfVolumes)
+    {
+    prefetch.NumberOfBuffers = prefetch.NumberOfVolumes;
+    }
+  prefetch.Buffers = new unsigned char * [prefetch.NumberOfBuffers];
+  int i;
+  for (i = 0; i < prefetch.NumberOfBuffers; ++i)
+    {
+    prefetch.Buffers[i] = new unsigned char [prefetch.VolumeSize];
+    }
+  prefetch.ReadVolumes = 0;
+  prefetch.ProcessedVolumes = 0;
+  prefetch.MissingVolume = -1;
+  prefetch.Failed = 0;
+  prefetch.Lock = vtkMutexLock::New();
+  prefetch.Ready = vtkConditionVariable::New();
+
+  vtkMultiThreader *threader = vtkMultiThreader::New();
+  threader->SetNumberOfThreads(1);
+  threader->SetSingleMethod(vtkVVPluginSeriesWorker, &prefetch);
+  this->SeriesPrefetcher = prefetch.ReadInline ? 0 : &prefetch;
+  this->RunInBackground(0, threader);
+  this->SeriesPrefetcher = 0;
+  threader->Delete();
 
-  while (!this->AbortProcessing && !abort && 
-         volumeToProcess < this->PluginInfo.InputVolumeSeriesNumberOfVolumes )
+  // the buffers are released here, not by ExecuteData()
+  pds->inDataSeries = 0;
+  prefetch.Ready->Delete();
+  prefetch.Lock->Delete();
+  for (i = 0; i < prefetch.NumberOfBuffers; ++i)
     {
-    vtkImageData * volume = this->SeriesInputOpenWizard->GetSeriesOutput(volumeToProcess);
-    if( volume && volume->GetScalarPointer() )
-      {
-      pds->inDataSeries = volume->GetScalarPointer();
-      pds->CurrentVolumeFromSeries = volumeToProcess;
-      // run the plugin
-      if (this->PluginInfo.ProcessData(&this->PluginInfo, pds))
-        {
-        abort = 1;
-        }
-      // set it to NULL to prevent others from attempting to release this
-      // memory. The memory actually belongs to the reader.
-      pds->inDataSeries = 0; 
-      }
-    else
-      {
-      vtkErrorMacro("Problem getting access to Volume " << volumeToProcess << " from the series" );
-      pds->inDataSeries = 0;
-      return;
-      }
-    volumeToProcess++;
+    delete [] prefetch.Buffers[i];
+    }
+  delete [] prefetch.Buffers;
+
+  int abort = prefetch.Failed;
+  if (prefetch.MissingVolume >= 0)
+    {
+    vtkErrorMacro("Problem getting access to Volume " 
+                  << prefetch.MissingVolume << " from the series" );
+    abort = 1;
     }
 
   if (!abort && !this->AbortProcessing)
@@ -3296,6 +4689,14 @@ void vtkVVPlugin::ProcessSeriesByVolumes(vtkImageData *input,
 //----------------------------------------------------------------------------
 void vtkVVPlugin::PushNewProperties()
 {
+  // the views of the data item selected while the plugin was running in the
+  // background show another data
+  if (this->ExecutingDataItem && 
+      this->ExecutingDataItem != this->Window->GetSelectedDataItem())
+    {
+    return;
+    }
+
   // if any properties were set then push them out
   int nb_rw = this->Window->GetNumberOfRenderWidgetsUsingSelectedDataItem();
   for (int i = 0; i < nb_rw; i++)
@@ -3581,6 +4982,9 @@ void vtkVVPlugin::PrintSelf(ostream& os, vtkIndent indent)
     {
     os << "(none)" << endl;
     }
+  os << indent << "FileName: "
+     << (this->FileName ? this->FileName : "(none)") << endl;
+  os << indent << "Loaded: " << this->Loaded << endl;
   os << indent << "TerseDocumentation: ";
   if (this->TerseDocumentation)
     {
@@ -3644,5 +5048,7 @@ void vtkVVPlugin::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "SecondInputOptional: " << this->SecondInputOptional << endl;  
   os << indent << "RequiresLabelInput: " << this->RequiresLabelInput << endl;
   os << indent << "SecondInputOpenWizard: " << this->SecondInputOpenWizard << endl;
+  os << indent << "PreviewMode: " << this->PreviewMode << endl;
+  os << indent << "PreviewSize: " << this->PreviewSize << endl;
 }
 
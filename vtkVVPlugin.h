@@ -16,10 +16,31 @@
 
 #include "vtkKWCompositeWidget.h"
 #include "vtkVVPluginAPI.h"
+#include "vtkVVPluginManifest.h" // for the description of unloaded plugins
 
 #define VTK_VV_PLUGIN_DEFAULT_GROUP "Miscelaneous"
 
+// maximum number of progress GUI refreshes per second while executing
+#define VTK_VV_PLUGIN_PROGRESS_RATE 20
+
+// milliseconds between two services of the GUI while a plugin runs in the
+// background
+#define VTK_VV_PLUGIN_BACKGROUND_POLL 10
+
+// volumes of a series in memory at once when it is processed volume by
+// volume: the one processed and the ones read ahead
+#define VTK_VV_PLUGIN_SERIES_PREFETCH 2
+
+// volumes of a series no longer in use kept in memory for the plugins
+// asking for them one at a time (VVP_SUPPORTS_PAGED_SERIES_INPUT)
+#define VTK_VV_PLUGIN_SERIES_CACHE 4
+
+// how a preview reduces the data, see vtkVVPlugin::Preview()
+#define VTK_VV_PLUGIN_PREVIEW_DOWNSAMPLED 0
+#define VTK_VV_PLUGIN_PREVIEW_CROPPED     1
+
 class vtkImageData;
+class vtkKWCheckButton;
 class vtkKWLabel;
 class vtkKWLabelWithLabel;
 class vtkKWPushButton;
@@ -29,6 +50,15 @@ class vtkVVGUIItem;
 class vtkKWOpenWizard;
 class vtkVV4DOpenWizard;
 class vtkKWEPaintbrushDrawing;
+class vtkMultiThreader;
+class vtkVVDataItemVolume;
+//BTX
+class vtkVVPluginMessageQueue;
+class vtkVVPluginResultCache;
+class vtkVVPluginSeriesCache;
+class vtkVVPluginSeriesPrefetcher;
+class vtkVVPluginSeriesRequest;
+//ETX
 
 class VTK_EXPORT vtkVVPlugin : public vtkKWCompositeWidget
 {
@@ -53,13 +83,83 @@ public:
   virtual void Execute(vtkVVPluginSelector *);
   virtual void Cancel(vtkVVPluginSelector *);
 
+  // Description:
+  // Run the plugin on a reduced copy of the data: the whole data
+  // downsampled to at most PreviewSize voxels along each axis, or the
+  // region inside the cropping planes at full resolution. The result is
+  // shown in place of the data until the plugin is applied (see
+  // vtkVVPluginSelector::ShowPreview()). Plugins that need more than the
+  // volume, or change the label map, cannot be previewed.
+  virtual void Preview(vtkVVPluginSelector *);
+  virtual int CanBePreviewed();
+  vtkSetClampMacro(PreviewMode, int, 
+                   VTK_VV_PLUGIN_PREVIEW_DOWNSAMPLED, 
+                   VTK_VV_PLUGIN_PREVIEW_CROPPED);
+  vtkGetMacro(PreviewMode, int);
+  virtual void SetPreviewModeToDownsampled()
+    { this->SetPreviewMode(VTK_VV_PLUGIN_PREVIEW_DOWNSAMPLED); }
+  virtual void SetPreviewModeToCropped()
+    { this->SetPreviewMode(VTK_VV_PLUGIN_PREVIEW_CROPPED); }
+  vtkSetClampMacro(PreviewSize, int, 8, 4096);
+  vtkGetMacro(PreviewSize, int);
+
+  // Description:
+  // Callbacks
+  virtual void PreviewCroppedCallback(int state);
+
   // Description:
   // Load this plugin and return success or failure. Success is zero.
   virtual int Load(const char *pluginDir, vtkKWApplication *app);
 
+//BTX
+  // Description:
+  // Set up the plugin in 'path' from the properties its Init function set
+  // in a previous Load() (see GetDescription()), without opening the
+  // library. EnsureLoaded() loads it and creates the widget when the plugin
+  // is first needed; it returns zero on success, like Load().
+  virtual void LoadDescription(
+    const char *path, const vtkVVPluginManifest::PropertiesType &);
+  const vtkVVPluginManifest::PropertiesType &GetDescription()
+    { return this->Description; }
+//ETX
+  virtual int EnsureLoaded(vtkKWApplication *app);
+  vtkGetMacro(Loaded, int);
+  vtkGetStringMacro(FileName);
+
+  // Description:
+  // Release the named buffers the plugins exchange through the SetBuffer
+  // and GetBuffer entries of their info structure.
+  static void ClearSharedBuffers();
+
   // Used internally for then a plugin is executed in pieces
   float ProgressMinimum;
   float ProgressMaximum;
+
+  // Used internally to limit the rate of the progress GUI refreshes
+  double LastProgressRefresh;
+
+//BTX
+  // Used internally while the plugin runs in the background, what it
+  // reports is queued for the GUI thread
+  vtkVVPluginMessageQueue *MessageQueue;
+
+  // Used internally to hand out the volumes of the series input one at a
+  // time, see VVP_SUPPORTS_PAGED_SERIES_INPUT
+  vtkVVPluginSeriesCache *SeriesCache;
+
+  // Used internally while a series is processed volume by volume, the GUI
+  // thread reads the volumes ahead (see ServeSeriesReads())
+  vtkVVPluginSeriesPrefetcher *SeriesPrefetcher;
+
+  // Used internally to have the GUI thread read the volumes the
+  // SeriesCache misses while the plugin runs in the background
+  vtkVVPluginSeriesRequest *SeriesRequest;
+//ETX
+
+  // Description:
+  // Show the progress of the plugin in the gauge and the status bar of the
+  // window.
+  virtual void ShowProgress(float progress, const char *msg);
   
   // Description:
   // Set/Get some properties of the plugin
@@ -219,6 +319,7 @@ protected:
   vtkKWLabelWithLabel *DocText;
   vtkKWLabelWithLabel *ReportText;
   vtkKWLabelWithLabel *StopWatchText;
+  vtkKWCheckButton *PreviewCroppedButton;
   vtkVVWindowBase *Window;
 
   virtual void UpdateGUI();
@@ -244,8 +345,25 @@ protected:
   void UpdateData(vtkImageData *);
   void ProcessInOnePiece(vtkImageData *input, int memCheck,
                          vtkVVProcessDataStruct *, vtkVVPluginSelector *);
+  void ProcessInPlace(vtkImageData *input, 
+                      vtkVVProcessDataStruct *, vtkVVPluginSelector *);
   void ProcessInPieces(vtkImageData *input, int memCheck, 
                        vtkVVProcessDataStruct *);
+
+  // run the plugin on 'pds', or the single method of 'threader' when not
+  // NULL, in a background thread while this one keeps the GUI alive and
+  // shows what the plugin reports. Return what ProcessData returned.
+  int RunInBackground(vtkVVProcessDataStruct *pds, vtkMultiThreader *threader);
+  int CanRunInBackground();
+
+  // the reads of the series input the plugin thread waits for, done by the
+  // GUI thread which owns the reader while the plugin runs in the
+  // background. Return 1 if something was read.
+  int ServeSeriesReads();
+
+  // the data item the plugin is executed on, its views are the only ones
+  // to get the new properties
+  vtkVVDataItemVolume *ExecutingDataItem;
 //BTX
 #ifdef KWVolView_PLUGINS_USE_SERIES
   void ProcessSeriesByVolumes(vtkImageData *input, int memCheck, 
@@ -253,8 +371,25 @@ protected:
 #endif
 //ETX
   
-  // handle memory issues for this plugin, warn if to big
-  int CheckMemory(vtkImageData *);
+  // choose how to run this plugin given the memory available (one of the
+  // vtkVVPluginMemoryPlanner strategies), warn if too big. None cancels.
+  // PlannedUndoMemory is the part of the plan kept for undo, 0 if the
+  // strategy keeps the input or if the run cannot be undone.
+  int PlanExecution(vtkImageData *, vtkVVPluginSelector *);
+  double PlannedPeakMemory;
+  double PlannedUndoMemory;
+
+  int PreviewMode;
+  int PreviewSize;
+
+//BTX
+  // the key of the result of running this plugin on 'input' with the
+  // current settings, return 0 if the result cannot be reused. Execute()
+  // caches the result of the run under ResultCacheKey when it is not empty.
+  int GetResultCacheKey(vtkImageData *input, vtkVVPluginResultCache *cache,
+                        vtkstd::string &key);
+  vtkstd::string ResultCacheKey;
+//ETX
 
   // these members must be set by the plugin 
   char *Name;
@@ -266,6 +401,14 @@ protected:
 //BTX
 #ifdef KWVolView_PLUGINS_USE_SERIES
   int SupportProcessingSeriesByVolumes;
+  int SupportPagedSeriesInput;
+
+  // read a volume of the series input, on the GUI thread which owns the
+  // reader; RequestSeriesVolume() has it read there for the SeriesCache
+  static int ReadSeriesVolume(void *self, int volume, 
+                              void *buffer, size_t size);
+  static int RequestSeriesVolume(void *self, int volume, 
+                                 void *buffer, size_t size);
 #endif
 //ETX
   int NumberOfGUIItems;
@@ -276,7 +419,8 @@ protected:
 //ETX
   int RequiredZOverlap;
   float PerVoxelMemoryRequired;
-  int AbortProcessing;
+  float PerVoxelStageMemory;
+  volatile int AbortProcessing;
   int RequiresSecondInput;
   int SecondInputIsUnstructuredGrid;
   int SecondInputOptional;  
@@ -304,6 +448,15 @@ protected:
   
   // where the GUI elements are stored
   vtkVVGUIItem *GUIItems;
+
+  // the library, and the properties its Init function set
+  vtkSetStringMacro(FileName);
+  char *FileName;
+  int Loaded;
+  int RecordingDescription;
+//BTX
+  vtkVVPluginManifest::PropertiesType Description;
+//ETX
   
   // Get the label image of the paintbrush widget that's selected. If there
   // is no paintbrush widget selected, this returns NULL
@@ -12,6 +12,8 @@
 #ifndef vtkVVPluginAPI_h
 #define vtkVVPluginAPI_h
 
+#include <stddef.h> /* size_t */
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -131,6 +133,22 @@ VVP_PLOTTING_X_AXIS_TITLE
 VVP_PLOTTING_Y_AXIS_TITLE 
   Title to be used for the X axis in plugins that return data to be plotted.
 
+VVP_PER_VOXEL_STAGE_MEMORY
+  a more precise form of VVP_PER_VOXEL_MEMORY_REQUIRED for plugins running
+  several stages (a pipeline of filters for instance): the bytes per input
+  voxel held while each stage runs, as a list of numbers separated by
+  spaces, such as "4 12 8". Count everything alive during the stage, the
+  intermediate images and the copies of single components of the input,
+  but not the input and output volumes. The largest value is used to plan
+  the execution; VVP_PER_VOXEL_MEMORY_REQUIRED is used when it is not set.
+
+VVP_SUPPORTS_PAGED_SERIES_INPUT
+  for plugins requiring a series input and not processing it volume by
+  volume: instead of gathering all the volumes in pds->inDataSeries (left
+  NULL), VolView hands them out one at a time through GetSeriesVolume and
+  ReleaseSeriesVolume, so that a long series does not have to fit in
+  memory at once.
+
 =========================================================================*/
 
 #define VV_PLUGIN_API_VERSION 1
@@ -160,6 +178,9 @@ VVP_PLOTTING_Y_AXIS_TITLE
 #define VVP_GUI_CHOICE   "choice"
 #define VV_GUI_CHECKBOX  2
 #define VVP_GUI_CHECKBOX "checkbox"
+/* a line of text, the value being the text itself */
+#define VV_GUI_ENTRY     3
+#define VVP_GUI_ENTRY    "entry"
 
 #define VVP_ERROR                         0
 #define VVP_NAME                          1
@@ -218,6 +239,17 @@ VVP_PLOTTING_Y_AXIS_TITLE
 
 #define VVP_SECOND_INPUT_IS_UNSTRUCTURED_GRID 46
 
+#define VVP_PER_VOXEL_STAGE_MEMORY 47
+
+#define VVP_SUPPORTS_PAGED_SERIES_INPUT 48
+
+/* the named buffer (see SetBuffer) collecting the execution trace of a
+ * plugin, Chrome trace-event JSON objects separated by commas. When
+ * tracing is on (the VV_PLUGIN_TRACE environment variable names the file
+ * to write), VolView creates it empty before each execution and the
+ * plugins append their events to it; it does not exist otherwise. */
+#define VVP_TRACE_BUFFER "VolView.Trace"
+
 #define VVP_GUI_LABEL   0
 #define VVP_GUI_TYPE    1
 #define VVP_GUI_DEFAULT 2
@@ -399,6 +431,37 @@ gets passed into the ProcessData function.
     /* specify the fields read from the unstructured grid */
     char *UnstructuredGridScalarFields;
 
+    /* named binary buffers kept by VolView between plugin executions, so
+     * that the plugins of a pipeline can hand their results to each other
+     * without going through files. SetBuffer copies 'size' bytes under
+     * 'key', replacing any previous content (a NULL 'data' removes the
+     * key) and returns 0 if the memory is not available. GetBuffer returns
+     * the bytes stored under 'key' and their number in 'size', or NULL if
+     * there is no such key; the pointer stays valid until the key is set
+     * again. Both may be called from several threads at once. */
+    int         (*SetBuffer) (void *info, const char *key, 
+                              const void *data, size_t size);
+    const void *(*GetBuffer) (void *info, const char *key, size_t *size);
+
+    /* non zero once the user asked to stop the processing, the same as
+     * GetProperty(VVP_ABORT_PROCESSING) without the string conversion so
+     * it can be tested in inner loops (see vvPluginAbortRequested) */
+    volatile int *AbortFlag;
+
+    /* same as UpdateProgress but cheap enough to be called for every row:
+     * VolView only refreshes its GUI a few times per second and returns
+     * right away otherwise. Returns the value of *AbortFlag. */
+    int   (*ReportProgress) (void *info, float progress, const char *msg);
+
+    /* for plugins setting VVP_SUPPORTS_PAGED_SERIES_INPUT, the scalars of
+     * volume 'volume' of the series input (see the InputVolumeSeries
+     * members), or NULL if it cannot be read. They stay valid until
+     * ReleaseSeriesVolume is called as many times for that volume. VolView
+     * keeps a few of the volumes released last, the others are read again
+     * when asked for. Both may be called from several threads at once. */
+    const void *(*GetSeriesVolume) (void *info, int volume);
+    void        (*ReleaseSeriesVolume) (void *info, int volume);
+
 	// ADD NEW ELEMENTS AT THE END PLEASE
 	
   } vtkVVPluginInfo;
@@ -484,6 +547,12 @@ gets passed into the ProcessData function.
   }
   
 
+/* test for an abort request, with a fallback for the info structures that
+ * do not provide AbortFlag */
+#define vvPluginAbortRequested(info) \
+  ((info)->AbortFlag ? *(info)->AbortFlag : \
+   atoi((info)->GetProperty((info), VVP_ABORT_PROCESSING)))
+
 /* this macro should be called first inside every Init function to make sure
  * the plugin version matches the volview version */
 #define vvPluginVersionCheck() \
@@ -0,0 +1,126 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkVVPluginBufferStore - named binary buffers shared by plugins
+// .SECTION Description
+// A small header-only map from names to blocks of bytes, used by the
+// plugin framework to implement the SetBuffer/GetBuffer entries of
+// vtkVVPluginInfo. The store outlives plugin executions, so one plugin can
+// leave a result (a list of voxels, per component statistics...) that a
+// later plugin picks up. Accesses are serialized, a plugin running in the
+// background may use it while the GUI thread does.
+
+#ifndef __vtkVVPluginBufferStore_h
+#define __vtkVVPluginBufferStore_h
+
+#include "vtkMutexLock.h"
+
+#include <vtkstd/map>
+#include <vtkstd/string>
+#include <vtkstd/vector>
+#include <string.h>
+
+class vtkVVPluginBufferStore
+{
+public:
+  typedef vtkstd::vector<unsigned char> BufferType;
+
+  // Description:
+  // Copy 'size' bytes under 'key', a NULL 'data' removes the key.
+  // Return 0 if the memory is not available (the key is then removed).
+  int Set(const char *key, const void *data, size_t size)
+    {
+    if (!key)
+      {
+      return 0;
+      }
+    this->Lock.Lock();
+    int ok = 1;
+    if (!data)
+      {
+      this->Buffers.erase(key);
+      }
+    else
+      {
+      try
+        {
+        // build the copy first, the old content stays readable meanwhile
+        BufferType copy(static_cast<const unsigned char *>(data),
+                        static_cast<const unsigned char *>(data) + size);
+        this->Buffers[key].swap(copy);
+        }
+      catch (...)
+        {
+        this->Buffers.erase(key);
+        ok = 0;
+        }
+      }
+    this->Lock.Unlock();
+    return ok;
+    }
+
+  // Description:
+  // Return the bytes stored under 'key' and their number in 'size', or
+  // NULL if there is no such key.
+  const void *Get(const char *key, size_t *size)
+    {
+    static const unsigned char empty = 0;
+    const void *data = 0;
+    size_t n = 0;
+    this->Lock.Lock();
+    if (key)
+      {
+      MapType::const_iterator it = this->Buffers.find(key);
+      if (it != this->Buffers.end())
+        {
+        n = it->second.size();
+        data = n ? &it->second[0] : &empty;
+        }
+      }
+    this->Lock.Unlock();
+    if (size)
+      {
+      *size = n;
+      }
+    return data;
+    }
+
+  // Description:
+  // Remove all the buffers.
+  void Clear()
+    {
+    this->Lock.Lock();
+    this->Buffers.clear();
+    this->Lock.Unlock();
+    }
+
+  // Description:
+  // Total number of bytes held.
+  size_t GetMemorySize()
+    {
+    size_t total = 0;
+    this->Lock.Lock();
+    MapType::const_iterator it;
+    for (it = this->Buffers.begin(); it != this->Buffers.end(); ++it)
+      {
+      total += it->second.size();
+      }
+    this->Lock.Unlock();
+    return total;
+    }
+
+protected:
+  typedef vtkstd::map<vtkstd::string, BufferType> MapType;
+  MapType Buffers;
+  vtkSimpleMutexLock Lock;
+};
+
+#endif
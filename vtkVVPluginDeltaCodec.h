@@ -0,0 +1,328 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkVVPluginDeltaCodec - run-length codec for plugin volume buffers
+// .SECTION Description
+// A small header-only codec used by the plugin framework to keep compressed
+// copies of volumes around (undo data for instance). A buffer is encoded as
+// a sequence of records of fixed size elements (usually one voxel). Each
+// record starts with a 32 bits little-endian header: the low 31 bits hold
+// the number of elements, the high bit tells whether a single element is
+// repeated (run) or the elements follow verbatim (literal).
+// The XOR difference between two versions of a volume processed by a plugin
+// is mostly made of zeros and compresses very well that way. Applying the
+// same XOR difference twice gives the original data back, so one buffer can
+// be used both to undo and to redo.
+
+#ifndef __vtkVVPluginDeltaCodec_h
+#define __vtkVVPluginDeltaCodec_h
+
+#include <vtkstd/vector>
+#include <string.h>
+
+class vtkVVPluginDeltaCodec
+{
+public:
+  typedef vtkstd::vector<unsigned char> BufferType;
+
+  // Description:
+  // Append the encoding of 'n' elements of 'elemSize' bytes to 'out'.
+  // Elements that do not compress are stored verbatim, the encoding never
+  // takes more than GetMaximumEncodedSize(n, elemSize) bytes.
+  static void Encode(const unsigned char *src, size_t n, int elemSize,
+                     BufferType &out)
+    {
+    size_t start = out.size();
+    size_t maximum = vtkVVPluginDeltaCodec::GetMaximumEncodedSize(n, elemSize);
+    size_t i = 0;
+    while (i < n)
+      {
+      size_t run = vtkVVPluginDeltaCodec::RunLength(
+        src, i, n, elemSize, vtkVVPluginDeltaCodec::MaximumCount);
+      size_t j = i + run;
+      if (run < 3)
+        {
+        // collect literals until the next run of 3 or more elements
+        while (j < n && j - i < vtkVVPluginDeltaCodec::MaximumCount &&
+               vtkVVPluginDeltaCodec::RunLength(src, j, n, elemSize, 3) < 3)
+          {
+          ++j;
+          }
+        }
+      size_t size = 4 + (run >= 3 ? 1 : j - i)*elemSize;
+      if (out.size() - start + size > maximum)
+        {
+        // short runs between literals cost more than they save
+        out.resize(start);
+        vtkVVPluginDeltaCodec::EncodeLiterals(src, n, elemSize, out);
+        return;
+        }
+      vtkVVPluginDeltaCodec::WriteHeader(out, j - i, run >= 3);
+      out.insert(out.end(), src + i*elemSize,
+                 src + (run >= 3 ? i + 1 : j)*elemSize);
+      i = j;
+      }
+    }
+
+  // Description:
+  // Largest number of bytes Encode() may append for 'n' elements, that is
+  // the elements themselves and the headers of the literal records.
+  static size_t GetMaximumEncodedSize(size_t n, int elemSize)
+    {
+    size_t records = (n + vtkVVPluginDeltaCodec::MaximumCount - 1) /
+      vtkVVPluginDeltaCodec::MaximumCount;
+    return n*elemSize + 4*records;
+    }
+
+  // Description:
+  // Sequential decoder. Decode() writes (or XORs) the next 'n' elements
+  // into 'dst' and returns the number of elements actually decoded.
+  class Decoder
+  {
+  public:
+    Decoder(const BufferType &buffer, int elemSize)
+      : Buffer(buffer), ElementSize(elemSize), Position(0),
+        Remaining(0), IsRun(0) {}
+
+    size_t Decode(unsigned char *dst, size_t n, int doXor)
+      {
+      size_t done = 0;
+      while (done < n)
+        {
+        if (!this->Remaining)
+          {
+          if (this->Position + 4 > this->Buffer.size())
+            {
+            break;
+            }
+          const unsigned char *h = &this->Buffer[this->Position];
+          unsigned int header = (unsigned int)h[0] |
+            ((unsigned int)h[1] << 8) | ((unsigned int)h[2] << 16) |
+            ((unsigned int)h[3] << 24);
+          this->Position += 4;
+          this->IsRun = (header & 0x80000000u) ? 1 : 0;
+          this->Remaining = header & 0x7fffffffu;
+          }
+        size_t k = n - done;
+        if (k > this->Remaining)
+          {
+          k = this->Remaining;
+          }
+        const unsigned char *src = &this->Buffer[this->Position];
+        unsigned char *out = dst + done*this->ElementSize;
+        if (this->IsRun)
+          {
+          vtkVVPluginDeltaCodec::Fill(out, src, k, this->ElementSize, doXor);
+          }
+        else
+          {
+          vtkVVPluginDeltaCodec::Copy(out, src, k*this->ElementSize, doXor);
+          this->Position += k*this->ElementSize;
+          }
+        this->Remaining -= k;
+        if (this->IsRun && !this->Remaining)
+          {
+          this->Position += this->ElementSize;
+          }
+        done += k;
+        }
+      return done;
+      }
+
+  protected:
+    const BufferType &Buffer;
+    int ElementSize;
+    size_t Position;
+    size_t Remaining;
+    int IsRun;
+  };
+
+  // Description:
+  // Decode 'encoded' into the 'n' elements of 'dst'.
+  static void Decode(const BufferType &encoded, unsigned char *dst,
+                     size_t n, int elemSize)
+    {
+    Decoder decoder(encoded, elemSize);
+    decoder.Decode(dst, n, 0);
+    }
+
+  // Description:
+  // Encode into 'out' the XOR difference between the buffer encoded in
+  // 'encoded' and the 'n' elements of 'current'. The difference is built
+  // a chunk at a time, the original buffer is never decoded in full.
+  static void EncodeDifference(const BufferType &encoded,
+                               const unsigned char *current,
+                               size_t n, int elemSize, BufferType &out)
+    {
+    const size_t chunk = 65536;
+    BufferType scratch(chunk*elemSize);
+    Decoder decoder(encoded, elemSize);
+    size_t i;
+    for (i = 0; i < n; i += chunk)
+      {
+      size_t k = (n - i < chunk) ? n - i : chunk;
+      memcpy(&scratch[0], current + i*elemSize, k*elemSize);
+      decoder.Decode(&scratch[0], k, 1);
+      vtkVVPluginDeltaCodec::Encode(&scratch[0], k, elemSize, out);
+      }
+    }
+
+  // Description:
+  // XOR the difference encoded in 'delta' onto the 'n' elements of 'data'.
+  static void ApplyDifference(const BufferType &delta, unsigned char *data,
+                              size_t n, int elemSize)
+    {
+    Decoder decoder(delta, elemSize);
+    decoder.Decode(data, n, 1);
+    }
+
+protected:
+  enum { MaximumCount = 0x7fffffff };
+
+  static void EncodeLiterals(const unsigned char *src, size_t n,
+                             int elemSize, BufferType &out)
+    {
+    size_t i;
+    for (i = 0; i < n; i += vtkVVPluginDeltaCodec::MaximumCount)
+      {
+      size_t k = n - i;
+      if (k > vtkVVPluginDeltaCodec::MaximumCount)
+        {
+        k = vtkVVPluginDeltaCodec::MaximumCount;
+        }
+      vtkVVPluginDeltaCodec::WriteHeader(out, k, 0);
+      out.insert(out.end(), src + i*elemSize, src + (i + k)*elemSize);
+      }
+    }
+
+  // number of elements equal to element 'i' from 'i' on, up to 'maximum'.
+  // Elements i to i+r-1 are equal when the bytes from element i match the
+  // bytes from element i+1, which is compared a word at a time.
+  static size_t RunLength(const unsigned char *src, size_t i, size_t n,
+                          int elemSize, size_t maximum)
+    {
+    size_t last = n - i < maximum ? n : i + maximum;
+    const unsigned char *first = src + i*elemSize;
+    return 1 + vtkVVPluginDeltaCodec::Mismatch(
+      first, first + elemSize, (last - i - 1)*elemSize)/elemSize;
+    }
+
+  // offset of the first byte that differs in 'a' and 'b', 'size' if none
+  static size_t Mismatch(const unsigned char *a, const unsigned char *b,
+                         size_t size)
+    {
+    size_t i = 0;
+    for (; i + sizeof(size_t) <= size; i += sizeof(size_t))
+      {
+      size_t wa, wb;
+      memcpy(&wa, a + i, sizeof(size_t));
+      memcpy(&wb, b + i, sizeof(size_t));
+      if (wa != wb)
+        {
+        break;
+        }
+      }
+    while (i < size && a[i] == b[i])
+      {
+      ++i;
+      }
+    return i;
+    }
+
+  static void WriteHeader(BufferType &out, size_t count, int isRun)
+    {
+    unsigned int header = (unsigned int)count | (isRun ? 0x80000000u : 0);
+    out.push_back((unsigned char)(header & 0xff));
+    out.push_back((unsigned char)((header >> 8) & 0xff));
+    out.push_back((unsigned char)((header >> 16) & 0xff));
+    out.push_back((unsigned char)((header >> 24) & 0xff));
+    }
+
+  static void Fill(unsigned char *dst, const unsigned char *elem, size_t k,
+                   int elemSize, int doXor)
+    {
+    size_t size = k*elemSize;
+    if (!size)
+      {
+      return;
+      }
+    if (!doXor)
+      {
+      // double the part filled until it covers the run
+      memcpy(dst, elem, elemSize);
+      size_t done = elemSize;
+      while (done < size)
+        {
+        size_t chunk = done < size - done ? done : size - done;
+        memcpy(dst + done, dst, chunk);
+        done += chunk;
+        }
+      return;
+      }
+
+    // a run of zeros leaves the data untouched, which is the common case
+    int e;
+    for (e = 0; e < elemSize && !elem[e]; ++e)
+      {
+      }
+    if (e == elemSize)
+      {
+      return;
+      }
+
+    // XOR a block of repeated elements at a time
+    unsigned char block[4096];
+    size_t perBlock = sizeof(block)/elemSize;
+    if (!perBlock)
+      {
+      size_t j;
+      for (j = 0; j < size; j += elemSize)
+        {
+        vtkVVPluginDeltaCodec::Copy(dst + j, elem, elemSize, 1);
+        }
+      return;
+      }
+    size_t blockSize = (perBlock < k ? perBlock : k)*elemSize;
+    vtkVVPluginDeltaCodec::Fill(block, elem, blockSize/elemSize, elemSize, 0);
+    size_t i;
+    for (i = 0; i < size; i += blockSize)
+      {
+      vtkVVPluginDeltaCodec::Copy(
+        dst + i, block, size - i < blockSize ? size - i : blockSize, 1);
+      }
+    }
+
+  static void Copy(unsigned char *dst, const unsigned char *src,
+                   size_t size, int doXor)
+    {
+    if (!doXor)
+      {
+      memcpy(dst, src, size);
+      return;
+      }
+    // a word at a time, then the bytes left
+    size_t i = 0;
+    for (; i + sizeof(size_t) <= size; i += sizeof(size_t))
+      {
+      size_t wd, ws;
+      memcpy(&wd, dst + i, sizeof(size_t));
+      memcpy(&ws, src + i, sizeof(size_t));
+      wd ^= ws;
+      memcpy(dst + i, &wd, sizeof(size_t));
+      }
+    for (; i < size; ++i)
+      {
+      dst[i] ^= src[i];
+      }
+    }
+};
+
+#endif
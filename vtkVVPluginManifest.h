@@ -0,0 +1,262 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkVVPluginManifest - cache of the properties set by plugins at load
+// .SECTION Description
+// A small header-only record of the properties (name, group, documentation,
+// flags, number of GUI items...) each plugin library sets from its Init
+// function, keyed by the path of the library and checked against its
+// modification time and size. It lets the plugin selector list the plugins
+// without opening every library at startup; the libraries are loaded when
+// first used. The record is saved as a text file, one block per plugin:
+//
+//   plugin <time> <size> <path>
+//   <property> <value>
+//   ...
+//   end
+//
+// with the newlines and backslashes of the values escaped.
+
+#ifndef __vtkVVPluginManifest_h
+#define __vtkVVPluginManifest_h
+
+#include <vtksys/SystemTools.hxx>
+
+#include <vtkstd/map>
+#include <vtkstd/string>
+#include <vtkstd/utility>
+#include <vtkstd/vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VTK_VV_PLUGIN_MANIFEST_VERSION "VolViewPluginManifest 1"
+
+class vtkVVPluginManifest
+{
+public:
+  typedef vtkstd::vector<vtkstd::pair<int, vtkstd::string> > PropertiesType;
+
+  vtkVVPluginManifest() : Modified(0) {}
+
+  // Description:
+  // Replace the content by the one of 'fileName'. A missing file, or one
+  // of another version, leaves the manifest empty. Return 0 on error.
+  int Read(const char *fileName)
+    {
+    this->Entries.clear();
+    this->Modified = 0;
+    FILE *fp = fileName ? fopen(fileName, "rb") : 0;
+    if (!fp)
+      {
+      return 0;
+      }
+    vtkstd::string line;
+    int ok = ReadLine(fp, line) && line == VTK_VV_PLUGIN_MANIFEST_VERSION;
+    EntryType *entry = 0;
+    while (ok && ReadLine(fp, line))
+      {
+      if (!entry)
+        {
+        unsigned long time, size;
+        int pos = 0;
+        ok = sscanf(line.c_str(), "plugin %lu %lu %n", &time, &size, &pos) >= 2
+          && pos > 0;
+        if (ok)
+          {
+          entry = &this->Entries[line.substr(pos)];
+          entry->Time = time;
+          entry->Size = size;
+          entry->Properties.clear();
+          }
+        }
+      else if (line == "end")
+        {
+        entry = 0;
+        }
+      else
+        {
+        vtkstd::string::size_type space = line.find(' ');
+        ok = space != vtkstd::string::npos;
+        if (ok)
+          {
+          entry->Properties.push_back(
+            vtkstd::make_pair(atoi(line.substr(0, space).c_str()),
+                              Unescape(line.substr(space + 1))));
+          }
+        }
+      }
+    fclose(fp);
+    if (!ok || entry)
+      {
+      this->Entries.clear();
+      return 0;
+      }
+    return 1;
+    }
+
+  // Description:
+  // Save the content to 'fileName'. Return 0 on error.
+  int Write(const char *fileName)
+    {
+    FILE *fp = fileName ? fopen(fileName, "wb") : 0;
+    if (!fp)
+      {
+      return 0;
+      }
+    fprintf(fp, "%s\n", VTK_VV_PLUGIN_MANIFEST_VERSION);
+    MapType::const_iterator it;
+    for (it = this->Entries.begin(); it != this->Entries.end(); ++it)
+      {
+      fprintf(fp, "plugin %lu %lu %s\n",
+              it->second.Time, it->second.Size, it->first.c_str());
+      PropertiesType::const_iterator p;
+      for (p = it->second.Properties.begin();
+           p != it->second.Properties.end(); ++p)
+        {
+        fprintf(fp, "%d %s\n", p->first, Escape(p->second).c_str());
+        }
+      fprintf(fp, "end\n");
+      }
+    int ok = !ferror(fp);
+    ok = !fclose(fp) && ok;
+    if (ok)
+      {
+      this->Modified = 0;
+      }
+    return ok;
+    }
+
+  // Description:
+  // Return the properties recorded for the library 'path', or NULL if there
+  // are none or the library changed since.
+  const PropertiesType *Find(const char *path)
+    {
+    MapType::const_iterator it = this->Entries.find(path);
+    if (it == this->Entries.end())
+      {
+      return 0;
+      }
+    unsigned long time, size;
+    GetFileStamp(path, &time, &size);
+    if (it->second.Time != time || it->second.Size != size)
+      {
+      return 0;
+      }
+    return &it->second.Properties;
+    }
+
+  // Description:
+  // Record the properties of the library 'path', as it is now.
+  void Set(const char *path, const PropertiesType &properties)
+    {
+    EntryType &entry = this->Entries[path];
+    GetFileStamp(path, &entry.Time, &entry.Size);
+    entry.Properties = properties;
+    this->Modified = 1;
+    }
+
+  // Description:
+  // Forget the libraries of directory 'dir' that do not exist anymore.
+  void RemoveMissing(const char *dir)
+    {
+    vtkstd::string prefix = dir;
+    prefix += "/";
+    MapType::iterator it = this->Entries.begin();
+    while (it != this->Entries.end())
+      {
+      MapType::iterator next = it;
+      ++next;
+      if (!it->first.compare(0, prefix.size(), prefix) &&
+          !vtksys::SystemTools::FileExists(it->first.c_str()))
+        {
+        this->Entries.erase(it);
+        this->Modified = 1;
+        }
+      it = next;
+      }
+    }
+
+  // Description:
+  // Has the content changed since the last Read() or Write()?
+  int GetModified() const { return this->Modified; }
+
+protected:
+  struct EntryType
+  {
+    unsigned long Time;
+    unsigned long Size;
+    PropertiesType Properties;
+  };
+  typedef vtkstd::map<vtkstd::string, EntryType> MapType;
+  MapType Entries;
+  int Modified;
+
+  static void GetFileStamp(const char *path,
+                           unsigned long *time, unsigned long *size)
+    {
+    *time = (unsigned long)vtksys::SystemTools::ModifiedTime(path);
+    *size = vtksys::SystemTools::FileLength(path);
+    }
+
+  static int ReadLine(FILE *fp, vtkstd::string &line)
+    {
+    line.erase();
+    int c;
+    while ((c = getc(fp)) != EOF && c != '\n')
+      {
+      line += (char)c;
+      }
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      {
+      line.erase(line.size() - 1);
+      }
+    return c != EOF || !line.empty();
+    }
+
+  static vtkstd::string Escape(const vtkstd::string &value)
+    {
+    vtkstd::string res;
+    vtkstd::string::size_type i;
+    for (i = 0; i < value.size(); ++i)
+      {
+      switch (value[i])
+        {
+        case '\\': res += "\\\\"; break;
+        case '\n': res += "\\n"; break;
+        case '\r': res += "\\r"; break;
+        default: res += value[i];
+        }
+      }
+    return res;
+    }
+
+  static vtkstd::string Unescape(const vtkstd::string &value)
+    {
+    vtkstd::string res;
+    vtkstd::string::size_type i;
+    for (i = 0; i < value.size(); ++i)
+      {
+      if (value[i] == '\\' && i + 1 < value.size())
+        {
+        ++i;
+        res += value[i] == 'n' ? '\n' : (value[i] == 'r' ? '\r' : value[i]);
+        }
+      else
+        {
+        res += value[i];
+        }
+      }
+    return res;
+    }
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkVVPluginMemoryPlanner - choose how to run a plugin in memory
+// .SECTION Description
+// A small header-only planner used by the plugin framework to decide how
+// a plugin is executed. It estimates, in bytes, the memory each way of
+// running the plugin needs on top of the input volume (already in memory)
+// and picks the fastest one that fits:
+//
+//   one piece with undo     - the input is kept and can be restored
+//   in place                - the output is written over the input
+//   series by volumes       - a series is passed one volume at a time
+//   one piece without undo  - the output replaces the input
+//   pieces                  - slabs with their Z overlap, through buffers
+//
+// The strategies that do not keep the input keep a compressed copy of it
+// for undo instead; when nothing fits with that copy, the plan gives up
+// undo. The estimates of the plugin itself are scaled by a factor learned
+// for each plugin from the peak memory measured during its previous runs
+// (see Calibrate()).
+
+#ifndef __vtkVVPluginMemoryPlanner_h
+#define __vtkVVPluginMemoryPlanner_h
+
+#include <vtkstd/map>
+#include <vtkstd/string>
+
+class vtkVVPluginMemoryPlanner
+{
+public:
+  enum
+  {
+    None = 0,
+    OnePieceWithUndo,
+    InPlace,
+    SeriesByVolumes,
+    OnePiece,
+    Pieces
+  };
+
+  // Description:
+  // What running the plugin involves, sizes in bytes.
+  struct RequestType
+  {
+    double InputBytes;
+    double OutputBytes;
+    // the largest stage of the plugin, besides its input and output
+    double IntermediateBytes;
+    int Slices;
+    int RequiredZOverlap;
+    // the plugin can process in place / in pieces, and the output has the
+    // layout of the input
+    int CanRunInPlace;
+    int CanRunInPieces;
+    // a series input: one volume, their number, and whether the plugin can
+    // take them one by one
+    double SeriesVolumeBytes;
+    int SeriesVolumes;
+    int CanRunSeriesByVolumes;
+    // the compressed copy of the input kept for undo when the input is not
+    // kept, at its largest (0 for no undo)
+    double UndoBytes;
+  };
+
+  // Description:
+  // A strategy, the extra memory it needs at its peak, whether that fits
+  // in the memory available, and whether the run can be undone.
+  struct PlanType
+  {
+    int Strategy;
+    double PeakBytes;
+    int Fits;
+    int Undo;
+  };
+
+  // Description:
+  // The memory needed by each strategy, None for those that cannot run.
+  static PlanType Estimate(const RequestType &req, int strategy,
+                           double calibration)
+    {
+    PlanType plan;
+    plan.Strategy = strategy;
+    plan.PeakBytes = 0;
+    plan.Fits = 0;
+    plan.Undo = strategy == OnePieceWithUndo || req.UndoBytes > 0;
+    double series = req.SeriesVolumeBytes*req.SeriesVolumes;
+    switch (strategy)
+      {
+      case OnePieceWithUndo:
+        // in place plugins keep a compressed copy of the input, the others
+        // keep the input itself and write a new output
+        plan.PeakBytes = (req.CanRunInPlace ? req.InputBytes :
+                          req.OutputBytes) + req.IntermediateBytes + series;
+        break;
+      case InPlace:
+        plan.PeakBytes = req.IntermediateBytes;
+        if (!req.CanRunInPlace || req.SeriesVolumes)
+          {
+          plan.Strategy = None;
+          }
+        break;
+      case SeriesByVolumes:
+        plan.PeakBytes = req.OutputBytes + req.IntermediateBytes +
+          req.SeriesVolumeBytes;
+        if (!req.SeriesVolumes || !req.CanRunSeriesByVolumes)
+          {
+          plan.Strategy = None;
+          }
+        break;
+      case OnePiece:
+        plan.PeakBytes = req.OutputBytes + req.IntermediateBytes + series;
+        break;
+      case Pieces:
+        {
+        if (!req.CanRunInPieces || req.SeriesVolumes || req.Slices <= 0)
+          {
+          plan.Strategy = None;
+          break;
+          }
+        // the two slab buffers of vtkVVPlugin::ProcessInPieces, and the
+        // plugin working on one slab and its halo
+        int slab = req.Slices/10;
+        slab = slab < req.RequiredZOverlap ? req.RequiredZOverlap : slab;
+        slab = slab < 1 ? 1 : slab;
+        double fraction = (double)slab/req.Slices;
+        double overlap = (double)(slab + req.RequiredZOverlap)/req.Slices;
+        overlap = overlap > 1 ? 1 : overlap;
+        plan.PeakBytes = 2*fraction*req.OutputBytes +
+          overlap*req.IntermediateBytes;
+        break;
+        }
+      default:
+        plan.Strategy = None;
+      }
+    plan.PeakBytes *= calibration;
+    if (strategy != OnePieceWithUndo)
+      {
+      plan.PeakBytes += req.UndoBytes;
+      }
+    return plan;
+    }
+
+  // Description:
+  // Choose the strategy for 'req' given the available memory and the total
+  // physical memory, in bytes. When nothing fits, the plan is the strategy
+  // needing the least memory, without undo, with Fits set to 0.
+  static PlanType Plan(const RequestType &req, double available,
+                       double physical, double calibration)
+    {
+    // keeping the input for undo is only worth it with plenty of memory
+    PlanType plan = Estimate(req, OnePieceWithUndo, calibration);
+    if (plan.PeakBytes <= 0.8*available && plan.PeakBytes <= 0.5*physical)
+      {
+      plan.Fits = 1;
+      return plan;
+      }
+    PlanType smallest = plan;
+    int strategy;
+    for (strategy = InPlace; strategy <= Pieces; ++strategy)
+      {
+      plan = Estimate(req, strategy, calibration);
+      if (plan.Strategy == None)
+        {
+        continue;
+        }
+      if (plan.PeakBytes <= 0.9*available)
+        {
+        plan.Fits = 1;
+        return plan;
+        }
+      if (plan.PeakBytes < smallest.PeakBytes)
+        {
+        smallest = plan;
+        }
+      }
+    if (req.UndoBytes > 0)
+      {
+      RequestType withoutUndo = req;
+      withoutUndo.UndoBytes = 0;
+      return Plan(withoutUndo, available, physical, calibration);
+      }
+    return smallest;
+    }
+
+  // Description:
+  // The factor applied to the estimates of plugin 'name', 1 at first.
+  double GetCalibration(const char *name) const
+    {
+    MapType::const_iterator it = this->Calibrations.find(name ? name : "");
+    return it == this->Calibrations.end() ? 1.0 : it->second;
+    }
+
+  // Description:
+  // Learn from a run of plugin 'name' that was estimated to need 'estimated'
+  // bytes with GetCalibration() and took 'measured' bytes at its peak.
+  // The factor follows the runs needing more memory than planned at once,
+  // the others slowly, so that the plans stay on the safe side. Runs too
+  // small to be measured reliably are ignored.
+  void Calibrate(const char *name, double estimated, double measured)
+    {
+    const double minimum = 16.0*1024*1024;
+    if (estimated < minimum && measured < minimum)
+      {
+      return;
+      }
+    double &factor = this->Calibrations[name ? name : ""];
+    double old = factor > 0 ? factor : 1.0;
+    double ratio = old*measured/(estimated > minimum ? estimated : minimum);
+    factor = ratio > old ? ratio : 0.5*(old + ratio);
+    factor = factor < 0.25 ? 0.25 : (factor > 16 ? 16 : factor);
+    }
+
+protected:
+  typedef vtkstd::map<vtkstd::string, double> MapType;
+  MapType Calibrations;
+};
+
+#endif
@@ -0,0 +1,309 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkVVPluginResultCache - compressed results of previous plugin runs
+// .SECTION Description
+// A small header-only cache of the volumes produced by plugins, used by
+// vtkVVPlugin so that applying a plugin again with the same settings on the
+// same data (after an undo, or going back and forth between two settings)
+// does not run it again. A result is found by a key made of the plugin, its
+// GUI values and a fingerprint of its input volumes (see GetFingerprint()),
+// and is kept encoded by vtkVVPluginDeltaCodec. The results least recently
+// used are dropped to keep the cache within a memory budget.
+
+#ifndef __vtkVVPluginResultCache_h
+#define __vtkVVPluginResultCache_h
+
+#include "vtkImageData.h"
+#include "vtkType.h"
+#include "vtkVVPluginDeltaCodec.h"
+
+#include <vtkstd/list>
+#include <vtkstd/map>
+#include <vtkstd/string>
+
+#include <string.h>
+
+class vtkVVPluginResultCache
+{
+public:
+  // Description:
+  // A volume produced by a plugin, with the meta info and the report the
+  // plugin set.
+  struct ResultType
+  {
+    int ScalarType;
+    int NumberOfComponents;
+    int Dimensions[3];
+    double Spacing[3];
+    double Origin[3];
+    vtkVVPluginDeltaCodec::BufferType Data;
+    vtkstd::string DistanceUnits;
+    vtkstd::string ScalarUnits[4];
+    int HasDistanceUnits;
+    int HasScalarUnits[4];
+    int IndependentComponents;
+    vtkstd::string ReportText;
+  };
+
+  vtkVVPluginResultCache() : Budget(0), MemorySize(0) {}
+  ~vtkVVPluginResultCache() { this->Clear(); }
+
+  // Description:
+  // Set/Get the memory the results may use, in bytes (0 for no limit).
+  void SetBudget(size_t budget) { this->Budget = budget; this->Trim(); }
+  size_t GetBudget() const { return this->Budget; }
+
+  // Description:
+  // Memory used by the results, and their number.
+  size_t GetMemorySize() const { return this->MemorySize; }
+  int GetNumberOfResults() const { return (int)this->Index.size(); }
+
+  // Description:
+  // A 64 bits fingerprint of the scalars of 'image'. It is only computed
+  // again once 'image' has been modified, so looking up the results of
+  // several plugins on the same data hashes it once.
+  vtkTypeUInt64 GetFingerprint(vtkImageData *image)
+    {
+    FingerprintType &fp = this->Fingerprints[image];
+    if (fp.Time == image->GetMTime() && fp.Time)
+      {
+      return fp.Value;
+      }
+    int *dim = image->GetDimensions();
+    size_t size = (size_t)dim[0]*dim[1]*dim[2]*
+      image->GetScalarSize()*image->GetNumberOfScalarComponents();
+    fp.Value = Hash(static_cast<const unsigned char *>(
+                      image->GetScalarPointer()), size);
+    fp.Time = image->GetMTime();
+    // forget the volumes that may be gone
+    if (this->Fingerprints.size() > 8)
+      {
+      FingerprintType last = fp;
+      this->Fingerprints.clear();
+      this->Fingerprints[image] = last;
+      }
+    return fp.Value;
+    }
+
+  // Description:
+  // Hash 'n' bytes, 8 at a time on four independent lanes so that the
+  // multiplications overlap.
+  static vtkTypeUInt64 Hash(const unsigned char *data, size_t n)
+    {
+    const vtkTypeUInt64 prime1 =
+      (static_cast<vtkTypeUInt64>(0x9E3779B1) << 32) | 0x85EBCA87;
+    const vtkTypeUInt64 prime2 =
+      (static_cast<vtkTypeUInt64>(0xC2B2AE3D) << 32) | 0x27D4EB4F;
+    vtkTypeUInt64 lane[4] = { prime1, prime2, ~prime1, ~prime2 };
+    size_t i = 0;
+    int k;
+    for (; i + 32 <= n; i += 32)
+      {
+      for (k = 0; k < 4; ++k)
+        {
+        vtkTypeUInt64 word;
+        memcpy(&word, data + i + 8*k, 8);
+        lane[k] = Rotate(lane[k] + word*prime2, 31)*prime1;
+        }
+      }
+    vtkTypeUInt64 h = (vtkTypeUInt64)n*prime1;
+    for (k = 0; k < 4; ++k)
+      {
+      h = Rotate(h ^ lane[k], 27)*prime1 + prime2;
+      }
+    for (; i < n; ++i)
+      {
+      h = Rotate(h ^ (data[i]*prime2), 23)*prime1;
+      }
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    return h;
+    }
+
+  // Description:
+  // The result stored under 'key', NULL if there is none. It becomes the
+  // most recently used.
+  const ResultType *Find(const vtkstd::string &key)
+    {
+    IndexType::iterator it = this->Index.find(key);
+    if (it == this->Index.end())
+      {
+      return 0;
+      }
+    this->Results.splice(this->Results.begin(), this->Results, it->second);
+    return it->second->second;
+    }
+
+  // Description:
+  // Encode the layout and scalars of 'image' into a new result, not in the
+  // cache yet. Return NULL if it would not fit in the budget.
+  ResultType *NewResult(vtkImageData *image)
+    {
+    ResultType *result = new ResultType;
+    result->ScalarType = image->GetScalarType();
+    result->NumberOfComponents = image->GetNumberOfScalarComponents();
+    image->GetDimensions(result->Dimensions);
+    image->GetSpacing(result->Spacing);
+    image->GetOrigin(result->Origin);
+    result->HasDistanceUnits = 0;
+    int i;
+    for (i = 0; i < 4; ++i)
+      {
+      result->HasScalarUnits[i] = 0;
+      }
+    result->IndependentComponents = -1;
+
+    int elemSize = image->GetScalarSize()*result->NumberOfComponents;
+    const unsigned char *data =
+      static_cast<const unsigned char *>(image->GetScalarPointer());
+    size_t slice = (size_t)result->Dimensions[0]*result->Dimensions[1];
+    vtkVVPluginDeltaCodec::BufferType encoded;
+    int z;
+    for (z = 0; z < result->Dimensions[2]; ++z)
+      {
+      vtkVVPluginDeltaCodec::Encode(
+        data + z*slice*elemSize, slice, elemSize, encoded);
+      if (this->Budget && encoded.size() > this->Budget)
+        {
+        delete result;
+        return 0;
+        }
+      }
+    // drop the slack left by the growth of the vector
+    vtkVVPluginDeltaCodec::BufferType(encoded).swap(result->Data);
+    return result;
+    }
+
+  // Description:
+  // Store 'result' under 'key', replacing the result already there. The
+  // cache takes ownership of it, and drops the least recently used results
+  // if over budget.
+  void Insert(const vtkstd::string &key, ResultType *result)
+    {
+    this->Remove(key);
+    this->Results.push_front(EntryType(key, result));
+    this->Index[key] = this->Results.begin();
+    this->MemorySize += GetResultSize(result);
+    this->Trim();
+    }
+
+  // Description:
+  // Give 'image' the layout and the scalars of 'result'.
+  static void Restore(const ResultType *result, vtkImageData *image)
+    {
+    int *dim = image->GetDimensions();
+    size_t n = (size_t)result->Dimensions[0]*result->Dimensions[1]*
+      result->Dimensions[2];
+    if (result->ScalarType == image->GetScalarType() &&
+        result->NumberOfComponents == image->GetNumberOfScalarComponents() &&
+        result->Dimensions[0] == dim[0] && result->Dimensions[1] == dim[1] &&
+        result->Dimensions[2] == dim[2])
+      {
+      vtkVVPluginDeltaCodec::Decode(
+        result->Data, static_cast<unsigned char *>(image->GetScalarPointer()),
+        n, image->GetScalarSize()*result->NumberOfComponents);
+      image->SetSpacing(result->Spacing[0], result->Spacing[1],
+                        result->Spacing[2]);
+      image->SetOrigin(result->Origin[0], result->Origin[1],
+                       result->Origin[2]);
+      image->Modified();
+      return;
+      }
+
+    vtkImageData *restored = vtkImageData::New();
+    restored->SetScalarType(result->ScalarType);
+    restored->SetNumberOfScalarComponents(result->NumberOfComponents);
+    restored->SetSpacing(result->Spacing[0], result->Spacing[1],
+                         result->Spacing[2]);
+    restored->SetOrigin(result->Origin[0], result->Origin[1],
+                        result->Origin[2]);
+    restored->SetDimensions(result->Dimensions[0], result->Dimensions[1],
+                            result->Dimensions[2]);
+    restored->AllocateScalars();
+    vtkVVPluginDeltaCodec::Decode(
+      result->Data, static_cast<unsigned char *>(restored->GetScalarPointer()),
+      n, restored->GetScalarSize()*result->NumberOfComponents);
+    image->ShallowCopy(restored);
+    image->Modified();
+    restored->Delete();
+    }
+
+  // Description:
+  // Drop all the results.
+  void Clear()
+    {
+    ListType::iterator it;
+    for (it = this->Results.begin(); it != this->Results.end(); ++it)
+      {
+      delete it->second;
+      }
+    this->Results.clear();
+    this->Index.clear();
+    this->Fingerprints.clear();
+    this->MemorySize = 0;
+    }
+
+protected:
+  // the results, the most recently used first
+  typedef vtkstd::pair<vtkstd::string, ResultType *> EntryType;
+  typedef vtkstd::list<EntryType> ListType;
+  typedef vtkstd::map<vtkstd::string, ListType::iterator> IndexType;
+  ListType Results;
+  IndexType Index;
+  size_t Budget;
+  size_t MemorySize;
+
+  struct FingerprintType
+  {
+    FingerprintType() : Time(0), Value(0) {}
+    unsigned long Time;
+    vtkTypeUInt64 Value;
+  };
+  vtkstd::map<vtkImageData *, FingerprintType> Fingerprints;
+
+  static vtkTypeUInt64 Rotate(vtkTypeUInt64 x, int r)
+    {
+    return (x << r) | (x >> (64 - r));
+    }
+
+  static size_t GetResultSize(const ResultType *result)
+    {
+    return result->Data.capacity() + result->ReportText.size();
+    }
+
+  void Remove(const vtkstd::string &key)
+    {
+    IndexType::iterator it = this->Index.find(key);
+    if (it == this->Index.end())
+      {
+      return;
+      }
+    this->MemorySize -= GetResultSize(it->second->second);
+    delete it->second->second;
+    this->Results.erase(it->second);
+    this->Index.erase(it);
+    }
+
+  // drop the least recently used results until the rest fits in the budget
+  void Trim()
+    {
+    while (this->Budget && this->MemorySize > this->Budget &&
+           !this->Results.empty())
+      {
+      vtkstd::string key = this->Results.back().first;
+      this->Remove(key);
+      }
+    }
+};
+
+#endif
@@ -15,6 +15,7 @@
 #include "vtkDirectory.h"
 #include "vtkDynamicLoader.h"
 #include "vtkImageData.h"
+#include "vtkTimerLog.h"
 
 #include "vtkKWApplication.h"
 #include "vtkKWEvent.h"
@@ -26,12 +27,14 @@
 #include "vtkKWMenuButtonWithLabel.h"
 #include "vtkKWProgressGauge.h"
 #include "vtkKWPushButton.h"
+#include "vtkKWRenderWidget.h"
 #include "vtkKWVolumeWidget.h"
 #include "vtkKWOptions.h"
 
 #include "vtkVVDataItemVolume.h"
 #include "vtkVVPlugin.h"
 #include "vtkVVPluginInterface.h"
+#include "vtkVVPluginManifest.h"
 #include "vtkVVPluginSelector.h"
 #include "vtkVVWindowBase.h"
 #include "vtkVVSelectionFrame.h"
@@ -64,6 +67,7 @@
 #define VTK_VV_PLUGINS_UNDO_TEXT "Undo Last Applied Plugin"
 #define VTK_VV_PLUGINS_REDO_TEXT "Redo Last Applied Plugin"
 #define VTK_VV_PLUGINS_NO_UNDO_TEXT "Undo Not Available"
+#define VTK_VV_PLUGINS_NO_REDO_TEXT "Redo Not Available"
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro( vtkVVPluginSelector );
@@ -83,7 +87,9 @@ vtkVVPluginSelector::vtkVVPluginSelector()
   this->ReloadButton     = vtkKWPushButton::New();
   this->PluginFrame      = vtkKWFrame::New();
   this->ApplyButton      = vtkKWPushButton::New();
+  this->PreviewButton    = vtkKWPushButton::New();
   this->UndoButton       = vtkKWPushButton::New();
+  this->RedoButton       = vtkKWPushButton::New();
 #ifdef KWVolView_PLUGINS_USE_SPLINE
   this->RemoveMeshButton = vtkKWPushButton::New();
 #endif
@@ -96,6 +102,27 @@ vtkVVPluginSelector::vtkVVPluginSelector()
   this->DistanceUnits = 0;
 
   this->PluginInterface = NULL;
+
+  this->ExecutingDataItem = NULL;
+
+  this->UndoDataItem = NULL;
+  this->SavedUndoData = NULL;
+  this->SavedUndoDataTime = 0;
+  this->SavedUndoDataPending = 0;
+  this->UndoMemoryBudget = 0;
+  this->SetUndoMemoryBudget(1024);
+  this->ResultCacheMemoryBudget = 0;
+
+  this->PreviewSavedData = NULL;
+  this->PreviewDataItem = NULL;
+  this->PreviewSavedDataTime = 0;
+  this->PreviewInput = NULL;
+  this->PreviewInputDataItem = NULL;
+  this->PreviewInputTime = 0;
+  for (i = 0; i < 7; i++)
+    {
+    this->PreviewInputRegion[i] = 0;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -126,6 +153,12 @@ vtkVVPluginSelector::~vtkVVPluginSelector()
     this->ApplyButton->Delete();
     this->ApplyButton = NULL;
     }
+
+  if (this->PreviewButton)
+    {
+    this->PreviewButton->Delete();
+    this->PreviewButton = NULL;
+    }
     
   if (this->UndoButton)
     {
@@ -133,6 +166,21 @@ vtkVVPluginSelector::~vtkVVPluginSelector()
     this->UndoButton = NULL;
     }
 
+  if (this->RedoButton)
+    {
+    this->RedoButton->Delete();
+    this->RedoButton = NULL;
+    }
+
+  this->UndoStack.DeleteEntry(this->SavedUndoData);
+
+  this->ClearPreview();
+  if (this->PreviewInput)
+    {
+    this->PreviewInput->Delete();
+    this->PreviewInput = NULL;
+    }
+
 #ifdef KWVolView_PLUGINS_USE_SPLINE
   if (this->RemoveMeshButton)
     {
@@ -309,6 +357,20 @@ void vtkVVPluginSelector::CreateWidget()
   tk_cmd << "pack " << this->ApplyButton->GetWidgetName()
          << " -side left -padx 2 -pady 2 -fill x -expand y" << endl;
 
+  // --------------------------------------------------------------
+  // Preview plugin
+
+  this->PreviewButton->SetParent(this);
+  this->PreviewButton->Create();
+  this->PreviewButton->SetText("Preview");
+  this->PreviewButton->SetCommand(this, "PreviewPluginCallback");
+  this->PreviewButton->SetBalloonHelpString(
+    "Run the plugin on a downsampled copy of the data, or inside the "
+    "cropping box only, and show the result until the plugin is applied.");
+
+  tk_cmd << "pack " << this->PreviewButton->GetWidgetName()
+         << " -side left -padx 2 -pady 2 -fill x -expand y" << endl;
+
   // --------------------------------------------------------------
   // Undo plugin
 
@@ -320,6 +382,17 @@ void vtkVVPluginSelector::CreateWidget()
   tk_cmd << "pack " << this->UndoButton->GetWidgetName()
          << " -side left -padx 2 -pady 2 -fill x -expand y" << endl;
 
+  // --------------------------------------------------------------
+  // Redo plugin
+
+  this->RedoButton->SetParent(this);
+  this->RedoButton->Create();
+  this->RedoButton->SetText(VTK_VV_PLUGINS_REDO_TEXT);
+  this->RedoButton->SetCommand(this, "RedoCallback");
+
+  tk_cmd << "pack " << this->RedoButton->GetWidgetName()
+         << " -side left -padx 2 -pady 2 -fill x -expand y" << endl;
+
   // --------------------------------------------------------------
   // Remove mesh
 
@@ -375,6 +448,22 @@ int vtkVVPluginSelectorSortPlugins(const void *arg1, const void *arg2)
   return (10 * strcmp(group1, group2) + strcmp(name1, name2));
 }
 
+//----------------------------------------------------------------------------
+static vtkstd::string vtkVVPluginSelectorGetManifestFileName(
+  vtkKWApplication *app, const char *plugpath)
+{
+  // one manifest per user if possible, the plugins directory may be
+  // read-only
+  vtkstd::string dir = plugpath;
+  const char *user_dir = app->GetUserDataDirectory();
+  if (user_dir && *user_dir && 
+      vtksys::SystemTools::MakeDirectory(user_dir))
+    {
+    dir = user_dir;
+    }
+  return dir + "/PluginsManifest.txt";
+}
+
 //----------------------------------------------------------------------------
 void vtkVVPluginSelector::LoadPlugins()
 {
@@ -383,6 +472,10 @@ void vtkVVPluginSelector::LoadPlugins()
     return;
     }
 
+  // The plugins may have been rebuilt, their previous results are stale
+  this->ClearPreview();
+  this->ClearResultCache();
+
   // Find all the plugins, they start with vv and end with .dll
   // or .do .sl etc
 
@@ -407,12 +500,21 @@ void vtkVVPluginSelector::LoadPlugins()
 #endif
   
   int old_nb_plugins = this->GetNumberOfPlugins();
+
+  // The properties of the plugins loaded by a previous session are kept in
+  // a manifest, only the new or modified libraries are opened now. The
+  // others are loaded when first selected or applied.
+
+  vtkstd::string manifest_file = 
+    vtkVVPluginSelectorGetManifestFileName(this->GetApplication(), plugpath);
+  vtkVVPluginManifest manifest;
+  manifest.Read(manifest_file.c_str());
   
   // Collect all the plugins and install those that have not been 
   // installed yet
 
-  int i, numFiles = dir->GetNumberOfFiles(), loaded = 0;
-  clock_t start_clock = clock();
+  int i, numFiles = dir->GetNumberOfFiles(), loaded = 0, deferred = 0;
+  double start_time = vtkTimerLog::GetUniversalTime();
   for (i = 0; i < numFiles; ++i)
     {
     const char *fname = dir->GetFile(i);
@@ -422,8 +524,22 @@ void vtkVVPluginSelector::LoadPlugins()
       sprintf(fullPath, "%s/%s", plugpath, fname);
 
       vtkVVPlugin *plugin = vtkVVPlugin::New();
-      if (!plugin->Load(fullPath, this->GetApplication()) &&
-          !this->HasPlugin(plugin->GetName(), plugin->GetGroup()))
+      int res = 0;
+      const vtkVVPluginManifest::PropertiesType *description = 
+        manifest.Find(fullPath);
+      if (description)
+        {
+        plugin->LoadDescription(fullPath, *description);
+        }
+      else
+        {
+        res = plugin->Load(fullPath, this->GetApplication());
+        if (!res)
+          {
+          manifest.Set(fullPath, plugin->GetDescription());
+          }
+        }
+      if (!res && !this->HasPlugin(plugin->GetName(), plugin->GetGroup()))
         {
         if (this->Window)
           {
@@ -440,19 +556,28 @@ void vtkVVPluginSelector::LoadPlugins()
             (int)(100.0 * (float)i / (float)numFiles));
           }
         loaded++;
+        if (!plugin->GetLoaded())
+          {
+          deferred++;
+          }
         this->Plugins->AppendItem(plugin);
 
-        // Create the plugin
+        // The plugin is created when first shown, see EnsureLoaded()
 
         plugin->SetParent(this->PluginFrame);
         plugin->SetWindow(this->Window);
-        plugin->Create();
         plugin->Register(this);
         }
       plugin->Delete();
       }
     }
 
+  manifest.RemoveMissing(plugpath);
+  if (manifest.GetModified())
+    {
+    manifest.Write(manifest_file.c_str());
+    }
+
 #ifdef _MSC_VER  
   // restore directory
  _chdir(cwd);
@@ -460,14 +585,15 @@ void vtkVVPluginSelector::LoadPlugins()
 
  if (this->Window && this->GetNumberOfPlugins())
     {
-    clock_t end_clock = clock();
     this->Window->GetProgressGauge()->SetValue(0);
     char buffer[256];
     sprintf(buffer, 
-            "Loading plugins (%d new, %d total) -- Done (in %0.2f s.)",
+            "Loading plugins (%d new, %d not loaded yet, %d total) "
+            "-- Done (in %0.2f s.)",
             loaded, 
+            deferred,
             this->GetNumberOfPlugins(), 
-            (double)(end_clock - start_clock) / (double)CLOCKS_PER_SEC);
+            vtkTimerLog::GetUniversalTime() - start_time);
     this->Window->SetStatusText(buffer);
     }
 
@@ -727,56 +853,60 @@ void vtkVVPluginSelector::Update()
 //----------------------------------------------------------------------------
 void vtkVVPluginSelector::UpdateUndoButton()
 {
-  // Should the undo button be enabled?
+  // Should the undo/redo buttons be enabled?
 
   if (!this->IsCreated())
     {
     return;
     }
 
-  // Check if I have undo data for the selected data item and the selected
-  // plugin.
-  vtkVVPlugin *plugin = this->GetPlugin(this->GetSelectedPluginIndex());
-  bool can_not_undo = 
-    !plugin || !this->Window || !this->Window->GetSelectedDataItem();
-  if (!can_not_undo) 
-    {
-    vtkVVDataItemVolume *volume_data = 
-      vtkVVDataItemVolume::SafeDownCast(this->Window->GetSelectedDataItem());
-    // Check if the operation can be redone/undone.
-    if (volume_data &&
-        volume_data->GetUndoRedoPluginName() && 
-        (volume_data->GetUndoRedoImageDataType() == vtkVVDataItemVolume::Undo ||
-         volume_data->GetUndoRedoImageDataType() == vtkVVDataItemVolume::Redo) &&
-        volume_data->GetUndoRedoImageData())
-      {
-      // Now check if it is an Undo or a Redo and set the appropriate text 
-      // and callback
-      if (volume_data->GetUndoRedoImageDataType() == vtkVVDataItemVolume::Undo)
-        {
-        this->UndoButton->SetText(VTK_VV_PLUGINS_UNDO_TEXT);
-        this->UndoButton->SetBalloonHelpString(VTK_VV_PLUGINS_UNDO_TEXT);
-        this->UndoButton->SetCommand(this, "UndoCallback");
-        }
-      if (volume_data->GetUndoRedoImageDataType() == vtkVVDataItemVolume::Redo)
-        {
-        this->UndoButton->SetText(VTK_VV_PLUGINS_REDO_TEXT);
-        this->UndoButton->SetBalloonHelpString(VTK_VV_PLUGINS_REDO_TEXT);
-        this->UndoButton->SetCommand(this, "RedoCallback");
-        }
-      }
-    else
-      {
-      can_not_undo = true; // Undo data does not exist
-      }
+  // Check the undo history of the selected data item, and release the
+  // volumes compressed in the background meanwhile
+
+  vtkVVDataItemVolume *volume_data = this->Window ? 
+    vtkVVDataItemVolume::SafeDownCast(this->Window->GetSelectedDataItem()) : 0;
+  vtkVVPluginUndoStack *stack = this->GetUndoStack(volume_data);
+  if (stack)
+    {
+    stack->Collect();
     }
-  
-  if (can_not_undo)
+
+  vtkVVPluginUndoStack::EntryType *entry = stack ? stack->GetUndoEntry() : 0;
+  if (entry)
+    {
+    vtksys_ios::ostringstream help;
+    help << "Undo " << entry->Name << " (" << stack->GetNumberOfUndoLevels()
+         << " level(s), " << stack->GetMemorySize()/(1024*1024) 
+         << " MB of history)";
+    this->UndoButton->SetText(VTK_VV_PLUGINS_UNDO_TEXT);
+    this->UndoButton->SetBalloonHelpString(help.str().c_str());
+    this->UndoButton->SetEnabled(
+      this->GetEnabled() && !this->ExecutingDataItem);
+    }
+  else
     {
     this->UndoButton->SetText(VTK_VV_PLUGINS_NO_UNDO_TEXT);
     this->UndoButton->SetBalloonHelpString(VTK_VV_PLUGINS_NO_UNDO_TEXT);
     this->UndoButton->SetEnabled(0);
     }
+
+  entry = stack ? stack->GetRedoEntry() : 0;
+  if (entry)
+    {
+    vtksys_ios::ostringstream help;
+    help << "Redo " << entry->Name << " (" << stack->GetNumberOfRedoLevels()
+         << " level(s))";
+    this->RedoButton->SetText(VTK_VV_PLUGINS_REDO_TEXT);
+    this->RedoButton->SetBalloonHelpString(help.str().c_str());
+    this->RedoButton->SetEnabled(
+      this->GetEnabled() && !this->ExecutingDataItem);
+    }
+  else
+    {
+    this->RedoButton->SetText(VTK_VV_PLUGINS_NO_REDO_TEXT);
+    this->RedoButton->SetBalloonHelpString(VTK_VV_PLUGINS_NO_REDO_TEXT);
+    this->RedoButton->SetEnabled(0);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -815,7 +945,12 @@ int vtkVVPluginSelector::HasPlugin(const char *plugin_name, const char *group)
 //----------------------------------------------------------------------------
 int vtkVVPluginSelector::SelectPlugin(const char *plugin_name, const char *group)
 {
-  this->SelectedPlugin = this->GetPluginIndex(plugin_name, group);
+  int selected = this->GetPluginIndex(plugin_name, group);
+  if (selected != this->SelectedPlugin)
+    {
+    this->ClearPreview();
+    }
+  this->SelectedPlugin = selected;
 
   if (!this->IsCreated())
     {
@@ -847,6 +982,12 @@ void vtkVVPluginSelector::UpdateSelectedPlugin()
   // Update the selected plugin, if any
 
   vtkVVPlugin *plugin = this->GetPlugin(this->SelectedPlugin);
+  if (plugin && plugin->EnsureLoaded(this->GetApplication()))
+    {
+    vtkWarningMacro("The plugin " << plugin->GetName() << " could not be "
+                    "loaded from " << plugin->GetFileName());
+    plugin = NULL;
+    }
   if (plugin)
     {
     plugin->Update();
@@ -1064,33 +1205,69 @@ int vtkVVPluginSelector::ApplyPlugin(const char *plugin_name, const char *group)
     return 0;
     }
 
-  // Make sure it is up-to-date
+  // One plugin at a time
+
+  if (this->ExecutingDataItem)
+    {
+    vtkWarningMacro("The plugin to apply (" << plugin->GetName() << ") "
+                    "cannot run while another plugin is running.");
+    return 0;
+    }
+
+  // Make sure it is loaded and up-to-date
 
+  if (plugin->EnsureLoaded(this->GetApplication()))
+    {
+    vtkWarningMacro("The plugin to apply (" << plugin->GetName() << ") could "
+                    "not be loaded from " << plugin->GetFileName() << ". No "
+                    "modification will be performed on the data.");
+    return 0;
+    }
+  // The plugin runs on the data, not on the preview shown in its place
+
+  this->ClearPreview();
   plugin->Update();
   
-  // It seems the grab has no impact on the menubar, so try to disable
-  // it manually
+  // Disable the menubar, opening or closing data while the plugin runs is
+  // not supported
 
   if (this->Window)
     {
     this->Window->GetMenu()->SetEnabled(0);
     }
 
-  // Perform a grab and change the text
+  // The plugin runs in the background, the rest of the GUI stays usable but
+  // this widget is left with the Cancel button only (see
+  // UpdateEnableState())
 
+  vtkVVDataItemVolume *volume_data = vtkVVDataItemVolume::SafeDownCast(
+    this->Window ? this->Window->GetSelectedDataItem() : 0);
+  if (volume_data)
+    {
+    this->ExecutingDataItem = volume_data;
+    this->ExecutingDataItem->Register(this);
+    }
   this->ApplyButton->SetText("Cancel");
   this->ApplyButton->SetCommand(this, "CancelPluginCallback");
-  this->ApplyButton->Grab();
+  this->UpdateEnableState();
+  this->DisableExecutingViews();
 
   // Execute the plugin
 
   plugin->Execute(this);
 
-  // Release the grab
+  // Restore the widget, for the data item selected now
+
+  this->RestoreExecutingViews();
 
-  this->ApplyButton->ReleaseGrab();
+  if (this->ExecutingDataItem)
+    {
+    this->ExecutingDataItem->UnRegister(this);
+    this->ExecutingDataItem = NULL;
+    }
   this->ApplyButton->SetText("Apply Plugin");
   this->ApplyButton->SetCommand(this, "ApplyPluginCallback");
+  this->Update();
 
   // Reenable the menubar
 
@@ -1102,6 +1279,52 @@ int vtkVVPluginSelector::ApplyPlugin(const char *plugin_name, const char *group)
   return 1;
 }
 
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::DisableExecutingViews()
+{
+  if (!this->Window || !this->ExecutingDataItem)
+    {
+    return;
+    }
+
+  // the executing item is still the selected one here
+  int nb_rw = this->Window->GetNumberOfRenderWidgetsUsingSelectedDataItem();
+  for (int i = 0; i < nb_rw; i++)
+    {
+    vtkKWRenderWidget *rw = 
+      this->Window->GetNthRenderWidgetUsingSelectedDataItem(i);
+    if (!rw)
+      {
+      continue;
+      }
+    ExecutingViewType view;
+    view.RenderWidget = rw;
+    view.RenderMode = rw->GetRenderMode();
+    view.Enabled = rw->GetEnabled();
+    rw->Register(this);
+    rw->SetRenderModeToDisabled();
+    // removes the interaction bindings, and with them the interactor
+    // widgets editing the data
+    rw->SetEnabled(0);
+    this->ExecutingViews.push_back(view);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::RestoreExecutingViews()
+{
+  vtkstd::vector<ExecutingViewType>::iterator it;
+  for (it = this->ExecutingViews.begin(); 
+       it != this->ExecutingViews.end(); ++it)
+    {
+    it->RenderWidget->SetEnabled(it->Enabled);
+    it->RenderWidget->SetRenderMode(it->RenderMode);
+    it->RenderWidget->Render();
+    it->RenderWidget->UnRegister(this);
+    }
+  this->ExecutingViews.clear();
+}
+
 //----------------------------------------------------------------------------
 int vtkVVPluginSelector::ApplySelectedPlugin()
 {
@@ -1114,54 +1337,411 @@ int vtkVVPluginSelector::ApplySelectedPlugin()
 }
 
 //----------------------------------------------------------------------------
-void vtkVVPluginSelector::SetUndoData(vtkImageData *undoImageData)
+vtkVVDataItemVolume* vtkVVPluginSelector::GetActiveDataItem()
 {
-  // Get the plugin name
+  if (this->ExecutingDataItem)
+    {
+    return this->ExecutingDataItem;
+    }
+  return this->Window ? 
+    vtkVVDataItemVolume::SafeDownCast(this->Window->GetSelectedDataItem()) : 0;
+}
 
-  vtkVVPlugin *plugin = this->GetPlugin(this->GetSelectedPluginIndex());
+//----------------------------------------------------------------------------
+int vtkVVPluginSelector::PreviewSelectedPlugin()
+{
+  vtkVVPlugin *plugin = this->GetPlugin(this->SelectedPlugin);
+  if (!plugin || this->ExecutingDataItem || 
+      plugin->EnsureLoaded(this->GetApplication()))
+    {
+    return 0;
+    }
+  plugin->Preview(this);
+  return 1;
+}
 
-  vtksys_ios::ostringstream full_name;
-  this->GetPluginPrettyName(full_name, plugin->GetName(), plugin->GetGroup());
-  
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::ShowPreview(vtkImageData *display)
+{
   vtkVVDataItemVolume *volume_data = vtkVVDataItemVolume::SafeDownCast(
     this->Window->GetSelectedDataItem());
-  if (!volume_data)
-    { 
+  if (!display || !volume_data || !volume_data->GetImageData())
+    {
     return;
     }
-  
-  if (!volume_data->SetUndoRedoImageData(undoImageData))
+
+  // keep the data itself only once, for a preview replacing another one
+  if (this->PreviewDataItem != volume_data)
     {
-    return; // Was the same undo data before.. 
+    this->ClearPreview();
     }
-  
-  volume_data->SetUndoRedoImageDataTypeToUndo();
-  volume_data->SetUndoRedoPluginName(full_name.str().c_str());
- 
-  if (undoImageData)
-    {
-    // also store the current settings of the widgets, this meta information
-    // should really be in the ImageData object itself
-    this->SetDistanceUnits(volume_data->GetDistanceUnits());
-    this->SetScalarUnits(0,volume_data->GetScalarUnits(0));
-    this->SetScalarUnits(1,volume_data->GetScalarUnits(1));
-    this->SetScalarUnits(2,volume_data->GetScalarUnits(2));
-    this->SetScalarUnits(3,volume_data->GetScalarUnits(3));
-    this->SetIndependentComponents(
-      volume_data->GetVolumeProperty()->GetIndependentComponents());
+  vtkImageData *image = volume_data->GetImageData();
+  if (!this->PreviewSavedData)
+    {
+    this->PreviewSavedData = vtkImageData::New();
+    this->PreviewSavedData->ShallowCopy(image);
+    this->PreviewSavedDataTime = image->GetMTime();
+    this->PreviewDataItem = volume_data;
+    this->PreviewDataItem->Register(this);
     }
-  else
+  image->ShallowCopy(display);
+  image->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::ClearPreview()
+{
+  if (!this->PreviewSavedData)
+    {
+    return;
+    }
+
+  vtkImageData *image = this->PreviewDataItem->GetImageData();
+  if (image)
     {
-    int i;
-    for (i=0; i< VTK_MAX_VRCOMP; i++)
+    // the data is back as it was, the copy previews run on still applies
+    image->ShallowCopy(this->PreviewSavedData);
+    image->Modified();
+    if (this->PreviewInputDataItem == this->PreviewDataItem &&
+        this->PreviewInputTime >= this->PreviewSavedDataTime)
       {
-      this->SetScalarUnits(i,0);
+      this->PreviewInputTime = image->GetMTime();
       }
     }
-  
-  //this->Modified();
+  this->PreviewSavedData->Delete();
+  this->PreviewSavedData = NULL;
+  this->PreviewDataItem->UnRegister(this);
+  this->PreviewDataItem = NULL;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* vtkVVPluginSelector::GetPreviewInput(
+  vtkVVDataItemVolume *volume_data, const int extent[6], int factor)
+{
+  vtkImageData *image = volume_data ? volume_data->GetImageData() : NULL;
+  if (!image || factor < 1)
+    {
+    return NULL;
+    }
+
+  int i;
+  int same = (this->PreviewInput && 
+              this->PreviewInputDataItem == volume_data && 
+              this->PreviewInputTime >= image->GetMTime() &&
+              this->PreviewInputRegion[6] == factor);
+  for (i = 0; i < 6 && same; i++)
+    {
+    same = (this->PreviewInputRegion[i] == extent[i]);
+    }
+  if (same)
+    {
+    return this->PreviewInput;
+    }
+
+  int *dim = image->GetDimensions();
+  for (i = 0; i < 3; i++)
+    {
+    if (extent[2*i] < 0 || extent[2*i + 1] >= dim[i] || 
+        extent[2*i] > extent[2*i + 1])
+      {
+      return NULL;
+      }
+    }
+
+  // every 'factor' voxels of the region, with the spacing and origin that
+  // keep them in place
+  int pdim[3];
+  double *spacing = image->GetSpacing();
+  double *origin = image->GetOrigin();
+  if (!this->PreviewInput)
+    {
+    this->PreviewInput = vtkImageData::New();
+    }
+  vtkImageData *preview = this->PreviewInput;
+  preview->Initialize();
+  for (i = 0; i < 3; i++)
+    {
+    pdim[i] = (extent[2*i + 1] - extent[2*i])/factor + 1;
+    }
+  preview->SetScalarType(image->GetScalarType());
+  preview->SetNumberOfScalarComponents(image->GetNumberOfScalarComponents());
+  preview->SetSpacing(spacing[0]*factor, spacing[1]*factor, 
+                      spacing[2]*factor);
+  preview->SetOrigin(origin[0] + spacing[0]*extent[0],
+                     origin[1] + spacing[1]*extent[2],
+                     origin[2] + spacing[2]*extent[4]);
+  preview->SetDimensions(pdim);
+  preview->AllocateScalars();
+
+  size_t elem = image->GetScalarSize()*image->GetNumberOfScalarComponents();
+  const unsigned char *src = 
+    static_cast<const unsigned char *>(image->GetScalarPointer());
+  unsigned char *dst = static_cast<unsigned char *>(preview->GetScalarPointer());
+  int x, y, z;
+  for (z = 0; z < pdim[2]; z++)
+    {
+    for (y = 0; y < pdim[1]; y++)
+      {
+      const unsigned char *row = src + elem*
+        (((size_t)(extent[4] + z*factor)*dim[1] + extent[2] + y*factor)*dim[0] +
+         extent[0]);
+      if (factor == 1)
+        {
+        memcpy(dst, row, elem*pdim[0]);
+        dst += elem*pdim[0];
+        continue;
+        }
+      for (x = 0; x < pdim[0]; x++, dst += elem)
+        {
+        memcpy(dst, row + elem*x*factor, elem);
+        }
+      }
+    }
+
+  this->PreviewInputDataItem = volume_data;
+  this->PreviewInputTime = image->GetMTime();
+  for (i = 0; i < 6; i++)
+    {
+    this->PreviewInputRegion[i] = extent[i];
+    }
+  this->PreviewInputRegion[6] = factor;
+  return preview;
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::SetUndoData(vtkImageData *undoImageData)
+{
+  if (!undoImageData || this->UndoMemoryBudget <= 0)
+    {
+    this->ClearUndoHistory();
+    return;
+    }
+
+  // the data is compressed by a worker thread, the caller lets go of it
+  this->PushUndoEntry(this->UndoStack.NewSnapshot(undoImageData, 1, 0), 0);
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::SetUndoDelta(vtkVVPluginDeltaCodec::BufferType &delta)
+{
+  vtkVVDataItemVolume *volume_data = this->GetActiveDataItem();
+  if (!volume_data || !volume_data->GetImageData())
+    { 
+    return;
+    }
+
+  this->PushUndoEntry(vtkVVPluginUndoStack::NewDifference(
+                        volume_data->GetImageData(), delta), 0);
+}
+
+//----------------------------------------------------------------------------
+int vtkVVPluginSelector::SaveUndoData(vtkImageData *undoImageData,
+                                      int withinBudget)
+{
+  this->UndoStack.DeleteEntry(this->SavedUndoData);
+  this->SavedUndoData = NULL;
+  this->SavedUndoDataPending = 0;
+
+  vtkVVDataItemVolume *volume_data = this->GetActiveDataItem();
+  if (!volume_data || !undoImageData)
+    {
+    return 0;
+    }
+  this->SavedUndoDataPending = 1;
+  this->SavedUndoDataTime = undoImageData->GetMTime();
+
+  // the copy has to fit in the budget with the history, give up early. It
+  // is encoded by the worker thread of the history while the events are
+  // processed, the data is only modified once it is done.
+  if (this->UndoMemoryBudget > 0 || !withinBudget)
+    {
+    this->UndoStack.Collect();
+    vtkKWApplication *app = this->GetApplication();
+    size_t limit = 
+      withinBudget ? (size_t)this->UndoMemoryBudget*1024*1024 : 0;
+    this->SavedUndoData = this->UndoStack.NewSnapshot(
+      undoImageData, app ? 1 : 0, limit);
+    while (app && !this->UndoStack.IsEncoded(this->SavedUndoData))
+      {
+      app->ProcessPendingEvents();
+      vtksys::SystemTools::Delay(VTK_VV_PLUGIN_BACKGROUND_POLL);
+      }
+    if (this->SavedUndoData && this->SavedUndoData->Data.empty())
+      {
+      this->UndoStack.DeleteEntry(this->SavedUndoData);
+      this->SavedUndoData = NULL;
+      }
+    }
+  if (!this->SavedUndoData)
+    {
+    return 0;
+    }
+
+  // the plugin may change the meta info before CommitUndoData()
+  this->GetUndoProperties(volume_data, this->SavedUndoData->Properties);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::CommitUndoData(vtkImageData *id)
+{
+  if (!this->SavedUndoDataPending)
+    {
+    return;
+    }
+  vtkVVPluginUndoStack::EntryType *entry = this->SavedUndoData;
+  this->SavedUndoData = NULL;
+  this->SavedUndoDataPending = 0;
+
+  // nothing to undo if the plugin failed or did not modify the data
+  if (!id || id->GetMTime() == this->SavedUndoDataTime)
+    {
+    this->UndoStack.DeleteEntry(entry);
+    return;
+    }
+
+  // the data was modified without a copy, the history does not lead to it
+  if (!entry)
+    {
+    this->ClearUndoHistory();
+    return;
+    }
+
+  // only keep what changed when the layout is the same
+  vtkVVPluginUndoStack::ConvertToDifference(entry, id);
+  vtkVVPluginUndoStack::PropertiesType properties = entry->Properties;
+  this->PushUndoEntry(entry, &properties);
+}
+
+//----------------------------------------------------------------------------
+int vtkVVPluginSelector::RestoreSavedUndoData(vtkImageData *id)
+{
+  if (!this->SavedUndoDataPending || !this->SavedUndoData || !id ||
+      !vtkVVPluginUndoStack::RestoreSnapshot(this->SavedUndoData, id))
+    {
+    return 0;
+    }
+
+  // the data is as it was, there is nothing to commit
+  this->UndoStack.DeleteEntry(this->SavedUndoData);
+  this->SavedUndoData = NULL;
+  this->SavedUndoDataPending = 0;
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+size_t vtkVVPluginSelector::GetSavedUndoDataSize()
+{
+  return this->SavedUndoData ? this->SavedUndoData->Data.size() : 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::ClearUndoHistory()
+{
+  this->UndoStack.Clear();
+  this->UndoDataItem = NULL;
+
+  int i;
+  for (i=0; i< VTK_MAX_VRCOMP; i++)
+    {
+    this->SetScalarUnits(i,0);
+    }
 
-  // Update the undo button
+  this->UpdateUndoButton();
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::SetUndoMemoryBudget(int budget)
+{
+  budget = budget < 0 ? 0 : budget;
+  if (this->UndoMemoryBudget == budget)
+    {
+    return;
+    }
+  this->UndoMemoryBudget = budget;
+  if (budget)
+    {
+    this->UndoStack.SetBudget((size_t)budget*1024*1024);
+    }
+  else
+    {
+    this->ClearUndoHistory();
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::SetResultCacheMemoryBudget(int budget)
+{
+  budget = budget < 0 ? 0 : budget;
+  if (this->ResultCacheMemoryBudget == budget)
+    {
+    return;
+    }
+  this->ResultCacheMemoryBudget = budget;
+  if (budget)
+    {
+    this->ResultCache.SetBudget((size_t)budget*1024*1024);
+    }
+  else
+    {
+    this->ClearResultCache();
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::ClearResultCache()
+{
+  this->ResultCache.Clear();
+}
+
+//----------------------------------------------------------------------------
+vtkVVPluginResultCache* vtkVVPluginSelector::GetResultCache()
+{
+  return this->ResultCacheMemoryBudget > 0 ? &this->ResultCache : NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::PushUndoEntry(
+  vtkVVPluginUndoStack::EntryType *entry,
+  const vtkVVPluginUndoStack::PropertiesType *properties)
+{
+  vtkVVDataItemVolume *volume_data = this->GetActiveDataItem();
+  if (!entry || !volume_data || this->UndoMemoryBudget <= 0)
+    {
+    this->UndoStack.DeleteEntry(entry);
+    return;
+    }
+
+  // the history follows a single data item
+  if (volume_data != this->UndoDataItem)
+    {
+    this->UndoStack.Clear();
+    this->UndoDataItem = volume_data;
+    }
+
+  vtksys_ios::ostringstream full_name;
+  vtkVVPlugin *plugin = this->GetPlugin(this->GetSelectedPluginIndex());
+  if (plugin)
+    {
+    this->GetPluginPrettyName(full_name, plugin->GetName(), plugin->GetGroup());
+    }
+
+  // the plugin has not changed the meta info yet, unless given
+  vtkVVPluginUndoStack::PropertiesType current;
+  if (!properties)
+    {
+    this->GetUndoProperties(volume_data, current);
+    properties = &current;
+    }
+
+  // the data item keeps the name of the last plugin applied, the undo data
+  // itself is in the history
+  volume_data->SetUndoRedoImageData(0);
+  volume_data->SetUndoRedoPluginName(full_name.str().c_str());
+
+  this->UndoStack.Push(entry, full_name.str().c_str(), *properties);
   this->UpdateUndoButton();
 }
 
@@ -1239,47 +1819,87 @@ void vtkVVPluginSelector::PushNewProperties()
 }
 
 //----------------------------------------------------------------------------
-void vtkVVPluginSelector::Undo()
+vtkVVPluginUndoStack* vtkVVPluginSelector::GetUndoStack(
+  vtkVVDataItemVolume *volume_data)
 {
-  // Replace the input data with the undo data using shallow copies
-  vtkVVDataItemVolume *volume_data = vtkVVDataItemVolume::SafeDownCast(
-                              this->Window->GetSelectedDataItem());
-  if (!volume_data)
+  return (volume_data && volume_data == this->UndoDataItem && 
+          volume_data->GetImageData()) ? &this->UndoStack : NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::GetUndoProperties(
+  vtkVVDataItemVolume *volume_data,
+  vtkVVPluginUndoStack::PropertiesType &properties)
+{
+  // this meta information should really be in the ImageData object itself
+  const char *units = volume_data->GetDistanceUnits();
+  properties.HasDistanceUnits = units ? 1 : 0;
+  properties.DistanceUnits = units ? units : "";
+  int j;
+  for (j = 0; j < 4; ++j)
     {
-    return;
+    units = volume_data->GetScalarUnits(j);
+    properties.HasScalarUnits[j] = units ? 1 : 0;
+    properties.ScalarUnits[j] = units ? units : "";
     }
-  vtkImageData *image_data = volume_data->GetImageData();
-  vtkImageData *undo_data = volume_data->GetUndoRedoImageData();
+  properties.IndependentComponents =
+    volume_data->GetVolumeProperty()->GetIndependentComponents();
+}
 
-  // Check if we have the image and undo datas and that that the data is really
-  // an UNDO data.
-  if (!image_data || !undo_data || !this->Window ||
-      volume_data->GetUndoRedoImageDataType() != vtkVVDataItemVolume::Undo)
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::SwapUndoProperties(
+  vtkVVPluginUndoStack::PropertiesType &properties)
+{
+  // PushNewProperties() pushes out the meta info of the ivars and leaves
+  // the previous one there
+  this->SetDistanceUnits(
+    properties.HasDistanceUnits ? properties.DistanceUnits.c_str() : 0);
+  int j;
+  for (j = 0; j < 4; ++j)
     {
-    return;
+    this->SetScalarUnits(
+      j, properties.HasScalarUnits[j] ? properties.ScalarUnits[j].c_str() : 0);
     }
-  
-  vtkImageData *tempID = vtkImageData::New();
-  tempID->ShallowCopy(undo_data);
-  undo_data->ShallowCopy(image_data);
-  image_data->ShallowCopy(tempID);
-  
-  // push out new properties
+  this->SetIndependentComponents(properties.IndependentComponents);
+
   this->PushNewProperties();
 
-  // Always leave the undo data as more recent
-  //undo_data->Modified();
+  properties.HasDistanceUnits = this->DistanceUnits ? 1 : 0;
+  properties.DistanceUnits = this->DistanceUnits ? this->DistanceUnits : "";
+  for (j = 0; j < 4; ++j)
+    {
+    const char *units = this->GetScalarUnits(j);
+    properties.HasScalarUnits[j] = units ? 1 : 0;
+    properties.ScalarUnits[j] = units ? units : "";
+    }
+  properties.IndependentComponents = this->IndependentComponents;
+}
 
-  if (this->IsCreated())
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::Undo()
+{
+  if (this->ExecutingDataItem)
+    {
+    return;
+    }
+
+  this->ClearPreview();
+
+  // Replace the data with the last level of the history, which gets the
+  // current data for redo
+  vtkVVDataItemVolume *volume_data = vtkVVDataItemVolume::SafeDownCast(
+                              this->Window->GetSelectedDataItem());
+  vtkVVPluginUndoStack *stack = this->GetUndoStack(volume_data);
+  vtkVVPluginUndoStack::EntryType *entry = stack ? stack->GetUndoEntry() : 0;
+  if (!entry || !stack->Undo(volume_data->GetImageData()))
     {
-    // Now that we just did a Undo, the next operation we can do is Redo
-    this->UndoButton->SetText(VTK_VV_PLUGINS_REDO_TEXT);
-    this->UndoButton->SetBalloonHelpString(VTK_VV_PLUGINS_REDO_TEXT);
-    this->UndoButton->SetCommand(this, "RedoCallback");
-    volume_data->SetUndoRedoImageDataTypeToRedo();
+    return;
     }
   
-  tempID->Delete();
+  // push out new properties
+  this->SwapUndoProperties(entry->Properties);
+
+  this->UpdateUndoButton();
 }
 
 //BTX
@@ -1300,42 +1920,28 @@ void vtkVVPluginSelector::RemoveMesh()
 //----------------------------------------------------------------------------
 void vtkVVPluginSelector::Redo()
 {
-  // Replace the input data with the redo data using shallow copies
-  vtkVVDataItemVolume *volume_data = vtkVVDataItemVolume::SafeDownCast(
-                              this->Window->GetSelectedDataItem());
-  if (!volume_data)
+  if (this->ExecutingDataItem)
     {
     return;
     }
-  vtkImageData *image_data = volume_data->GetImageData();
-  vtkImageData *redo_data = volume_data->GetUndoRedoImageData();
-  if (!image_data || !redo_data || !this->Window ||
-      volume_data->GetUndoRedoImageDataType() != vtkVVDataItemVolume::Redo)
+
+  this->ClearPreview();
+
+  // Replace the data with the next level of the history, which gets the
+  // current data for undo
+  vtkVVDataItemVolume *volume_data = vtkVVDataItemVolume::SafeDownCast(
+                              this->Window->GetSelectedDataItem());
+  vtkVVPluginUndoStack *stack = this->GetUndoStack(volume_data);
+  vtkVVPluginUndoStack::EntryType *entry = stack ? stack->GetRedoEntry() : 0;
+  if (!entry || !stack->Redo(volume_data->GetImageData()))
     {
     return;
     }
   
-  vtkImageData *tempID = vtkImageData::New();
-  tempID->ShallowCopy(redo_data);
-  redo_data->ShallowCopy(image_data);
-  image_data->ShallowCopy(tempID);
-  
   // push out new properties
-  this->PushNewProperties();
-
-  // Always leave the redo data as more recent
-  //redo_data->Modified();
+  this->SwapUndoProperties(entry->Properties);
 
-  if (this->IsCreated())
-    {
-    // Now that we just did a Redo, the next operation we can do is Undo
-    this->UndoButton->SetText(VTK_VV_PLUGINS_UNDO_TEXT);
-    this->UndoButton->SetBalloonHelpString(VTK_VV_PLUGINS_UNDO_TEXT);
-    this->UndoButton->SetCommand(this, "UndoCallback");
-    volume_data->SetUndoRedoImageDataTypeToUndo();
-    }
-  
-  tempID->Delete();
+  this->UpdateUndoButton();
 }
 
 //----------------------------------------------------------------------------
@@ -1366,6 +1972,12 @@ void vtkVVPluginSelector::RemoveMeshCallback()
 #endif
 //ETX
 
+//----------------------------------------------------------------------------
+void vtkVVPluginSelector::PreviewPluginCallback()
+{
+  this->PreviewSelectedPlugin();
+}
+
 //----------------------------------------------------------------------------
 void vtkVVPluginSelector::ApplyPluginCallback()
 {
@@ -1421,16 +2033,48 @@ void vtkVVPluginSelector::UpdateEnableState()
     enabled = 0;
     }
 
+  // while a plugin runs, only its Cancel button is left
+  if (this->ExecutingDataItem)
+    {
+    if (this->ReloadButton)
+      {
+      this->ReloadButton->SetEnabled(0);
+      }
+    if (this->PluginsMenu)
+      {
+      this->PluginsMenu->SetEnabled(0);
+      }
+    if (this->ApplyButton)
+      {
+      this->ApplyButton->SetEnabled(this->GetEnabled());
+      }
+    enabled = 0;
+    }
+  else if (this->ApplyButton)
+    {
+    this->ApplyButton->SetEnabled(enabled);
+    }
+
   if (plugin)
     {
     plugin->SetEnabled(enabled);
     }
-  if (this->ApplyButton)
+  if (this->PreviewButton)
     {
-    this->ApplyButton->SetEnabled(enabled);
+    this->PreviewButton->SetEnabled(
+      enabled && plugin && plugin->CanBePreviewed());
     }
 
-  this->PropagateEnableState(this->UndoButton);
+  if (this->ExecutingDataItem)
+    {
+    this->UndoButton->SetEnabled(0);
+    this->RedoButton->SetEnabled(0);
+    }
+  else
+    {
+    this->PropagateEnableState(this->UndoButton);
+    this->PropagateEnableState(this->RedoButton);
+    }
 #ifdef KWVolView_PLUGINS_USE_SPLINE
   this->PropagateEnableState(this->RemoveMeshButton);
 #endif
@@ -1538,6 +2182,9 @@ void vtkVVPluginSelector::PrintSelf(ostream& os, vtkIndent indent)
 
   os << indent << "Window: " << this->Window << endl;
   os << indent << "SelectedPlugin: " << this->SelectedPlugin << endl;
+  os << indent << "UndoMemoryBudget: " << this->UndoMemoryBudget << endl;
+  os << indent << "ResultCacheMemoryBudget: " 
+     << this->ResultCacheMemoryBudget << endl;
   os << indent << "Image metadata: " << endl;
   os << indent << "Independent Components: " << this->IndependentComponents << endl;
   if (this->DistanceUnits)
@@ -16,14 +16,22 @@
 
 #include "vtkKWCompositeWidget.h"
 #include "vtkKWVolViewConfigure.h" // KWVolView_PLUGINS_USE_SPLINE and such
+#include "vtkVVPluginResultCache.h" // for the results of previous runs
+#include "vtkVVPluginUndoStack.h" // for the undo history
+
+//BTX
+#include <vtkstd/vector> // for the views of the executing data item
+//ETX
 
 class vtkImageData;
 class vtkKWFrame;
+class vtkKWRenderWidget;
 class vtkKWMenuButtonWithLabel;
 class vtkKWPushButton;
 class vtkVVPlugin;
 class vtkVVWindowBase;
 class vtkVVPluginInterface;
+class vtkVVDataItemVolume;
 
 //BTX
 template<class DataType> class vtkVector;
@@ -72,6 +80,36 @@ public:
   virtual int ApplyPlugin(const char *plugin_name, const char *group = 0);
   virtual int ApplySelectedPlugin();
 
+  // Description:
+  // The data item plugins apply to: the one a plugin is running on, or the
+  // selected one. A plugin runs in the background, another data item can
+  // be selected meanwhile; the rest of this widget is disabled until it is
+  // done, except for the Cancel button.
+  vtkVVDataItemVolume* GetActiveDataItem();
+  int IsExecuting() { return this->ExecutingDataItem ? 1 : 0; }
+
+  // Description:
+  // Preview the currently selected plugin on a reduced copy of the data
+  // (see vtkVVPlugin::Preview()). Returns 0 on error, 1 on success.
+  virtual int PreviewSelectedPlugin();
+
+  // Description:
+  // Show 'display', the result of a preview, in place of the selected data
+  // until ClearPreview() puts the data back. Applying a plugin, undo, redo
+  // and selecting another plugin clear the preview.
+  void ShowPreview(vtkImageData *display);
+  void ClearPreview();
+  int HasPreview() { return this->PreviewSavedData ? 1 : 0; }
+
+//BTX
+  // Description:
+  // The copy of the data of 'volume_data' a preview runs on: the voxels of
+  // 'extent' every 'factor' voxels along each axis. It is kept for the next
+  // previews until the data is modified.
+  vtkImageData *GetPreviewInput(vtkVVDataItemVolume *volume_data,
+                                const int extent[6], int factor);
+//ETX
+
   // Description:
   // Cancel a plugin given the plugin name (and optionally group), or cancel
   // the currently selected plugin, or cancel all plugins.
@@ -91,8 +129,68 @@ public:
     int nb, const char *plugin_names[], const char *groups[]);
 
   // Description:
-  // Allows a plugin to specify undo data
+  // Allows a plugin to specify undo data: the data before it ran, that it
+  // does not modify anymore. It is added to the undo history of the
+  // selected data item, compressed in the background. NULL clears the
+  // history.
   void SetUndoData(vtkImageData *id);
+
+//BTX
+  // Description:
+  // Allows a plugin that processed the data in place to specify undo data
+  // as the XOR difference between the original and the current data,
+  // encoded by vtkVVPluginDeltaCodec. The content of 'delta' is swapped in,
+  // 'delta' is left empty.
+  void SetUndoDelta(vtkVVPluginDeltaCodec::BufferType &delta);
+//ETX
+
+  // Description:
+  // Keep a compressed copy of the data a plugin is about to modify, for
+  // plugins that do not keep their input. The copy is encoded in the
+  // background while the GUI events are processed, and takes at most
+  // vtkVVPluginUndoStack::GetMaximumSnapshotSize() bytes. CommitUndoData()
+  // adds it to the undo history if the data was modified since, as the
+  // difference with the new data when possible. When the copy does not fit
+  // in the undo memory budget, SaveUndoData() returns 0 and modifying the
+  // data clears the history. GetSavedUndoDataSize() returns the size of
+  // the copy. Unless 'withinBudget' is set, the copy is kept whatever its
+  // size, for the plugins that restore the data from it on failure (see
+  // RestoreSavedUndoData()); the history drops it on commit if too big.
+  int SaveUndoData(vtkImageData *id, int withinBudget = 1);
+  void CommitUndoData(vtkImageData *id);
+
+  // Description:
+  // Put the copy kept by SaveUndoData() back into the data after a plugin
+  // failed half way through it, and drop the copy. Return 0 if there was
+  // no copy to restore from.
+  int RestoreSavedUndoData(vtkImageData *id);
+//BTX
+  size_t GetSavedUndoDataSize();
+//ETX
+
+  // Description:
+  // Drop all the undo/redo levels.
+  void ClearUndoHistory();
+
+  // Description:
+  // Set/Get the memory the undo history may use, in MB. The oldest levels
+  // are dropped beyond it.
+  virtual void SetUndoMemoryBudget(int);
+  vtkGetMacro(UndoMemoryBudget, int);
+
+  // Description:
+  // Set/Get the memory the results of previous plugin runs may use, in MB.
+  // When it is not 0, applying a plugin again with the same settings on
+  // the same data reuses its result instead of running it. 0 by default.
+  virtual void SetResultCacheMemoryBudget(int);
+  vtkGetMacro(ResultCacheMemoryBudget, int);
+  void ClearResultCache();
+
+//BTX
+  // Description:
+  // The cache of the results of previous runs, NULL if it is disabled.
+  vtkVVPluginResultCache *GetResultCache();
+//ETX
   
   // Description
   // support for undo and redo
@@ -109,6 +207,7 @@ public:
   virtual void SelectPluginCallback(
     const char *plugin_name, const char *group);
   virtual void ApplyPluginCallback();
+  virtual void PreviewPluginCallback();
   virtual void CancelPluginCallback();
   virtual void UndoCallback();
   virtual void RedoCallback();
@@ -165,7 +264,9 @@ protected:
   vtkKWPushButton          *ReloadButton;
   vtkKWFrame               *PluginFrame;
   vtkKWPushButton          *ApplyButton;
+  vtkKWPushButton          *PreviewButton;
   vtkKWPushButton          *UndoButton;
+  vtkKWPushButton          *RedoButton;
 #ifdef KWVolView_PLUGINS_USE_SPLINE
   vtkKWPushButton          *RemoveMeshButton;
 #endif
@@ -178,8 +279,70 @@ protected:
 
   int SelectedPlugin;
 
+  // the data item the plugin being applied runs on
+  vtkVVDataItemVolume *ExecutingDataItem;
+
+  // The plugin may write into the data and label map of that item while
+  // it runs: its views neither render nor take user interaction (paintbrush,
+  // markers, cropping) until it is done
+  virtual void DisableExecutingViews();
+  virtual void RestoreExecutingViews();
+  //BTX
+  struct ExecutingViewType
+  {
+    vtkKWRenderWidget *RenderWidget;
+    int RenderMode;
+    int Enabled;
+  };
+  vtkstd::vector<ExecutingViewType> ExecutingViews;
+  //ETX
+
   // when redo or undo we need to propagate the meta info
   virtual void PushNewProperties();
+
+  // the undo history, for the data item UndoDataItem only
+  //BTX
+  vtkVVPluginUndoStack UndoStack;
+  vtkVVPluginUndoStack::EntryType *SavedUndoData;
+  //ETX
+  vtkVVDataItemVolume *UndoDataItem;
+  unsigned long SavedUndoDataTime;
+  int SavedUndoDataPending;
+  int UndoMemoryBudget;
+
+  //BTX
+  vtkVVPluginResultCache ResultCache;
+  //ETX
+  int ResultCacheMemoryBudget;
+
+  // the data a preview is shown in place of, and its data item
+  vtkImageData *PreviewSavedData;
+  vtkVVDataItemVolume *PreviewDataItem;
+  unsigned long PreviewSavedDataTime;
+
+  // the copy of the data previews run on, see GetPreviewInput()
+  vtkImageData *PreviewInput;
+  vtkVVDataItemVolume *PreviewInputDataItem;
+  unsigned long PreviewInputTime;
+  int PreviewInputRegion[7];
+
+  //BTX
+  // add a level to the history of the selected data item, with the given
+  // meta info or the current one if NULL
+  virtual void PushUndoEntry(
+    vtkVVPluginUndoStack::EntryType *entry,
+    const vtkVVPluginUndoStack::PropertiesType *properties);
+
+  // get the meta info of the data item, or swap it with the one of a level
+  virtual void GetUndoProperties(
+    vtkVVDataItemVolume *volume_data,
+    vtkVVPluginUndoStack::PropertiesType &properties);
+  virtual void SwapUndoProperties(
+    vtkVVPluginUndoStack::PropertiesType &properties);
+
+  // the undo history of the data item, NULL if it has none
+  virtual vtkVVPluginUndoStack* GetUndoStack(vtkVVDataItemVolume *volume_data);
+  //ETX
   
   // Description:
   // Are the scalar components of this data independent of each other?
@@ -205,9 +368,9 @@ protected:
   virtual void UpdatePluginsMenuEnableState();
 
   // Description:
-  // Updates the Undo and redo buttons. This checks the current data item volume,
-  // checks if it can be undone or redone for this plugin and displays 
-  // the appropriate text.
+  // Updates the Undo and redo buttons. This checks the undo history of the
+  // current data item volume and displays the plugin each button would
+  // undo or redo.
   virtual void UpdateUndoButton();
 
   // Update the selection
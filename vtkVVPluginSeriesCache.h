@@ -0,0 +1,207 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkVVPluginSeriesCache - the volumes of a series input, on demand
+// .SECTION Description
+// A small header-only cache handing out the volumes of a series one at a
+// time, used by vtkVVPlugin to implement the GetSeriesVolume and
+// ReleaseSeriesVolume entries of vtkVVPluginInfo for the plugins that set
+// VVP_SUPPORTS_PAGED_SERIES_INPUT. A volume is read when first asked for
+// and kept while in use. A few of the volumes no longer in use are kept
+// too, the least recently used are dropped beyond that. When a scratch
+// file is given, the volumes are read into that file mapped in memory
+// instead: dropping a volume only lets the system take back its pages, it
+// is paged in again from the file rather than read and decoded again.
+// Accesses are serialized, the plugins may use it from several threads.
+
+#ifndef __vtkVVPluginSeriesCache_h
+#define __vtkVVPluginSeriesCache_h
+
+#include "vtkMutexLock.h"
+#include "vvPluginMappedFile.h"
+
+#include <vtkstd/list>
+#include <vtkstd/string>
+#include <vtkstd/vector>
+
+#include <stdio.h>
+
+class vtkVVPluginSeriesCache
+{
+public:
+  // Description:
+  // The function reading volume 'volume' into the 'size' bytes of
+  // 'buffer'. Return 0 on error.
+  typedef int (*ReaderType)(void *clientData, int volume,
+                            void *buffer, size_t size);
+
+  vtkVVPluginSeriesCache() : VolumeSize(0), Keep(0), Reader(0),
+                             ClientData(0) {}
+  ~vtkVVPluginSeriesCache() { this->Clear(); }
+
+  // Description:
+  // Hand out 'numberOfVolumes' volumes of 'volumeSize' bytes read by
+  // 'reader', keeping at most 'keep' of those not in use. The volumes go to
+  // 'scratchFile' when not NULL; return 0 if it cannot be mapped, the
+  // volumes are kept in memory then.
+  int Initialize(int numberOfVolumes, size_t volumeSize, int keep,
+                 ReaderType reader, void *clientData, const char *scratchFile)
+    {
+    this->Clear();
+    this->Lock.Lock();
+    VolumeType empty = { 0, 0, 0 };
+    this->Volumes.assign(numberOfVolumes > 0 ? numberOfVolumes : 0, empty);
+    this->VolumeSize = volumeSize;
+    this->Keep = keep;
+    this->Reader = reader;
+    this->ClientData = clientData;
+    int ok = 1;
+    if (scratchFile && !this->Volumes.empty())
+      {
+      ok = this->Scratch.Open(scratchFile, this->Volumes.size()*volumeSize, 1);
+      if (ok)
+        {
+        this->ScratchFile = scratchFile;
+        }
+      }
+    this->Lock.Unlock();
+    return ok;
+    }
+
+  // Description:
+  // The scalars of volume 'volume', read if needed, or NULL if it cannot
+  // be read. They stay valid until Release() is called for each Acquire().
+  const void *Acquire(int volume)
+    {
+    if (volume < 0 || volume >= (int)this->Volumes.size())
+      {
+      return 0;
+      }
+    this->Lock.Lock();
+    VolumeType &vol = this->Volumes[volume];
+    if (vol.Data)
+      {
+      if (!vol.Users)
+        {
+        this->Unused.remove(volume);
+        }
+      }
+    else if (this->Scratch.GetPointer())
+      {
+      unsigned char *data =
+        this->Scratch.GetPointer() + volume*this->VolumeSize;
+      if (!vol.InScratch &&
+          this->Reader(this->ClientData, volume, data, this->VolumeSize))
+        {
+        vol.InScratch = 1;
+        }
+      vol.Data = vol.InScratch ? data : 0;
+      }
+    else
+      {
+      vol.Data = new unsigned char [this->VolumeSize];
+      if (!this->Reader(this->ClientData, volume, vol.Data, this->VolumeSize))
+        {
+        delete [] vol.Data;
+        vol.Data = 0;
+        }
+      }
+    if (vol.Data)
+      {
+      vol.Users++;
+      }
+    const void *data = vol.Data;
+    this->Lock.Unlock();
+    return data;
+    }
+
+  // Description:
+  // Let go of a volume given by Acquire().
+  void Release(int volume)
+    {
+    if (volume < 0 || volume >= (int)this->Volumes.size())
+      {
+      return;
+      }
+    this->Lock.Lock();
+    VolumeType &vol = this->Volumes[volume];
+    if (vol.Data && vol.Users > 0 && --vol.Users == 0)
+      {
+      this->Unused.push_front(volume);
+      while ((int)this->Unused.size() > this->Keep)
+        {
+        this->Drop(this->Unused.back());
+        this->Unused.pop_back();
+        }
+      }
+    this->Lock.Unlock();
+    }
+
+  // Description:
+  // Drop all the volumes, in use or not, and remove the scratch file.
+  void Clear()
+    {
+    this->Lock.Lock();
+    size_t i;
+    for (i = 0; i < this->Volumes.size(); ++i)
+      {
+      this->Drop((int)i);
+      }
+    this->Volumes.clear();
+    this->Unused.clear();
+    this->Scratch.Close();
+    if (!this->ScratchFile.empty())
+      {
+      remove(this->ScratchFile.c_str());
+      this->ScratchFile = "";
+      }
+    this->Lock.Unlock();
+    }
+
+protected:
+  struct VolumeType
+  {
+    unsigned char *Data;
+    int Users;
+    int InScratch;
+  };
+  vtkstd::vector<VolumeType> Volumes;
+  // the volumes in memory but not in use, the most recently used first
+  vtkstd::list<int> Unused;
+  size_t VolumeSize;
+  int Keep;
+  ReaderType Reader;
+  void *ClientData;
+  vvPluginMappedFile Scratch;
+  vtkstd::string ScratchFile;
+  vtkSimpleMutexLock Lock;
+
+  void Drop(int volume)
+    {
+    VolumeType &vol = this->Volumes[volume];
+    if (!vol.Data)
+      {
+      return;
+      }
+    if (this->Scratch.GetPointer())
+      {
+      this->Scratch.Release(volume*this->VolumeSize, this->VolumeSize);
+      }
+    else
+      {
+      delete [] vol.Data;
+      }
+    vol.Data = 0;
+    vol.Users = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,537 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkVVPluginUndoStack - compressed undo/redo history of a volume
+// .SECTION Description
+// A small header-only history of the changes made by plugins to a volume,
+// used by vtkVVPluginSelector. Each level is kept either as a snapshot of
+// the whole volume (when a plugin changed its type or dimensions) or as
+// the XOR difference between the volumes before and after the plugin, both
+// encoded by vtkVVPluginDeltaCodec. A difference is mostly made of runs of
+// zeros outside of the slabs the plugin changed, so most levels take a
+// small fraction of the volume.
+//
+// A snapshot given uncompressed is encoded by a worker thread while the
+// user goes on, and holds on to the volume until then. The oldest levels
+// are dropped to keep the whole history within a memory budget.
+//
+// Levels [0, Position) can be undone, the last one first, and levels
+// [Position, size) redone. Undoing or redoing a level swaps its volume
+// with the current one, so that the same level is used both ways.
+
+#ifndef __vtkVVPluginUndoStack_h
+#define __vtkVVPluginUndoStack_h
+
+#include "vtkImageData.h"
+#include "vtkMultiThreader.h"
+#include "vtkMutexLock.h"
+#include "vtkVVPluginDeltaCodec.h"
+
+#include <vtkstd/string>
+#include <vtkstd/vector>
+
+class vtkVVPluginUndoStack
+{
+public:
+  enum { Snapshot = 0, Difference };
+
+  // Description:
+  // The metadata of the volume of a level, restored with it.
+  struct PropertiesType
+  {
+    vtkstd::string DistanceUnits;
+    vtkstd::string ScalarUnits[4];
+    int HasDistanceUnits;
+    int HasScalarUnits[4];
+    int IndependentComponents;
+  };
+
+  struct EntryType
+  {
+    int Kind;
+    vtkstd::string Name;
+    PropertiesType Properties;
+    // the layout of the volume (the snapshot, or the volume a difference
+    // applies to)
+    int ScalarType;
+    int NumberOfComponents;
+    int Dimensions[3];
+    double Spacing[3];
+    double Origin[3];
+    vtkVVPluginDeltaCodec::BufferType Data;
+    // the snapshot being encoded by a worker thread
+    vtkImageData *Pending;
+    int ThreadId;
+    int Done;
+  };
+
+  vtkVVPluginUndoStack() : Position(0), Budget(0)
+    {
+    this->Threader = vtkMultiThreader::New();
+    }
+  ~vtkVVPluginUndoStack()
+    {
+    this->Clear();
+    this->Threader->Delete();
+    }
+
+  // Description:
+  // Set/Get the memory the history may use, in bytes (0 for no limit).
+  void SetBudget(size_t budget) { this->Budget = budget; this->Trim(); }
+  size_t GetBudget() const { return this->Budget; }
+
+  // Description:
+  // Number of levels that can be undone or redone.
+  int GetNumberOfUndoLevels() const { return (int)this->Position; }
+  int GetNumberOfRedoLevels() const
+    { return (int)(this->Entries.size() - this->Position); }
+
+  // Description:
+  // The level Undo() or Redo() would use, NULL if there is none.
+  EntryType *GetUndoEntry()
+    { return this->Position ? this->Entries[this->Position - 1] : 0; }
+  EntryType *GetRedoEntry()
+    {
+    return this->Position < this->Entries.size() ?
+      this->Entries[this->Position] : 0;
+    }
+
+  // Description:
+  // Memory used by the history, in bytes. The snapshots not encoded yet
+  // count for their full size.
+  size_t GetMemorySize()
+    {
+    this->Collect();
+    size_t total = 0;
+    size_t i;
+    for (i = 0; i < this->Entries.size(); ++i)
+      {
+      total += GetEntrySize(this->Entries[i]);
+      }
+    return total;
+    }
+
+  // Description:
+  // Create a snapshot of 'image', not in the history yet. When 'background'
+  // is set 'image' is shallow copied and encoded by a worker thread, and
+  // must not be modified until IsEncoded() says so; the snapshot is left
+  // empty if it takes more than 'limit' bytes (0 for no limit). Otherwise
+  // it is encoded now, and NULL is returned if it does not fit.
+  EntryType *NewSnapshot(vtkImageData *image, int background, size_t limit)
+    {
+    EntryType *entry = NewEntry(Snapshot, image);
+    if (background)
+      {
+      this->StartEncoding(entry, image, limit);
+      }
+    else if (!Encode(image, entry->Data, limit))
+      {
+      delete entry;
+      return 0;
+      }
+    return entry;
+    }
+
+  // Description:
+  // Create a level from the XOR difference between 'image' and the volume
+  // it had before a plugin ran (see vtkVVPluginDeltaCodec). The content of
+  // 'delta' is swapped in, 'delta' is left empty.
+  static EntryType *NewDifference(vtkImageData *image,
+                                  vtkVVPluginDeltaCodec::BufferType &delta)
+    {
+    EntryType *entry = NewEntry(Difference, image);
+    entry->Data.swap(delta);
+    return entry;
+    }
+
+  // Description:
+  // Turn a snapshot encoded by NewSnapshot() into the difference with
+  // 'image', the volume a plugin made of it, if they have the same layout.
+  // Return 0 if the snapshot was kept.
+  static int ConvertToDifference(EntryType *entry, vtkImageData *image)
+    {
+    if (entry->Kind != Snapshot || entry->Pending ||
+        !HasLayout(entry, image))
+      {
+      return 0;
+      }
+    vtkVVPluginDeltaCodec::BufferType delta;
+    vtkVVPluginDeltaCodec::EncodeDifference(
+      entry->Data, static_cast<const unsigned char *>(image->GetScalarPointer()),
+      GetNumberOfElements(entry), GetElementSize(image), delta);
+    vtkVVPluginDeltaCodec::BufferType(delta).swap(entry->Data);
+    entry->Kind = Difference;
+    return 1;
+    }
+
+  // Description:
+  // Decode a snapshot encoded by NewSnapshot() back into 'image', the
+  // volume it was taken from, if they still have the same layout. Return 0
+  // if it could not be restored.
+  static int RestoreSnapshot(const EntryType *entry, vtkImageData *image)
+    {
+    if (entry->Kind != Snapshot || entry->Pending ||
+        !HasLayout(entry, image))
+      {
+      return 0;
+      }
+    vtkVVPluginDeltaCodec::Decode(
+      entry->Data, static_cast<unsigned char *>(image->GetScalarPointer()),
+      GetNumberOfElements(entry), GetElementSize(image));
+    return 1;
+    }
+
+  // Description:
+  // Add 'entry' to the history, after the level last applied. The history
+  // takes ownership of it; the levels that could be redone are dropped,
+  // then the oldest ones if over budget. Return 0 if 'entry' itself did not
+  // fit and was dropped.
+  int Push(EntryType *entry, const char *name,
+           const PropertiesType &properties)
+    {
+    entry->Name = name ? name : "";
+    entry->Properties = properties;
+    while (this->Entries.size() > this->Position)
+      {
+      this->DeleteEntry(this->Entries.back());
+      this->Entries.pop_back();
+      }
+    this->Entries.push_back(entry);
+    this->Position = this->Entries.size();
+    this->Trim();
+    return !this->Entries.empty() && this->Entries.back() == entry;
+    }
+
+  // Description:
+  // Undo/Redo a level on 'image': 'image' gets the volume of the level and
+  // the level gets the volume 'image' had. Return 0 if there is no such
+  // level or it does not apply to 'image'.
+  int Undo(vtkImageData *image)
+    {
+    EntryType *entry = this->GetUndoEntry();
+    if (!entry || !image || !this->Swap(entry, image))
+      {
+      return 0;
+      }
+    --this->Position;
+    return 1;
+    }
+  int Redo(vtkImageData *image)
+    {
+    EntryType *entry = this->GetRedoEntry();
+    if (!entry || !image || !this->Swap(entry, image))
+      {
+      return 0;
+      }
+    ++this->Position;
+    return 1;
+    }
+
+  // Description:
+  // Drop all the levels.
+  void Clear()
+    {
+    while (!this->Entries.empty())
+      {
+      this->DeleteEntry(this->Entries.back());
+      this->Entries.pop_back();
+      }
+    this->Position = 0;
+    }
+
+  // Description:
+  // Tell whether the worker thread is done with a level that is not in the
+  // history, releasing its volume if so.
+  int IsEncoded(EntryType *entry)
+    {
+    this->Lock.Lock();
+    int done = entry->Done;
+    this->Lock.Unlock();
+    if (done)
+      {
+      this->FinishEncoding(entry);
+      }
+    return done;
+    }
+
+  // Description:
+  // Largest memory a snapshot of a volume of dimensions 'dim' and elements
+  // of 'elemSize' bytes may take, including the slice being encoded.
+  static size_t GetMaximumSnapshotSize(const int dim[3], int elemSize)
+    {
+    return (size_t)(dim[2] + 1)*vtkVVPluginDeltaCodec::GetMaximumEncodedSize(
+      (size_t)dim[0]*dim[1], elemSize);
+    }
+
+  // Description:
+  // Delete a level that is not in the history.
+  void DeleteEntry(EntryType *entry)
+    {
+    if (entry)
+      {
+      this->FinishEncoding(entry);
+      delete entry;
+      }
+    }
+
+  // Description:
+  // Release the volumes the worker threads are done with, then drop levels
+  // if over budget.
+  void Collect()
+    {
+    size_t i;
+    for (i = 0; i < this->Entries.size(); ++i)
+      {
+      EntryType *entry = this->Entries[i];
+      if (entry->Pending)
+        {
+        this->Lock.Lock();
+        int done = entry->Done;
+        this->Lock.Unlock();
+        if (done)
+          {
+          this->FinishEncoding(entry);
+          }
+        }
+      }
+    this->Trim();
+    }
+
+protected:
+  vtkstd::vector<EntryType *> Entries;
+  size_t Position;
+  size_t Budget;
+  vtkMultiThreader *Threader;
+  vtkSimpleMutexLock Lock;
+
+  struct WorkType
+  {
+    vtkVVPluginUndoStack *Self;
+    EntryType *Entry;
+    size_t Limit;
+  };
+
+  static EntryType *NewEntry(int kind, vtkImageData *image)
+    {
+    EntryType *entry = new EntryType;
+    entry->Kind = kind;
+    entry->Pending = 0;
+    entry->ThreadId = -1;
+    entry->Done = 1;
+    SetLayout(entry, image);
+    return entry;
+    }
+
+  static void SetLayout(EntryType *entry, vtkImageData *image)
+    {
+    entry->ScalarType = image->GetScalarType();
+    entry->NumberOfComponents = image->GetNumberOfScalarComponents();
+    image->GetDimensions(entry->Dimensions);
+    image->GetSpacing(entry->Spacing);
+    image->GetOrigin(entry->Origin);
+    }
+
+  static int HasLayout(const EntryType *entry, vtkImageData *image)
+    {
+    int *dim = image->GetDimensions();
+    return entry->ScalarType == image->GetScalarType() &&
+      entry->NumberOfComponents == image->GetNumberOfScalarComponents() &&
+      entry->Dimensions[0] == dim[0] && entry->Dimensions[1] == dim[1] &&
+      entry->Dimensions[2] == dim[2];
+    }
+
+  static size_t GetNumberOfElements(const EntryType *entry)
+    {
+    return (size_t)entry->Dimensions[0]*entry->Dimensions[1]*
+      entry->Dimensions[2];
+    }
+
+  static int GetElementSize(vtkImageData *image)
+    {
+    return image->GetScalarSize()*image->GetNumberOfScalarComponents();
+    }
+
+  static size_t GetEntrySize(const EntryType *entry)
+    {
+    if (entry->Pending)
+      {
+      return GetNumberOfElements(entry)*GetElementSize(entry->Pending);
+      }
+    return entry->Data.capacity();
+    }
+
+  // drop the oldest levels until the history fits in the budget. The redo
+  // levels go first when only the last level applied is left to undo.
+  void Trim()
+    {
+    if (!this->Budget)
+      {
+      return;
+      }
+    size_t total = 0;
+    size_t i;
+    for (i = 0; i < this->Entries.size(); ++i)
+      {
+      total += GetEntrySize(this->Entries[i]);
+      }
+    while (total > this->Budget && !this->Entries.empty())
+      {
+      EntryType *entry;
+      if (this->Position > 1 || this->Position == this->Entries.size())
+        {
+        entry = this->Entries.front();
+        this->Entries.erase(this->Entries.begin());
+        if (this->Position)
+          {
+          --this->Position;
+          }
+        }
+      else
+        {
+        entry = this->Entries.back();
+        this->Entries.pop_back();
+        }
+      total -= GetEntrySize(entry);
+      this->DeleteEntry(entry);
+      }
+    }
+
+  // Encode the scalars of 'image' a slice at a time into 'out', giving up
+  // beyond 'limit' bytes (0 for no limit). Return 0 if it did not fit.
+  // The size is worked out by a first pass so that 'out' is allocated
+  // once, the vector never grows past GetMaximumSnapshotSize().
+  static int Encode(vtkImageData *image,
+                    vtkVVPluginDeltaCodec::BufferType &out, size_t limit)
+    {
+    int *dim = image->GetDimensions();
+    int elemSize = GetElementSize(image);
+    const unsigned char *data =
+      static_cast<const unsigned char *>(image->GetScalarPointer());
+    size_t slice = (size_t)dim[0]*dim[1];
+    vtkVVPluginDeltaCodec::BufferType scratch;
+    scratch.reserve(
+      vtkVVPluginDeltaCodec::GetMaximumEncodedSize(slice, elemSize));
+    size_t total = 0;
+    int z;
+    for (z = 0; z < dim[2]; ++z)
+      {
+      scratch.clear();
+      vtkVVPluginDeltaCodec::Encode(
+        data + z*slice*elemSize, slice, elemSize, scratch);
+      total += scratch.size();
+      if (limit && total > limit)
+        {
+        return 0;
+        }
+      }
+    vtkVVPluginDeltaCodec::BufferType().swap(scratch);
+    vtkVVPluginDeltaCodec::BufferType encoded;
+    encoded.reserve(total);
+    for (z = 0; z < dim[2]; ++z)
+      {
+      vtkVVPluginDeltaCodec::Encode(
+        data + z*slice*elemSize, slice, elemSize, encoded);
+      }
+    encoded.swap(out);
+    return 1;
+    }
+
+  static VTK_THREAD_RETURN_TYPE EncodeWorker(void *arg)
+    {
+    vtkMultiThreader::ThreadInfo *ti =
+      static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+    WorkType *work = static_cast<WorkType *>(ti->UserData);
+    Encode(work->Entry->Pending, work->Entry->Data, work->Limit);
+    work->Self->Lock.Lock();
+    work->Entry->Done = 1;
+    work->Self->Lock.Unlock();
+    delete work;
+    return VTK_THREAD_RETURN_VALUE;
+    }
+
+  void StartEncoding(EntryType *entry, vtkImageData *image, size_t limit = 0)
+    {
+    entry->Pending = vtkImageData::New();
+    entry->Pending->ShallowCopy(image);
+    entry->Done = 0;
+    WorkType *work = new WorkType;
+    work->Self = this;
+    work->Entry = entry;
+    work->Limit = limit;
+    entry->ThreadId =
+      this->Threader->SpawnThread(vtkVVPluginUndoStack::EncodeWorker, work);
+    if (entry->ThreadId < 0)
+      {
+      // no thread left, encode now
+      delete work;
+      Encode(entry->Pending, entry->Data, limit);
+      entry->Done = 1;
+      }
+    }
+
+  // wait for the worker encoding 'entry', if any, then release its volume
+  void FinishEncoding(EntryType *entry)
+    {
+    if (!entry->Pending)
+      {
+      return;
+      }
+    if (entry->ThreadId >= 0)
+      {
+      this->Threader->TerminateThread(entry->ThreadId);
+      entry->ThreadId = -1;
+      }
+    entry->Done = 1;
+    entry->Pending->Delete();
+    entry->Pending = 0;
+    }
+
+  // exchange the volume of 'entry' and the one of 'image'
+  int Swap(EntryType *entry, vtkImageData *image)
+    {
+    if (entry->Kind == Difference)
+      {
+      if (!HasLayout(entry, image))
+        {
+        return 0;
+        }
+      vtkVVPluginDeltaCodec::ApplyDifference(
+        entry->Data, static_cast<unsigned char *>(image->GetScalarPointer()),
+        GetNumberOfElements(entry), GetElementSize(image));
+      image->Modified();
+      return 1;
+      }
+
+    // decode the level into a new volume, then let the level keep the
+    // current one, encoded in the background
+    this->FinishEncoding(entry);
+    vtkImageData *restored = vtkImageData::New();
+    restored->SetScalarType(entry->ScalarType);
+    restored->SetNumberOfScalarComponents(entry->NumberOfComponents);
+    restored->SetSpacing(entry->Spacing);
+    restored->SetOrigin(entry->Origin);
+    restored->SetDimensions(entry->Dimensions);
+    restored->AllocateScalars();
+    vtkVVPluginDeltaCodec::Decode(
+      entry->Data, static_cast<unsigned char *>(restored->GetScalarPointer()),
+      GetNumberOfElements(entry), GetElementSize(restored));
+    vtkVVPluginDeltaCodec::BufferType().swap(entry->Data);
+
+    SetLayout(entry, image);
+    this->StartEncoding(entry, image);
+    image->ShallowCopy(restored);
+    image->Modified();
+    restored->Delete();
+    return 1;
+    }
+};
+
+#endif
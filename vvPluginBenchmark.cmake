@@ -0,0 +1,104 @@
+##=========================================================================
+##
+##   Copyright (c) Kitware, Inc.
+##   All rights reserved.
+##   See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+##
+##      This software is distributed WITHOUT ANY WARRANTY; without even
+##      the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+##      PURPOSE.  See the above copyright notice for more information.
+##
+##=========================================================================
+# Times every plugin module found in PLUGIN_DIRS on synthetic phantoms with
+# vvPluginRunner, and writes one CSV line per run to RESULTS. Run by the
+# vvPluginBenchmark target, or by hand:
+#
+#   cmake -DRUNNER=vvPluginRunner -DPLUGIN_DIRS=Plugins
+#         -DRESULTS=results.csv -P vvPluginBenchmark.cmake
+#
+# Lists (PLUGIN_DIRS, PHANTOMS, SIZES, TYPES) are separated by commas.
+# The plugins that vvPluginRunner cannot drive (meshes, series, plots) are
+# skipped, the runs exceeding TIMEOUT seconds are recorded as timeouts and
+# the larger sizes of their plugin are skipped.
+
+IF (NOT RUNNER OR NOT PLUGIN_DIRS OR NOT RESULTS)
+  MESSAGE(FATAL_ERROR "RUNNER, PLUGIN_DIRS and RESULTS must be set")
+ENDIF (NOT RUNNER OR NOT PLUGIN_DIRS OR NOT RESULTS)
+
+IF (NOT PHANTOMS)
+  SET (PHANTOMS "noise,spheres,vessels")
+ENDIF (NOT PHANTOMS)
+IF (NOT SIZES)
+  SET (SIZES "64,128,256,512,1024")
+ENDIF (NOT SIZES)
+IF (NOT TYPES)
+  SET (TYPES "uchar,short,float")
+ENDIF (NOT TYPES)
+IF (NOT REPEAT)
+  SET (REPEAT 3)
+ENDIF (NOT REPEAT)
+IF (NOT TIMEOUT)
+  SET (TIMEOUT 600)
+ENDIF (NOT TIMEOUT)
+
+FOREACH (LIST PLUGIN_DIRS PHANTOMS SIZES TYPES)
+  STRING(REPLACE "," ";" ${LIST} "${${LIST}}")
+ENDFOREACH (LIST)
+
+SET (MODULES)
+FOREACH (DIR ${PLUGIN_DIRS})
+  FILE(GLOB DIR_MODULES
+    "${DIR}/vv*${MODULE_SUFFIX}" "${DIR}/${MODULE_PREFIX}vv*${MODULE_SUFFIX}")
+  SET (MODULES ${MODULES} ${DIR_MODULES})
+ENDFOREACH (DIR)
+IF (NOT MODULES)
+  MESSAGE(FATAL_ERROR "No plugin modules in ${PLUGIN_DIRS}")
+ENDIF (NOT MODULES)
+LIST(REMOVE_DUPLICATES MODULES)
+
+# a fresh file for each benchmark, with the columns of vvPluginRunner
+FILE(WRITE "${RESULTS}" "plugin,module,input,dimensions,type,components,runs,best_s,mean_s,mvoxels_per_s,mb_per_s,peak_memory_mb,status\n")
+
+FOREACH (MODULE ${MODULES})
+  GET_FILENAME_COMPONENT(MODULE_NAME "${MODULE}" NAME_WE)
+  SET (SKIP_MODULE 0)
+  FOREACH (TYPE ${TYPES})
+    FOREACH (PHANTOM ${PHANTOMS})
+      SET (SKIP_SIZES 0)
+      FOREACH (SIZE ${SIZES})
+        IF (NOT SKIP_MODULE AND NOT SKIP_SIZES)
+          MESSAGE(STATUS "${MODULE_NAME} ${PHANTOM} ${SIZE}^3 ${TYPE}")
+          EXECUTE_PROCESS(
+            COMMAND "${RUNNER}" --quiet --repeat ${REPEAT}
+                    --results "${RESULTS}"
+                    --phantom ${PHANTOM} ${SIZE} ${TYPE} "${MODULE}"
+            RESULT_VARIABLE STATUS
+            OUTPUT_QUIET
+            ERROR_VARIABLE ERROR
+            TIMEOUT ${TIMEOUT})
+          IF ("${STATUS}" STREQUAL "4")
+            MESSAGE(STATUS "  skipped, not a volume filter")
+            SET (SKIP_MODULE 1)
+          ELSE ("${STATUS}" STREQUAL "4")
+            IF (NOT "${STATUS}" MATCHES "^[0-3]$")
+              # the runner did not get to write a line, timed out or crashed
+              IF ("${STATUS}" MATCHES "timeout")
+                SET (STATUS timeout)
+              ELSE ("${STATUS}" MATCHES "timeout")
+                SET (STATUS crashed)
+              ENDIF ("${STATUS}" MATCHES "timeout")
+              FILE(APPEND "${RESULTS}"
+                ",${MODULE},${PHANTOM},${SIZE}x${SIZE}x${SIZE},${TYPE},1,0,,,,,,${STATUS}\n")
+              SET (SKIP_SIZES 1)
+            ENDIF (NOT "${STATUS}" MATCHES "^[0-3]$")
+            IF (NOT "${STATUS}" STREQUAL "0")
+              MESSAGE(STATUS "  ${STATUS} ${ERROR}")
+            ENDIF (NOT "${STATUS}" STREQUAL "0")
+          ENDIF ("${STATUS}" STREQUAL "4")
+        ENDIF (NOT SKIP_MODULE AND NOT SKIP_SIZES)
+      ENDFOREACH (SIZE)
+    ENDFOREACH (PHANTOM)
+  ENDFOREACH (TYPE)
+ENDFOREACH (MODULE)
+
+MESSAGE(STATUS "Results written to ${RESULTS}")
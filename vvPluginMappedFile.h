@@ -0,0 +1,251 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* vvPluginMappedFile - a file mapped in memory, for out-of-core volumes
+ *
+ * Maps the first bytes of a file, read only or read/write (the file is
+ * then created or resized), so that a volume larger than the memory can be
+ * handed to a plugin as a single buffer: the system reads the pages when
+ * they are touched and writes the modified ones back to the file. The
+ * ranges about to be used can be read ahead, and the ones done with
+ * written back and released, to keep the memory used bounded. */
+
+#ifndef __vvPluginMappedFile_h
+#define __vvPluginMappedFile_h
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class vvPluginMappedFile
+{
+public:
+  vvPluginMappedFile() : Pointer(0), Size(0), Writable(0)
+    {
+#ifdef _WIN32
+    this->File = INVALID_HANDLE_VALUE;
+    this->Mapping = 0;
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    this->PageSize = sysInfo.dwPageSize;
+#else
+    this->File = -1;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    this->PageSize = pageSize > 0 ? (size_t)pageSize : 4096;
+#endif
+    }
+  ~vvPluginMappedFile() { this->Close(); }
+
+  /* map the first 'size' bytes of 'fileName'. A read only file must be
+   * that large, a writable one is created or resized to 'size' bytes.
+   * Return 0 on error. */
+  int Open(const char *fileName, size_t size, int writable)
+    {
+    this->Close();
+    if (!size)
+      {
+      return 0;
+      }
+    this->Writable = writable;
+#ifdef _WIN32
+    this->File = CreateFileA(
+      fileName, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+      FILE_SHARE_READ, 0, writable ? OPEN_ALWAYS : OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL, 0);
+    if (this->File == INVALID_HANDLE_VALUE)
+      {
+      return 0;
+      }
+    LARGE_INTEGER length;
+    length.QuadPart = (LONGLONG)size;
+    if (writable &&
+        (!SetFilePointerEx(this->File, length, 0, FILE_BEGIN) ||
+         !SetEndOfFile(this->File)))
+      {
+      this->Close();
+      return 0;
+      }
+    this->Mapping = CreateFileMappingA(
+      this->File, 0, writable ? PAGE_READWRITE : PAGE_READONLY,
+      (DWORD)(length.QuadPart >> 32), (DWORD)length.QuadPart, 0);
+    if (this->Mapping)
+      {
+      this->Pointer = (unsigned char *)MapViewOfFile(
+        this->Mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+      }
+#else
+    this->File = open(fileName, writable ? O_RDWR | O_CREAT : O_RDONLY, 0666);
+    if (this->File < 0)
+      {
+      return 0;
+      }
+    struct stat st;
+    if (writable ? ftruncate(this->File, (off_t)size) != 0 :
+        (fstat(this->File, &st) != 0 || (size_t)st.st_size < size))
+      {
+      this->Close();
+      return 0;
+      }
+    void *ptr = mmap(0, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                     MAP_SHARED, this->File, 0);
+    this->Pointer = ptr == MAP_FAILED ? 0 : (unsigned char *)ptr;
+#endif
+    if (!this->Pointer)
+      {
+      this->Close();
+      return 0;
+      }
+    this->Size = size;
+    return 1;
+    }
+
+  /* unmap the file, the modified pages are written back eventually */
+  void Close()
+    {
+#ifdef _WIN32
+    if (this->Pointer)
+      {
+      UnmapViewOfFile(this->Pointer);
+      }
+    if (this->Mapping)
+      {
+      CloseHandle(this->Mapping);
+      }
+    if (this->File != INVALID_HANDLE_VALUE)
+      {
+      CloseHandle(this->File);
+      }
+    this->File = INVALID_HANDLE_VALUE;
+    this->Mapping = 0;
+#else
+    if (this->Pointer)
+      {
+      munmap(this->Pointer, this->Size);
+      }
+    if (this->File >= 0)
+      {
+      close(this->File);
+      }
+    this->File = -1;
+#endif
+    this->Pointer = 0;
+    this->Size = 0;
+    }
+
+  unsigned char *GetPointer() const { return this->Pointer; }
+  size_t GetSize() const { return this->Size; }
+
+  /* read the pages of [offset, offset + length) into memory. The system is
+   * told first, so that it can issue large reads, then the pages are
+   * touched; call it from another thread to read ahead. */
+  void ReadAhead(size_t offset, size_t length)
+    {
+    if (!this->Clip(offset, length))
+      {
+      return;
+      }
+#ifndef _WIN32
+    size_t begin = offset - offset % this->PageSize;
+    madvise(this->Pointer + begin, offset + length - begin, MADV_WILLNEED);
+#endif
+    volatile unsigned char sum = 0;
+    size_t i;
+    for (i = offset; i < offset + length; i += this->PageSize)
+      {
+      sum ^= this->Pointer[i];
+      }
+    sum ^= this->Pointer[offset + length - 1];
+    }
+
+  /* write the modified pages of [offset, offset + length) to the file and
+   * wait for it. Return 0 on error. */
+  int Flush(size_t offset, size_t length)
+    {
+    if (!this->Writable || !this->Clip(offset, length))
+      {
+      return 1;
+      }
+    size_t begin = offset - offset % this->PageSize;
+#ifdef _WIN32
+    return FlushViewOfFile(this->Pointer + begin, offset + length - begin) ?
+      1 : 0;
+#else
+    return msync(this->Pointer + begin, offset + length - begin, MS_SYNC) ?
+      0 : 1;
+#endif
+    }
+
+  /* let the system take back the memory of the whole pages of
+   * [offset, offset + length); their content stays in the file */
+  void Release(size_t offset, size_t length)
+    {
+    if (!this->Clip(offset, length))
+      {
+      return;
+      }
+    size_t begin = offset + this->PageSize - 1;
+    begin -= begin % this->PageSize;
+    size_t end = offset + length;
+    if (end < this->Size)
+      {
+      end -= end % this->PageSize;
+      }
+    if (end <= begin)
+      {
+      return;
+      }
+#ifdef _WIN32
+    /* unlocking pages that are not locked drops them from the working set */
+    VirtualUnlock(this->Pointer + begin, end - begin);
+#else
+    madvise(this->Pointer + begin, end - begin, MADV_DONTNEED);
+#endif
+    }
+
+protected:
+  unsigned char *Pointer;
+  size_t Size;
+  size_t PageSize;
+  int Writable;
+#ifdef _WIN32
+  HANDLE File;
+  HANDLE Mapping;
+#else
+  int File;
+#endif
+
+  /* restrict the range to the mapped bytes, return 0 if nothing is left */
+  int Clip(size_t offset, size_t &length) const
+    {
+    if (!this->Pointer || offset >= this->Size)
+      {
+      return 0;
+      }
+    if (length > this->Size - offset)
+      {
+      length = this->Size - offset;
+      }
+    return length > 0;
+    }
+
+private:
+  vvPluginMappedFile(const vvPluginMappedFile &);
+  void operator=(const vvPluginMappedFile &);
+};
+
+#endif
@@ -0,0 +1,303 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* vvPluginPhantom - reproducible synthetic volumes for benchmarking
+ *
+ * Three kinds of single component phantoms are generated:
+ *
+ *   noise    - uniform white noise over the whole intensity range
+ *   spheres  - bright spheres of various sizes and intensities on a noisy
+ *              background
+ *   vessels  - a tree of tubes branching from the top of the volume, with
+ *              radii shrinking at each generation, like coronary arteries
+ *              in a CTA
+ *
+ * The intensities go from 0 to 4000 (clamped to the range of the scalar
+ * type), so CT oriented thresholds work on every type. The noise comes
+ * from a hash of the voxel index, so the same kind, size and seed give the
+ * same volume on every machine and run. */
+
+#ifndef __vvPluginPhantom_h
+#define __vvPluginPhantom_h
+
+#include <limits>
+#include <math.h>
+#include <string.h>
+
+#define VV_PHANTOM_NOISE   0
+#define VV_PHANTOM_SPHERES 1
+#define VV_PHANTOM_VESSELS 2
+
+inline const char *vvPluginPhantomName(int kind)
+{
+  static const char *names[] = { "noise", "spheres", "vessels" };
+  return kind >= 0 && kind < 3 ? names[kind] : "";
+}
+
+/* the kind named 'name', -1 if there is none */
+inline int vvPluginPhantomKind(const char *name)
+{
+  int i;
+  for (i = 0; i < 3; ++i)
+    {
+    if (!strcmp(name, vvPluginPhantomName(i)))
+      {
+      return i;
+      }
+    }
+  return -1;
+}
+
+/* a pseudo random number in [0,1) depending only on 'i' and 'seed' */
+inline double vvPluginPhantomHash(size_t i, unsigned int seed)
+{
+  unsigned int h = (unsigned int)i*0x9e3779b1u ^
+    (unsigned int)(i >> 16 >> 16)*0x85ebca6bu ^ seed*0xc2b2ae35u;
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h/4294967296.0;
+}
+
+/* a sequence of pseudo random numbers in [0,1) */
+class vvPluginPhantomRandom
+{
+public:
+  vvPluginPhantomRandom(unsigned int seed) : Seed(seed), Index(0) {}
+  double operator()(double lo = 0, double hi = 1)
+    {
+    return lo + (hi - lo)*vvPluginPhantomHash(this->Index++, this->Seed);
+    }
+private:
+  unsigned int Seed;
+  size_t Index;
+};
+
+/* maps the levels of the phantoms, from 0 to 1, to the values of T */
+template <class T>
+class vvPluginPhantomWriter
+{
+public:
+  vvPluginPhantomWriter(T *data, const int dim[3], unsigned int seed,
+                        double noise) : Data(data), Seed(seed), Noise(noise)
+    {
+    this->Dimensions[0] = dim[0];
+    this->Dimensions[1] = dim[1];
+    this->Dimensions[2] = dim[2];
+    double lo = std::numeric_limits<T>::is_integer ?
+      (double)std::numeric_limits<T>::min() : 0.0;
+    double hi = (double)std::numeric_limits<T>::max();
+    this->Low = lo > 0 ? lo : 0;
+    this->High = hi < 4000 ? hi : 4000;
+    }
+
+  // the level plus some noise at voxel i, as a T
+  T Value(size_t i, double level) const
+    {
+    if (this->Noise > 0)
+      {
+      /* two uniform numbers make a rough gaussian */
+      level += this->Noise*(vvPluginPhantomHash(i, this->Seed) +
+                            vvPluginPhantomHash(i, ~this->Seed) - 1);
+      }
+    level = level < 0 ? 0 : (level > 1 ? 1 : level);
+    double v = this->Low + level*(this->High - this->Low);
+    return (T)(std::numeric_limits<T>::is_integer ? floor(v + 0.5) : v);
+    }
+
+  void Fill(double level)
+    {
+    size_t n = (size_t)this->Dimensions[0]*this->Dimensions[1]*
+      this->Dimensions[2];
+    size_t i;
+    for (i = 0; i < n; ++i)
+      {
+      this->Data[i] = this->Value(i, level);
+      }
+    }
+
+  // set the voxels of the ball at 'center' (in voxels) to 'level'
+  void Sphere(const double center[3], double radius, double level)
+    {
+    int lo[3], hi[3];
+    this->Bounds(center, center, radius, lo, hi);
+    int x, y, z;
+    for (z = lo[2]; z <= hi[2]; ++z)
+      {
+      for (y = lo[1]; y <= hi[1]; ++y)
+        {
+        for (x = lo[0]; x <= hi[0]; ++x)
+          {
+          double d[3] = { x - center[0], y - center[1], z - center[2] };
+          if (d[0]*d[0] + d[1]*d[1] + d[2]*d[2] <= radius*radius)
+            {
+            this->Set(x, y, z, level);
+            }
+          }
+        }
+      }
+    }
+
+  // set the voxels of the tube of 'radius' around [p0,p1] to 'level'
+  void Tube(const double p0[3], const double p1[3], double radius,
+            double level)
+    {
+    int lo[3], hi[3];
+    this->Bounds(p0, p1, radius, lo, hi);
+    double axis[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    double length2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+    int x, y, z;
+    for (z = lo[2]; z <= hi[2]; ++z)
+      {
+      for (y = lo[1]; y <= hi[1]; ++y)
+        {
+        for (x = lo[0]; x <= hi[0]; ++x)
+          {
+          double d[3] = { x - p0[0], y - p0[1], z - p0[2] };
+          double t = length2 > 0 ?
+            (d[0]*axis[0] + d[1]*axis[1] + d[2]*axis[2])/length2 : 0;
+          t = t < 0 ? 0 : (t > 1 ? 1 : t);
+          d[0] -= t*axis[0];
+          d[1] -= t*axis[1];
+          d[2] -= t*axis[2];
+          if (d[0]*d[0] + d[1]*d[1] + d[2]*d[2] <= radius*radius)
+            {
+            this->Set(x, y, z, level);
+            }
+          }
+        }
+      }
+    }
+
+private:
+  void Set(int x, int y, int z, double level)
+    {
+    size_t i = ((size_t)z*this->Dimensions[1] + y)*this->Dimensions[0] + x;
+    this->Data[i] = this->Value(i, level);
+    }
+
+  void Bounds(const double p0[3], const double p1[3], double radius,
+              int lo[3], int hi[3]) const
+    {
+    int i;
+    for (i = 0; i < 3; ++i)
+      {
+      double a = (p0[i] < p1[i] ? p0[i] : p1[i]) - radius;
+      double b = (p0[i] < p1[i] ? p1[i] : p0[i]) + radius;
+      lo[i] = a < 0 ? 0 : (int)ceil(a);
+      hi[i] = b > this->Dimensions[i] - 1 ? this->Dimensions[i] - 1 :
+        (int)floor(b);
+      }
+    }
+
+  T *Data;
+  int Dimensions[3];
+  unsigned int Seed;
+  double Noise;
+  double Low;
+  double High;
+};
+
+/* grow a branch of the vessel tree from 'start' along 'dir', then split */
+template <class T>
+void vvPluginPhantomBranch(vvPluginPhantomWriter<T> &writer,
+                           vvPluginPhantomRandom &random,
+                           const double start[3], const double dir[3],
+                           double length, double radius, int generation)
+{
+  /* a few straight segments bending a little make the branch */
+  double p[3] = { start[0], start[1], start[2] };
+  double d[3] = { dir[0], dir[1], dir[2] };
+  int s;
+  for (s = 0; s < 4; ++s)
+    {
+    int i;
+    for (i = 0; i < 3; ++i)
+      {
+      d[i] += random(-0.3, 0.3);
+      }
+    double norm = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    double q[3];
+    for (i = 0; i < 3; ++i)
+      {
+      d[i] /= norm;
+      q[i] = p[i] + d[i]*length/4;
+      }
+    writer.Tube(p, q, radius, 0.75);
+    memcpy(p, q, sizeof(p));
+    }
+  if (generation <= 0 || radius < 0.75)
+    {
+    return;
+    }
+
+  /* two children, on both sides of a random plane through the branch */
+  double side[3] = { random(-1, 1), random(-1, 1), random(-1, 1) };
+  int c;
+  for (c = 0; c < 2; ++c)
+    {
+    double child[3];
+    int i;
+    for (i = 0; i < 3; ++i)
+      {
+      child[i] = d[i] + (c ? 0.7 : -0.7)*side[i];
+      }
+    vvPluginPhantomBranch(writer, random, p, child, length*0.75,
+                          radius*(c ? 0.8 : 0.65), generation - 1);
+    }
+}
+
+/* fill 'data', of dimensions 'dim', with the phantom of 'kind' */
+template <class T>
+void vvPluginPhantomGenerate(int kind, const int dim[3], unsigned int seed,
+                             T *data)
+{
+  vvPluginPhantomRandom random(seed);
+  double size = dim[0];
+  size = dim[1] < size ? dim[1] : size;
+  size = dim[2] < size ? dim[2] : size;
+
+  if (kind == VV_PHANTOM_NOISE)
+    {
+    vvPluginPhantomWriter<T> writer(data, dim, seed, 0.5);
+    writer.Fill(0.5);
+    return;
+    }
+
+  vvPluginPhantomWriter<T> writer(data, dim, seed, 0.04);
+  writer.Fill(0.1);
+  if (kind == VV_PHANTOM_SPHERES)
+    {
+    int s;
+    for (s = 0; s < 24; ++s)
+      {
+      double radius = random(0.03, 0.15)*size;
+      double center[3];
+      int i;
+      for (i = 0; i < 3; ++i)
+        {
+        center[i] = random(radius, dim[i] - 1 - radius);
+        }
+      writer.Sphere(center, radius, random(0.3, 0.9));
+      }
+    return;
+    }
+
+  /* the root enters at the top and heads down into the volume */
+  double start[3] = { 0.5*(dim[0] - 1), 0.5*(dim[1] - 1), dim[2] - 1.0 };
+  double dir[3] = { 0, 0, -1 };
+  vvPluginPhantomBranch(writer, random, start, dir, 0.45*dim[2],
+                        0.025*size + 1, 6);
+}
+
+#endif
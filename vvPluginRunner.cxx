@@ -0,0 +1,1635 @@
+/*=========================================================================
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/VolViewCopyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/* vvPluginRunner - run a VolView plugin without VolView.
+ *
+ * Loads a plugin module, reads a volume from a MetaImage (.mha, .mhd) or
+ * raw file, sets the GUI values given on the command line and runs
+ * ProcessData on the whole volume in one piece, the way
+ * vtkVVPlugin::ProcessInOnePiece does. The wall clock time, throughput and
+ * peak memory are printed, and the result may be written as MetaImage.
+ * It is meant for batch processing on servers and for profiling plugins:
+ * the input may be a synthetic phantom (see vvPluginPhantom.h) and the
+ * timings appended to a CSV file, which vvPluginBenchmark.cmake uses to
+ * time every plugin. Run it without arguments for the list of options.
+ *
+ * With --out-of-core, the input and the output stay in memory mapped
+ * files and plugins that can process pieces are run slab by slab, the way
+ * vtkVVPlugin::ProcessInPieces does, so that volumes larger than the
+ * memory can be processed. While a slab is processed, another thread reads
+ * the next one ahead and writes the previous output slab back to disk.
+ *
+ * Plugins that produce meshes, series or plots are not supported. The
+ * runner does not link against VTK, only the plugin API. */
+
+#include "vtkVVPluginAPI.h"
+#include "C/vvPluginThreads.h"
+#include "vvPluginMappedFile.h"
+#include "vvPluginPhantom.h"
+
+#include <ctype.h>
+#include <limits>
+#include <map>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <dlfcn.h>
+#include <sys/resource.h>
+#endif
+
+//----------------------------------------------------------------------------
+// Volumes
+
+struct vvRunnerVolume
+{
+  vvRunnerVolume() : File(0), Offset(0) {}
+  int ScalarType;
+  int NumberOfComponents;
+  int Dimensions[3];
+  float Spacing[3];
+  float Origin[3];
+  std::vector<unsigned char> Data;
+  /* the mapped file holding the voxels at Offset, rather than Data */
+  vvPluginMappedFile *File;
+  size_t Offset;
+};
+
+/* the scalar types, with their MetaImage and command line names */
+static const struct
+{
+  int Type;
+  int Size;
+  const char *MetaName;
+  const char *Name;
+} vvRunnerTypes[] =
+{
+  { VTK_CHAR, sizeof(char), "MET_CHAR", "char" },
+  { VTK_UNSIGNED_CHAR, sizeof(unsigned char), "MET_UCHAR", "uchar" },
+  { VTK_SHORT, sizeof(short), "MET_SHORT", "short" },
+  { VTK_UNSIGNED_SHORT, sizeof(unsigned short), "MET_USHORT", "ushort" },
+  { VTK_INT, sizeof(int), "MET_INT", "int" },
+  { VTK_UNSIGNED_INT, sizeof(unsigned int), "MET_UINT", "uint" },
+  { VTK_LONG, sizeof(long), "MET_LONG", "long" },
+  { VTK_UNSIGNED_LONG, sizeof(unsigned long), "MET_ULONG", "ulong" },
+  { VTK_FLOAT, sizeof(float), "MET_FLOAT", "float" },
+  { VTK_DOUBLE, sizeof(double), "MET_DOUBLE", "double" }
+};
+
+#define VV_RUNNER_NUMBER_OF_TYPES \
+  (int)(sizeof(vvRunnerTypes)/sizeof(vvRunnerTypes[0]))
+
+/* index in vvRunnerTypes of a type given by value or by name, -1 if none */
+static int vvRunnerFindType(int type, const char *name)
+{
+  int i;
+  for (i = 0; i < VV_RUNNER_NUMBER_OF_TYPES; ++i)
+    {
+    if (name ? (!strcmp(name, vvRunnerTypes[i].MetaName) ||
+                !strcmp(name, vvRunnerTypes[i].Name)) :
+        type == vvRunnerTypes[i].Type)
+      {
+      return i;
+      }
+    }
+  return -1;
+}
+
+static int vvRunnerScalarSize(int type)
+{
+  int i = vvRunnerFindType(type, 0);
+  return i < 0 ? 0 : vvRunnerTypes[i].Size;
+}
+
+static size_t vvRunnerNumberOfVoxels(const int dim[3])
+{
+  return (size_t)dim[0]*dim[1]*dim[2];
+}
+
+static size_t vvRunnerDataSize(const vvRunnerVolume &vol)
+{
+  return vvRunnerNumberOfVoxels(vol.Dimensions)*vol.NumberOfComponents*
+    vvRunnerScalarSize(vol.ScalarType);
+}
+
+static unsigned char *vvRunnerVoxels(vvRunnerVolume &vol)
+{
+  if (vol.File)
+    {
+    return vol.File->GetPointer() + vol.Offset;
+    }
+  return vol.Data.empty() ? 0 : &vol.Data[0];
+}
+
+static const unsigned char *vvRunnerVoxels(const vvRunnerVolume &vol)
+{
+  return vvRunnerVoxels(const_cast<vvRunnerVolume &>(vol));
+}
+
+static int vvRunnerIsBigEndian()
+{
+  unsigned short one = 1;
+  return *(unsigned char *)&one == 0;
+}
+
+static void vvRunnerSwapBytes(std::vector<unsigned char> &data, int size)
+{
+  size_t i;
+  for (i = 0; size > 1 && i + size <= data.size(); i += size)
+    {
+    int j;
+    for (j = 0; j < size/2; ++j)
+      {
+      unsigned char tmp = data[i + j];
+      data[i + j] = data[i + size - 1 - j];
+      data[i + size - 1 - j] = tmp;
+      }
+    }
+}
+
+/* read 'data.size()' bytes at 'offset' in 'fileName' */
+static int vvRunnerReadData(const char *fileName, long offset,
+                            std::vector<unsigned char> &data,
+                            std::string &error)
+{
+  FILE *fp = fopen(fileName, "rb");
+  if (!fp)
+    {
+    error = std::string("cannot open ") + fileName;
+    return 0;
+    }
+  int ok = !fseek(fp, offset, SEEK_SET) &&
+    (data.empty() || fread(&data[0], 1, data.size(), fp) == data.size());
+  fclose(fp);
+  if (!ok)
+    {
+    error = std::string("cannot read the voxels of ") + fileName;
+    }
+  return ok;
+}
+
+/* read a MetaImage header into 'vol', without the voxels. They are at
+ * 'offset' in 'dataFile', the header itself when they are LOCAL, with the
+ * most significant byte first when 'msb' is set. */
+static int vvRunnerReadMetaImageHeader(const char *fileName,
+                                       vvRunnerVolume &vol,
+                                       std::string &dataFile, long &offset,
+                                       int &msb, std::string &error)
+{
+  FILE *fp = fopen(fileName, "rb");
+  if (!fp)
+    {
+    error = std::string("cannot open ") + fileName;
+    return 0;
+    }
+
+  int ndims = 3;
+  int typeIndex = -1;
+  msb = 0;
+  dataFile.erase();
+  char line[4096];
+  vol.NumberOfComponents = 1;
+  while (fgets(line, sizeof(line), fp))
+    {
+    char *eq = strchr(line, '=');
+    if (!eq)
+      {
+      continue;
+      }
+    /* trim the key and the value */
+    char *key = line;
+    char *value = eq + 1;
+    char *end = eq;
+    while (end > key && isspace((unsigned char)end[-1]))
+      {
+      --end;
+      }
+    *end = '\0';
+    while (isspace((unsigned char)*value))
+      {
+      ++value;
+      }
+    end = value + strlen(value);
+    while (end > value && isspace((unsigned char)end[-1]))
+      {
+      --end;
+      }
+    *end = '\0';
+
+    if (!strcmp(key, "NDims"))
+      {
+      ndims = atoi(value);
+      }
+    else if (!strcmp(key, "DimSize"))
+      {
+      vol.Dimensions[1] = vol.Dimensions[2] = 1;
+      sscanf(value, "%d %d %d", vol.Dimensions, vol.Dimensions + 1,
+             vol.Dimensions + 2);
+      }
+    else if (!strcmp(key, "ElementSpacing") || !strcmp(key, "ElementSize"))
+      {
+      sscanf(value, "%f %f %f", vol.Spacing, vol.Spacing + 1,
+             vol.Spacing + 2);
+      }
+    else if (!strcmp(key, "Offset") || !strcmp(key, "Position") ||
+             !strcmp(key, "Origin"))
+      {
+      sscanf(value, "%f %f %f", vol.Origin, vol.Origin + 1, vol.Origin + 2);
+      }
+    else if (!strcmp(key, "ElementNumberOfChannels"))
+      {
+      vol.NumberOfComponents = atoi(value);
+      }
+    else if (!strcmp(key, "ElementType"))
+      {
+      typeIndex = vvRunnerFindType(0, value);
+      }
+    else if (!strcmp(key, "BinaryDataByteOrderMSB") ||
+             !strcmp(key, "ElementByteOrderMSB"))
+      {
+      msb = !strcmp(value, "True") || !strcmp(value, "true");
+      }
+    else if (!strcmp(key, "CompressedData") &&
+             (!strcmp(value, "True") || !strcmp(value, "true")))
+      {
+      error = "compressed MetaImage files are not supported";
+      fclose(fp);
+      return 0;
+      }
+    else if (!strcmp(key, "ElementDataFile"))
+      {
+      dataFile = value;
+      break;
+      }
+    }
+  offset = ftell(fp);
+  fclose(fp);
+
+  if (ndims < 1 || ndims > 3 || typeIndex < 0 || dataFile.empty() ||
+      dataFile == "LIST" || vol.NumberOfComponents < 1 ||
+      vol.NumberOfComponents > 4)
+    {
+    error = std::string("unsupported MetaImage header in ") + fileName;
+    return 0;
+    }
+  vol.ScalarType = vvRunnerTypes[typeIndex].Type;
+
+  if (dataFile == "LOCAL")
+    {
+    dataFile = fileName;
+    }
+  else
+    {
+    /* relative to the header */
+    std::string path = fileName;
+    std::string::size_type slash = path.find_last_of("/\\");
+    if (slash != std::string::npos && dataFile[0] != '/' &&
+        dataFile.find(':') == std::string::npos)
+      {
+      dataFile = path.substr(0, slash + 1) + dataFile;
+      }
+    offset = 0;
+    }
+  return 1;
+}
+
+/* read a MetaImage header and its data, LOCAL or in a separate raw file */
+static int vvRunnerReadMetaImage(const char *fileName, vvRunnerVolume &vol,
+                                 std::string &error)
+{
+  std::string dataFile;
+  long offset;
+  int msb;
+  if (!vvRunnerReadMetaImageHeader(fileName, vol, dataFile, offset, msb,
+                                   error))
+    {
+    return 0;
+    }
+  vol.Data.resize(vvRunnerDataSize(vol));
+  if (!vvRunnerReadData(dataFile.c_str(), offset, vol.Data, error))
+    {
+    return 0;
+    }
+  if (msb != vvRunnerIsBigEndian())
+    {
+    vvRunnerSwapBytes(vol.Data, vvRunnerScalarSize(vol.ScalarType));
+    }
+  return 1;
+}
+
+/* write the MetaImage header of 'vol' to 'fileName' and return the file
+ * the voxels go to, at its current position: the header itself, or a
+ * separate raw file named 'dataFile' when 'fileName' ends in .mhd */
+static FILE *vvRunnerWriteMetaImageHeader(const char *fileName,
+                                          const vvRunnerVolume &vol,
+                                          std::string &dataFile,
+                                          std::string &error)
+{
+  std::string header = fileName;
+  std::string rawName;
+  std::string::size_type dot = header.rfind('.');
+  if (dot != std::string::npos && header.substr(dot) == ".mhd")
+    {
+    rawName = header.substr(0, dot) + ".raw";
+    std::string::size_type slash = rawName.find_last_of("/\\");
+    dataFile = slash == std::string::npos ? rawName :
+      rawName.substr(slash + 1);
+    }
+
+  FILE *fp = fopen(fileName, "wb");
+  if (!fp)
+    {
+    error = std::string("cannot write ") + fileName;
+    return 0;
+    }
+  fprintf(fp, "ObjectType = Image\nNDims = 3\n");
+  fprintf(fp, "BinaryData = True\nBinaryDataByteOrderMSB = %s\n",
+          vvRunnerIsBigEndian() ? "True" : "False");
+  fprintf(fp, "Offset = %g %g %g\n", vol.Origin[0], vol.Origin[1],
+          vol.Origin[2]);
+  fprintf(fp, "ElementSpacing = %g %g %g\n", vol.Spacing[0], vol.Spacing[1],
+          vol.Spacing[2]);
+  fprintf(fp, "DimSize = %d %d %d\n", vol.Dimensions[0], vol.Dimensions[1],
+          vol.Dimensions[2]);
+  if (vol.NumberOfComponents > 1)
+    {
+    fprintf(fp, "ElementNumberOfChannels = %d\n", vol.NumberOfComponents);
+    }
+  fprintf(fp, "ElementType = %s\nElementDataFile = %s\n",
+          vvRunnerTypes[vvRunnerFindType(vol.ScalarType, 0)].MetaName,
+          rawName.empty() ? "LOCAL" : dataFile.c_str());
+  if (rawName.empty())
+    {
+    dataFile = fileName;
+    return fp;
+    }
+  dataFile = rawName;
+  if (fclose(fp) || !(fp = fopen(rawName.c_str(), "wb")))
+    {
+    error = "cannot write " + rawName;
+    return 0;
+    }
+  return fp;
+}
+
+/* write a MetaImage with its data, separate when 'fileName' ends in .mhd */
+static int vvRunnerWriteMetaImage(const char *fileName,
+                                  const vvRunnerVolume &vol,
+                                  std::string &error)
+{
+  std::string dataFile;
+  FILE *fp = vvRunnerWriteMetaImageHeader(fileName, vol, dataFile, error);
+  if (!fp)
+    {
+    return 0;
+    }
+  int ok = vol.Data.empty() ||
+    fwrite(&vol.Data[0], 1, vol.Data.size(), fp) == vol.Data.size();
+  ok = !fclose(fp) && ok;
+  if (!ok)
+    {
+    error = std::string("cannot write the voxels of ") + fileName;
+    }
+  return ok;
+}
+
+/* smallest and largest value of each component, in a single pass over
+ * the voxels since they may have to be read from disk. The pages of a
+ * mapped volume are released a slice at a time. */
+template <class T>
+void vvRunnerComputeRange(const vvRunnerVolume &vol, double range[8], T *)
+{
+  const T *ptr = (const T *)vvRunnerVoxels(vol);
+  size_t slice = (size_t)vol.Dimensions[0]*vol.Dimensions[1];
+  int nc = vol.NumberOfComponents < 4 ? vol.NumberOfComponents : 4;
+  int c;
+  for (c = 0; c < nc && slice; ++c)
+    {
+    range[2*c] = range[2*c + 1] = (double)ptr[c];
+    }
+  int z;
+  for (z = 0; z < vol.Dimensions[2]; ++z)
+    {
+    size_t i;
+    for (i = 0; i < slice; ++i, ptr += vol.NumberOfComponents)
+      {
+      for (c = 0; c < nc; ++c)
+        {
+        double v = (double)ptr[c];
+        if (v < range[2*c])
+          {
+          range[2*c] = v;
+          }
+        if (v > range[2*c + 1])
+          {
+          range[2*c + 1] = v;
+          }
+        }
+      }
+    if (vol.File)
+      {
+      size_t size = slice*vol.NumberOfComponents*sizeof(T);
+      vol.File->Release(vol.Offset + z*size, size);
+      }
+    }
+}
+
+template <class T>
+void vvRunnerTypeRange(double range[2], T *)
+{
+  range[1] = (double)std::numeric_limits<T>::max();
+  range[0] = std::numeric_limits<T>::is_integer ?
+    (double)std::numeric_limits<T>::min() : -range[1];
+}
+
+//----------------------------------------------------------------------------
+// The host side of the plugin API
+
+struct vvRunnerGUIItem
+{
+  std::string Fields[6];
+  int Set[6];
+};
+
+struct vvRunner
+{
+  vtkVVPluginInfo Info;
+  std::map<int, std::string> Properties;
+  std::vector<vvRunnerGUIItem> GUIItems;
+  std::map<std::string, std::vector<unsigned char> > Buffers;
+  volatile int AbortProcessing;
+  int Quiet;
+  double LastProgress;
+  /* the part of the whole run the progress of the plugin stands for */
+  float ProgressMinimum;
+  float ProgressMaximum;
+};
+
+static vvRunner *vvRunnerInstance = 0;
+
+static vvRunner *vvRunnerGet(void *info)
+{
+  return (vvRunner *)((vtkVVPluginInfo *)info)->Self;
+}
+
+extern "C"
+{
+static void vvRunnerSetProperty(void *info, int property, const char *value)
+{
+  vvRunner *self = vvRunnerGet(info);
+  if (property == VVP_NUMBER_OF_GUI_ITEMS && value)
+    {
+    int n = atoi(value);
+    self->GUIItems.resize(n > 0 ? n : 0);
+    }
+  if (value)
+    {
+    self->Properties[property] = value;
+    }
+  else
+    {
+    self->Properties.erase(property);
+    }
+}
+
+static const char *vvRunnerGetProperty(void *info, int property)
+{
+  vvRunner *self = vvRunnerGet(info);
+  if (property == VVP_ABORT_PROCESSING)
+    {
+    return self->AbortProcessing ? "1" : "0";
+    }
+  std::map<int, std::string>::const_iterator it =
+    self->Properties.find(property);
+  if (it != self->Properties.end())
+    {
+    return it->second.c_str();
+    }
+  return property == VVP_INPUT_COMPONENTS_ARE_INDEPENDENT ? "1" : "";
+}
+
+static void vvRunnerSetGUIProperty(void *info, int num, int property,
+                                   const char *value)
+{
+  vvRunner *self = vvRunnerGet(info);
+  if (num < 0 || num >= (int)self->GUIItems.size() || property < 0 ||
+      property > VVP_GUI_VALUE)
+    {
+    return;
+    }
+  self->GUIItems[num].Fields[property] = value ? value : "";
+  self->GUIItems[num].Set[property] = value != 0;
+}
+
+static const char *vvRunnerGetGUIProperty(void *info, int num, int property)
+{
+  vvRunner *self = vvRunnerGet(info);
+  if (num < 0 || num >= (int)self->GUIItems.size() || property < 0 ||
+      property > VVP_GUI_VALUE || !self->GUIItems[num].Set[property])
+    {
+    return 0;
+    }
+  return self->GUIItems[num].Fields[property].c_str();
+}
+
+static void vvRunnerUpdateProgress(void *info, float progress,
+                                   const char *msg)
+{
+  vvRunner *self = vvRunnerGet(info);
+  double now = vvPluginGetTime();
+  if (self->Quiet || (progress < 1 && now - self->LastProgress < 0.5))
+    {
+    return;
+    }
+  self->LastProgress = now;
+  progress = self->ProgressMinimum +
+    progress*(self->ProgressMaximum - self->ProgressMinimum);
+  fprintf(stderr, "%s %3d%%\n", msg ? msg : "", (int)(100*progress));
+}
+
+static int vvRunnerReportProgress(void *info, float progress,
+                                  const char *msg)
+{
+  vvRunnerUpdateProgress(info, progress, msg);
+  return vvRunnerGet(info)->AbortProcessing;
+}
+
+/* the runner runs one plugin at a time, on the calling thread */
+static int vvRunnerSetBuffer(void *info, const char *key, const void *data,
+                             size_t size)
+{
+  vvRunner *self = vvRunnerGet(info);
+  if (!key)
+    {
+    return 0;
+    }
+  if (!data)
+    {
+    self->Buffers.erase(key);
+    return 1;
+    }
+  const unsigned char *bytes = (const unsigned char *)data;
+  std::vector<unsigned char>(bytes, bytes + size).swap(self->Buffers[key]);
+  return 1;
+}
+
+static const void *vvRunnerGetBuffer(void *info, const char *key,
+                                     size_t *size)
+{
+  static const unsigned char empty = 0;
+  vvRunner *self = vvRunnerGet(info);
+  std::map<std::string, std::vector<unsigned char> >::const_iterator it =
+    key ? self->Buffers.find(key) : self->Buffers.end();
+  if (size)
+    {
+    *size = it == self->Buffers.end() ? 0 : it->second.size();
+    }
+  if (it == self->Buffers.end())
+    {
+    return 0;
+    }
+  return it->second.empty() ? &empty : &it->second[0];
+}
+
+static void vvRunnerInterrupt(int)
+{
+  /* the first Ctrl-C asks the plugin to stop, the next ones kill */
+  if (vvRunnerInstance)
+    {
+    vvRunnerInstance->AbortProcessing = 1;
+    }
+  signal(SIGINT, SIG_DFL);
+}
+}
+
+/* open the module and return its Init function, named after the file
+ * the way vtkVVPlugin::Load does (a "lib" prefix is dropped) */
+static VV_INIT_FUNCTION vvRunnerLoad(const char *path, const char *name,
+                                     std::string &error)
+{
+  std::string initName;
+  if (name)
+    {
+    initName = std::string("vv") + name;
+    }
+  else
+    {
+    initName = path;
+    std::string::size_type slash = initName.find_last_of("/\\");
+    if (slash != std::string::npos)
+      {
+      initName = initName.substr(slash + 1);
+      }
+    std::string::size_type dot = initName.find('.');
+    if (dot != std::string::npos)
+      {
+      initName = initName.substr(0, dot);
+      }
+    if (initName.compare(0, 5, "libvv") == 0)
+      {
+      initName = initName.substr(3);
+      }
+    }
+  initName += "Init";
+
+  void *symbol = 0;
+#ifdef _WIN32
+  HMODULE lib = LoadLibraryA(path);
+  if (lib)
+    {
+    symbol = (void *)GetProcAddress(lib, initName.c_str());
+    }
+#else
+  void *lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (!lib)
+    {
+    error = dlerror();
+    return 0;
+    }
+  symbol = dlsym(lib, initName.c_str());
+#endif
+  if (!lib)
+    {
+    error = std::string("cannot load ") + path;
+    }
+  else if (!symbol)
+    {
+    error = std::string("no function ") + initName + " in " + path;
+    }
+  return (VV_INIT_FUNCTION)symbol;
+}
+
+/* peak resident memory of the process in MB */
+static double vvRunnerPeakMemory()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    {
+    return pmc.PeakWorkingSetSize/1048576.0;
+    }
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    {
+    return 0;
+    }
+#ifdef __APPLE__
+  return usage.ru_maxrss/1048576.0;
+#else
+  return usage.ru_maxrss/1024.0;
+#endif
+#endif
+}
+
+/* fill the input (or second input when 'second' is set) fields of 'info' */
+static void vvRunnerSetInput(vtkVVPluginInfo *info, const vvRunnerVolume &vol,
+                             int second)
+{
+  double range[8] = { 0, 1, 0, 1, 0, 1, 0, 1 };
+  double typeRange[2] = { 0, 1 };
+  switch (vol.ScalarType)
+    {
+    vtkTemplateMacro3(vvRunnerComputeRange, vol, range,
+                      static_cast<VTK_TT *>(0));
+    }
+  switch (vol.ScalarType)
+    {
+    vtkTemplateMacro(vvRunnerTypeRange(typeRange,
+                                       static_cast<VTK_TT *>(0)));
+    }
+
+  int i;
+  if (second)
+    {
+    info->InputVolume2ScalarType = vol.ScalarType;
+    info->InputVolume2ScalarSize = vvRunnerScalarSize(vol.ScalarType);
+    info->InputVolume2NumberOfComponents = vol.NumberOfComponents;
+    for (i = 0; i < 3; ++i)
+      {
+      info->InputVolume2Dimensions[i] = vol.Dimensions[i];
+      info->InputVolume2Spacing[i] = vol.Spacing[i];
+      info->InputVolume2Origin[i] = vol.Origin[i];
+      }
+    memcpy(info->InputVolume2ScalarRange, range, sizeof(range));
+    memcpy(info->InputVolume2ScalarTypeRange, typeRange, sizeof(typeRange));
+    return;
+    }
+  info->InputVolumeScalarType = vol.ScalarType;
+  info->InputVolumeScalarSize = vvRunnerScalarSize(vol.ScalarType);
+  info->InputVolumeNumberOfComponents = vol.NumberOfComponents;
+  for (i = 0; i < 3; ++i)
+    {
+    info->InputVolumeDimensions[i] = vol.Dimensions[i];
+    info->InputVolumeSpacing[i] = vol.Spacing[i];
+    info->InputVolumeOrigin[i] = vol.Origin[i];
+    }
+  memcpy(info->InputVolumeScalarRange, range, sizeof(range));
+  memcpy(info->InputVolumeScalarTypeRange, typeRange, sizeof(typeRange));
+}
+
+static int vvRunnerPropertyIsSet(vvRunner &runner, int property)
+{
+  return atoi(vvRunnerGetProperty(&runner.Info, property)) != 0;
+}
+
+static void vvRunnerUsage()
+{
+  fprintf(stderr,
+"Usage: vvPluginRunner [options] plugin input [output]\n"
+"       vvPluginRunner [options] --phantom KIND SIZE TYPE plugin [output]\n"
+"\n"
+"Runs the VolView plugin module 'plugin' on the volume 'input', a MetaImage\n"
+"(.mha, .mhd) or a raw file (see --raw), and writes the result to 'output'\n"
+"(.mha, or .mhd with a separate .raw) when given.\n"
+"\n"
+"Options:\n"
+"  --name NAME             the Init function is vvNAMEInit, by default it\n"
+"                          is named after the module file\n"
+"  --gui ITEM=VALUE        set the GUI item ITEM, given by its index or its\n"
+"                          label, to VALUE (may be repeated)\n"
+"  --input2 FILE           the second input\n"
+"  --raw NX NY NZ TYPE NC  read the inputs as raw voxels of type TYPE\n"
+"                          (char, uchar, short, ushort, int, uint, long,\n"
+"                          ulong, float, double) with NC components\n"
+"  --spacing SX SY SZ      the spacing of raw inputs\n"
+"  --origin OX OY OZ       the origin of raw inputs\n"
+"  --phantom KIND N TYPE   generate the input, a N x N x N phantom of TYPE\n"
+"                          (noise, spheres or vessels), and the second input\n"
+"                          too when the plugin needs one\n"
+"  --results FILE          append the timings to the CSV file FILE\n"
+"  --trace FILE            write the execution trace of the runs, with the\n"
+"                          events of the plugin, as Chrome trace JSON\n"
+"  --repeat N              run N times, on a fresh copy of the input\n"
+"  --out-of-core           keep the input and the output in files mapped in\n"
+"                          memory and process them slab by slab, for\n"
+"                          volumes larger than the memory. The plugin must\n"
+"                          support pieces, the output file is required\n"
+"  --slab-slices N         the number of slices of the out-of-core slabs,\n"
+"                          by default about 64 MB of input\n"
+"  --list                  print the plugin properties and GUI items\n"
+"  --quiet                 do not print the progress\n"
+"\n"
+"Exit codes: 0 success, 1 bad arguments or files, 2 the plugin failed,\n"
+"3 aborted, 4 the plugin needs more than volumes.\n");
+}
+
+/* read a MetaImage or, when 'raw' is set, a raw volume like 'raw' */
+static int vvRunnerReadVolume(const char *fileName, const vvRunnerVolume *raw,
+                              vvRunnerVolume &vol, std::string &error)
+{
+  if (!raw)
+    {
+    vol.Spacing[0] = vol.Spacing[1] = vol.Spacing[2] = 1;
+    vol.Origin[0] = vol.Origin[1] = vol.Origin[2] = 0;
+    return vvRunnerReadMetaImage(fileName, vol, error);
+    }
+  vol.ScalarType = raw->ScalarType;
+  vol.NumberOfComponents = raw->NumberOfComponents;
+  memcpy(vol.Dimensions, raw->Dimensions, sizeof(vol.Dimensions));
+  memcpy(vol.Spacing, raw->Spacing, sizeof(vol.Spacing));
+  memcpy(vol.Origin, raw->Origin, sizeof(vol.Origin));
+  vol.Data.resize(vvRunnerNumberOfVoxels(vol.Dimensions)*
+                  vol.NumberOfComponents*vvRunnerScalarSize(vol.ScalarType));
+  return vvRunnerReadData(fileName, 0, vol.Data, error);
+}
+
+/* generate the phantom of 'kind' in 'vol', of 'size' cubed voxels */
+static int vvRunnerMakePhantom(int kind, int size, int type,
+                               unsigned int seed, vvRunnerVolume &vol)
+{
+  vol.ScalarType = type;
+  vol.NumberOfComponents = 1;
+  int i;
+  for (i = 0; i < 3; ++i)
+    {
+    vol.Dimensions[i] = size;
+    vol.Spacing[i] = 1;
+    vol.Origin[i] = 0;
+    }
+  vol.Data.resize(vvRunnerNumberOfVoxels(vol.Dimensions)*
+                  vvRunnerScalarSize(type));
+  void *ptr = &vol.Data[0];
+  switch (type)
+    {
+    vtkTemplateMacro(vvPluginPhantomGenerate(kind, vol.Dimensions, seed,
+                                             static_cast<VTK_TT *>(ptr)));
+    default:
+      return 0;
+    }
+  return 1;
+}
+
+/* 'value' as a CSV field */
+static std::string vvRunnerQuote(const std::string &value)
+{
+  if (value.find_first_of(",\"\n") == std::string::npos)
+    {
+    return value;
+    }
+  std::string quoted = "\"";
+  std::string::size_type i;
+  for (i = 0; i < value.size(); ++i)
+    {
+    quoted += value[i] == '"' ? "\"\"" : value.substr(i, 1);
+    }
+  return quoted + "\"";
+}
+
+/* append a line to the CSV file 'fileName', with a header if it is new */
+static int vvRunnerAppendResults(const char *fileName,
+                                 const std::vector<std::string> &fields)
+{
+  FILE *fp = fopen(fileName, "ab");
+  if (!fp)
+    {
+    return 0;
+    }
+  fseek(fp, 0, SEEK_END);
+  if (ftell(fp) == 0)
+    {
+    fprintf(fp, "plugin,module,input,dimensions,type,components,runs,"
+            "best_s,mean_s,mvoxels_per_s,mb_per_s,peak_memory_mb,status\n");
+    }
+  size_t i;
+  for (i = 0; i < fields.size(); ++i)
+    {
+    fprintf(fp, "%s%s", i ? "," : "", vvRunnerQuote(fields[i]).c_str());
+    }
+  fprintf(fp, "\n");
+  return !fclose(fp);
+}
+
+static std::string vvRunnerFormat(const char *format, double value)
+{
+  char text[64];
+  sprintf(text, format, value);
+  return text;
+}
+
+//----------------------------------------------------------------------------
+// Out-of-core processing
+
+/* one slab: thread 0 runs the plugin on it while thread 1 reads the next
+ * slab ahead, writes the output of the previous one back to disk and
+ * releases the memory of both. In place plugins get the input of the slab
+ * copied into its output first, as they would find it in memory. */
+struct vvRunnerSlab
+{
+  vtkVVPluginInfo *Info;
+  vtkVVProcessDataStruct *ProcessDataStruct;
+  const unsigned char *CopySource;
+  size_t CopyLength;
+  int Failed;
+  vvPluginMappedFile *Input;
+  size_t ReadOffset;
+  size_t ReadLength;
+  size_t ReleaseOffset;
+  size_t ReleaseLength;
+  vvPluginMappedFile *Output;
+  size_t WriteOffset;
+  size_t WriteLength;
+  int WriteFailed;
+};
+
+static void vvRunnerProcessSlab(void *arg, int threadId, int)
+{
+  vvRunnerSlab *slab = (vvRunnerSlab *)arg;
+  if (threadId == 0)
+    {
+    if (slab->CopyLength)
+      {
+      memcpy(slab->ProcessDataStruct->outData, slab->CopySource,
+             slab->CopyLength);
+      }
+    slab->Failed = slab->Info->ProcessData(slab->Info, 
+                                           slab->ProcessDataStruct);
+    return;
+    }
+  slab->Input->ReadAhead(slab->ReadOffset, slab->ReadLength);
+  if (!slab->Output->Flush(slab->WriteOffset, slab->WriteLength))
+    {
+    slab->WriteFailed = 1;
+    }
+  slab->Output->Release(slab->WriteOffset, slab->WriteLength);
+  slab->Input->Release(slab->ReleaseOffset, slab->ReleaseLength);
+}
+
+/* run the plugin on the mapped volume 'input' slab by slab into the
+ * mapped volume 'output'. Slabs of 'slabSlices' slices, with the Z overlap
+ * the plugin requires around them. Return non-zero on failure. */
+static int vvRunnerProcessOutOfCore(vvRunner &runner,
+                                    vtkVVProcessDataStruct *pds,
+                                    vvRunnerVolume &input,
+                                    vvRunnerVolume &output, int slabSlices)
+{
+  vvPluginMappedFile &in = *input.File;
+  vvPluginMappedFile &out = *output.File;
+  size_t inOffset = input.Offset;
+  size_t outOffset = output.Offset;
+  const int *dim = input.Dimensions;
+  size_t inSlice = (size_t)dim[0]*dim[1]*input.NumberOfComponents*
+    vvRunnerScalarSize(input.ScalarType);
+  size_t outSlice = (size_t)dim[0]*dim[1]*output.NumberOfComponents*
+    vvRunnerScalarSize(output.ScalarType);
+  int overlap = atoi(vvRunnerGetProperty(&runner.Info, 
+                                         VVP_REQUIRED_Z_OVERLAP));
+  int inPlace = 
+    vvRunnerPropertyIsSet(runner, VVP_SUPPORTS_IN_PLACE_PROCESSING) &&
+    inSlice == outSlice && input.ScalarType == output.ScalarType;
+
+  /* the first slab and its halo are read now */
+  int last = slabSlices + overlap < dim[2] ? slabSlices + overlap : dim[2];
+  in.ReadAhead(inOffset, last*inSlice);
+
+  vvRunnerSlab slab;
+  slab.Info = &runner.Info;
+  slab.ProcessDataStruct = pds;
+  slab.Failed = 0;
+  slab.Input = &in;
+  slab.Output = &out;
+  slab.WriteFailed = 0;
+  int released = 0;
+  int previous = 0;
+  int start;
+  for (start = 0; start < dim[2] && !slab.Failed && !slab.WriteFailed &&
+         !runner.AbortProcessing; start += slabSlices)
+    {
+    int slices = dim[2] - start < slabSlices ? dim[2] - start : slabSlices;
+    runner.ProgressMinimum = (float)start/dim[2];
+    runner.ProgressMaximum = (float)(start + slices)/dim[2];
+    pds->inData = vvRunnerVoxels(input);
+    pds->outData = vvRunnerVoxels(output) + start*outSlice;
+    pds->StartSlice = start;
+    pds->NumberOfSlicesToProcess = slices;
+    slab.CopySource = vvRunnerVoxels(input) + start*inSlice;
+    slab.CopyLength = inPlace ? slices*inSlice : 0;
+
+    /* the next slab with its halo above, the halo below is in already */
+    int first = last;
+    last = start + 2*slices + overlap < dim[2] ? 
+      start + 2*slices + overlap : dim[2];
+    slab.ReadOffset = inOffset + first*inSlice;
+    slab.ReadLength = (last - first)*inSlice;
+    /* the output of the previous slab */
+    slab.WriteOffset = outOffset + previous*outSlice;
+    slab.WriteLength = (start - previous)*outSlice;
+    previous = start;
+    /* the input below the halo of this slab is not read anymore */
+    int keep = start - overlap > released ? start - overlap : released;
+    slab.ReleaseOffset = inOffset + released*inSlice;
+    slab.ReleaseLength = (keep - released)*inSlice;
+    released = keep;
+
+    vvPluginParallelExecute(2, vvRunnerProcessSlab, &slab);
+    }
+  runner.ProgressMinimum = 0;
+  runner.ProgressMaximum = 1;
+
+  /* the last slab */
+  if (!out.Flush(outOffset + previous*outSlice, 
+                 (dim[2] - previous)*outSlice))
+    {
+    slab.WriteFailed = 1;
+    }
+  in.Release(inOffset, dim[2]*inSlice);
+  out.Release(outOffset, dim[2]*outSlice);
+  if (slab.WriteFailed)
+    {
+    vvRunnerSetProperty(&runner.Info, VVP_ERROR, 
+                        "cannot write the output to disk");
+    }
+  return slab.Failed || slab.WriteFailed;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *name = 0;
+  const char *input2File = 0;
+  const char *files[3] = { 0, 0, 0 };
+  int numFiles = 0;
+  int repeat = 1;
+  int list = 0;
+  int useRaw = 0;
+  int phantom = -1;
+  int phantomSize = 0;
+  int phantomType = 0;
+  const char *resultsFile = 0;
+  const char *traceFile = 0;
+  int outOfCore = 0;
+  int slabSlices = 0;
+  vvRunnerVolume raw;
+  raw.Spacing[0] = raw.Spacing[1] = raw.Spacing[2] = 1;
+  raw.Origin[0] = raw.Origin[1] = raw.Origin[2] = 0;
+  std::vector<std::string> guiValues;
+
+  vvRunner runner;
+  runner.AbortProcessing = 0;
+  runner.Quiet = 0;
+  runner.LastProgress = 0;
+  runner.ProgressMinimum = 0;
+  runner.ProgressMaximum = 1;
+
+  int i;
+  for (i = 1; i < argc; ++i)
+    {
+    std::string arg = argv[i];
+    int left = argc - i - 1;
+    if (arg == "--name" && left >= 1)
+      {
+      name = argv[++i];
+      }
+    else if (arg == "--gui" && left >= 1)
+      {
+      guiValues.push_back(argv[++i]);
+      }
+    else if (arg == "--input2" && left >= 1)
+      {
+      input2File = argv[++i];
+      }
+    else if (arg == "--raw" && left >= 5)
+      {
+      int t = vvRunnerFindType(0, argv[i + 4]);
+      if (t < 0)
+        {
+        fprintf(stderr, "unknown scalar type %s\n", argv[i + 4]);
+        return 1;
+        }
+      raw.Dimensions[0] = atoi(argv[i + 1]);
+      raw.Dimensions[1] = atoi(argv[i + 2]);
+      raw.Dimensions[2] = atoi(argv[i + 3]);
+      raw.ScalarType = vvRunnerTypes[t].Type;
+      raw.NumberOfComponents = atoi(argv[i + 5]);
+      useRaw = 1;
+      i += 5;
+      }
+    else if (arg == "--phantom" && left >= 3)
+      {
+      int t = vvRunnerFindType(0, argv[i + 3]);
+      phantom = vvPluginPhantomKind(argv[i + 1]);
+      phantomSize = atoi(argv[i + 2]);
+      if (phantom < 0 || phantomSize < 1 || t < 0)
+        {
+        fprintf(stderr, "invalid phantom %s %s %s\n", argv[i + 1],
+                argv[i + 2], argv[i + 3]);
+        return 1;
+        }
+      phantomType = vvRunnerTypes[t].Type;
+      i += 3;
+      }
+    else if (arg == "--results" && left >= 1)
+      {
+      resultsFile = argv[++i];
+      }
+    else if (arg == "--trace" && left >= 1)
+      {
+      traceFile = argv[++i];
+      }
+    else if (arg == "--spacing" && left >= 3)
+      {
+      raw.Spacing[0] = (float)atof(argv[++i]);
+      raw.Spacing[1] = (float)atof(argv[++i]);
+      raw.Spacing[2] = (float)atof(argv[++i]);
+      }
+    else if (arg == "--origin" && left >= 3)
+      {
+      raw.Origin[0] = (float)atof(argv[++i]);
+      raw.Origin[1] = (float)atof(argv[++i]);
+      raw.Origin[2] = (float)atof(argv[++i]);
+      }
+    else if (arg == "--repeat" && left >= 1)
+      {
+      repeat = atoi(argv[++i]);
+      repeat = repeat < 1 ? 1 : repeat;
+      }
+    else if (arg == "--list")
+      {
+      list = 1;
+      }
+    else if (arg == "--out-of-core")
+      {
+      outOfCore = 1;
+      }
+    else if (arg == "--slab-slices" && left >= 1)
+      {
+      slabSlices = atoi(argv[++i]);
+      }
+    else if (arg == "--quiet")
+      {
+      runner.Quiet = 1;
+      }
+    else if (arg[0] != '-' && numFiles < 3)
+      {
+      files[numFiles++] = argv[i];
+      }
+    else
+      {
+      vvRunnerUsage();
+      return 1;
+      }
+    }
+  if (phantom >= 0 && numFiles < 3)
+    {
+    /* no input file, the output comes right after the plugin */
+    files[2] = files[1];
+    files[1] = 0;
+    numFiles = files[2] ? 3 : 2;
+    }
+  if (numFiles < (list ? 1 : 2) ||
+      (useRaw && (raw.NumberOfComponents < 1 ||
+                  raw.NumberOfComponents > 4)) ||
+      (outOfCore && (list || phantom >= 0 || numFiles < 3)))
+    {
+    vvRunnerUsage();
+    return 1;
+    }
+
+  // load the plugin
+  std::string error;
+  VV_INIT_FUNCTION init = vvRunnerLoad(files[0], name, error);
+  if (!init)
+    {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+    }
+  vtkVVPluginInfo *info = &runner.Info;
+  memset(info, 0, sizeof(*info));
+  info->Self = &runner;
+  info->UpdateProgress = vvRunnerUpdateProgress;
+  info->SetProperty = vvRunnerSetProperty;
+  info->GetProperty = vvRunnerGetProperty;
+  info->SetGUIProperty = vvRunnerSetGUIProperty;
+  info->GetGUIProperty = vvRunnerGetGUIProperty;
+  info->SetBuffer = vvRunnerSetBuffer;
+  info->GetBuffer = vvRunnerGetBuffer;
+  info->AbortFlag = &runner.AbortProcessing;
+  info->ReportProgress = vvRunnerReportProgress;
+  info->magic1 = VV_PLUGIN_API_VERSION;
+  (*init)(info);
+  if (!info->magic1 || !info->ProcessData || !info->UpdateGUI)
+    {
+    fprintf(stderr, "%s is not compatible with this plugin API\n",
+            files[0]);
+    return 1;
+    }
+  if (vvRunnerPropertyIsSet(runner, VVP_PRODUCES_MESH_ONLY) ||
+      vvRunnerPropertyIsSet(runner, VVP_REQUIRES_SERIES_INPUT) ||
+      vvRunnerPropertyIsSet(runner, VVP_PRODUCES_OUTPUT_SERIES) ||
+      vvRunnerPropertyIsSet(runner, VVP_PRODUCES_PLOTTING_OUTPUT) ||
+      vvRunnerPropertyIsSet(runner, VVP_SECOND_INPUT_IS_UNSTRUCTURED_GRID))
+    {
+    fprintf(stderr, "%s produces or needs data other than volumes, which "
+            "vvPluginRunner does not support\n", files[0]);
+    return 4;
+    }
+  /* checked again once the GUI is set, see below */
+  if (outOfCore &&
+      (!vvRunnerPropertyIsSet(runner, VVP_SUPPORTS_PROCESSING_PIECES) ||
+       vvRunnerPropertyIsSet(runner, VVP_REQUIRES_LABEL_INPUT)))
+    {
+    fprintf(stderr, "%s cannot process pieces, it cannot run out of core\n",
+            files[0]);
+    return 1;
+    }
+
+  // read the inputs, or map the first one
+  vvRunnerVolume input;
+  vvRunnerVolume input2;
+  vvPluginMappedFile inputFile;
+  size_t inputOffset = 0;
+  if (outOfCore)
+    {
+    std::string dataFile = files[1];
+    long offset = 0;
+    int msb = vvRunnerIsBigEndian();
+    if (useRaw)
+      {
+      input = raw;
+      }
+    else if (!vvRunnerReadMetaImageHeader(files[1], input, dataFile, offset,
+                                          msb, error))
+      {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+      }
+    inputOffset = (size_t)offset;
+    if (msb != vvRunnerIsBigEndian())
+      {
+      fprintf(stderr, "%s is not in the byte order of this machine, it "
+              "cannot be mapped\n", files[1]);
+      return 1;
+      }
+    if (!inputFile.Open(dataFile.c_str(), inputOffset + 
+                        vvRunnerDataSize(input), 0))
+      {
+      fprintf(stderr, "cannot map the voxels of %s\n", files[1]);
+      return 1;
+      }
+    input.File = &inputFile;
+    input.Offset = inputOffset;
+    }
+  else if (phantom >= 0)
+    {
+    if (!vvRunnerMakePhantom(phantom, phantomSize, phantomType, 1, input))
+      {
+      fprintf(stderr, "cannot generate the phantom\n");
+      return 1;
+      }
+    }
+  else if (numFiles > 1 &&
+           !vvRunnerReadVolume(files[1], useRaw ? &raw : 0, input, error))
+    {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+    }
+  if (numFiles < 2)
+    {
+    /* --list without an input, a small volume for UpdateGUI */
+    input.ScalarType = VTK_UNSIGNED_CHAR;
+    input.NumberOfComponents = 1;
+    for (i = 0; i < 3; ++i)
+      {
+      input.Dimensions[i] = 1;
+      input.Spacing[i] = 1;
+      input.Origin[i] = 0;
+      }
+    input.Data.resize(1);
+    }
+  vvRunnerSetInput(info, input, 0);
+  if (input2File)
+    {
+    if (!vvRunnerReadVolume(input2File, useRaw ? &raw : 0, input2, error))
+      {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+      }
+    vvRunnerSetInput(info, input2, 1);
+    }
+  else if (phantom >= 0 &&
+           vvRunnerPropertyIsSet(runner, VVP_REQUIRES_SECOND_INPUT))
+    {
+    /* the same kind of phantom, from another seed */
+    vvRunnerMakePhantom(phantom, phantomSize, phantomType, 2, input2);
+    vvRunnerSetInput(info, input2, 1);
+    }
+  else if (!list && vvRunnerPropertyIsSet(runner, VVP_REQUIRES_SECOND_INPUT) &&
+           !vvRunnerPropertyIsSet(runner, VVP_SECOND_INPUT_OPTIONAL))
+    {
+    fprintf(stderr, "%s requires a second input (--input2)\n", files[0]);
+    return 1;
+    }
+  float cropping[6];
+  for (i = 0; i < 3; ++i)
+    {
+    cropping[2*i] = input.Origin[i];
+    cropping[2*i + 1] =
+      input.Origin[i] + (input.Dimensions[i] - 1)*input.Spacing[i];
+    }
+  info->CroppingPlanes = cropping;
+
+  // the GUI, the values start from the defaults as in VolView
+  info->UpdateGUI(info);
+  size_t g;
+  for (g = 0; g < runner.GUIItems.size(); ++g)
+    {
+    vvRunnerGUIItem &item = runner.GUIItems[g];
+    if (item.Set[VVP_GUI_DEFAULT] && !item.Set[VVP_GUI_VALUE])
+      {
+      vvRunnerSetGUIProperty(info, (int)g, VVP_GUI_VALUE,
+                             item.Fields[VVP_GUI_DEFAULT].c_str());
+      }
+    }
+  for (g = 0; g < guiValues.size(); ++g)
+    {
+    std::string::size_type eq = guiValues[g].find('=');
+    std::string key = guiValues[g].substr(0, eq);
+    int index = -1;
+    size_t k;
+    for (k = 0; k < runner.GUIItems.size() && eq != std::string::npos; ++k)
+      {
+      if (runner.GUIItems[k].Fields[VVP_GUI_LABEL] == key)
+        {
+        index = (int)k;
+        }
+      }
+    if (index < 0 && eq != std::string::npos && !key.empty() &&
+        key.find_first_not_of("0123456789") == std::string::npos)
+      {
+      index = atoi(key.c_str());
+      }
+    if (index < 0 || index >= (int)runner.GUIItems.size())
+      {
+      fprintf(stderr, "no GUI item for %s\n", guiValues[g].c_str());
+      return 1;
+      }
+    vvRunnerSetGUIProperty(info, index, VVP_GUI_VALUE,
+                           guiValues[g].c_str() + eq + 1);
+    }
+  info->UpdateGUI(info);
+
+  /* UpdateGUI may have changed what the plugin supports for these values */
+  if (outOfCore &&
+      (!vvRunnerPropertyIsSet(runner, VVP_SUPPORTS_PROCESSING_PIECES) ||
+       vvRunnerPropertyIsSet(runner, VVP_REQUIRES_LABEL_INPUT)))
+    {
+    fprintf(stderr, "%s cannot process pieces with these settings, it "
+            "cannot run out of core\n", files[0]);
+    return 1;
+    }
+
+  if (list)
+    {
+    static const struct { int Property; const char *Name; } properties[] =
+      {
+        { VVP_NAME, "name" },
+        { VVP_GROUP, "group" },
+        { VVP_TERSE_DOCUMENTATION, "terse documentation" },
+        { VVP_FULL_DOCUMENTATION, "full documentation" },
+        { VVP_SUPPORTS_IN_PLACE_PROCESSING, "in place" },
+        { VVP_SUPPORTS_PROCESSING_PIECES, "pieces" },
+        { VVP_REQUIRES_SECOND_INPUT, "second input" }
+      };
+    for (i = 0; i < (int)(sizeof(properties)/sizeof(properties[0])); ++i)
+      {
+      printf("%s: %s\n", properties[i].Name,
+             vvRunnerGetProperty(info, properties[i].Property));
+      }
+    for (g = 0; g < runner.GUIItems.size(); ++g)
+      {
+      const vvRunnerGUIItem &item = runner.GUIItems[g];
+      std::string hints = item.Fields[VVP_GUI_HINTS];
+      std::string::size_type nl;
+      while ((nl = hints.find('\n')) != std::string::npos)
+        {
+        hints[nl] = ' ';
+        }
+      printf("gui %d: \"%s\" %s = %s [%s]\n  %s\n", (int)g,
+             item.Fields[VVP_GUI_LABEL].c_str(),
+             item.Fields[VVP_GUI_TYPE].c_str(),
+             item.Fields[VVP_GUI_VALUE].c_str(), hints.c_str(),
+             item.Fields[VVP_GUI_HELP].c_str());
+      }
+    return 0;
+    }
+
+  // the output, on the input itself when the plugin allows it
+  vvRunnerVolume output;
+  output.ScalarType = info->OutputVolumeScalarType;
+  output.NumberOfComponents = info->OutputVolumeNumberOfComponents;
+  for (i = 0; i < 3; ++i)
+    {
+    output.Dimensions[i] = info->OutputVolumeDimensions[i];
+    output.Spacing[i] = info->OutputVolumeSpacing[i];
+    output.Origin[i] = info->OutputVolumeOrigin[i];
+    }
+  int inPlace =
+    vvRunnerPropertyIsSet(runner, VVP_SUPPORTS_IN_PLACE_PROCESSING) &&
+    output.ScalarType == input.ScalarType &&
+    output.NumberOfComponents == input.NumberOfComponents &&
+    !memcmp(output.Dimensions, input.Dimensions, sizeof(input.Dimensions));
+  int outputSize = vvRunnerScalarSize(output.ScalarType);
+  if (!outputSize || output.NumberOfComponents < 1)
+    {
+    fprintf(stderr, "the plugin did not set a valid output\n");
+    return 1;
+    }
+
+  // out of core, the output is mapped in its file, written as it goes
+  vvPluginMappedFile outputFile;
+  size_t outputOffset = 0;
+  if (outOfCore)
+    {
+    if (memcmp(output.Dimensions, input.Dimensions, sizeof(input.Dimensions)))
+      {
+      fprintf(stderr, "the plugin changes the dimensions of the volume, it "
+              "cannot run out of core\n");
+      return 1;
+      }
+    inPlace = 0;
+    std::string dataFile;
+    FILE *fp = vvRunnerWriteMetaImageHeader(files[2], output, dataFile,
+                                            error);
+    if (!fp)
+      {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+      }
+    outputOffset = (size_t)ftell(fp);
+    fclose(fp);
+    if (!outputFile.Open(dataFile.c_str(), outputOffset + 
+                         vvRunnerDataSize(output), 1))
+      {
+      fprintf(stderr, "cannot map %s\n", dataFile.c_str());
+      return 1;
+      }
+    output.File = &outputFile;
+    output.Offset = outputOffset;
+    if (slabSlices < 1)
+      {
+      size_t slice = vvRunnerDataSize(input)/input.Dimensions[2];
+      slabSlices = (int)((64 << 20)/(slice ? slice : 1));
+      }
+    int overlap = atoi(vvRunnerGetProperty(info, VVP_REQUIRED_Z_OVERLAP));
+    slabSlices = slabSlices < overlap ? overlap : slabSlices;
+    slabSlices = slabSlices < 1 ? 1 : slabSlices;
+    }
+  std::vector<unsigned char> original;
+  if (inPlace && repeat > 1)
+    {
+    original = input.Data;
+    }
+  if (!inPlace && !outOfCore)
+    {
+    output.Data.resize(vvRunnerNumberOfVoxels(output.Dimensions)*
+                       output.NumberOfComponents*outputSize);
+    }
+  std::vector<LabelImagePixelType> labels;
+  if (vvRunnerPropertyIsSet(runner, VVP_REQUIRES_LABEL_INPUT))
+    {
+    labels.resize(vvRunnerNumberOfVoxels(input.Dimensions), 0);
+    }
+
+  vtkVVProcessDataStruct pds;
+  memset(&pds, 0, sizeof(pds));
+  pds.inData = vvRunnerVoxels(input);
+  pds.inData2 = vvRunnerVoxels(input2);
+  pds.outData = inPlace ? vvRunnerVoxels(input) : vvRunnerVoxels(output);
+  pds.StartSlice = 0;
+  pds.NumberOfSlicesToProcess = input.Dimensions[2];
+  pds.inLabelData = labels.empty() ? 0 : &labels[0];
+
+  // run
+  vvRunnerInstance = &runner;
+  signal(SIGINT, vvRunnerInterrupt);
+  double memoryBefore = vvRunnerPeakMemory();
+  double best = 0;
+  double total = 0;
+  int failed = 0;
+  std::string trace;
+  if (traceFile)
+    {
+    /* the plugins append their events to this buffer when it exists */
+    vvRunnerSetBuffer(info, VVP_TRACE_BUFFER, "", 0);
+    }
+  int run;
+  for (run = 0; run < repeat && !failed && !runner.AbortProcessing; ++run)
+    {
+    if (run && inPlace)
+      {
+      memcpy(&input.Data[0], &original[0], original.size());
+      }
+    runner.Properties.erase(VVP_ERROR);
+    double start = vvPluginGetTime();
+    if (outOfCore)
+      {
+      failed = vvRunnerProcessOutOfCore(runner, &pds, input, output,
+                                        slabSlices);
+      }
+    else
+      {
+      failed = info->ProcessData(info, &pds);
+      }
+    double elapsed = vvPluginGetTime() - start;
+    failed = failed || runner.Properties.count(VVP_ERROR);
+    total += elapsed;
+    best = !run || elapsed < best ? elapsed : best;
+    if (traceFile)
+      {
+      char event[256];
+      sprintf(event, "%s{\"name\":\"run %d\",\"cat\":\"plugin\","
+              "\"ph\":\"X\",\"ts\":%.0f,\"dur\":%.0f,\"pid\":1,"
+              "\"tid\":0}", run ? ",\n" : "", run + 1, start*1e6,
+              elapsed*1e6);
+      trace += event;
+      }
+    }
+  if (traceFile)
+    {
+    size_t size = 0;
+    const char *events =
+      (const char *)vvRunnerGetBuffer(info, VVP_TRACE_BUFFER, &size);
+    if (size)
+      {
+      trace += ",\n";
+      trace.append(events, size);
+      }
+    FILE *fp = fopen(traceFile, "w");
+    if (!fp ||
+        fprintf(fp, "{\"traceEvents\":[\n%s\n],\"displayTimeUnit\":\"ms\"}\n",
+                trace.c_str()) < 0)
+      {
+      fprintf(stderr, "cannot write %s\n", traceFile);
+      }
+    if (fp)
+      {
+      fclose(fp);
+      }
+    }
+  double memoryAfter = vvRunnerPeakMemory();
+  signal(SIGINT, SIG_DFL);
+
+  // report, the timings of a run that failed or was aborted mean nothing
+  size_t voxels = vvRunnerNumberOfVoxels(input.Dimensions);
+  double seconds = best > 1e-9 ? best : 1e-9;
+  int succeeded = !failed && !runner.AbortProcessing;
+  if (succeeded)
+    {
+    printf("plugin: %s\n", vvRunnerGetProperty(info, VVP_NAME));
+    printf("input: %d x %d x %d, %s, %d component(s)%s\n",
+           input.Dimensions[0], input.Dimensions[1], input.Dimensions[2],
+           vvRunnerTypes[vvRunnerFindType(input.ScalarType, 0)].Name,
+           input.NumberOfComponents, inPlace ? ", processed in place" :
+           (outOfCore ? ", processed out of core" : ""));
+    printf("time: %.4f s", best);
+    if (run > 1)
+      {
+      printf(" (best of %d, mean %.4f s)", run, total/run);
+      }
+    printf("\nthroughput: %.2f Mvoxels/s, %.2f MB/s\n",
+           voxels*1e-6/seconds, vvRunnerDataSize(input)/1048576.0/seconds);
+    printf("peak memory: %.1f MB (%.1f MB before processing)\n",
+           memoryAfter, memoryBefore);
+    const char *report = vvRunnerGetProperty(info, VVP_REPORT_TEXT);
+    if (*report)
+      {
+      printf("report: %s\n", report);
+      }
+    }
+  if (resultsFile)
+    {
+    const char *inputName =
+      phantom >= 0 ? vvPluginPhantomName(phantom) : files[1];
+    char dimensions[64];
+    sprintf(dimensions, "%dx%dx%d", input.Dimensions[0],
+            input.Dimensions[1], input.Dimensions[2]);
+    std::vector<std::string> fields;
+    fields.push_back(vvRunnerGetProperty(info, VVP_NAME));
+    fields.push_back(files[0]);
+    fields.push_back(inputName);
+    fields.push_back(dimensions);
+    fields.push_back(
+      vvRunnerTypes[vvRunnerFindType(input.ScalarType, 0)].Name);
+    fields.push_back(vvRunnerFormat("%.0f", input.NumberOfComponents));
+    fields.push_back(vvRunnerFormat("%.0f", run));
+    if (succeeded)
+      {
+      fields.push_back(vvRunnerFormat("%.6f", best));
+      fields.push_back(vvRunnerFormat("%.6f", total/run));
+      fields.push_back(vvRunnerFormat("%.3f", voxels*1e-6/seconds));
+      fields.push_back(
+        vvRunnerFormat("%.3f", vvRunnerDataSize(input)/1048576.0/seconds));
+      fields.push_back(vvRunnerFormat("%.1f", memoryAfter));
+      }
+    else
+      {
+      fields.resize(fields.size() + 5);
+      }
+    fields.push_back(runner.AbortProcessing ? "aborted" :
+                     (failed ? "failed" : "ok"));
+    if (!vvRunnerAppendResults(resultsFile, fields))
+      {
+      fprintf(stderr, "cannot write %s\n", resultsFile);
+      }
+    }
+  if (runner.AbortProcessing)
+    {
+    fprintf(stderr, "aborted\n");
+    return 3;
+    }
+  if (failed)
+    {
+    const char *message = vvRunnerGetProperty(info, VVP_ERROR);
+    fprintf(stderr, "the plugin failed%s%s\n", *message ? ": " : "",
+            message);
+    return 2;
+    }
+
+  if (numFiles > 2 && !outOfCore)
+    {
+    if (inPlace)
+      {
+      output.Data.swap(input.Data);
+      }
+    if (!vvRunnerWriteMetaImage(files[2], output, error))
+      {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+      }
+    }
+  return 0;
+}